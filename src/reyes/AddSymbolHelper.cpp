@@ -39,7 +39,7 @@ AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*fun
     return *this;
 }
 
-AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0), ValueType type, ValueStorage storage )
+AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0), ValueType type, ValueStorage storage )
 {
     REYES_ASSERT( symbol_table_ );
 
@@ -50,7 +50,7 @@ AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*fun
     return *this;
 }
 
-AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0, std::shared_ptr<Value> a1), ValueType type, ValueStorage storage )
+AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1), ValueType type, ValueStorage storage )
 {
     REYES_ASSERT( symbol_table_ );
 
@@ -61,7 +61,7 @@ AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*fun
     return *this;
 }
 
-AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0, std::shared_ptr<Value> a1, std::shared_ptr<Value> a2), ValueType type, ValueStorage storage )
+AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1, const Value* a2), ValueType type, ValueStorage storage )
 {
     REYES_ASSERT( symbol_table_ );
 
@@ -72,7 +72,7 @@ AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*fun
     return *this;
 }
 
-AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0, std::shared_ptr<Value> a1, std::shared_ptr<Value> a2, std::shared_ptr<Value> a3), ValueType type, ValueStorage storage )
+AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1, const Value* a2, const Value* a3), ValueType type, ValueStorage storage )
 {
     REYES_ASSERT( symbol_table_ );
 
@@ -83,7 +83,7 @@ AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*fun
     return *this;
 }
 
-AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0, std::shared_ptr<Value> a1, std::shared_ptr<Value> a2, std::shared_ptr<Value> a3, std::shared_ptr<Value> a4), ValueType type, ValueStorage storage )
+AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1, const Value* a2, const Value* a3, const Value* a4), ValueType type, ValueStorage storage )
 {
     REYES_ASSERT( symbol_table_ );
 
@@ -94,7 +94,7 @@ AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*fun
     return *this;
 }
 
-AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0, std::shared_ptr<Value> a1, std::shared_ptr<Value> a2, std::shared_ptr<Value> a3, std::shared_ptr<Value> a4, std::shared_ptr<Value> a5), ValueType type, ValueStorage storage )
+AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1, const Value* a2, const Value* a3, const Value* a4, const Value* a5), ValueType type, ValueStorage storage )
 {
     REYES_ASSERT( symbol_table_ );
     
@@ -105,6 +105,18 @@ AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*fun
     return *this;    
 }
 
+AddSymbolHelper& AddSymbolHelper::operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1, const Value* a2, const Value* a3, Value* a4, Value* a5), ValueType type, ValueStorage storage )
+{
+    REYES_ASSERT( symbol_table_ );
+    
+    symbol_ = symbol_table_->add_symbol( identifier );
+    symbol_->set_type( type );
+    symbol_->set_storage( storage );
+    symbol_->set_function( reinterpret_cast<void*>(function) );
+    symbol_->set_writes_arguments( true );
+    return *this;    
+}
+
 AddSymbolHelper& AddSymbolHelper::operator()( ValueType type, ValueStorage storage )
 {
     REYES_ASSERT( symbol_ );
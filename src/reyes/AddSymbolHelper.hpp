@@ -28,12 +28,13 @@ public:
     AddSymbolHelper( SymbolTable* symbol_table );
     AddSymbolHelper& operator()( const char* identifier, ValueType type, ValueStorage storage = STORAGE_VARYING );
     AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&), ValueType type, ValueStorage storage = STORAGE_VARYING );
-    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0), ValueType type, ValueStorage storage = STORAGE_VARYING );
-    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0, std::shared_ptr<Value> a1), ValueType type, ValueStorage storage = STORAGE_VARYING );
-    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0, std::shared_ptr<Value> a1, std::shared_ptr<Value> a2), ValueType type, ValueStorage storage = STORAGE_VARYING );
-    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0, std::shared_ptr<Value> a1, std::shared_ptr<Value> a2, std::shared_ptr<Value> a3), ValueType type, ValueStorage storage = STORAGE_VARYING );
-    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0, std::shared_ptr<Value> a1, std::shared_ptr<Value> a2, std::shared_ptr<Value> a3, std::shared_ptr<Value> a4), ValueType type, ValueStorage storage = STORAGE_VARYING );
-    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, std::shared_ptr<Value> a0, std::shared_ptr<Value> a1, std::shared_ptr<Value> a2, std::shared_ptr<Value> a3, std::shared_ptr<Value> a4, std::shared_ptr<Value> a5), ValueType type, ValueStorage storage = STORAGE_VARYING );
+    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0), ValueType type, ValueStorage storage = STORAGE_VARYING );
+    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1), ValueType type, ValueStorage storage = STORAGE_VARYING );
+    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1, const Value* a2), ValueType type, ValueStorage storage = STORAGE_VARYING );
+    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1, const Value* a2, const Value* a3), ValueType type, ValueStorage storage = STORAGE_VARYING );
+    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1, const Value* a2, const Value* a3, const Value* a4), ValueType type, ValueStorage storage = STORAGE_VARYING );
+    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1, const Value* a2, const Value* a3, const Value* a4, const Value* a5), ValueType type, ValueStorage storage = STORAGE_VARYING );
+    AddSymbolHelper& operator()( const char* identifier, void (*function)(const Renderer&, const Grid&, Value* a0, const Value* a1, const Value* a2, const Value* a3, Value* a4, Value* a5), ValueType type, ValueStorage storage = STORAGE_VARYING );
     AddSymbolHelper& operator()( ValueType type, ValueStorage storage = STORAGE_VARYING );
     AddSymbolHelper& operator()( const char* identifier, float value );
 };
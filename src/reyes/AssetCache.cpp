@@ -0,0 +1,294 @@
+//
+// AssetCache.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "AssetCache.hpp"
+#include "Shader.hpp"
+#include "ShaderCache.hpp"
+#include "SymbolTable.hpp"
+#include "DeferredErrorPolicy.hpp"
+#include "Texture.hpp"
+#include "assert.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using std::map;
+using std::vector;
+using std::string;
+using std::mutex;
+using std::lock_guard;
+using std::thread;
+using std::atomic;
+using std::shared_ptr;
+using std::make_pair;
+using std::find;
+using std::min;
+using std::max;
+using namespace reyes;
+
+AssetCache::AssetCache()
+: mutex_(),
+  shaders_(),
+  textures_(),
+  shader_cache_()
+{
+}
+
+AssetCache::~AssetCache()
+{
+}
+
+/**
+// Load or find an existing shader.
+//
+// The shader is compiled outside of the lock so that Renderers compiling
+// different shaders don't serialize on each other.  If two threads race to
+// compile the same shader then the first shader added to the cache wins and
+// is returned to both.  Shaders are loaded from, and saved to, the on disk
+// shader cache if one has been set.
+//
+// @param filename
+//  The filename of the shader to find or load (assumed not null).
+//
+// @param symbol_table
+//  The SymbolTable to use when compiling the shader (owned by the calling
+//  thread's Renderer).
+//
+// @param error_policy
+//  The ErrorPolicy to report compilation errors to.
+//
+// @return
+//  The shader.
+*/
+std::shared_ptr<const Shader> AssetCache::shader( const char* filename, SymbolTable& symbol_table, ErrorPolicy& error_policy )
+{
+    REYES_ASSERT( filename );
+
+    shared_ptr<const Shader> shader = find_shader( filename );
+    if ( !shader )
+    {
+        shared_ptr<const ShaderCache> shader_cache = AssetCache::shader_cache();
+        if ( shader_cache )
+        {
+            shader = shader_cache->shader( filename, symbol_table, error_policy );
+        }
+        else
+        {
+            shader.reset( new Shader(filename, symbol_table, error_policy) );
+        }
+        lock_guard<mutex> lock( mutex_ );
+        shader = shaders_.insert( make_pair(string(filename), shader) ).first->second;
+    }
+    return shader;
+}
+
+/**
+// Load or find existing shaders compiling any that aren't already loaded
+// concurrently on a pool of threads.
+//
+// Each shader is compiled with its own SymbolTable, sharing only the 
+// built-in functions and constants of \e symbol_table, and reports errors
+// to its own DeferredErrorPolicy.  Once every shader has been compiled the
+// errors are reported to \e error_policy in the order that the shaders are
+// listed in \e filenames and the compiled shaders are added to the cache 
+// together.
+//
+// @param filenames
+//  The filenames of the shaders to find or load.
+//
+// @param symbol_table
+//  The SymbolTable whose built-in functions and constants are used to 
+//  compile the shaders (owned by the calling thread's Renderer).
+//
+// @param error_policy
+//  The ErrorPolicy to report compilation errors to.
+//
+// @param threads
+//  The maximum number of threads to compile shaders on, including the 
+//  calling thread, or 0 to use one thread per hardware thread.
+//
+// @return
+//  The shaders in the same order as \e filenames.
+*/
+std::vector<std::shared_ptr<const Shader>> AssetCache::shaders( const std::vector<std::string>& filenames, const SymbolTable& symbol_table, ErrorPolicy& error_policy, int threads )
+{
+    REYES_ASSERT( threads >= 0 );
+
+    vector<shared_ptr<const Shader>> shaders( filenames.size() );
+    vector<string> compile_filenames;
+    for ( unsigned int i = 0; i < filenames.size(); ++i )
+    {
+        shaders[i] = find_shader( filenames[i].c_str() );
+        if ( !shaders[i] && find(compile_filenames.begin(), compile_filenames.end(), filenames[i]) == compile_filenames.end() )
+        {
+            compile_filenames.push_back( filenames[i] );
+        }
+    }
+
+    const int count = int(compile_filenames.size());
+    vector<shared_ptr<const Shader>> compiled_shaders( count );
+    vector<DeferredErrorPolicy> error_policies( count );
+    shared_ptr<const ShaderCache> shader_cache = AssetCache::shader_cache();
+    atomic<int> next_index( 0 );
+    auto compile_shaders = [&]()
+    {
+        int index = next_index++;
+        while ( index < count )
+        {
+            const char* filename = compile_filenames[index].c_str();
+            SymbolTable compile_symbol_table( &symbol_table );
+            if ( shader_cache )
+            {
+                compiled_shaders[index] = shader_cache->shader( filename, compile_symbol_table, error_policies[index] );
+            }
+            else
+            {
+                compiled_shaders[index].reset( new Shader(filename, compile_symbol_table, error_policies[index]) );
+            }
+            index = next_index++;
+        }
+    };
+
+    if ( threads == 0 )
+    {
+        threads = max( int(thread::hardware_concurrency()), 1 );
+    }
+    vector<thread> workers;
+    for ( int i = 1; i < min(threads, count); ++i )
+    {
+        workers.push_back( thread(compile_shaders) );
+    }
+    compile_shaders();
+    for ( vector<thread>::iterator i = workers.begin(); i != workers.end(); ++i )
+    {
+        i->join();
+    }
+
+    for ( vector<DeferredErrorPolicy>::const_iterator i = error_policies.begin(); i != error_policies.end(); ++i )
+    {
+        i->report( error_policy );
+    }
+
+    lock_guard<mutex> lock( mutex_ );
+    for ( unsigned int i = 0; i < filenames.size(); ++i )
+    {
+        if ( !shaders[i] )
+        {
+            int index = int(find(compile_filenames.begin(), compile_filenames.end(), filenames[i]) - compile_filenames.begin());
+            REYES_ASSERT( index < count );
+            shaders[i] = shaders_.insert( make_pair(filenames[i], compiled_shaders[index]) ).first->second;
+        }
+    }
+    return shaders;
+}
+
+/**
+// Find an existing shader.
+//
+// @param filename
+//  The filename of the shader to find (assumed not null).
+//
+// @return
+//  The shader or null if no matching shader was found.
+*/
+std::shared_ptr<const Shader> AssetCache::find_shader( const char* filename ) const
+{
+    REYES_ASSERT( filename );
+
+    lock_guard<mutex> lock( mutex_ );
+    map<string, shared_ptr<const Shader>>::const_iterator i = shaders_.find( filename );
+    return i != shaders_.end() ? i->second : shared_ptr<const Shader>();
+}
+
+/**
+// Load or find an existing texture.
+//
+// @param filename
+//  The path to the texture to find or load (assumed not null).
+//
+// @param type
+//  The type of texture to load if the texture isn't already loaded.
+//
+// @param error_policy
+//  The ErrorPolicy to report loading errors to.
+//
+// @return
+//  The texture.
+*/
+std::shared_ptr<const Texture> AssetCache::texture( const char* filename, TextureType type, ErrorPolicy* error_policy )
+{
+    REYES_ASSERT( filename );
+
+    shared_ptr<const Texture> texture = find_texture( filename );
+    if ( !texture )
+    {
+        texture.reset( new Texture(filename, type, error_policy) );
+        lock_guard<mutex> lock( mutex_ );
+        texture = textures_.insert( make_pair(string(filename), texture) ).first->second;
+    }
+    return texture;
+}
+
+/**
+// Find an existing texture.
+//
+// @param filename
+//  The path to the texture to find (assumed not null).
+//
+// @return
+//  The texture or null if no matching texture was found.
+*/
+std::shared_ptr<const Texture> AssetCache::find_texture( const char* filename ) const
+{
+    REYES_ASSERT( filename );
+
+    lock_guard<mutex> lock( mutex_ );
+    map<string, shared_ptr<const Texture>>::const_iterator i = textures_.find( filename );
+    return i != textures_.end() ? i->second : shared_ptr<const Texture>();
+}
+
+/**
+// Release this cache's references to its shaders and textures.
+//
+// Assets still in use by Renderers remain valid until those Renderers
+// are destroyed.
+*/
+void AssetCache::clear()
+{
+    lock_guard<mutex> lock( mutex_ );
+    shaders_.clear();
+    textures_.clear();
+}
+
+/**
+// Set the directory that compiled shaders are cached in on disk.
+//
+// @param directory
+//  The directory to cache compiled shaders in (assumed to exist) or null 
+//  to stop caching compiled shaders on disk.
+*/
+void AssetCache::set_shader_cache_directory( const char* directory )
+{
+    shared_ptr<const ShaderCache> shader_cache;
+    if ( directory )
+    {
+        shader_cache.reset( new ShaderCache(directory) );
+    }
+    lock_guard<mutex> lock( mutex_ );
+    shader_cache_ = shader_cache;
+}
+
+/**
+// Get the on disk cache of compiled shaders.
+//
+// @return
+//  The shader cache or null if compiled shaders aren't cached on disk.
+*/
+std::shared_ptr<const ShaderCache> AssetCache::shader_cache() const
+{
+    lock_guard<mutex> lock( mutex_ );
+    return shader_cache_;
+}
@@ -0,0 +1,53 @@
+#ifndef REYES_ASSETCACHE_HPP_INCLUDED
+#define REYES_ASSETCACHE_HPP_INCLUDED
+
+#include "TextureType.hpp"
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace reyes
+{
+
+class Shader;
+class ShaderCache;
+class Texture;
+class SymbolTable;
+class ErrorPolicy;
+
+/**
+// A thread-safe cache of shaders and textures loaded from files that can be
+// shared between Renderers rendering concurrently on different threads.
+//
+// Shaders and textures are immutable once loaded so the cache hands out
+// shared pointers to const objects.  Compiled shaders can also be cached 
+// on disk so that later runs load them without parsing (see ShaderCache).
+// Renderers hold references to the assets that they use so assets remain 
+// valid for as long as any Renderer uses them even if the cache is cleared.
+*/
+class AssetCache
+{
+    mutable std::mutex mutex_; ///< Guards access to the shader and texture maps.
+    std::map<std::string, std::shared_ptr<const Shader>> shaders_; ///< The shaders that have been loaded (by filename).
+    std::map<std::string, std::shared_ptr<const Texture>> textures_; ///< The textures that have been loaded (by filename).
+    std::shared_ptr<const ShaderCache> shader_cache_; ///< The on disk cache that compiled shaders are loaded from and saved to (null if there is none).
+
+public:
+    AssetCache();
+    ~AssetCache();
+
+    std::shared_ptr<const Shader> shader( const char* filename, SymbolTable& symbol_table, ErrorPolicy& error_policy );
+    std::vector<std::shared_ptr<const Shader>> shaders( const std::vector<std::string>& filenames, const SymbolTable& symbol_table, ErrorPolicy& error_policy, int threads = 0 );
+    std::shared_ptr<const Shader> find_shader( const char* filename ) const;
+    std::shared_ptr<const Texture> texture( const char* filename, TextureType type, ErrorPolicy* error_policy );
+    std::shared_ptr<const Texture> find_texture( const char* filename ) const;
+    void clear();
+    void set_shader_cache_directory( const char* directory );
+    std::shared_ptr<const ShaderCache> shader_cache() const;
+};
+
+}
+
+#endif
@@ -7,13 +7,22 @@
 #include "Attributes.hpp"
 #include "Value.hpp"
 #include "Grid.hpp"
+#include "Identifier.hpp"
 #include "Shader.hpp"
+#include "ShaderGlobal.hpp"
+#include "Light.hpp"
+#include "LightInfluence.hpp"
 #include "VirtualMachine.hpp"
 #include <math/vec2.ipp>
 #include <math/vec3.ipp>
 #include <math/mat4x4.ipp>
 #include "assert.hpp"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
 
+using std::min;
+using std::max;
 using std::map;
 using std::pair;
 using std::string;
@@ -33,6 +42,7 @@ Attributes::Attributes( VirtualMachine* virtual_machine )
   geometry_left_handed_( true ),
   color_( 0.0f, 0.0f, 0.0f ),
   opacity_( 1.0f, 1.0f, 1.0f ),
+  light_cutoff_( 0.0f ),
   u_basis_( NULL ),
   v_basis_( NULL ),
   displacement_parameters_( NULL ),
@@ -41,12 +51,15 @@ Attributes::Attributes( VirtualMachine* virtual_machine )
   surface_shader_( NULL ),
   light_shaders_(),
   active_light_shaders_(),
+  light_influences_(),
+  light_grid_( NULL ),
   transforms_(),
-  named_transforms_()
+  named_transforms_( IDENTIFIER_COUNT )
 {
     REYES_ASSERT( virtual_machine_ );
     displacement_parameters_ = new Grid();
     surface_parameters_ = new Grid();
+    light_grid_ = new Grid();
 
     const unsigned int LIGHT_SHADERS_RESERVE = 32;
     light_shaders_.reserve( LIGHT_SHADERS_RESERVE );
@@ -65,6 +78,7 @@ Attributes::Attributes( const Attributes& attributes )
   geometry_left_handed_( attributes.geometry_left_handed_ ),
   color_( attributes.color_ ),
   opacity_( attributes.opacity_ ),
+  light_cutoff_( attributes.light_cutoff_ ),
   u_basis_( attributes.u_basis_ ),
   v_basis_( attributes.v_basis_ ),
   displacement_parameters_( NULL ),
@@ -73,16 +87,22 @@ Attributes::Attributes( const Attributes& attributes )
   surface_shader_( attributes.surface_shader_ ),
   light_shaders_( attributes.light_shaders_ ),
   active_light_shaders_( attributes.active_light_shaders_ ),
+  light_influences_( attributes.light_influences_ ),
+  light_grid_( NULL ),
   transforms_( attributes.transforms_ ),
   named_transforms_( attributes.named_transforms_ )
 {
     REYES_ASSERT( virtual_machine_ );
     displacement_parameters_ = new Grid( *attributes.displacement_parameters_ );
     surface_parameters_ = new Grid( *attributes.surface_parameters_ );
+    light_grid_ = new Grid();
 }
 
 Attributes::~Attributes()
 {
+    delete light_grid_;
+    light_grid_ = NULL;
+
     delete surface_parameters_;
     surface_parameters_ = NULL;
     
@@ -125,6 +145,11 @@ const math::vec3& Attributes::opacity() const
     return opacity_;
 }
 
+float Attributes::light_cutoff() const
+{
+    return light_cutoff_;
+}
+
 const math::vec4* Attributes::u_basis() const
 {
     return u_basis_;
@@ -171,6 +196,12 @@ void Attributes::set_opacity( const math::vec3& opacity )
     opacity_ = opacity;
 }
 
+void Attributes::set_light_cutoff( float light_cutoff )
+{
+    REYES_ASSERT( light_cutoff >= 0.0f );
+    light_cutoff_ = light_cutoff > 0.0f ? light_cutoff : 0.0f;
+}
+
 void Attributes::set_u_basis( const math::vec4* u_basis )
 {
     REYES_ASSERT( u_basis );
@@ -188,31 +219,31 @@ void Attributes::displacement_shade( Grid& grid )
     if ( displacement_shader_ )
     {
         grid.generate_normals( geometry_left_handed() );
-        add_coordinate_system( "current", math::identity() );
-        add_coordinate_system( "shader", displacement_parameters_->get_transform() );
-        virtual_machine_->shade( grid, *displacement_parameters_, *displacement_shader_ );
-        remove_coordinate_system( "shader" );
-        remove_coordinate_system( "current" );
+        add_coordinate_system( IDENTIFIER_CURRENT, math::identity() );
+        add_coordinate_system( IDENTIFIER_SHADER, displacement_parameters_->get_transform() );
+        virtual_machine_->shade( grid, *displacement_parameters_, *displacement_shader_->specialization(*displacement_parameters_) );
+        remove_coordinate_system( IDENTIFIER_SHADER );
+        remove_coordinate_system( IDENTIFIER_CURRENT );
         grid.generate_normals(  geometry_left_handed(), true );
     }
 }
 
-void Attributes::set_displacement_shader( Shader* displacement_shader, const math::mat4x4& camera_transform )
+void Attributes::set_displacement_shader( const Shader* displacement_shader, const math::mat4x4& camera_transform )
 {
     displacement_parameters_->clear();
     displacement_shader_ = displacement_shader;
     if ( displacement_shader_ )
     {
         displacement_parameters_->set_transform( camera_transform * transforms_.back() );
-        add_coordinate_system( "current", math::identity() );
-        add_coordinate_system( "shader", displacement_parameters_->get_transform() );
+        add_coordinate_system( IDENTIFIER_CURRENT, math::identity() );
+        add_coordinate_system( IDENTIFIER_SHADER, displacement_parameters_->get_transform() );
         virtual_machine_->initialize( *displacement_parameters_, *displacement_shader_ );
-        remove_coordinate_system( "shader" );
-        remove_coordinate_system( "current" );
+        remove_coordinate_system( IDENTIFIER_SHADER );
+        remove_coordinate_system( IDENTIFIER_CURRENT );
     }
 }
 
-Shader* Attributes::displacement_shader() const
+const Shader* Attributes::displacement_shader() const
 {
     return displacement_shader_;
 }
@@ -226,61 +257,78 @@ void Attributes::surface_shade( Grid& grid )
 {
     if ( surface_shader_ && !matte_ )
     {   
-        grid.generate_normals( geometry_left_handed() );
-        light_shade( grid );
+        // Only set up the global variables that the surface shader uses.  The
+        // surface color and opacity are passed as uniform values and only
+        // expanded by the VirtualMachine if the shader needs them varying.
+        // Normals are also generated when any active light shader reads "N"
+        // as the light shaders are run against the same grid.
+        int globals = surface_shader_->globals();
+        int light_globals = 0;
+        if ( surface_shader_->uses_lights() )
+        {
+            for ( vector<Grid*>::const_iterator i = active_light_shaders_.begin(); i != active_light_shaders_.end(); ++i )
+            {
+                REYES_ASSERT( *i && (*i)->shader() );
+                light_globals |= (*i)->shader()->globals();
+            }
+        }
+        if ( (globals | light_globals) & SHADER_GLOBAL_N )
+        {
+            grid.generate_normals( geometry_left_handed() );
+        }
 
-        Value& incident_color = grid.value( "Ci", TYPE_COLOR );
+        if ( surface_shader_->uses_lights() )
+        {
+            light_shade( grid );
+        }
+
+        Value& incident_color = grid.value( IDENTIFIER_CI, TYPE_COLOR );
         incident_color.zero();
 
-        Value& incident_opacity = grid.value( "Oi", TYPE_COLOR );
+        Value& incident_opacity = grid.value( IDENTIFIER_OI, TYPE_COLOR );
         incident_opacity.zero();
 
         // @todo
         //  Adjust the 'I' value in a surface shader if 'P' is not in eye space.
-        if ( !grid.find_value("I") )
+        if ( (globals & SHADER_GLOBAL_I) && !grid.find_value(IDENTIFIER_I) )
         {
-            grid.insert_value( "I", grid.find_value("P") );
+            grid.insert_value( IDENTIFIER_I, grid.find_value(IDENTIFIER_P) );
         }
         
-        Value& P = grid["P"];
-        Value& Os = grid.value( "Os", TYPE_COLOR );
-        vec3* values = Os.vec3_values();
-        for ( unsigned int i = 0; i < P.size(); ++i )
+        if ( globals & SHADER_GLOBAL_OS )
         {
-            values[i] = opacity_;
+            grid.value( IDENTIFIER_OS, TYPE_COLOR ) = opacity_;
         }
 
-        Value& Cs = grid.value( "Cs", TYPE_COLOR );
-        values = Cs.vec3_values();
-        for ( unsigned int i = 0; i < P.size(); ++i )
+        if ( globals & SHADER_GLOBAL_CS )
         {
-            values[i] = color_;
+            grid.value( IDENTIFIER_CS, TYPE_COLOR ) = color_;
         }
 
-        add_coordinate_system( "current", math::identity() );
-        add_coordinate_system( "shader", surface_parameters_->get_transform() );        
-        virtual_machine_->shade( grid, *surface_parameters_, *surface_shader_ );                
-        remove_coordinate_system( "shader" );
-        remove_coordinate_system( "current" );
+        add_coordinate_system( IDENTIFIER_CURRENT, math::identity() );
+        add_coordinate_system( IDENTIFIER_SHADER, surface_parameters_->get_transform() );        
+        virtual_machine_->shade( grid, *surface_parameters_, *surface_shader_->specialization(*surface_parameters_) );
+        remove_coordinate_system( IDENTIFIER_SHADER );
+        remove_coordinate_system( IDENTIFIER_CURRENT );
     }
 }
 
-void Attributes::set_surface_shader( Shader* surface_shader, const math::mat4x4& camera_transform )
+void Attributes::set_surface_shader( const Shader* surface_shader, const math::mat4x4& camera_transform )
 {
     surface_parameters_->clear();
     surface_shader_ = surface_shader;
     if ( surface_shader_ )
     {
         surface_parameters_->set_transform( camera_transform * transforms_.back() );
-        add_coordinate_system( "current", math::identity() );
-        add_coordinate_system( "shader", surface_parameters_->get_transform() );
+        add_coordinate_system( IDENTIFIER_CURRENT, math::identity() );
+        add_coordinate_system( IDENTIFIER_SHADER, surface_parameters_->get_transform() );
         virtual_machine_->initialize( *surface_parameters_, *surface_shader_ );
-        remove_coordinate_system( "shader" );
-        remove_coordinate_system( "current" );
+        remove_coordinate_system( IDENTIFIER_SHADER );
+        remove_coordinate_system( IDENTIFIER_CURRENT );
     }
 }
 
-Shader* Attributes::surface_shader() const
+const Shader* Attributes::surface_shader() const
 {
     return surface_shader_;
 }
@@ -292,24 +340,67 @@ Grid& Attributes::surface_parameters() const
 
 void Attributes::light_shade( Grid& grid )
 {
+    // Bound the grid with a sphere so that lights whose influence doesn't
+    // reach the grid can be skipped without running their light shaders.
+    shared_ptr<Value> P = grid.find_value( IDENTIFIER_P );
+    REYES_ASSERT( P );
+    vec3 minimum( FLT_MAX, FLT_MAX, FLT_MAX );
+    vec3 maximum( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+    const vec3* positions = P->vec3_values();
+    const vec3* positions_end = positions + P->size();
+    for ( const vec3* i = positions; i != positions_end; ++i )
+    {
+        minimum.x = min( minimum.x, i->x );
+        minimum.y = min( minimum.y, i->y );
+        minimum.z = min( minimum.z, i->z );        
+        maximum.x = max( maximum.x, i->x );
+        maximum.y = max( maximum.y, i->y );
+        maximum.z = max( maximum.z, i->z );
+    }
+    const vec3 center = (minimum + maximum) * 0.5f;
+    const float radius = length( maximum - minimum ) * 0.5f;
+
     grid.reserve_lights( light_shaders_.size() );    
     for ( vector<Grid*>::const_iterator i = active_light_shaders_.begin(); i != active_light_shaders_.end(); ++i )
     {
         Grid* light_parameters = *i;
         REYES_ASSERT( light_parameters );
-    
-        Shader* shader = light_parameters->shader();
-        REYES_ASSERT( shader );
-        
-        Grid light_grid;
-        light_grid.resize( grid.width(), grid.height() );
-        light_grid.insert_value( "Ps", grid.find_value("P") );
+
+        map<const Grid*, shared_ptr<LightInfluence> >::const_iterator j = light_influences_.find( light_parameters );
+        REYES_ASSERT( j != light_influences_.end() );
+        LightInfluence* light_influence = j->second.get();
+        if ( !light_influence->inferred(light_cutoff_) )
+        {
+            infer_light_influence( *light_parameters, light_influence );
+        }
+
+        if ( !light_influence->affects(center, radius) )
+        {
+            continue;
+        }
+
+        const vector<shared_ptr<Light> >& uniform_lights = light_influence->uniform_lights();
+        if ( !uniform_lights.empty() )
+        {
+            for ( vector<shared_ptr<Light> >::const_iterator j = uniform_lights.begin(); j != uniform_lights.end(); ++j )
+            {
+                grid.add_light( *j );
+            }
+            continue;
+        }
         
-        add_coordinate_system( "current", math::identity() );
-        add_coordinate_system( "shader", light_parameters->get_transform() );
-        virtual_machine_->shade( light_grid, *light_parameters, *shader );
-        remove_coordinate_system( "shader" );
-        remove_coordinate_system( "current" );
+        // The light grid is cleared once its lights are copied so that it
+        // doesn't keep "P", "N", and the lights from being recycled along 
+        // with the grid that they belong to.
+        Grid& light_grid = *light_grid_;
+        light_grid.resize( grid );
+        light_grid.insert_value( IDENTIFIER_PS, P );
+        shared_ptr<Value> N = grid.find_value( IDENTIFIER_N );
+        if ( N )
+        {
+            light_grid.insert_value( IDENTIFIER_N, N );
+        }
+        run_light_shader( *light_parameters, light_grid );
         
         const vector<shared_ptr<Light> >& lights = light_grid.lights();
         for ( vector<shared_ptr<Light> >::const_iterator i = lights.begin(); i != lights.end(); ++i )
@@ -317,23 +408,25 @@ void Attributes::light_shade( Grid& grid )
             const shared_ptr<Light>& light = *i;      
             grid.add_light( light );
         }
+        light_grid.clear();
     }
 }
 
-Grid& Attributes::add_light_shader( Shader* light_shader, const math::mat4x4& camera_transform )
+Grid& Attributes::add_light_shader( const Shader* light_shader, const math::mat4x4& camera_transform )
 {
     REYES_ASSERT( light_shader );
     
     shared_ptr<Grid> light_parameters( new Grid(light_shader) );
     light_shaders_.push_back( make_pair(light_shader, light_parameters) );
     active_light_shaders_.push_back( light_parameters.get() );
+    light_influences_[light_parameters.get()].reset( new LightInfluence() );
 
     light_parameters->set_transform( camera_transform * transforms_.back() );
-    add_coordinate_system( "current", math::identity() );
-    add_coordinate_system( "shader", light_parameters->get_transform() );
+    add_coordinate_system( IDENTIFIER_CURRENT, math::identity() );
+    add_coordinate_system( IDENTIFIER_SHADER, light_parameters->get_transform() );
     virtual_machine_->initialize( *light_parameters, *light_shader );
-    remove_coordinate_system( "shader" );
-    remove_coordinate_system( "current" );
+    remove_coordinate_system( IDENTIFIER_SHADER );
+    remove_coordinate_system( IDENTIFIER_CURRENT );
     
     return *light_parameters;
 }
@@ -414,23 +507,232 @@ const math::mat4x4& Attributes::transform() const
     return transforms_.back();
 }
 
+Attributes::NamedTransform::NamedTransform()
+: transform_( math::identity() ),
+  inverse_( math::identity() ),
+  inverted_( true ),
+  defined_( false )
+{
+}
+
 void Attributes::add_coordinate_system( const char* name, const math::mat4x4& transform )
 {
     REYES_ASSERT( name );
+    add_coordinate_system( intern_identifier(name), transform );
+}
+
+/**
+// Add a named coordinate system by the interned identifier of its name.
+//
+// The inverse of the transform is only calculated the first time that it is
+// needed (see transform_to()) so coordinate systems that are redefined for
+// every grid, like "shader", are cheap to add when shaders don't transform 
+// to them.
+//
+// @param identifier
+//  The interned identifier of the name of the coordinate system.
+//
+// @param transform
+//  The transform from the named coordinate system to "camera" space.
+*/
+void Attributes::add_coordinate_system( int identifier, const math::mat4x4& transform )
+{
+    REYES_ASSERT( identifier >= 0 );
     REYES_ASSERT( !transforms_.empty() );
-    named_transforms_[name] = transform;
+    if ( identifier >= int(named_transforms_.size()) )
+    {
+        named_transforms_.resize( identifier + 1 );
+    }
+    NamedTransform& named_transform = named_transforms_[identifier];
+    named_transform.transform_ = transform;
+    named_transform.inverted_ = false;
+    named_transform.defined_ = true;
 }
 
 void Attributes::remove_coordinate_system( const char* name )
 {
     REYES_ASSERT( name );
-    REYES_ASSERT( named_transforms_.find(name) != named_transforms_.end() );
-    named_transforms_.erase( name );
+    remove_coordinate_system( intern_identifier(name) );
+}
+
+void Attributes::remove_coordinate_system( int identifier )
+{
+    REYES_ASSERT( identifier >= 0 && identifier < int(named_transforms_.size()) );
+    REYES_ASSERT( named_transforms_[identifier].defined_ );
+    named_transforms_[identifier] = NamedTransform();
 }
 
-math::mat4x4 Attributes::transform_from( const std::string& name ) const
+const math::mat4x4& Attributes::transform_from( const std::string& name ) const
 {
-    REYES_ASSERT( named_transforms_.find(name) != named_transforms_.end() );
-    map<string, math::mat4x4>::const_iterator i = named_transforms_.find( name );
-    return i != named_transforms_.end() ? i->second : math::identity();    
+    return transform_from( intern_identifier(name) );
+}
+
+/**
+// Get the transform from a named coordinate system to "camera" space.
+//
+// @param identifier
+//  The interned identifier of the name of the coordinate system.
+//
+// @return
+//  The transform to "camera" space or the identity if the coordinate system
+//  isn't defined.
+*/
+const math::mat4x4& Attributes::transform_from( int identifier ) const
+{
+    REYES_ASSERT( identifier >= 0 && identifier < int(named_transforms_.size()) && named_transforms_[identifier].defined_ );
+    if ( identifier >= 0 && identifier < int(named_transforms_.size()) )
+    {
+        return named_transforms_[identifier].transform_;
+    }
+    static const math::mat4x4 IDENTITY = math::identity();
+    return IDENTITY;
+}
+
+/**
+// Get the transform from "camera" space to a named coordinate system.
+//
+// The inverse is calculated the first time it is needed after the 
+// coordinate system is added and is then reused for every later transform
+// to the same coordinate system.
+//
+// @param identifier
+//  The interned identifier of the name of the coordinate system.
+//
+// @return
+//  The transform from "camera" space or the identity if the coordinate 
+//  system isn't defined.
+*/
+const math::mat4x4& Attributes::transform_to( int identifier ) const
+{
+    REYES_ASSERT( identifier >= 0 && identifier < int(named_transforms_.size()) && named_transforms_[identifier].defined_ );
+    if ( identifier >= 0 && identifier < int(named_transforms_.size()) )
+    {
+        const NamedTransform& named_transform = named_transforms_[identifier];
+        if ( !named_transform.inverted_ )
+        {
+            named_transform.inverse_ = inverse( named_transform.transform_ );
+            named_transform.inverted_ = true;
+        }
+        return named_transform.inverse_;
+    }
+    static const math::mat4x4 IDENTITY = math::identity();
+    return IDENTITY;
+}
+
+/**
+// Run a light shader against a grid.
+//
+// @param light_parameters
+//  The parameters of the light shader to run (returned from an earlier call
+//  to add_light_shader()).
+//
+// @param light_grid
+//  The grid to run the light shader against (assumed to provide "Ps").
+*/
+void Attributes::run_light_shader( Grid& light_parameters, Grid& light_grid )
+{
+    REYES_ASSERT( light_parameters.shader() );
+    const Shader* shader = light_parameters.shader()->specialization( light_parameters );
+
+    add_coordinate_system( IDENTIFIER_CURRENT, math::identity() );
+    add_coordinate_system( IDENTIFIER_SHADER, light_parameters.get_transform() );
+    virtual_machine_->shade( light_grid, light_parameters, *shader );
+    remove_coordinate_system( IDENTIFIER_SHADER );
+    remove_coordinate_system( IDENTIFIER_CURRENT );
+}
+
+/**
+// Infer the influence of a light shader by running it against a single
+// probe vertex.
+//
+// Only light shaders that contain exactly one illuminate statement and no
+// solar statements are bounded; the cone of that statement bounds the 
+// light's influence by direction.  The probe only executes the statements
+// chosen for its own position so a shader with more than one statement 
+// might light other positions through a statement that the probe missed.  When a cutoff intensity is set the light is also probed at
+// one and two units along its axis and, if its intensity falls off at least
+// as fast as the inverse square of distance, its influence is bounded by the
+// distance at which its intensity drops below the cutoff.
+//
+// The light's position and intensity are assumed not to depend on the 
+// surface position passed in "Ps".
+//
+// Light shaders that don't read "Ps" or "N" return the same lights for 
+// every grid.  The lights returned for the probe vertex are kept with 
+// uniform color and opacity and shared between all grids.
+//
+// @param light_parameters
+//  The parameters of the light shader to infer the influence of.
+//
+// @param light_influence
+//  The LightInfluence to store the inferred influence in (assumed not null).
+*/
+void Attributes::infer_light_influence( Grid& light_parameters, LightInfluence* light_influence )
+{
+    REYES_ASSERT( light_influence );
+
+    // Light shaders that read "N" can't be probed with positions alone so
+    // their influence isn't bounded.
+    const Shader* shader = light_parameters.shader();
+    REYES_ASSERT( shader );
+    if ( shader->globals() & SHADER_GLOBAL_N )
+    {
+        light_influence->set_unbounded( light_cutoff_ );
+        return;
+    }
+
+    Grid probe_grid;
+    probe_grid.resize( 1, 1 );
+    probe_grid.value( IDENTIFIER_PS, TYPE_POINT ).zero();
+    run_light_shader( light_parameters, probe_grid );
+
+    const vector<shared_ptr<Light> >& lights = probe_grid.lights();
+    if ( shader->solar_and_illuminate_statements() != 1 || lights.size() != 1 || (lights.front()->type() != LIGHT_ILLUMINATE && lights.front()->type() != LIGHT_ILLUMINATE_AXIS_ANGLE) )
+    {
+        light_influence->set_unbounded( light_cutoff_ );
+        
+        if ( !(shader->globals() & (SHADER_GLOBAL_PS | SHADER_GLOBAL_N)) )
+        {
+            for ( vector<shared_ptr<Light> >::const_iterator i = lights.begin(); i != lights.end(); ++i )
+            {
+                const Light* light = i->get();
+                REYES_ASSERT( light );
+                light->color()->reset( TYPE_COLOR, STORAGE_UNIFORM, 1 );
+                light->opacity()->reset( TYPE_COLOR, STORAGE_UNIFORM, 1 );
+            }
+            light_influence->set_uniform_lights( lights );
+        }
+        return;
+    }
+
+    const Light* light = lights.front().get();
+    const vec3 position = light->position();
+    const vec3 axis = light->type() == LIGHT_ILLUMINATE_AXIS_ANGLE ? light->axis() : vec3( 0.0f, 0.0f, 1.0f );
+    const float angle = light->type() == LIGHT_ILLUMINATE_AXIS_ANGLE ? light->angle() : 0.0f;
+    float radius = FLT_MAX;
+
+    if ( light_cutoff_ > 0.0f && length(axis) > 0.0f )
+    {
+        Grid falloff_grid;
+        falloff_grid.resize( 2, 1 );
+        vec3* probe_positions = falloff_grid.value( IDENTIFIER_PS, TYPE_POINT ).vec3_values();
+        probe_positions[0] = position + normalize( axis );
+        probe_positions[1] = position + normalize( axis ) * 2.0f;
+        run_light_shader( light_parameters, falloff_grid );
+
+        const vector<shared_ptr<Light> >& falloff_lights = falloff_grid.lights();
+        if ( falloff_lights.size() == 1 && falloff_lights.front()->color()->size() == 2 )
+        {
+            const vec3* colors = falloff_lights.front()->color()->vec3_values();
+            const float near_intensity = max( fabsf(colors[0].x), max(fabsf(colors[0].y), fabsf(colors[0].z)) );
+            const float far_intensity = max( fabsf(colors[1].x), max(fabsf(colors[1].y), fabsf(colors[1].z)) );
+            const float INVERSE_SQUARE_TOLERANCE = 1.001f;
+            if ( far_intensity <= near_intensity * 0.25f * INVERSE_SQUARE_TOLERANCE )
+            {
+                radius = sqrtf( near_intensity / light_cutoff_ );
+            }
+        }
+    }
+
+    light_influence->set_bounded( light_cutoff_, position, axis, angle, radius );
 }
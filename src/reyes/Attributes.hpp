@@ -15,6 +15,7 @@ namespace reyes
 
 class Grid;
 class Shader;
+class LightInfluence;
 class VirtualMachine;
 
 /**
@@ -22,6 +23,18 @@ class VirtualMachine;
 */
 class Attributes
 {
+    /**
+    // The transform between a named coordinate system and "camera" space.
+    */
+    struct NamedTransform
+    {
+        math::mat4x4 transform_; ///< The transform from the named coordinate system to "camera" space.
+        mutable math::mat4x4 inverse_; ///< The transform from "camera" space to the named coordinate system (only valid once inverted_ is true).
+        mutable bool inverted_; ///< True if inverse_ has been calculated from transform_.
+        bool defined_; ///< True if the named coordinate system is defined.
+        NamedTransform();
+    };
+
     VirtualMachine* virtual_machine_; ///< The VirtualMachine used to initialize shader parameters.
     float shading_rate_; ///< The current shading rate.
     bool matte_; ///< The current matte object flag.
@@ -30,16 +43,19 @@ class Attributes
     bool geometry_left_handed_; ///< True if geometry is currently expected to be left handed (false indicates right handed).
     math::vec3 color_; ///< The current color.
     math::vec3 opacity_; ///< The current opacity.
+    float light_cutoff_; ///< The light intensity below which lights are culled from grids (0 disables distance culling).
     const math::vec4 *u_basis_; ///< The 4 rows that define the cubic basis in the u direction for patches.
     const math::vec4 *v_basis_; ///< The 4 rows that define the cubic basis in the u direction for patches.
     Grid* displacement_parameters_; ///< The parameters for the currently active displacement shader.
-    Shader* displacement_shader_; ///< The currently active displacement shader or null if there is no displacement shader.
+    const Shader* displacement_shader_; ///< The currently active displacement shader or null if there is no displacement shader.
     Grid* surface_parameters_; ///< The parameters for the currently active surface shader.
-    Shader* surface_shader_; ///< The currently active surface shader or null if there is no surface shader.
-    std::vector<std::pair<Shader*, std::shared_ptr<Grid> > > light_shaders_; ///< The currently allocated light shaders.
+    const Shader* surface_shader_; ///< The currently active surface shader or null if there is no surface shader.
+    std::vector<std::pair<const Shader*, std::shared_ptr<Grid> > > light_shaders_; ///< The currently allocated light shaders.
     std::vector<Grid*> active_light_shaders_; ///< The currently active light shaders.
+    std::map<const Grid*, std::shared_ptr<LightInfluence> > light_influences_; ///< The influence of each allocated light shader (by light shader parameters).
+    Grid* light_grid_; ///< The grid that light shaders are run against (cleared and reused for each light shader and grid).
     std::vector<math::mat4x4> transforms_; ///< The transform stack.
-    std::map<std::string, math::mat4x4> named_transforms_; ///< Transform from camera space to the named space.
+    std::vector<NamedTransform> named_transforms_; ///< The transforms of named coordinate systems indexed by the interned identifiers of their names.
     
 public:
     Attributes( VirtualMachine* virtual_machine );
@@ -53,10 +69,10 @@ public:
     bool geometry_left_handed() const;
     const math::vec3& color() const;
     const math::vec3& opacity() const;
+    float light_cutoff() const;
     const math::vec4* u_basis() const;
     const math::vec4* v_basis() const;
     const std::vector<math::mat4x4>& transforms() const;
-    const std::map<std::string, math::mat4x4>& named_transforms() const;
 
     void set_shading_rate( float shading_rate );
     void set_matte( bool matte );
@@ -65,21 +81,22 @@ public:
     void set_two_sided( bool two_sided );
     void set_color( const math::vec3& color );
     void set_opacity( const math::vec3& opacity );
+    void set_light_cutoff( float light_cutoff );
     void set_u_basis( const math::vec4* u_basis );
     void set_v_basis( const math::vec4* v_basis );
 
     void displacement_shade( Grid& grid );
-    void set_displacement_shader( Shader* displacement_shader, const math::mat4x4& camera_transform );
-    Shader* displacement_shader() const;
+    void set_displacement_shader( const Shader* displacement_shader, const math::mat4x4& camera_transform );
+    const Shader* displacement_shader() const;
     Grid& displacement_parameters() const;
 
     void surface_shade( Grid& grid );
-    void set_surface_shader( Shader* surface_shader, const math::mat4x4& camera_transform );
-    Shader* surface_shader() const;
+    void set_surface_shader( const Shader* surface_shader, const math::mat4x4& camera_transform );
+    const Shader* surface_shader() const;
     Grid& surface_parameters() const;
 
     void light_shade( Grid& grid );
-    Grid& add_light_shader( Shader* light_shader, const math::mat4x4& camera_transform );
+    Grid& add_light_shader( const Shader* light_shader, const math::mat4x4& camera_transform );
     void activate_light_shader( const Grid& grid );
     void deactivate_light_shader( const Grid& grid );
     std::vector<Grid*>::iterator find_active_light_shader_by_grid( const Grid& grid );
@@ -93,8 +110,16 @@ public:
     const math::mat4x4& transform() const;
 
     void add_coordinate_system( const char* name, const math::mat4x4& transform );
+    void add_coordinate_system( int identifier, const math::mat4x4& transform );
     void remove_coordinate_system( const char* name );
-    math::mat4x4 transform_from( const std::string& name ) const;
+    void remove_coordinate_system( int identifier );
+    const math::mat4x4& transform_from( const std::string& name ) const;
+    const math::mat4x4& transform_from( int identifier ) const;
+    const math::mat4x4& transform_to( int identifier ) const;
+
+private:
+    void run_light_shader( Grid& light_parameters, Grid& light_grid );
+    void infer_light_influence( Grid& light_parameters, LightInfluence* light_influence );
 };
 
 }
@@ -13,6 +13,7 @@
 #include "SymbolTable.hpp"
 #include "ErrorCode.hpp"
 #include "ErrorPolicy.hpp"
+#include "ShaderGlobal.hpp"
 #include <math/vec2.ipp>
 #include <math/vec3.ipp>
 #include "assert.hpp"
@@ -64,10 +65,15 @@ CodeGenerator::CodeGenerator( const SymbolTable& symbol_table, ErrorPolicy* erro
   errors_( 0 ),
   symbols_(),
   values_(),
+  local_registers_(),
   temporary_registers_(),
   loops_(),
   index_( 0 ),
   registers_( 0 ),
+  uses_lights_( false ),
+  globals_( SHADER_GLOBAL_NULL ),
+  line_( 0 ),
+  lines_(),
   encoder_( nullptr )
 {
     encoder_ = new Encoder;
@@ -95,10 +101,15 @@ void CodeGenerator::generate( SyntaxNode* node, const char* name )
     constants_ = 0;
     symbols_.clear();
     values_.clear();
+    local_registers_.clear();
     temporary_registers_.clear();
     loops_.clear();
     index_ = 0;
     registers_ = 0;
+    uses_lights_ = false;
+    globals_ = SHADER_GLOBAL_NULL;
+    line_ = 0;
+    lines_.clear();
     encoder_->clear();
 
     if ( node && error_policy_->total_errors() == 0 )
@@ -108,11 +119,13 @@ void CodeGenerator::generate( SyntaxNode* node, const char* name )
 
         generate_symbols( *node->node(0) );
         variables_ = int(symbols_.size()) - parameters_;
+        generate_globals();
 
         generate_constants( node->node(0) );
         constants_ = int(values_.size());
 
         generate_indexes_for_symbols();
+        generate_local_registers( *node->node(0)->node(1) );
 
         initialize_address_ = encoder_->size();
         generate_code_for_list( *node->node(0)->node(0) );
@@ -213,11 +226,46 @@ const std::vector<unsigned char>& CodeGenerator::code() const
     return encoder_->code();
 }
 
+/**
+// Get the registers of the variables declared in the body of the most 
+// recently generated shader.
+//
+// Unlike parameters and global variables these aren't visible once the 
+// shader has run so writes to them that are never read can be removed 
+// (see Optimizer::optimize()).
+*/
+const std::vector<int>& CodeGenerator::local_registers() const
+{
+    return local_registers_;
+}
+
+/**
+// Get the lines of source that the most recently generated code was 
+// generated for.
+//
+// Each instruction is attributed to the line of the innermost statement 
+// that it was generated for.
+*/
+const std::vector<SourceLine>& CodeGenerator::lines() const
+{
+    return lines_;
+}
+
 int CodeGenerator::registers() const
 {
     return registers_;
 }
 
+bool CodeGenerator::uses_lights() const
+{
+    return uses_lights_;
+}
+
+int CodeGenerator::globals() const
+{
+    return globals_;
+}
+
 void CodeGenerator::error( bool condition, int /*line*/, const char* format, ... )
 {       
     if ( condition )
@@ -245,10 +293,15 @@ void CodeGenerator::generate_code_in_case_of_errors()
     constants_ = 0;
     symbols_.clear();
     values_.clear();
+    local_registers_.clear();
     temporary_registers_.clear();
     loops_.clear();
     index_ = 0;
     registers_ = 0;
+    uses_lights_ = false;
+    globals_ = SHADER_GLOBAL_NULL;
+    line_ = 0;
+    lines_.clear();
     encoder_->clear();
 
     initialize_address_ = encoder_->size();
@@ -293,6 +346,44 @@ void CodeGenerator::generate_symbols_for_parameters( SyntaxNode* list_node )
     }
 }
 
+void CodeGenerator::generate_globals()
+{
+    struct GlobalMetadata
+    {
+        const char* identifier;
+        int global;
+    };
+    
+    static const GlobalMetadata GLOBALS [] =
+    {
+        { "P", SHADER_GLOBAL_P },
+        { "N", SHADER_GLOBAL_N },
+        { "I", SHADER_GLOBAL_I },
+        { "Cs", SHADER_GLOBAL_CS },
+        { "Os", SHADER_GLOBAL_OS },
+        { "s", SHADER_GLOBAL_S },
+        { "t", SHADER_GLOBAL_T },
+        { "Ps", SHADER_GLOBAL_PS },
+        { NULL, SHADER_GLOBAL_NULL }
+    };
+
+    globals_ = SHADER_GLOBAL_NULL;
+    for ( vector<shared_ptr<Symbol> >::const_iterator i = symbols_.begin() + parameters_; i != symbols_.end(); ++i )
+    {
+        const Symbol* symbol = i->get();
+        REYES_ASSERT( symbol );
+        if ( !symbol->function() )
+        {
+            const GlobalMetadata* metadata = &GLOBALS[0];
+            while ( metadata->identifier && symbol->identifier() != metadata->identifier )
+            {
+                ++metadata;
+            }
+            globals_ |= metadata->global;
+        }
+    }
+}
+
 shared_ptr<Value> CodeGenerator::generate_constants( SyntaxNode* node )
 {
     REYES_ASSERT( node );
@@ -341,6 +432,15 @@ shared_ptr<Value> CodeGenerator::generate_constants( SyntaxNode* node )
     return value;
 }
 
+/**
+// Assign symbol and register indices to the symbols used by the shader.
+//
+// Function symbols belong to the built-in scope of the SymbolTable and may
+// be shared by shaders compiled concurrently on other threads so they are
+// never written to here; calls look up their index in symbols_ instead (see 
+// function_index()).  Function symbols still take up a register index so 
+// that register numbering is the same as it has always been.
+*/
 void CodeGenerator::generate_indexes_for_symbols()
 {
     int index = 0;
@@ -348,7 +448,10 @@ void CodeGenerator::generate_indexes_for_symbols()
     {
         Symbol* symbol = i->get();
         REYES_ASSERT( symbol );
-        symbol->set_index( index );
+        if ( !symbol->function() )
+        {
+            symbol->set_index( index );
+        }
         ++index;
     }
 
@@ -359,6 +462,7 @@ void CodeGenerator::generate_indexes_for_symbols()
     {
         Symbol* symbol = i->get();
         REYES_ASSERT( symbol );
+        REYES_ASSERT( !symbol->function() );
         symbol->set_register_index( register_index  );
         ++register_index ;
         ++i;
@@ -369,7 +473,10 @@ void CodeGenerator::generate_indexes_for_symbols()
     {
         Symbol* symbol = i->get();
         REYES_ASSERT( symbol );
-        symbol->set_register_index( register_index );
+        if ( !symbol->function() )
+        {
+            symbol->set_register_index( register_index );
+        }
         ++register_index;
         ++i;
     }
@@ -380,6 +487,29 @@ void CodeGenerator::generate_indexes_for_symbols()
     permanent_registers_ = register_index;
 }
 
+/**
+// Collect the registers of the variables declared in the body of a shader 
+// into local_registers_.
+*/
+void CodeGenerator::generate_local_registers( const SyntaxNode& node )
+{
+    if ( node.node_type() == SHADER_NODE_VARIABLE )
+    {
+        const Symbol* symbol = node.symbol().get();
+        REYES_ASSERT( symbol );
+        if ( find(local_registers_.begin(), local_registers_.end(), symbol->register_index()) == local_registers_.end() )
+        {
+            local_registers_.push_back( symbol->register_index() );
+        }
+    }
+
+    const vector<shared_ptr<SyntaxNode> >& nodes = node.nodes();
+    for ( vector<shared_ptr<SyntaxNode> >::const_iterator i = nodes.begin(); i != nodes.end(); ++i )
+    {
+        generate_local_registers( *(*i) );
+    }
+}
+
 void CodeGenerator::evaluate_expression( shared_ptr<Value> value, const SyntaxNode* node ) const
 {
     REYES_ASSERT( value );
@@ -528,13 +658,16 @@ int CodeGenerator::generate_type_conversion( int register_index, const SyntaxNod
         REYES_ASSERT( node.original_type() == TYPE_FLOAT );
         REYES_ASSERT( node.type() != TYPE_FLOAT );
         
+        // Conversion happens before any promotion so the value converted 
+        // still has its original storage.
         ValueType to_type = node.type();
+        ValueStorage storage = node.original_storage() != STORAGE_NULL ? node.original_storage() : node.storage();
         if ( node.type() != node.original_type() )
         {
             instruction(
                 INSTRUCTION_CONVERT,
-                node.type(), node.storage(),
-                node.original_type(), node.storage()
+                node.type(), storage,
+                node.original_type(), storage
             );
             argument( register_index );
             register_index = allocate_register();
@@ -614,6 +747,8 @@ void CodeGenerator::generate_code_for_parameters( const SyntaxNode& node )
 
 void CodeGenerator::generate_statement( const SyntaxNode& node )
 {
+    const int line = line_;
+    line_ = node.line();
     switch ( node.node_type() )
     {
         case SHADER_NODE_LIST:
@@ -627,6 +762,10 @@ void CodeGenerator::generate_statement( const SyntaxNode& node )
         case SHADER_NODE_CALL:
             generate_call_expression( node );
             break;
+
+        case SHADER_NODE_INLINE_CALL:
+            generate_inline_call_expression( node );
+            break;
             
         case SHADER_NODE_RETURN:
             generate_return_statement( node );
@@ -696,6 +835,7 @@ void CodeGenerator::generate_statement( const SyntaxNode& node )
             REYES_ASSERT( false );
             break;
     }
+    line_ = line;
 }
 
 void CodeGenerator::generate_if_statement( const SyntaxNode& node )
@@ -884,6 +1024,7 @@ void CodeGenerator::generate_illuminance_statement( const SyntaxNode& node )
     }
     else
     {
+        uses_lights_ = true;
         push_loop();
         jump_to_end( INSTRUCTION_JUMP_ILLUMINANCE, 1 );
     
@@ -971,6 +1112,10 @@ int CodeGenerator::generate_expression( const SyntaxNode& node )
         case SHADER_NODE_CALL:
             index = generate_call_expression( node );
             break;
+
+        case SHADER_NODE_INLINE_CALL:
+            index = generate_inline_call_expression( node );
+            break;
             
         case SHADER_NODE_CROSS:
             REYES_ASSERT( false );
@@ -1056,6 +1201,30 @@ int CodeGenerator::generate_expression( const SyntaxNode& node )
     return index;
 }
 
+/**
+// Find the index of a function symbol in the symbols used by the shader.
+//
+// @param symbol
+//  The function symbol to find the index of (assumed not null and used by
+//  the shader).
+//
+// @return
+//  The index of the function symbol in symbols_.
+*/
+int CodeGenerator::function_index( const Symbol* symbol ) const
+{
+    REYES_ASSERT( symbol );
+    REYES_ASSERT( symbol->function() );
+    
+    vector<shared_ptr<Symbol> >::const_iterator i = symbols_.begin();
+    while ( i != symbols_.end() && i->get() != symbol )
+    {
+        ++i;
+    }
+    REYES_ASSERT( i != symbols_.end() );
+    return int(i - symbols_.begin());
+}
+
 int CodeGenerator::generate_call_expression( const SyntaxNode& call_node )
 {
     REYES_ASSERT( call_node.node_type() == SHADER_NODE_CALL );
@@ -1070,8 +1239,16 @@ int CodeGenerator::generate_call_expression( const SyntaxNode& call_node )
         arguments[i] = argument;
     }
     
+    // The lighting functions sum contributions from the lights passed to 
+    // the shader so shaders that call them need light shaders run first.
+    const string& identifier = call_node.symbol()->identifier();
+    if ( identifier == "ambient" || identifier == "diffuse" || identifier == "specular" || identifier == "phong" )
+    {
+        uses_lights_ = true;
+    }
+
     instruction( INSTRUCTION_CALL_0 + call_node.nodes().size() );
-    argument( call_node.symbol()->index() );
+    argument( function_index(call_node.symbol().get()) );
     for ( int i = 0; i < int(call_node.nodes().size()); ++i )
     {
         argument( arguments[i] );
@@ -1080,6 +1257,21 @@ int CodeGenerator::generate_call_expression( const SyntaxNode& call_node )
     return allocate_register();
 }
 
+/**
+// Generate code for a call to a function defined in the shader source.
+//
+// The parser replaces these calls with a copy of the function's body that
+// assigns its return value to a variable so the code for the call is the 
+// code for that copy and the value of the call is the register of that 
+// variable (or zero for void functions called as statements).
+*/
+int CodeGenerator::generate_inline_call_expression( const SyntaxNode& node )
+{
+    REYES_ASSERT( node.node_type() == SHADER_NODE_INLINE_CALL );
+    generate_code_for_list( *node.node(0) );
+    return node.node(1)->node_type() != SHADER_NODE_NULL ? generate_expression( *node.node(1) ) : 0;
+}
+
 int CodeGenerator::generate_divide_expression( const SyntaxNode& divide_node )
 {
     REYES_ASSERT( divide_node.node(0) );
@@ -1356,19 +1548,35 @@ int CodeGenerator::generate_identifier_expression( const SyntaxNode& node )
 
 void CodeGenerator::instruction( int instruction )
 {
+    mark_line();
     encoder_->instruction( instruction );
 }
 
 void CodeGenerator::instruction( int instruction, int type, int storage )
 {
+    mark_line();
     encoder_->instruction( instruction, type, storage );
 }
 
 void CodeGenerator::instruction( int instruction, int type, int storage, int other_type, int other_storage )
 {
+    mark_line();
     encoder_->instruction( instruction, type, storage, other_type, other_storage );
 }
 
+/**
+// Record the line of the current statement against the next instruction 
+// if it differs from the line of the previous instruction.
+*/
+void CodeGenerator::mark_line()
+{
+    if ( lines_.empty() || lines_.back().line != line_ )
+    {
+        SourceLine source_line = { address(), line_ };
+        lines_.push_back( source_line );
+    }
+}
+
 void CodeGenerator::argument( int argument )
 {
     encoder_->argument( argument );
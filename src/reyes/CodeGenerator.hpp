@@ -4,6 +4,7 @@
 #include "SyntaxNodeType.hpp"
 #include "ValueType.hpp"
 #include "ValueStorage.hpp"
+#include "SourceLine.hpp"
 #include <vector>
 #include <string>
 #include <memory>
@@ -51,10 +52,15 @@ class CodeGenerator
     int errors_; ///< The number of errors detected during code generation.
     std::vector<std::shared_ptr<Symbol> > symbols_; ///< The symbols that are used in the shader.
     std::vector<std::shared_ptr<Value> > values_; ///< The values of any constants used in the shader (including default parameter values).
+    std::vector<int> local_registers_; ///< The registers of the variables declared in the body of the shader.
     std::vector<int> temporary_registers_; ///< The stack of register indices that are being used to store values that are still being used.
     std::vector<Loop> loops_; ///< The Loops used to patch jumps to the beginning or the end of an enclosing loop.
     int index_; ///< The index of the next available register.  
     int registers_; ///< The number of registers that are used by the most recently generated code (variables and temporaries).
+    bool uses_lights_; ///< True if the most recently generated code reads lights (through illuminance statements or lighting functions).
+    int globals_; ///< The bitmask of ShaderGlobal values for the global variables used by the most recently generated code.
+    int line_; ///< The line of source of the statement that code is being generated for.
+    std::vector<SourceLine> lines_; ///< The lines of source that the most recently generated code was generated for.
     Encoder* encoder_; ///< Write byte code instructions and arguments.
 
 public:
@@ -76,15 +82,21 @@ public:
     std::vector<std::shared_ptr<Value> >& values();
     const std::vector<std::shared_ptr<Value> >& values() const;
     const std::vector<unsigned char>& code() const;
+    const std::vector<int>& local_registers() const;
+    const std::vector<SourceLine>& lines() const;
     int registers() const;
+    bool uses_lights() const;
+    int globals() const;
     
 private:
     void error( bool condition, int line, const char* format, ... );
     void generate_code_in_case_of_errors();
     void generate_symbols( const SyntaxNode& node );
     void generate_symbols_for_parameters( SyntaxNode* node );
+    void generate_globals();
     std::shared_ptr<Value> generate_constants( SyntaxNode* node );
     void generate_indexes_for_symbols();
+    void generate_local_registers( const SyntaxNode& node );
     void evaluate_expression( std::shared_ptr<Value> value, const SyntaxNode* node ) const;
     int assign_instruction_from_type( int instruction, ValueType type ) const;
     int arithmetic_instruction_from_type( int instruction, ValueType type ) const;
@@ -112,7 +124,9 @@ private:
     void generate_return_statement( const SyntaxNode& node );
 
     int generate_expression( const SyntaxNode& node );
+    int function_index( const Symbol* symbol ) const;
     int generate_call_expression( const SyntaxNode& node );
+    int generate_inline_call_expression( const SyntaxNode& node );
     int generate_divide_expression( const SyntaxNode& node );
     int generate_negate_expression( const SyntaxNode& node );
     int generate_ternary_expression( const SyntaxNode& node );
@@ -132,6 +146,7 @@ private:
     void instruction( int instruction );
     void instruction( int instruction, int type, int storage );
     void instruction( int instruction, int type, int storage, int other_type, int other_storage );
+    void mark_line();
     void argument( int argument );
     void patch_argument( int address, int distance );
     int argument_for_patching();
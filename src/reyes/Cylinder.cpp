@@ -6,6 +6,7 @@
 #include "stdafx.hpp"
 #include "Cylinder.hpp"
 #include "Grid.hpp"
+#include "Identifier.hpp"
 #include "Value.hpp"
 #include <math/vec2.ipp>
 #include <math/vec3.ipp>
@@ -55,10 +56,10 @@ void Cylinder::bound( const math::mat4x4& transform, vec3* minimum, vec3* maximu
     *minimum = vec3( FLT_MAX, FLT_MAX, FLT_MAX );
     *maximum = vec3( -FLT_MAX, -FLT_MAX, -FLT_MAX );
     
-    Grid grid;
+    Grid& grid = bounding_grid();
     dice( transform, 8, 8, &grid );
-    const vec3* positions = grid["P"].vec3_values();
-    const vec3* positions_end = positions + grid["P"].size();
+    const vec3* positions = grid[IDENTIFIER_P].vec3_values();
+    const vec3* positions_end = positions + grid[IDENTIFIER_P].size();
     for ( const vec3* i = positions; i != positions_end; ++i )
     {
         minimum->x = min( minimum->x, i->x );
@@ -120,9 +121,9 @@ void Cylinder::dice( const math::mat4x4& transform, int width, int height, Grid*
     grid->du_ = (u_range.y - u_range.x) / float(width - 1);
     grid->dv_ = (v_range.y - v_range.x) / float(height - 1);
     
-    vec3* positions = grid->value( "P", TYPE_POINT ).vec3_values();
-    float* s = grid->value( "s", TYPE_FLOAT ).float_values();
-    float* t = grid->value( "t", TYPE_FLOAT ).float_values();
+    vec3* positions = grid->value( IDENTIFIER_P, TYPE_POINT ).vec3_values();
+    float* s = grid->value( IDENTIFIER_S, TYPE_FLOAT ).float_values();
+    float* t = grid->value( IDENTIFIER_T, TYPE_FLOAT ).float_values();
     
     int vertex = 0;
     float v = v_range.x;
@@ -4,10 +4,13 @@
 #include "Symbol.hpp"
 #include "Value.hpp"
 #include "Grid.hpp"
+#include "Identifier.hpp"
 #include "SampleBuffer.hpp"
 #include "SyntaxNode.hpp"
 #include "Shader.hpp"
+#include "Profile.hpp"
 #include <reyes/reyes_virtual_machine/Instruction.hpp>
+#include <reyes/reyes_virtual_machine/InstructionMetadata.hpp>
 #include "ValueStorage.hpp"
 #include <math/vec3.ipp>
 #include <math/mat4x4.ipp>
@@ -59,6 +62,7 @@ void Debugger::dump_syntax_tree( const SyntaxNode* node, int level ) const
             "VARIABLE",
             "TYPE",
             "CALL",
+            "INLINE_CALL",
             "RETURN",
             "BREAK",
             "CONTINUE",
@@ -147,7 +151,7 @@ void Debugger::dump_syntax_tree( const SyntaxNode* node, int level ) const
     }
 }
 
-void Debugger::dump_shader( Shader& shader ) const
+void Debugger::dump_shader( const Shader& shader ) const
 {
     printf( "initialize=%d, shade=%d, parameters=%d, variables=%d, constants=%d, permanent_registers=%d, registers=%d\n", 
         shader.initialize_address(),
@@ -205,7 +209,7 @@ void Debugger::dump_symbols( const std::vector<std::shared_ptr<Symbol> >& symbol
     {
         const Symbol* symbol = i->get();
         REYES_ASSERT( symbol );
-        printf( "%d, %s\n", symbol->index(), symbol->identifier().c_str() );
+        printf( "%d, %s\n", int(i - symbols.begin()), symbol->identifier().c_str() );
     }
 
     printf( "\n\n" );
@@ -250,119 +254,111 @@ void Debugger::dump_values( const std::vector<std::shared_ptr<Value> >& values )
     printf( "\n\n" );
 }
 
+/**
+// Dump the byte code for a shader as one instruction per line.
+//
+// Each line shows the address of the instruction, its name, its dispatch
+// code(s) in hexadecimal, and its arguments.  Jumps show their distance 
+// and the address that they jump to.
+//
+// @param code
+//  The byte code to dump (usually Shader::code() which is the code after
+//  optimization).
+*/
 void Debugger::dump_code( const std::vector<unsigned char>& code ) const
 {
-    /*
-    struct InstructionMetadata
+    const unsigned char* begin = code.empty() ? NULL : &code[0];
+    const unsigned char* end = begin + code.size();
+    const unsigned char* i = begin;
+    while ( i < end )
     {
-        const char* name;
-        int size;
-    };
+        const long address = long(i - begin);
+        int instruction = *reinterpret_cast<const short*>( i );
+        i += sizeof(short);
+        if ( instruction < INSTRUCTION_NULL || instruction >= INSTRUCTION_COUNT )
+        {
+            printf( "%ld: ?? %d\n", address, instruction );
+            break;
+        }
+
+        const InstructionMetadata& metadata = instruction_metadata( instruction );
+        printf( "%ld: %s", address, metadata.name );
+        for ( int j = 0; j < metadata.words; ++j )
+        {
+            int dispatch = *reinterpret_cast<const short*>( i );
+            i += sizeof(short);
+            printf( " %04x", dispatch );
+        }
+
+        for ( int j = 0; j < metadata.arguments; ++j )
+        {
+            int argument = *reinterpret_cast<const int*>( i );
+            i += sizeof(int);
+            printf( "%s %d", j > 0 ? "," : "", argument );
+            if ( metadata.jump )
+            {
+                printf( " (%ld)", long(i - begin) + argument );
+            }
+        }
+        printf( "\n" );
+    }
     
-    const InstructionMetadata INSTRUCTIONS [INSTRUCTION_COUNT] = 
+    printf( "\n\n" );
+}
+
+/**
+// Dump the decoded instructions of a shader to stdout.
+//
+// Each instruction is printed on its own line with its index, the line of
+// shader source that it was generated for, its name, its result register,
+// and its arguments.  If a profile is passed and has counted the shader 
+// then each instruction is annotated with the number of times that it 
+// was executed, the elements that it processed, and the time that it 
+// took.
+//
+// @param shader
+//  The shader to dump the decoded instructions of.
+//
+// @param profile
+//  The Profile to annotate instructions from or null to dump instructions
+//  without annotations.
+*/
+void Debugger::dump_code( const Shader& shader, const Profile* profile ) const
+{
+    const Profile::Counters* counters = profile ? profile->find_counters( shader ) : NULL;
+    const vector<DecodedInstruction>& instructions = shader.instructions();
+    for ( unsigned int i = 0; i < instructions.size(); ++i )
     {
-        { "null", 0 },
-        { "halt", 0 },
-        { "reset", 1 },
-        { "clear_mask", 0 },
-        { "generate_mask", 1 },
-        { "invert_mask", 0 },
-        { "jump_empty", 1 },
-        { "jump_not_empty", 1 },
-        { "jump_illuminance", 1 },
-        { "jump", 1 },
-        { "transform", 2 },
-        { "transform_vector", 2 },
-        { "transform_normal", 2 },
-        { "transform_color", 2 },
-        { "transform_matrix", 2 },
-        { "dot", 2 },
-        { "multiply_float", 2 },
-        { "multiply_vec3", 2 },
-        { "divide_float", 2 },
-        { "divide_vec3", 2 },
-        { "add_float", 2 },
-        { "add_vec3", 2 },
-        { "subtract_float", 2 },
-        { "subtract_vec3", 2 },
-        { "greater", 2 },
-        { "greater_equal", 2 },
-        { "less", 2 },
-        { "less_equal", 2 },
-        { "and", 2 },
-        { "or", 2 },
-        { "equal_float", 2 },
-        { "equal_vec3", 2 },
-        { "not_equal_float", 2 },
-        { "not_equal_vec3", 2 },
-        { "negate", 1 },
-        { "promote_integer", 1 },
-        { "promote_float", 1 },
-        { "promote_vec3", 1 },
-        { "float_to_color", 1 },
-        { "float_to_point", 1 },
-        { "float_to_vector", 1 },
-        { "float_to_normal", 1 },
-        { "float_to_matrix", 1 },
-        { "assign_float", 2 },
-        { "assign_vec3", 2 },
-        { "assign_mat4x4", 2 },
-        { "assign_integer", 2 },
-        { "assign_string", 2 },
-        { "add_assign_float", 2 },
-        { "add_assign_vec3", 2 },
-        { "multiply_assign_float", 2 },
-        { "multiply_assign_vec3", 2 },
-        { "float_texture", 3 },
-        { "vec3_texture", 3 },
-        { "float_environment", 2 },
-        { "vec3_environment", 2 },
-        { "shadow", 3 },
-        { "call", 1 },
-        { "call", 2 },
-        { "call", 3 },
-        { "call", 4 },
-        { "call", 5 },
-        { "call", 6 },
-        { "ambient", 2 },
-        { "solar", 0 },
-        { "solar_axis_angle", 4 },
-        { "illuminate", 5 },
-        { "illuminate_axis_angle", 7 },
-        { "illuminance_axis_angle", 6 }
-    };
-    
-    const short* i = &code[0];
-    const short* instructions_end = i + code.size();
-    while ( i < instructions_end )
-    {        
-        int instruction = *i;
-        REYES_ASSERT( instruction >= INSTRUCTION_NULL && instruction <= INSTRUCTION_COUNT );
-        const char* name = INSTRUCTIONS[instruction].name;
-        int size = INSTRUCTIONS[instruction].size;        
-        printf( "%ld: %s", i - &code[0], name );
-        ++i;
-        if ( instruction == INSTRUCTION_JUMP || instruction == INSTRUCTION_JUMP_EMPTY || instruction == INSTRUCTION_JUMP_NOT_EMPTY || instruction == INSTRUCTION_JUMP_ILLUMINANCE )
+        const DecodedInstruction& instruction = instructions[i];
+        const InstructionMetadata& metadata = instruction_metadata( instruction.instruction );
+        printf( "%u: (line %d) %s", i, instruction.line, metadata.name );
+        if ( instruction.result >= 0 )
+        {
+            printf( " %d =", instruction.result );
+        }
+        if ( metadata.jump )
         {
-            REYES_ASSERT( size == 1 );
-            int jump_distance = *i;
-            ++i;
-            printf( ", %d (%ld)", jump_distance, i + jump_distance - &code[0] );
+            printf( " (%d)", instruction.jump );
         }
         else
         {
-            for ( int j = 0; j < size; ++j )
+            for ( int j = 0; j < metadata.arguments && j < DecodedInstruction::ARGUMENTS; ++j )
             {
-                int register_index = *i;
-                printf( ", %d", register_index );
-                ++i;
+                printf( "%s %d", j > 0 ? "," : "", instruction.arguments[j] );
             }
         }
+        if ( counters )
+        {
+            printf( " ; %llu executions, %llu elements, %llu ns", 
+                (unsigned long long) counters[i].executions, 
+                (unsigned long long) counters[i].elements, 
+                (unsigned long long) counters[i].nanoseconds 
+            );
+        }
         printf( "\n" );
     }
     
     printf( "\n\n" );
-    */
 }
 
 void Debugger::dump_grid( const Grid& grid, const math::vec4& color, const char* format, ... ) const
@@ -391,7 +387,7 @@ void Debugger::dump_grid( const Grid& grid, const math::vec4& color, const char*
     fprintf( stream, "\n" );
     fprintf( stream, "   vertices {\n" );
 
-    const vec3* positions = grid["P"].vec3_values();
+    const vec3* positions = grid[IDENTIFIER_P].vec3_values();
     const int width = grid.width();
     const int height = grid.height();
     int i = 0;
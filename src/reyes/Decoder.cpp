@@ -0,0 +1,863 @@
+//
+// Decoder.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "Decoder.hpp"
+#include <reyes/reyes_virtual_machine/Instruction.hpp>
+#include <reyes/reyes_virtual_machine/InstructionMetadata.hpp>
+#include <reyes/reyes_virtual_machine/add.hpp>
+#include <reyes/reyes_virtual_machine/subtract.hpp>
+#include <reyes/reyes_virtual_machine/multiply.hpp>
+#include <reyes/reyes_virtual_machine/divide.hpp>
+#include <reyes/reyes_virtual_machine/greater.hpp>
+#include <reyes/reyes_virtual_machine/greater_equal.hpp>
+#include <reyes/reyes_virtual_machine/less.hpp>
+#include <reyes/reyes_virtual_machine/less_equal.hpp>
+#include <reyes/reyes_virtual_machine/equal.hpp>
+#include <reyes/reyes_virtual_machine/not_equal.hpp>
+#include <reyes/reyes_virtual_machine/negate.hpp>
+#include "assert.hpp"
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <stddef.h>
+
+using std::max;
+using std::min;
+using std::map;
+using std::pair;
+using std::make_pair;
+using std::sort;
+using std::vector;
+using namespace reyes;
+
+/**
+// Is an argument to a decoded instruction the index of a register?
+//
+// Every argument is a register except for the distance to jump (already 
+// resolved into DecodedInstruction::jump) and the index of the symbol of 
+// the function called by calls.
+*/
+static bool register_argument( const DecodedInstruction& decoded_instruction, int index )
+{
+    const int instruction = decoded_instruction.instruction;
+    if ( index >= instruction_metadata(instruction).arguments || decoded_instruction.jump >= 0 )
+    {
+        return false;
+    }
+    if ( instruction >= INSTRUCTION_CALL_0 && instruction <= INSTRUCTION_CALL_5 )
+    {
+        return index > 0;
+    }
+    return true;
+}
+
+/**
+// Is an instruction an assignment to the variable in its first argument?
+*/
+static bool assignment( int instruction )
+{
+    return instruction >= INSTRUCTION_ASSIGN && instruction <= INSTRUCTION_DIVIDE_ASSIGN;
+}
+
+/**
+// Is an instruction one of the mask and jump instructions that control 
+// which elements are processed and which instructions are executed?
+*/
+static bool control( int instruction )
+{
+    return instruction >= INSTRUCTION_HALT && instruction <= INSTRUCTION_JUMP;
+}
+
+/**
+// Order loops so that inner loops come before the loops that contain them.
+*/
+static bool shorter_loop( const pair<int, int>& lhs, const pair<int, int>& rhs )
+{
+    return lhs.second - lhs.first < rhs.second - rhs.first;
+}
+
+Decoder::Decoder()
+: instructions_(),
+  initialize_instruction_( 0 ),
+  shade_instruction_( 0 ),
+  registers_( 0 ),
+  pure_functions_( NULL )
+{
+}
+
+std::vector<DecodedInstruction>& Decoder::instructions()
+{
+    return instructions_;
+}
+
+int Decoder::initialize_instruction() const
+{
+    return initialize_instruction_;
+}
+
+int Decoder::shade_instruction() const
+{
+    return shade_instruction_;
+}
+
+/**
+// Get the number of registers that the virtual machine needs to execute
+// the most recently decoded instructions.
+//
+// @return
+//  The number of permanent registers plus the most temporary registers 
+//  used by either the initialize or shade code.
+*/
+int Decoder::registers() const
+{
+    return registers_;
+}
+
+/**
+// Decode byte code.
+//
+// The virtual machine allocates registers for results from 
+// \e permanent_registers up at the start of each code fragment and
+// from the argument to each reset after that.  This is followed here 
+// in the order that instructions appear in the code which matches the 
+// order they're executed in because the code generator resets registers 
+// before every jump back to the start of a loop.
+//
+// @param code
+//  The byte code to decode.
+//
+// @param lines
+//  The lines of source that \e code was generated for; each decoded 
+//  instruction keeps the line of the instruction that it was decoded from
+//  wherever it is moved to.
+//
+// @param initialize_address
+//  The address of the initialize code in \e code.
+//
+// @param shade_address
+//  The address of the shade code in \e code.
+//
+// @param permanent_registers
+//  The number of registers that aren't temporaries.
+//
+// @param pure_functions
+//  Whether or not the function with each symbol index is pure; that is it
+//  returns the same value each time it is called with the same arguments
+//  and writes nothing but its result.  Calls to pure functions are shared
+//  and moved out of loops like any other instruction.
+*/
+void Decoder::decode( const std::vector<unsigned char>& code, const std::vector<SourceLine>& lines, int initialize_address, int shade_address, int permanent_registers, const std::vector<bool>& pure_functions )
+{
+    pure_functions_ = &pure_functions;
+    instructions_.clear();
+    initialize_instruction_ = 0;
+    shade_instruction_ = 0;
+    registers_ = permanent_registers;
+
+    const int size = int(code.size());
+    vector<int> instruction_by_address( size + 1, -1 );
+    int register_index = permanent_registers;
+    int address = 0;
+    while ( address < size )
+    {
+        if ( address == initialize_address )
+        {
+            initialize_instruction_ = int(instructions_.size());
+            register_index = permanent_registers;
+        }
+        if ( address == shade_address )
+        {
+            shade_instruction_ = int(instructions_.size());
+            register_index = permanent_registers;
+        }
+        instruction_by_address[address] = int(instructions_.size());
+        const int instruction_address = address;
+
+        const int instruction = *reinterpret_cast<const short*>( &code[address] );
+        REYES_ASSERT( instruction > INSTRUCTION_NULL && instruction < INSTRUCTION_COUNT );
+        const InstructionMetadata& metadata = instruction_metadata( instruction );
+        REYES_ASSERT( metadata.arguments <= DecodedInstruction::ARGUMENTS );
+        const short* words = reinterpret_cast<const short*>( &code[address + sizeof(short)] );
+        const int* arguments = reinterpret_cast<const int*>( &code[address + (1 + metadata.words) * sizeof(short)] );
+        address += (1 + metadata.words) * sizeof(short) + metadata.arguments * sizeof(int);
+        REYES_ASSERT( address <= size );
+
+        if ( instruction == INSTRUCTION_RESET )
+        {
+            register_index = arguments[0];
+            continue;
+        }
+
+        DecodedInstruction decoded_instruction;
+        decoded_instruction.instruction = instruction;
+        decoded_instruction.dispatch = words[0];
+        decoded_instruction.addend_dispatch = metadata.words > 1 ? words[1] : 0;
+        decoded_instruction.kernel.binary = NULL;
+        decoded_instruction.result = metadata.result ? register_index++ : -1;
+        decoded_instruction.jump = metadata.jump ? address + arguments[0] : -1;
+        decoded_instruction.line = source_line( lines, instruction_address );
+        for ( int i = 0; i < DecodedInstruction::ARGUMENTS; ++i )
+        {
+            decoded_instruction.arguments[i] = i < metadata.arguments ? arguments[i] : 0;
+        }
+
+        switch ( instruction )
+        {
+            case INSTRUCTION_ADD:
+                decoded_instruction.kernel.binary = add_kernel( decoded_instruction.dispatch );
+                break;
+
+            case INSTRUCTION_SUBTRACT:
+                decoded_instruction.kernel.binary = subtract_kernel( decoded_instruction.dispatch );
+                break;
+
+            case INSTRUCTION_MULTIPLY:
+                decoded_instruction.kernel.binary = multiply_kernel( decoded_instruction.dispatch );
+                break;
+
+            case INSTRUCTION_DIVIDE:
+                decoded_instruction.kernel.binary = divide_kernel( decoded_instruction.dispatch );
+                break;
+
+            case INSTRUCTION_GREATER:
+                decoded_instruction.kernel.comparison = greater_kernel( decoded_instruction.dispatch );
+                break;
+
+            case INSTRUCTION_GREATER_EQUAL:
+                decoded_instruction.kernel.comparison = greater_equal_kernel( decoded_instruction.dispatch );
+                break;
+
+            case INSTRUCTION_LESS:
+                decoded_instruction.kernel.comparison = less_kernel( decoded_instruction.dispatch );
+                break;
+
+            case INSTRUCTION_LESS_EQUAL:
+                decoded_instruction.kernel.comparison = less_equal_kernel( decoded_instruction.dispatch );
+                break;
+
+            case INSTRUCTION_EQUAL:
+                decoded_instruction.kernel.comparison = equal_kernel( decoded_instruction.dispatch );
+                break;
+
+            case INSTRUCTION_NOT_EQUAL:
+                decoded_instruction.kernel.comparison = not_equal_kernel( decoded_instruction.dispatch );
+                break;
+
+            case INSTRUCTION_NEGATE:
+                decoded_instruction.kernel.unary = negate_kernel( decoded_instruction.dispatch );
+                break;
+
+            default:
+                break;
+        }
+
+        instructions_.push_back( decoded_instruction );
+    }
+    instruction_by_address[size] = int(instructions_.size());
+
+    // Resets aren't decoded so jumps to resets go to the instruction after
+    // them instead.
+    for ( int i = size - 1; i >= 0; --i )
+    {
+        if ( instruction_by_address[i] < 0 )
+        {
+            instruction_by_address[i] = instruction_by_address[i + 1];
+        }
+    }
+
+    for ( vector<DecodedInstruction>::iterator i = instructions_.begin(); i != instructions_.end(); ++i )
+    {
+        DecodedInstruction& decoded_instruction = *i;
+        if ( decoded_instruction.jump >= 0 )
+        {
+            REYES_ASSERT( decoded_instruction.jump < size );
+            decoded_instruction.jump = instruction_by_address[decoded_instruction.jump];
+        }
+    }
+
+    const int values = number_values( permanent_registers );
+    while ( hoist_loop_invariants(values) )
+    {
+    }
+    share_common_subexpressions( values );
+    reuse_registers( permanent_registers );
+    pure_functions_ = NULL;
+}
+
+/**
+// Is a decoded instruction pure; that is does it only write its result and
+// always write the same result given the same arguments?
+//
+// Calls are pure when the function that they call is pure.  Illuminance
+// writes the light direction, color, and opacity for the current light as
+// well as its result.
+*/
+bool Decoder::pure( const DecodedInstruction& decoded_instruction ) const
+{
+    const int instruction = decoded_instruction.instruction;
+    if ( instruction >= INSTRUCTION_CALL_0 && instruction <= INSTRUCTION_CALL_5 )
+    {
+        REYES_ASSERT( pure_functions_ );
+        const int function = decoded_instruction.arguments[0];
+        return function >= 0 && function < int(pure_functions_->size()) && (*pure_functions_)[function];
+    }
+    return 
+        instruction_metadata(instruction).result &&
+        instruction != INSTRUCTION_ILLUMINANCE_AXIS_ANGLE
+    ;
+}
+
+/**
+// Does a decoded instruction write to one of its arguments?
+//
+// Assignments write their first argument and illuminance writes the 
+// light direction, color, and opacity arguments.  Pure instructions and 
+// the mask and jump instructions write none of their arguments.  Impure 
+// calls and the light instructions are assumed to write all of them.
+*/
+bool Decoder::writes( const DecodedInstruction& decoded_instruction, int index ) const
+{
+    const int instruction = decoded_instruction.instruction;
+    if ( !register_argument(decoded_instruction, index) || control(instruction) || pure(decoded_instruction) )
+    {
+        return false;
+    }
+    if ( assignment(instruction) || instruction == INSTRUCTION_ASSIGN_STRING )
+    {
+        return index == 0;
+    }
+    if ( instruction == INSTRUCTION_ILLUMINANCE_AXIS_ANGLE )
+    {
+        return index >= 3;
+    }
+    return true;
+}
+
+/**
+// Give the value written by each instruction in the shade code a register
+// of its own.
+//
+// Values then can't be overwritten by other instructions so instructions
+// are free to be shared or moved as long as each value is still written 
+// before it is read.  Registers are renumbered again from the live ranges 
+// of values by reuse_registers() once sharing and moving are done.
+//
+// @param permanent_registers
+//  The number of registers that aren't temporaries.
+//
+// @return
+//  The register given to the value written by the first instruction in 
+//  the shade code.  Registers below this are variables; either permanent
+//  registers or registers that the shade code reads before writing them.
+*/
+int Decoder::number_values( int permanent_registers )
+{
+    const int begin = shade_instruction_;
+    const int end = int(instructions_.size());
+    int values = permanent_registers;
+    for ( int i = 0; i < end; ++i )
+    {
+        const DecodedInstruction& decoded_instruction = instructions_[i];
+        values = max( values, decoded_instruction.result + 1 );
+        for ( int j = 0; j < DecodedInstruction::ARGUMENTS; ++j )
+        {
+            if ( register_argument(decoded_instruction, j) )
+            {
+                values = max( values, decoded_instruction.arguments[j] + 1 );
+            }
+        }
+    }
+
+    vector<int> values_by_register( values, -1 );
+    for ( int i = begin; i < end; ++i )
+    {
+        DecodedInstruction& decoded_instruction = instructions_[i];
+        for ( int j = 0; j < DecodedInstruction::ARGUMENTS; ++j )
+        {
+            int& argument = decoded_instruction.arguments[j];
+            if ( argument >= permanent_registers && register_argument(decoded_instruction, j) && values_by_register[argument] >= 0 )
+            {
+                argument = values_by_register[argument];
+            }
+        }
+        if ( decoded_instruction.result >= 0 )
+        {
+            values_by_register[decoded_instruction.result] = values + i - begin;
+            decoded_instruction.result = values + i - begin;
+        }
+    }
+    return values;
+}
+
+/**
+// Move the instructions in the innermost loop that compute the same value
+// on every iteration to just before the start of that loop.
+//
+// An instruction is loop invariant if it is pure and every argument that 
+// it reads is either a variable that isn't written anywhere in the loop 
+// or a value written outside of the loop or by another loop invariant 
+// instruction.  Invariant instructions are moved even when they're in 
+// conditional code in the loop; they're pure so computing them for 
+// elements that the loop's condition masks out only costs the time taken
+// to do so and never changes the values that the loop reads.
+//
+// Jumps from outside of the loop to its start jump to the moved 
+// instructions so that they're executed on the way into the loop, jumps 
+// from inside the loop back to its start skip them.
+//
+// @param values
+//  The first register that holds a value rather than a variable (see 
+//  number_values()).
+//
+// @return
+//  True if any instructions were moved otherwise false.
+*/
+bool Decoder::hoist_loop_invariants( int values )
+{
+    const int begin = shade_instruction_;
+    const int end = int(instructions_.size());
+
+    vector<pair<int, int>> loops;
+    for ( int i = begin; i < end; ++i )
+    {
+        const int target = instructions_[i].jump;
+        if ( target >= begin && target <= i )
+        {
+            loops.push_back( make_pair(target, i) );
+        }
+    }
+    sort( loops.begin(), loops.end(), &shorter_loop );
+
+    for ( vector<pair<int, int>>::const_iterator loop = loops.begin(); loop != loops.end(); ++loop )
+    {
+        const int target = loop->first;
+        const int back = loop->second;
+
+        vector<bool> written( values, false );
+        for ( int i = target; i <= back; ++i )
+        {
+            const DecodedInstruction& decoded_instruction = instructions_[i];
+            for ( int j = 0; j < DecodedInstruction::ARGUMENTS; ++j )
+            {
+                const int argument = decoded_instruction.arguments[j];
+                if ( writes(decoded_instruction, j) && argument < values )
+                {
+                    written[argument] = true;
+                }
+            }
+        }
+
+        bool hoisted = false;
+        vector<bool> invariant( back - target + 1, false );
+        vector<bool> variant( values + end - begin, false );
+        for ( int i = target; i <= back; ++i )
+        {
+            const DecodedInstruction& decoded_instruction = instructions_[i];
+            bool loop_invariant = pure( decoded_instruction );
+            for ( int j = 0; j < DecodedInstruction::ARGUMENTS && loop_invariant; ++j )
+            {
+                const int argument = decoded_instruction.arguments[j];
+                if ( register_argument(decoded_instruction, j) )
+                {
+                    loop_invariant = argument < values ? !written[argument] : !variant[argument];
+                }
+            }
+            if ( decoded_instruction.result >= 0 )
+            {
+                variant[decoded_instruction.result] = !loop_invariant;
+            }
+            invariant[i - target] = loop_invariant;
+            hoisted = hoisted || loop_invariant;
+        }
+
+        if ( hoisted )
+        {
+            vector<DecodedInstruction> instructions;
+            instructions.reserve( end );
+            vector<int> positions( end + 1, -1 );
+            for ( int i = 0; i < end; ++i )
+            {
+                if ( i == target )
+                {
+                    for ( int j = target; j <= back; ++j )
+                    {
+                        if ( invariant[j - target] )
+                        {
+                            positions[j] = int(instructions.size());
+                            instructions.push_back( instructions_[j] );
+                        }
+                    }
+                }
+                if ( i < target || i > back || !invariant[i - target] )
+                {
+                    positions[i] = int(instructions.size());
+                    instructions.push_back( instructions_[i] );
+                }
+            }
+            positions[end] = end;
+
+            for ( int i = 0; i < end; ++i )
+            {
+                DecodedInstruction& decoded_instruction = instructions[positions[i]];
+                int jump = decoded_instruction.jump;
+                if ( jump >= 0 )
+                {
+                    if ( jump == target && (i < target || i > back) )
+                    {
+                        decoded_instruction.jump = target;
+                    }
+                    else
+                    {
+                        while ( jump >= target && jump <= back && invariant[jump - target] )
+                        {
+                            ++jump;
+                        }
+                        decoded_instruction.jump = positions[jump];
+                    }
+                }
+            }
+
+            instructions_.swap( instructions );
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+// Replace instructions that compute a value that has already been 
+// computed with the earlier value.
+//
+// Instructions compute the same value when they're the same pure 
+// instruction with the same arguments and the variables in those 
+// arguments haven't been written in between.  The earlier value is only
+// used when it was computed for every element that the later instruction
+// processes; that is when it was computed under the same mask as the later
+// instruction or under one of the masks that the later instruction's mask
+// was generated from.  Values computed in one branch of an if statement 
+// are never used by the other branch or after the if statement.
+//
+// Jumps forward discard the values computed after the jump at their 
+// targets and jumps back to the start of a loop discard the values that 
+// depend on variables that are written in the loop.
+//
+// @param values
+//  The first register that holds a value rather than a variable (see 
+//  number_values()).
+*/
+void Decoder::share_common_subexpressions( int values )
+{
+    const int begin = shade_instruction_;
+    const int end = int(instructions_.size());
+
+    // Find the earliest jump forward to and the latest jump back to each 
+    // instruction.
+    vector<int> forward_jumps( end + 1, end );
+    vector<int> backward_jumps( end + 1, -1 );
+    for ( int i = begin; i < end; ++i )
+    {
+        const int target = instructions_[i].jump;
+        if ( target > i )
+        {
+            forward_jumps[target] = min( forward_jumps[target], i );
+        }
+        else if ( target >= begin )
+        {
+            backward_jumps[target] = max( backward_jumps[target], i );
+        }
+    }
+
+    // Masks are identified by the order in which they're generated or 
+    // inverted; each mask is generated from its parent.
+    vector<int> parent_masks( 1, -1 );
+    vector<int> masks( 1, 0 );
+
+    vector<int> versions( values, 0 );
+    vector<int> replacements( values + end - begin, -1 );
+    vector<bool> removed( end, false );
+    map<vector<int>, pair<int, int>> available;
+    for ( int i = begin; i < end; ++i )
+    {
+        if ( forward_jumps[i] < i )
+        {
+            for ( map<vector<int>, pair<int, int>>::iterator value = available.begin(); value != available.end(); )
+            {
+                map<vector<int>, pair<int, int>>::iterator next = value;
+                ++next;
+                if ( value->second.first > forward_jumps[i] )
+                {
+                    available.erase( value );
+                }
+                value = next;
+            }
+        }
+
+        if ( backward_jumps[i] >= i )
+        {
+            for ( int j = i; j <= backward_jumps[i]; ++j )
+            {
+                const DecodedInstruction& decoded_instruction = instructions_[j];
+                for ( int k = 0; k < DecodedInstruction::ARGUMENTS; ++k )
+                {
+                    const int argument = decoded_instruction.arguments[k];
+                    if ( writes(decoded_instruction, k) && argument < values )
+                    {
+                        ++versions[argument];
+                    }
+                }
+            }
+        }
+
+        DecodedInstruction& decoded_instruction = instructions_[i];
+        for ( int j = 0; j < DecodedInstruction::ARGUMENTS; ++j )
+        {
+            int& argument = decoded_instruction.arguments[j];
+            if ( register_argument(decoded_instruction, j) && argument >= values && replacements[argument] >= 0 )
+            {
+                argument = replacements[argument];
+            }
+        }
+
+        const int instruction = decoded_instruction.instruction;
+        if ( instruction == INSTRUCTION_GENERATE_MASK )
+        {
+            parent_masks.push_back( masks.back() );
+            masks.push_back( int(parent_masks.size()) - 1 );
+        }
+        else if ( instruction == INSTRUCTION_INVERT_MASK )
+        {
+            REYES_ASSERT( masks.size() > 1 );
+            parent_masks.push_back( parent_masks[masks.back()] );
+            masks.back() = int(parent_masks.size()) - 1;
+        }
+        else if ( instruction == INSTRUCTION_CLEAR_MASK )
+        {
+            REYES_ASSERT( masks.size() > 1 );
+            masks.pop_back();
+        }
+        else if ( pure(decoded_instruction) )
+        {
+            vector<int> key;
+            key.reserve( 3 + 2 * DecodedInstruction::ARGUMENTS );
+            key.push_back( instruction );
+            key.push_back( decoded_instruction.dispatch );
+            key.push_back( decoded_instruction.addend_dispatch );
+            for ( int j = 0; j < instruction_metadata(instruction).arguments; ++j )
+            {
+                const int argument = decoded_instruction.arguments[j];
+                key.push_back( argument );
+                key.push_back( register_argument(decoded_instruction, j) && argument < values ? versions[argument] : -1 );
+            }
+
+            map<vector<int>, pair<int, int>>::iterator value = available.find( key );
+            if ( value != available.end() )
+            {
+                int mask = masks.back();
+                while ( mask >= 0 && mask != value->second.second )
+                {
+                    mask = parent_masks[mask];
+                }
+                if ( mask >= 0 )
+                {
+                    replacements[decoded_instruction.result] = instructions_[value->second.first].result;
+                    removed[i] = true;
+                    continue;
+                }
+            }
+            available[key] = make_pair( i, masks.back() );
+        }
+
+        for ( int j = 0; j < DecodedInstruction::ARGUMENTS; ++j )
+        {
+            const int argument = decoded_instruction.arguments[j];
+            if ( writes(decoded_instruction, j) && argument < values )
+            {
+                ++versions[argument];
+            }
+        }
+    }
+
+    // Remove the replaced instructions; jumps to removed instructions go 
+    // to the instruction after them instead.
+    vector<int> positions( end + 1, -1 );
+    int position = begin;
+    for ( int i = 0; i < end; ++i )
+    {
+        if ( !removed[i] )
+        {
+            positions[i] = i < begin ? i : position++;
+        }
+    }
+    positions[end] = position;
+    for ( int i = end - 1; i >= 0; --i )
+    {
+        if ( positions[i] < 0 )
+        {
+            positions[i] = positions[i + 1];
+        }
+    }
+    for ( int i = 0; i < end; ++i )
+    {
+        if ( !removed[i] )
+        {
+            DecodedInstruction& decoded_instruction = instructions_[i];
+            if ( decoded_instruction.jump >= 0 )
+            {
+                decoded_instruction.jump = positions[decoded_instruction.jump];
+            }
+            instructions_[positions[i]] = decoded_instruction;
+        }
+    }
+    instructions_.resize( position );
+}
+
+/**
+// Renumber the temporary registers written by the shade code so that a 
+// register is reused as soon as the value written to it is no longer read.
+//
+// Each value is live from the instruction that writes it to the last 
+// instruction that reads it and values that are live at the start of a 
+// loop stay live until the jump back to the start.  Values are given the
+// lowest numbered register that is free when they're written.  Registers
+// are only freed after the instruction that last reads them so that no
+// instruction writes its result over one of its own operands.
+//
+// Registers read by the shade code before it writes them (parameters 
+// with typecast defaults are bound to the temporaries that the initialize
+// code writes them to) keep their numbers and are never reused.  The 
+// initialize code runs once per grid and is left as it is.
+//
+// @param permanent_registers
+//  The number of registers that aren't temporaries.
+*/
+void Decoder::reuse_registers( int permanent_registers )
+{
+    const int begin = shade_instruction_;
+    const int end = int(instructions_.size());
+    int registers = permanent_registers;
+    int initialize_registers = permanent_registers;
+    for ( int i = 0; i < end; ++i )
+    {
+        const DecodedInstruction& decoded_instruction = instructions_[i];
+        registers = max( registers, decoded_instruction.result + 1 );
+        for ( int j = 0; j < DecodedInstruction::ARGUMENTS; ++j )
+        {
+            if ( register_argument(decoded_instruction, j) )
+            {
+                registers = max( registers, decoded_instruction.arguments[j] + 1 );
+            }
+        }
+        if ( i < begin )
+        {
+            initialize_registers = registers;
+        }
+    }
+
+    // Find the instruction that wrote each value read by the shade code and
+    // the last instruction that reads each value that it writes.
+    vector<int> writers( registers, -1 );
+    vector<bool> pinned( registers, false );
+    vector<int> sources( (end - begin) * DecodedInstruction::ARGUMENTS, -1 );
+    vector<int> last_reads( end - begin, -1 );
+    for ( int i = begin; i < end; ++i )
+    {
+        const DecodedInstruction& decoded_instruction = instructions_[i];
+        for ( int j = 0; j < DecodedInstruction::ARGUMENTS; ++j )
+        {
+            const int argument = decoded_instruction.arguments[j];
+            if ( argument >= permanent_registers && register_argument(decoded_instruction, j) )
+            {
+                const int writer = writers[argument];
+                if ( writer >= 0 )
+                {
+                    sources[(i - begin) * DecodedInstruction::ARGUMENTS + j] = writer;
+                    last_reads[writer - begin] = i;
+                }
+                else
+                {
+                    pinned[argument] = true;
+                }
+            }
+        }
+        if ( decoded_instruction.result >= 0 )
+        {
+            writers[decoded_instruction.result] = i;
+            last_reads[i - begin] = i;
+        }
+    }
+
+    // Keep values that are live at the start of a loop live until the jump
+    // back to the start; repeated until nothing changes for nested loops.
+    bool extended = true;
+    while ( extended )
+    {
+        extended = false;
+        for ( int i = begin; i < end; ++i )
+        {
+            const int target = instructions_[i].jump;
+            if ( target >= begin && target <= i )
+            {
+                for ( int writer = begin; writer < target; ++writer )
+                {
+                    int& last_read = last_reads[writer - begin];
+                    if ( last_read >= target && last_read < i )
+                    {
+                        last_read = i;
+                        extended = true;
+                    }
+                }
+            }
+        }
+    }
+
+    vector<int> renumbered( end - begin, -1 );
+    vector<int> owners( permanent_registers, -1 );
+    for ( int i = begin; i < end; ++i )
+    {
+        for ( int r = permanent_registers; r < int(owners.size()); ++r )
+        {
+            if ( owners[r] >= 0 && last_reads[owners[r] - begin] < i )
+            {
+                owners[r] = -1;
+            }
+        }
+
+        DecodedInstruction& decoded_instruction = instructions_[i];
+        for ( int j = 0; j < DecodedInstruction::ARGUMENTS; ++j )
+        {
+            const int source = sources[(i - begin) * DecodedInstruction::ARGUMENTS + j];
+            if ( source >= 0 )
+            {
+                decoded_instruction.arguments[j] = renumbered[source - begin];
+            }
+        }
+
+        if ( decoded_instruction.result >= 0 )
+        {
+            int r = permanent_registers;
+            while ( r < int(owners.size()) && (owners[r] >= 0 || (r < int(pinned.size()) && pinned[r])) )
+            {
+                ++r;
+            }
+            if ( r == int(owners.size()) )
+            {
+                owners.push_back( -1 );
+            }
+            owners[r] = i;
+            renumbered[i - begin] = r;
+            decoded_instruction.result = r;
+        }
+    }
+
+    registers_ = max( initialize_registers, int(owners.size()) );
+    for ( int r = 0; r < int(pinned.size()); ++r )
+    {
+        if ( pinned[r] )
+        {
+            registers_ = max( registers_, r + 1 );
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef REYES_DECODER_HPP_INCLUDED
+#define REYES_DECODER_HPP_INCLUDED
+
+#include <reyes/reyes_virtual_machine/DecodedInstruction.hpp>
+#include "SourceLine.hpp"
+#include <vector>
+
+namespace reyes
+{
+
+/**
+// Decode the byte code for a shader into DecodedInstructions for the 
+// virtual machine to execute.
+//
+// Instructions in the shade code that compute a value that has already 
+// been computed are removed and instructions that compute the same value 
+// on every iteration of a loop are moved out of the loop.  The byte code 
+// allocates temporaries statement by statement so this is done here where
+// each value can be given a register of its own for as long as it is 
+// needed.
+//
+// The temporary registers written by the shade code are renumbered from 
+// the live ranges of the values written to them so that each register is
+// reused as soon as its value is no longer read.  This bounds the number
+// of registers, and so the memory allocated per grid, by the most values
+// live at once rather than by the length of the shader.
+*/
+class Decoder
+{
+    std::vector<DecodedInstruction> instructions_; ///< The decoded instructions.
+    int initialize_instruction_; ///< The index of the first instruction of the initialize code.
+    int shade_instruction_; ///< The index of the first instruction of the shade code.
+    int registers_; ///< The number of registers read or written by the decoded instructions.
+    const std::vector<bool>* pure_functions_; ///< Whether or not the function with each symbol index is pure (only while decoding).
+
+public:
+    Decoder();
+    std::vector<DecodedInstruction>& instructions();
+    int initialize_instruction() const;
+    int shade_instruction() const;
+    int registers() const;
+    void decode( const std::vector<unsigned char>& code, const std::vector<SourceLine>& lines, int initialize_address, int shade_address, int permanent_registers, const std::vector<bool>& pure_functions );
+
+private:
+    bool pure( const DecodedInstruction& decoded_instruction ) const;
+    bool writes( const DecodedInstruction& decoded_instruction, int index ) const;
+    int number_values( int permanent_registers );
+    bool hoist_loop_invariants( int values );
+    void share_common_subexpressions( int values );
+    void reuse_registers( int permanent_registers );
+};
+
+}
+
+#endif
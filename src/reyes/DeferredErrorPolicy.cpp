@@ -0,0 +1,57 @@
+//
+// DeferredErrorPolicy.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "DeferredErrorPolicy.hpp"
+#include "assert.hpp"
+#include <stdio.h>
+#include <stdarg.h>
+
+using std::vector;
+using std::string;
+using namespace reyes;
+
+DeferredErrorPolicy::DeferredErrorPolicy()
+: ErrorPolicy(),
+  codes_(),
+  messages_()
+{
+}
+
+const std::vector<int>& DeferredErrorPolicy::codes() const
+{
+    return codes_;
+}
+
+const std::vector<std::string>& DeferredErrorPolicy::messages() const
+{
+    return messages_;
+}
+
+/**
+// Report the errors recorded by this DeferredErrorPolicy to another 
+// ErrorPolicy in the order that they were recorded.
+//
+// @param error_policy
+//  The ErrorPolicy to report the recorded errors to.
+*/
+void DeferredErrorPolicy::report( ErrorPolicy& error_policy ) const
+{
+    REYES_ASSERT( codes_.size() == messages_.size() );
+    for ( unsigned int i = 0; i < codes_.size(); ++i )
+    {
+        error_policy.error( codes_[i], "%s", messages_[i].c_str() );
+    }
+}
+
+void DeferredErrorPolicy::render_error( int error, const char* format, va_list args )
+{
+    REYES_ASSERT( format );
+    char message [1024];
+    vsnprintf( message, sizeof(message), format, args );
+    message[sizeof(message) - 1] = 0;
+    codes_.push_back( error );
+    messages_.push_back( message );
+}
@@ -0,0 +1,37 @@
+#ifndef REYES_DEFERREDERRORPOLICY_HPP_INCLUDED
+#define REYES_DEFERREDERRORPOLICY_HPP_INCLUDED
+
+#include "ErrorPolicy.hpp"
+#include <string>
+#include <vector>
+
+namespace reyes
+{
+
+/**
+// An ErrorPolicy that records errors so that they can be reported to 
+// another ErrorPolicy later.
+//
+// Shaders compiled concurrently each report to their own 
+// DeferredErrorPolicy so that diagnostics are collected per shader and then
+// reported, in a deterministic order, on the thread that owns the 
+// Renderer's ErrorPolicy.
+*/
+class DeferredErrorPolicy : public ErrorPolicy
+{
+    std::vector<int> codes_; ///< The error codes of the recorded errors.
+    std::vector<std::string> messages_; ///< The formatted messages of the recorded errors.
+
+public:
+    DeferredErrorPolicy();
+    const std::vector<int>& codes() const;
+    const std::vector<std::string>& messages() const;
+    void report( ErrorPolicy& error_policy ) const;
+
+private:
+    void render_error( int error, const char* format, va_list args );
+};
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "stdafx.hpp"
 #include "Geometry.hpp"
+#include "Grid.hpp"
 #include <math/vec2.ipp>
 #include <math/vec3.ipp>
 #include <math/mat4x4.ipp>
@@ -67,3 +68,19 @@ bool Geometry::diceable() const
 void Geometry::dice( const math::mat4x4& /*transform*/, int /*width*/, int /*height*/, Grid* /*grid*/ ) const
 {
 }
+
+/**
+// Get an empty grid to dice into when calculating bounds.
+//
+// The grid is kept per thread and cleared rather than destroyed so that its
+// values are recycled and bounding geometry doesn't allocate once warm.
+//
+// @return
+//  The empty bounding grid for the calling thread.
+*/
+Grid& Geometry::bounding_grid()
+{
+    static thread_local Grid grid;
+    grid.clear();
+    return grid;
+}
@@ -33,6 +33,9 @@ public:
     virtual void split( std::list<std::shared_ptr<Geometry>>* primitives ) const;
     virtual bool diceable() const;
     virtual void dice( const math::mat4x4& transform, int width, int height, Grid* grid ) const;
+
+protected:
+    static Grid& bounding_grid();
 };
 
 }
@@ -6,11 +6,11 @@
 #include "stdafx.hpp"
 #include "Grid.hpp"
 #include "Value.hpp"
+#include "Identifier.hpp"
 #include <math/mat4x4.ipp>
 #include "assert.hpp"
 #include <vector>
 
-using std::map;
 using std::string;
 using std::vector;
 using std::shared_ptr;
@@ -23,23 +23,29 @@ Grid::Grid()
   du_( 0.0f ),
   dv_( 0.0f ),
   values_(),
-  values_by_identifier_(),
+  values_by_identifier_( IDENTIFIER_COUNT ),
+  identifiers_(),
   lights_(),
   transform_( math::identity() ),
-  shader_( NULL )
+  shader_( NULL ),
+  patches_(),
+  free_values_()
 {
 }
 
-Grid::Grid( Shader* shader )
+Grid::Grid( const Shader* shader )
 : width_( 1 ),
   height_( 1 ),
   du_( 0.0f ),
   dv_( 0.0f ),
   values_(),
-  values_by_identifier_(),
+  values_by_identifier_( IDENTIFIER_COUNT ),
+  identifiers_(),
   lights_(),
   transform_( math::identity() ),
-  shader_( shader )
+  shader_( shader ),
+  patches_(),
+  free_values_()
 {
     REYES_ASSERT( shader_ );
 }
@@ -50,16 +56,19 @@ Grid::Grid( const Grid& grid )
   du_( grid.du_ ),
   dv_( grid.dv_ ),
   values_(),
-  values_by_identifier_(),
+  values_by_identifier_( IDENTIFIER_COUNT ),
+  identifiers_(),
   lights_(),
   transform_( grid.transform_ ),
-  shader_( grid.shader_ )
+  shader_( grid.shader_ ),
+  patches_( grid.patches_ ),
+  free_values_()
 {
-    values_.reserve( grid.values_by_identifier_.size() );
-    const map<string, shared_ptr<Value>>& values_by_identifier = grid.values_by_identifier_;
-    for ( map<string, shared_ptr<Value>>::const_iterator i = values_by_identifier.begin(); i != values_by_identifier.end(); ++i )
+    values_.reserve( grid.identifiers_.size() );
+    identifiers_.reserve( grid.identifiers_.size() );
+    for ( vector<int>::const_iterator i = grid.identifiers_.begin(); i != grid.identifiers_.end(); ++i )
     {
-        copy_value( i->first, i->second );
+        copy_value( *i, grid.values_by_identifier_[*i] );
     }
 }
 
@@ -82,19 +91,39 @@ int Grid::size() const
     return width_ * height_;
 }
 
-Shader* Grid::shader() const
+const Shader* Grid::shader() const
 {
     return shader_;
 }
 
+/**
+// Clear this grid of its values, lights, and patches.
+//
+// Values that aren't referred to from outside of this grid are cleared and
+// kept to be reused by values added later.
+*/
 void Grid::clear()
 {
     width_ = 1;
     height_ = 1;
     du_ = 0.0f;
     dv_ = 0.0f;
+    patches_.clear();
     lights_.clear();
-    values_by_identifier_.clear();
+    for ( vector<int>::const_iterator i = identifiers_.begin(); i != identifiers_.end(); ++i )
+    {
+        values_by_identifier_[*i].reset();
+    }
+    identifiers_.clear();
+    for ( vector<shared_ptr<Value> >::const_iterator i = values_.begin(); i != values_.end(); ++i )
+    {
+        const shared_ptr<Value>& value = *i;
+        if ( value.use_count() == 1 )
+        {
+            value->clear();
+            free_values_.push_back( value );
+        }
+    }
     values_.clear();
 }
 
@@ -105,58 +134,174 @@ void Grid::resize( int width, int height )
     
     width_ = width;
     height_ = height;
+    patches_.clear();
+}
+
+/**
+// Resize this grid to the same size and patches as another grid.
+//
+// @param grid
+//  The grid to take the size and patches of.
+*/
+void Grid::resize( const Grid& grid )
+{
+    width_ = grid.width_;
+    height_ = grid.height_;
+    du_ = grid.du_;
+    dv_ = grid.dv_;
+    patches_ = grid.patches_;
+}
+
+/**
+// @return
+//  The number of patches in this grid (1 if this grid isn't concatenated
+//  from other grids).
+*/
+int Grid::patches() const
+{
+    return patches_.empty() ? 1 : int(patches_.size());
+}
+
+/**
+// Get the topology of a patch in this grid.
+//
+// @param index
+//  The index of the patch (assumed to be less than patches()).
+//
+// @return
+//  The patch; the whole grid if this grid isn't concatenated from other
+//  grids.
+*/
+Grid::Patch Grid::patch( int index ) const
+{
+    if ( patches_.empty() )
+    {
+        REYES_ASSERT( index == 0 );
+        Patch patch = { 0, width_, height_, du_, dv_ };
+        return patch;
+    }
+    REYES_ASSERT( index >= 0 && index < int(patches_.size()) );
+    return patches_[index];
+}
+
+/**
+// Append a patch of vertices to this grid.
+//
+// The first patch added after clear() or resize() replaces the size of
+// this grid; after that this grid is a single row of the vertices of all
+// of its patches.  Values should be added to this grid only after all of 
+// its patches have been added.
+//
+// @param width
+//  The number of vertices across the u direction of the patch.
+//
+// @param height
+//  The number of vertices down the v direction of the patch.
+//
+// @param du
+//  The size of increments in u for the patch.
+//
+// @param dv
+//  The size of increments in v for the patch.
+*/
+void Grid::add_patch( int width, int height, float du, float dv )
+{
+    REYES_ASSERT( width > 0 );
+    REYES_ASSERT( height > 0 );
+
+    const int offset = patches_.empty() ? 0 : width_ * height_;
+    Patch patch = { offset, width, height, du, dv };
+    patches_.push_back( patch );
+    width_ = offset + width * height;
+    height_ = 1;
+    du_ = du;
+    dv_ = dv;
 }
 
 void Grid::generate_normals( bool left_handed, bool force )
 {
-    if ( force || !find_value("N") )
+    if ( force || !find_value(IDENTIFIER_N) )
     {
-        Value& normals = value( "N", TYPE_NORMAL );    
-        const vec3* positions = value("P").vec3_values();
+        Value& normals = value( IDENTIFIER_N, TYPE_NORMAL );    
+        const vec3* positions = value(IDENTIFIER_P).vec3_values();
         REYES_ASSERT( positions );
         
-        vector<vec4> generated_normals;
-        generated_normals.insert( generated_normals.end(), width_ * height_, vec4(0.0f, 0.0f, 0.0f, 0.0f) );
+        // Accumulate face normals directly into the normals value; each 
+        // vertex is shared by one, two, or four faces depending on whether
+        // it is on a corner, an edge, or inside its patch.
+        normals.reset( TYPE_NORMAL, STORAGE_VARYING, width_ * height_ );
+        vec3* generated_normals = normals.vec3_values();
+        for ( int i = 0; i < width_ * height_; ++i )
+        {
+            generated_normals[i] = vec3( 0.0f, 0.0f, 0.0f );
+        }
 
-        int i = 0;
-        for ( int y = 0; y < height_ - 1; ++y )
+        const int patches = Grid::patches();
+        for ( int j = 0; j < patches; ++j )
         {
-            for ( int x = 0; x < width_ - 1; ++x )
+            const Patch patch = Grid::patch( j );
+            const int width = patch.width;
+            const int height = patch.height;
+
+            int i = patch.offset;
+            for ( int y = 0; y < height - 1; ++y )
+            {
+                for ( int x = 0; x < width - 1; ++x )
+                {
+                    int i0 = i + x;
+                    int i1 = i + width + x;
+                    int i2 = i + width + x + 1;
+                    int i3 = i + x + 1;
+
+                    vec3 u0 = positions[i3] - positions[i0];
+                    vec3 u1 = positions[i2] - positions[i1];
+                    vec3 u = length(u0) > length(u1) ? u0 : u1;
+                    vec3 v0 = positions[i1] - positions[i0];
+                    vec3 v1 = positions[i2] - positions[i3];
+                    vec3 v = length(v0) > length(v1) ? v0 : v1;     
+                    vec3 normal = normalize( left_handed ? cross(u, v) : cross(v, u) );
+
+                    generated_normals[i0] += normal;
+                    generated_normals[i1] += normal;
+                    generated_normals[i2] += normal;
+                    generated_normals[i3] += normal;
+                }
+                i += width;
+            }
+            
+            i = patch.offset;
+            for ( int y = 0; y < height; ++y )
             {
-                int i0 = i + x;
-                int i1 = i + width_ + x;
-                int i2 = i + width_ + x + 1;
-                int i3 = i + x + 1;
-
-                vec3 u0 = positions[i3] - positions[i0];
-                vec3 u1 = positions[i2] - positions[i1];
-                vec3 u = length(u0) > length(u1) ? u0 : u1;
-                vec3 v0 = positions[i1] - positions[i0];
-                vec3 v1 = positions[i2] - positions[i3];
-                vec3 v = length(v0) > length(v1) ? v0 : v1;     
-                vec3 normal = normalize( left_handed ? cross(u, v) : cross(v, u) );
-
-                generated_normals[i0] += vec4( normal, 1.0f );
-                generated_normals[i1] += vec4( normal, 1.0f );
-                generated_normals[i2] += vec4( normal, 1.0f );
-                generated_normals[i3] += vec4( normal, 1.0f );
+                float faces_in_v = y > 0 && y < height - 1 ? 2.0f : 1.0f;
+                for ( int x = 0; x < width; ++x )
+                {
+                    float faces_in_u = x > 0 && x < width - 1 ? 2.0f : 1.0f;
+                    generated_normals[i + x] = generated_normals[i + x] / (faces_in_u * faces_in_v);
+                }
+                i += width;
             }
-            i += width_;
         }
-        
-        normals.clear();
-        normals.reserve( generated_normals.size() );
-        vec3* values = normals.vec3_values();
-        int j = 0;
-        for ( vector<vec4>::const_iterator normal = generated_normals.begin(); normal != generated_normals.end(); ++normal )
-        {
-            values[j] = vec3(*normal) / normal->w;
-            ++j;
-        }  
     }
 }
 
 Value& Grid::value( const std::string& identifier, ValueType type )
+{
+    return value( intern_identifier(identifier), type );
+}
+
+/**
+// Find or add a value by its interned identifier.
+//
+// @param identifier
+//  The interned identifier of the value (see Identifier).
+//
+// @param type
+//  The type of the value to add if there is no value with \e identifier.
+//
+// @return
+//  The value.
+*/
+Value& Grid::value( int identifier, ValueType type )
 {
     shared_ptr<Value> value = find_value( identifier );
     if ( !value )
@@ -168,9 +313,14 @@ Value& Grid::value( const std::string& identifier, ValueType type )
 
 const Value& Grid::value( const std::string& identifier ) const
 {
-    shared_ptr<Value> value = find_value( identifier );
-    REYES_ASSERT( value );
-    return *value;
+    return value( intern_identifier(identifier) );
+}
+
+const Value& Grid::value( int identifier ) const
+{
+    REYES_ASSERT( identifier >= 0 && identifier < int(values_by_identifier_.size()) );
+    REYES_ASSERT( values_by_identifier_[identifier] );
+    return *values_by_identifier_[identifier];
 }
 
 Value& Grid::operator[]( const std::string& identifier )
@@ -178,48 +328,88 @@ Value& Grid::operator[]( const std::string& identifier )
     return value( identifier, TYPE_NULL );
 }
 
+Value& Grid::operator[]( int identifier )
+{
+    return value( identifier, TYPE_NULL );
+}
+
 const Value& Grid::operator[]( const std::string& identifier ) const
 {
     return value( identifier );
 }
 
+const Value& Grid::operator[]( int identifier ) const
+{
+    return value( identifier );
+}
+
 void Grid::copy_value( const std::string& identifier, std::shared_ptr<Value> value )
 {
     REYES_ASSERT( !identifier.empty() );
+    copy_value( intern_identifier(identifier), value );
+}
+
+void Grid::copy_value( int identifier, std::shared_ptr<Value> value )
+{
+    REYES_ASSERT( identifier >= 0 );
     REYES_ASSERT( !find_value(identifier) );
     REYES_ASSERT( value );
     REYES_ASSERT( int(value->size()) <= width_ * height_ );
 
-    shared_ptr<Value> copied_value( new Value(*value) );
+    shared_ptr<Value> copied_value = allocate_value();
+    *copied_value = *value;
     values_.push_back( copied_value );
-    values_by_identifier_.insert( make_pair(identifier, copied_value) );
+    insert_value( identifier, copied_value );
 }
 
 void Grid::insert_value( const std::string& identifier, std::shared_ptr<Value> value )
 {
     REYES_ASSERT( !identifier.empty() );
+    insert_value( intern_identifier(identifier), value );
+}
+
+void Grid::insert_value( int identifier, std::shared_ptr<Value> value )
+{
+    REYES_ASSERT( identifier >= 0 );
     REYES_ASSERT( !find_value(identifier) );
     REYES_ASSERT( value );
     REYES_ASSERT( int(value->size()) <= width_ * height_ );
     
-    values_by_identifier_.insert( make_pair(identifier, value) );
+    if ( identifier >= int(values_by_identifier_.size()) )
+    {
+        values_by_identifier_.resize( identifier + 1 );
+    }
+    values_by_identifier_[identifier] = value;
+    identifiers_.push_back( identifier );
 }
 
 std::shared_ptr<Value> Grid::add_value( const std::string& identifier, ValueType type, ValueStorage storage )
 {
     REYES_ASSERT( !identifier.empty() );
+    return add_value( intern_identifier(identifier), type, storage );
+}
+
+std::shared_ptr<Value> Grid::add_value( int identifier, ValueType type, ValueStorage storage )
+{
+    REYES_ASSERT( identifier >= 0 );
     REYES_ASSERT( !find_value(identifier) );
     
-    shared_ptr<Value> value( new Value(type, storage, size()) );
+    shared_ptr<Value> value = allocate_value();
+    value->reset( type, storage, size() );
     values_.push_back( value );
-    values_by_identifier_.insert( make_pair(identifier, value) );
+    insert_value( identifier, value );
     return value;
 }
 
 std::shared_ptr<Value> Grid::find_value( const std::string& identifier ) const
 {
-    map<string, shared_ptr<Value> >::const_iterator i = values_by_identifier_.find( identifier );
-    return i != values_by_identifier_.end() ? i->second : std::shared_ptr<Value>();
+    return find_value( intern_identifier(identifier) );
+}
+
+std::shared_ptr<Value> Grid::find_value( int identifier ) const
+{
+    REYES_ASSERT( identifier >= 0 );
+    return identifier < int(values_by_identifier_.size()) ? values_by_identifier_[identifier] : std::shared_ptr<Value>();
 }
 
 const std::vector<std::shared_ptr<Value>>& Grid::values() const
@@ -227,11 +417,29 @@ const std::vector<std::shared_ptr<Value>>& Grid::values() const
     return values_;
 }
 
-const std::map<std::string, std::shared_ptr<Value>>& Grid::values_by_identifier() const
+/**
+// Get the values stored in this grid indexed by their interned identifier.
+//
+// @return
+//  The values indexed by interned identifier; entries for identifiers that
+//  have no value in this grid are null (see identifiers()).
+*/
+const std::vector<std::shared_ptr<Value>>& Grid::values_by_identifier() const
 {
     return values_by_identifier_;
 }
 
+/**
+// Get the interned identifiers of the values stored in this grid.
+//
+// @return
+//  The interned identifiers in the order that their values were added.
+*/
+const std::vector<int>& Grid::identifiers() const
+{
+    return identifiers_;
+}
+
 void Grid::reserve_lights( unsigned int lights )
 {
     lights_.reserve( lights );
@@ -262,3 +470,21 @@ const math::mat4x4& Grid::get_transform() const
 {
     return transform_;
 }
+
+/**
+// Allocate a value to add to this grid.
+//
+// @return
+//  A value released by an earlier call to clear() or a new value if there
+//  are no released values.
+*/
+std::shared_ptr<Value> Grid::allocate_value()
+{
+    if ( free_values_.empty() )
+    {
+        return shared_ptr<Value>( new Value() );
+    }
+    shared_ptr<Value> value = free_values_.back();
+    free_values_.pop_back();
+    return value;
+}
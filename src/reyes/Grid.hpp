@@ -6,7 +6,6 @@
 #include <math/mat4x4.hpp>
 #include <string>
 #include <vector>
-#include <map>
 #include <memory>
 
 namespace math
@@ -29,45 +28,83 @@ class Shader;
 // A grid of uniform and/or varying values that represents parameters
 // to shaders, vertices in a diced grid of micropolygons, and lighting values
 // returned by light shaders run against a diced grid of micropolygons.
+//
+// Several small grids may be concatenated into one grid to be shaded 
+// together (see GridBatch).  A concatenated grid is a single row of all
+// of the vertices of the grids and keeps the topology of each of the 
+// grids as a patch so that derivatives and normals are still calculated
+// across each grid separately (see patches() and patch()).
+//
+// Values released by clear() are kept and reused by values added later so
+// that a grid that is cleared and diced again doesn't allocate once its 
+// values have grown to size.
 */
 class Grid
 {
 public:
+    /**
+    // The topology of one of the grids concatenated into a grid.
+    */
+    struct Patch
+    {
+        int offset; ///< The index of the first vertex of the patch in the grid.
+        int width; ///< The number of vertices across the u direction of the patch.
+        int height; ///< The number of vertices down the v direction of the patch.
+        float du; ///< Size of increments in u for the patch.
+        float dv; ///< Size of increments in v for the patch.
+    };
+
     int width_; ///< The number of vertices across the u direction of this grid.
     int height_; ///< The number of vertices down the v direction of this grid.
     float du_; ///< Size of increments in u for this grid.
     float dv_; ///< Size of increments in v for this grid.
     std::vector<std::shared_ptr<Value> > values_; // The values stored in this grid.
-    std::map<std::string, std::shared_ptr<Value> > values_by_identifier_; ///< The values stored in this grid by their identifier.
+    std::vector<std::shared_ptr<Value> > values_by_identifier_; ///< The values stored in this grid indexed by their interned identifier (null where there is no value).
+    std::vector<int> identifiers_; ///< The interned identifiers of the values stored in this grid in the order that they were added.
     std::vector<std::shared_ptr<Light> > lights_; ///< The lighting values for this grid.
     math::mat4x4 transform_; ///< The object to camera space transform at the time this Grid was bound to a Shader.
-    Shader* shader_; ///< The light shader that this Grid stores parameters for or null if this Grid doesn't store parameters.
+    const Shader* shader_; ///< The light shader that this Grid stores parameters for or null if this Grid doesn't store parameters.
+    std::vector<Patch> patches_; ///< The patches of the grids concatenated into this grid (empty if this grid isn't concatenated).
+    std::vector<std::shared_ptr<Value> > free_values_; ///< The values released by clear() to be reused by add_value() and copy_value().
     
     public:
         Grid();
-        Grid( Shader* shader );
+        Grid( const Shader* shader );
         Grid( const Grid& grid );
         ~Grid();
         
         int width() const;
         int height() const;
         int size() const;
-        Shader* shader() const;
+        const Shader* shader() const;
 
         void clear();
         void resize( int width, int height );
+        void resize( const Grid& grid );
+        int patches() const;
+        Patch patch( int index ) const;
+        void add_patch( int width, int height, float du, float dv );
         void generate_normals( bool left_handed, bool force = false );
 
         Value& value( const std::string& identifier, ValueType type );
+        Value& value( int identifier, ValueType type );
         const Value& value( const std::string& identifier ) const;
+        const Value& value( int identifier ) const;
         Value& operator[]( const std::string& identifier );
+        Value& operator[]( int identifier );
         const Value& operator[]( const std::string& identifier ) const;
+        const Value& operator[]( int identifier ) const;
         void copy_value( const std::string& identifier, std::shared_ptr<Value> value );
+        void copy_value( int identifier, std::shared_ptr<Value> value );
         void insert_value( const std::string& identifier, std::shared_ptr<Value> value );
+        void insert_value( int identifier, std::shared_ptr<Value> value );
         std::shared_ptr<Value> add_value( const std::string& identifier, ValueType type, ValueStorage storage = STORAGE_VARYING );
+        std::shared_ptr<Value> add_value( int identifier, ValueType type, ValueStorage storage = STORAGE_VARYING );
         std::shared_ptr<Value> find_value( const std::string& identifier ) const;
+        std::shared_ptr<Value> find_value( int identifier ) const;
         const std::vector<std::shared_ptr<Value> >& values() const;
-        const std::map<std::string, std::shared_ptr<Value> >& values_by_identifier() const;
+        const std::vector<std::shared_ptr<Value> >& values_by_identifier() const;
+        const std::vector<int>& identifiers() const;
         
         void reserve_lights( unsigned int lights );
         void add_light( std::shared_ptr<Light> light );
@@ -76,6 +113,9 @@ public:
         
         void set_transform( const math::mat4x4& transform );
         const math::mat4x4& get_transform() const;
+
+    private:
+        std::shared_ptr<Value> allocate_value();
 };
 
 }
@@ -0,0 +1,277 @@
+//
+// GridBatch.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "GridBatch.hpp"
+#include "Grid.hpp"
+#include "Value.hpp"
+#include "assert.hpp"
+#include <string.h>
+
+using std::vector;
+using std::shared_ptr;
+using namespace reyes;
+
+/**
+// Are two uniform values equal?
+*/
+static bool equal_uniform_values( const Value& value, const Value& other_value )
+{
+    if ( value.type() == TYPE_STRING )
+    {
+        return value.string_value() == other_value.string_value();
+    }
+    return 
+        value.size() == other_value.size() && 
+        memcmp( value.values(), other_value.values(), value.size() * value.element_size() ) == 0
+    ;
+}
+
+GridBatch::GridBatch()
+: grids_(),
+  next_grid_(),
+  free_grids_(),
+  vertices_( 0 ),
+  grid_()
+{
+}
+
+/**
+// @return
+//  True if no grids are queued in this batch.
+*/
+bool GridBatch::empty() const
+{
+    return grids_.empty();
+}
+
+/**
+// @return
+//  The number of grids queued in this batch.
+*/
+int GridBatch::grids() const
+{
+    return int(grids_.size());
+}
+
+/**
+// @return
+//  The total number of vertices in the grids queued in this batch.
+*/
+int GridBatch::vertices() const
+{
+    return vertices_;
+}
+
+/**
+// Get a grid queued in this batch.
+//
+// @param index
+//  The index of the grid in the order that it was queued (assumed to be
+//  less than grids()).
+//
+// @return
+//  The grid.
+*/
+Grid& GridBatch::grid( int index ) const
+{
+    REYES_ASSERT( index >= 0 && index < int(grids_.size()) );
+    REYES_ASSERT( grids_[index] );
+    return *grids_[index];
+}
+
+/**
+// Get the grid that the next grid to queue should be diced into.
+//
+// The grid isn't queued until push() is called so it can be checked with
+// accepts() first and the batch shaded and cleared if it isn't accepted.
+//
+// @return
+//  The grid to dice the next grid into; a grid released by an earlier call
+//  to clear() if there is one.
+*/
+Grid& GridBatch::next()
+{
+    if ( !next_grid_ )
+    {
+        if ( !free_grids_.empty() )
+        {
+            next_grid_ = free_grids_.back();
+            free_grids_.pop_back();
+        }
+        else
+        {
+            next_grid_.reset( new Grid );
+        }
+    }
+    return *next_grid_;
+}
+
+/**
+// Can a grid be queued in this batch?
+//
+// @param grid
+//  The grid to check (usually the grid returned by next()).
+//
+// @param maximum_vertices
+//  The most vertices that this batch may hold.
+//
+// @return
+//  True if this batch is empty or if \e grid fits in this batch and has
+//  the same values as the grids already queued with the same types, 
+//  storage, and uniform values.
+*/
+bool GridBatch::accepts( const Grid& grid, int maximum_vertices ) const
+{
+    if ( grids_.empty() )
+    {
+        return true;
+    }
+
+    if ( vertices_ + grid.size() > maximum_vertices )
+    {
+        return false;
+    }
+
+    const Grid& first_grid = *grids_.front();
+    const vector<int>& identifiers = first_grid.identifiers();
+    if ( grid.identifiers().size() != identifiers.size() )
+    {
+        return false;
+    }
+
+    for ( vector<int>::const_iterator i = identifiers.begin(); i != identifiers.end(); ++i )
+    {
+        const shared_ptr<Value> value = first_grid.find_value( *i );
+        const shared_ptr<Value> other_value = grid.find_value( *i );
+        if ( !value || !other_value || value->type() != other_value->type() || value->storage() != other_value->storage() )
+        {
+            return false;
+        }
+        if ( value->storage() != STORAGE_VARYING && !equal_uniform_values(*value, *other_value) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+// Queue the grid returned by next() in this batch.
+*/
+void GridBatch::push()
+{
+    REYES_ASSERT( next_grid_ );
+    vertices_ += next_grid_->size();
+    grids_.push_back( next_grid_ );
+    next_grid_.reset();
+}
+
+/**
+// Concatenate the queued grids into one grid for shading.
+//
+// @return
+//  The concatenated grid; one patch per queued grid with the varying 
+//  values of each grid in the order they were queued and the uniform 
+//  values of the first grid.
+*/
+Grid& GridBatch::gather()
+{
+    REYES_ASSERT( !grids_.empty() );
+
+    grid_.clear();
+    for ( vector<shared_ptr<Grid>>::const_iterator i = grids_.begin(); i != grids_.end(); ++i )
+    {
+        const Grid& grid = **i;
+        grid_.add_patch( grid.width(), grid.height(), grid.du_, grid.dv_ );
+    }
+
+    const Grid& first_grid = *grids_.front();
+    const vector<int>& identifiers = first_grid.identifiers();
+    for ( vector<int>::const_iterator i = identifiers.begin(); i != identifiers.end(); ++i )
+    {
+        const int identifier = *i;
+        const shared_ptr<Value>& first_value = first_grid.find_value( identifier );
+        REYES_ASSERT( first_value );
+        if ( first_value->storage() != STORAGE_VARYING )
+        {
+            grid_.copy_value( identifier, first_value );
+            continue;
+        }
+
+        shared_ptr<Value> value = grid_.add_value( identifier, first_value->type() );
+        const unsigned int element_size = value->element_size();
+        unsigned char* values = static_cast<unsigned char*>( value->values() );
+        for ( int j = 0; j < grid_.patches(); ++j )
+        {
+            const Grid::Patch patch = grid_.patch( j );
+            const Value& grid_value = grids_[j]->value( identifier );
+            REYES_ASSERT( int(grid_value.size()) == patch.width * patch.height );
+            memcpy( values + patch.offset * element_size, grid_value.values(), patch.width * patch.height * element_size );
+        }
+    }
+    return grid_;
+}
+
+/**
+// Copy the varying values of the concatenated grid back into the queued 
+// grids after shading.
+//
+// Values added by shading are added to each grid and uniform values are
+// copied to each grid unchanged.
+*/
+void GridBatch::scatter()
+{
+    REYES_ASSERT( grid_.patches() == int(grids_.size()) );
+
+    const vector<int>& identifiers = grid_.identifiers();
+    for ( vector<int>::const_iterator i = identifiers.begin(); i != identifiers.end(); ++i )
+    {
+        const int identifier = *i;
+        const shared_ptr<Value>& batch_value = grid_.find_value( identifier );
+        REYES_ASSERT( batch_value );
+        const bool varying = batch_value->storage() == STORAGE_VARYING && int(batch_value->size()) == grid_.size();
+        const unsigned int element_size = batch_value->element_size();
+        const unsigned char* batch_values = static_cast<const unsigned char*>( batch_value->values() );
+        for ( int j = 0; j < grid_.patches(); ++j )
+        {
+            Grid& grid = *grids_[j];
+            shared_ptr<Value> value = grid.find_value( identifier );
+            if ( !value )
+            {
+                value = grid.add_value( identifier, batch_value->type(), batch_value->storage() );
+            }
+
+            if ( varying )
+            {
+                const Grid::Patch patch = grid_.patch( j );
+                value->reset( batch_value->type(), STORAGE_VARYING, patch.width * patch.height );
+                memcpy( value->values(), batch_values + patch.offset * element_size, patch.width * patch.height * element_size );
+            }
+            else
+            {
+                *value = *batch_value;
+            }
+        }
+    }
+}
+
+/**
+// Remove all of the grids queued in this batch.
+//
+// The grids are cleared and kept to be returned from next() later.
+*/
+void GridBatch::clear()
+{
+    for ( vector<shared_ptr<Grid>>::const_iterator i = grids_.begin(); i != grids_.end(); ++i )
+    {
+        const shared_ptr<Grid>& grid = *i;
+        grid->clear();
+        free_grids_.push_back( grid );
+    }
+    grids_.clear();
+    vertices_ = 0;
+    grid_.clear();
+}
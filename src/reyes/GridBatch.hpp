@@ -0,0 +1,54 @@
+#ifndef REYES_GRIDBATCH_HPP_INCLUDED
+#define REYES_GRIDBATCH_HPP_INCLUDED
+
+#include "Grid.hpp"
+#include <vector>
+#include <memory>
+
+namespace reyes
+{
+
+/**
+// A queue of small grids that are shaded together as one grid.
+//
+// Distant geometry dices into many tiny grids and each paid the full cost
+// of setting up and running shaders (and light shaders) for only a handful
+// of vertices.  Grids diced with the same attributes are queued in a batch
+// instead, concatenated into one grid for shading (see gather()), and then
+// have the shaded values copied back for sampling (see scatter()).  The 
+// concatenated grid keeps each grid as a patch so that derivatives and 
+// normals see the topology of each grid (see Grid::patch()).
+//
+// Grids are only batched together if they have the same values with the 
+// same types and storage and equal uniform values so that the uniform 
+// values of the concatenated grid are those of every grid in it.
+//
+// Grids are cleared and kept when the batch is cleared and handed out 
+// again by next() so that dicing and shading doesn't allocate once the 
+// grids and their values have grown to size.
+*/
+class GridBatch
+{
+    std::vector<std::shared_ptr<Grid>> grids_; ///< The grids queued in this batch.
+    std::shared_ptr<Grid> next_grid_; ///< The grid to dice the next grid into (see next()).
+    std::vector<std::shared_ptr<Grid>> free_grids_; ///< The grids released by clear() to be reused by next().
+    int vertices_; ///< The total number of vertices in the grids queued in this batch.
+    Grid grid_; ///< The grid that the queued grids are concatenated into for shading.
+
+public:
+    GridBatch();
+    bool empty() const;
+    int grids() const;
+    int vertices() const;
+    Grid& grid( int index ) const;
+    Grid& next();
+    bool accepts( const Grid& grid, int maximum_vertices ) const;
+    void push();
+    Grid& gather();
+    void scatter();
+    void clear();
+};
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+//
+// Identifier.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "Identifier.hpp"
+#include "assert.hpp"
+#include <map>
+#include <mutex>
+#include <vector>
+
+using std::map;
+using std::vector;
+using std::string;
+using std::mutex;
+using std::lock_guard;
+using std::make_pair;
+
+namespace reyes
+{
+
+/**
+// The identifiers interned so far; shared by every Renderer and guarded by
+// a mutex as shaders can be loaded on several threads at once.
+*/
+struct IdentifierTable
+{
+    mutex mutex_; ///< Guards access to the identifiers.
+    map<string, int> indices_; ///< The interned identifiers by their identifier.
+    vector<string> identifiers_; ///< The identifiers by their interned identifier.
+
+    IdentifierTable()
+    : mutex_(),
+      indices_(),
+      identifiers_()
+    {
+        const char* IDENTIFIERS [IDENTIFIER_COUNT] = 
+        {
+            "P", "N", "I", "Cs", "Os", "Ci", "Oi", "s", "t", "Ps",
+            "current", "shader", "object", "world", "camera", "screen"
+        };
+        for ( int i = 0; i < IDENTIFIER_COUNT; ++i )
+        {
+            indices_.insert( make_pair(string(IDENTIFIERS[i]), i) );
+            identifiers_.push_back( IDENTIFIERS[i] );
+        }
+    }
+};
+
+static IdentifierTable& identifier_table()
+{
+    static IdentifierTable identifier_table;
+    return identifier_table;
+}
+
+/**
+// Intern an identifier.
+//
+// @param identifier
+//  The identifier to intern (assumed not empty).
+//
+// @return
+//  The interned identifier; the same identifier always interns to the same
+//  small, non-negative integer.
+*/
+int intern_identifier( const std::string& identifier )
+{
+    REYES_ASSERT( !identifier.empty() );
+
+    IdentifierTable& table = identifier_table();
+    lock_guard<mutex> lock( table.mutex_ );
+    map<string, int>::const_iterator i = table.indices_.find( identifier );
+    if ( i != table.indices_.end() )
+    {
+        return i->second;
+    }
+    int index = int(table.identifiers_.size());
+    table.indices_.insert( make_pair(identifier, index) );
+    table.identifiers_.push_back( identifier );
+    return index;
+}
+
+/**
+// Get the identifier that was interned to an interned identifier.
+//
+// @param identifier
+//  The interned identifier (assumed to have been returned from 
+//  intern_identifier()).
+//
+// @return
+//  The identifier.
+*/
+std::string interned_identifier( int identifier )
+{
+    IdentifierTable& table = identifier_table();
+    lock_guard<mutex> lock( table.mutex_ );
+    REYES_ASSERT( identifier >= 0 && identifier < int(table.identifiers_.size()) );
+    return table.identifiers_[identifier];
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef REYES_IDENTIFIER_HPP_INCLUDED
+#define REYES_IDENTIFIER_HPP_INCLUDED
+
+#include <string>
+
+namespace reyes
+{
+
+/**
+// Interned identifiers for the global variables that the renderer sets and
+// reads in grids and for the standard named coordinate systems.
+//
+// Identifiers are interned into small integers once, when a shader is 
+// loaded or a value is first added to a grid by name, so that grids can 
+// store their values in flat arrays and shaders can bind those values to 
+// registers without string comparisons.  String values are interned when
+// they're set so that the coordinate systems that they name are found 
+// without string comparisons too.  The identifiers here are interned 
+// first, in this order, so they are known at compile time.
+*/
+enum Identifier
+{
+    IDENTIFIER_P,
+    IDENTIFIER_N,
+    IDENTIFIER_I,
+    IDENTIFIER_CS,
+    IDENTIFIER_OS,
+    IDENTIFIER_CI,
+    IDENTIFIER_OI,
+    IDENTIFIER_S,
+    IDENTIFIER_T,
+    IDENTIFIER_PS,
+    IDENTIFIER_CURRENT,
+    IDENTIFIER_SHADER,
+    IDENTIFIER_OBJECT,
+    IDENTIFIER_WORLD,
+    IDENTIFIER_CAMERA,
+    IDENTIFIER_SCREEN,
+    IDENTIFIER_COUNT
+};
+
+int intern_identifier( const std::string& identifier );
+std::string interned_identifier( int identifier );
+
+}
+
+#endif
@@ -24,17 +24,42 @@ Light::~Light()
 {
 }
 
+/**
+// Reset this light to be reused for another light keeping its color and 
+// opacity values (see VirtualMachine::allocate_light()).
+//
+// @param type
+//  The type of light.
+//
+// @param position
+//  The position of the light.
+//
+// @param axis
+//  The axis of the light.
+//
+// @param angle
+//  The angle of the cone of light.
+*/
+void Light::reset( LightType type, const math::vec3& position, const math::vec3& axis, float angle )
+{
+    REYES_ASSERT( type >= LIGHT_NULL && type < LIGHT_COUNT );
+    type_ = type;
+    position_ = position;
+    axis_ = axis;
+    angle_ = angle;
+}
+
 LightType Light::type() const
 {
     return type_;
 }
 
-std::shared_ptr<Value> Light::color() const
+const std::shared_ptr<Value>& Light::color() const
 {
     return color_;
 }
 
-std::shared_ptr<Value> Light::opacity() const
+const std::shared_ptr<Value>& Light::opacity() const
 {
     return opacity_;
 }
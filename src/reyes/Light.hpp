@@ -26,10 +26,11 @@ class Light
 public:
     Light( LightType type, std::shared_ptr<Value> color, std::shared_ptr<Value> opacity, const math::vec3& position, const math::vec3& axis, float angle );
     ~Light();
+    void reset( LightType type, const math::vec3& position, const math::vec3& axis, float angle );
     
     LightType type() const;
-    std::shared_ptr<Value> color() const;
-    std::shared_ptr<Value> opacity() const;
+    const std::shared_ptr<Value>& color() const;
+    const std::shared_ptr<Value>& opacity() const;
     const math::vec3& position() const;
     const math::vec3& axis() const;
     float angle() const;
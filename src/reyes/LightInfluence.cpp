@@ -0,0 +1,185 @@
+//
+// LightInfluence.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "LightInfluence.hpp"
+#include "Light.hpp"
+#include <math/vec3.ipp>
+#include "assert.hpp"
+#include <float.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+using std::vector;
+using std::shared_ptr;
+using namespace math;
+using namespace reyes;
+
+LightInfluence::LightInfluence()
+: inferred_( false ),
+  cutoff_( 0.0f ),
+  position_( 0.0f, 0.0f, 0.0f ),
+  axis_( 0.0f, 0.0f, 1.0f ),
+  angle_( 0.0f ),
+  radius_( FLT_MAX ),
+  bounded_( false ),
+  uniform_lights_()
+{
+}
+
+/**
+// Has this influence been inferred with a particular cutoff intensity?
+//
+// @param cutoff
+//  The cutoff intensity currently in effect.
+//
+// @return
+//  True if this influence has been inferred with \e cutoff otherwise false.
+*/
+bool LightInfluence::inferred( float cutoff ) const
+{
+    return inferred_ && cutoff_ == cutoff;
+}
+
+bool LightInfluence::bounded() const
+{
+    return bounded_;
+}
+
+const math::vec3& LightInfluence::position() const
+{
+    return position_;
+}
+
+const math::vec3& LightInfluence::axis() const
+{
+    return axis_;
+}
+
+float LightInfluence::angle() const
+{
+    return angle_;
+}
+
+float LightInfluence::radius() const
+{
+    return radius_;
+}
+
+const std::vector<std::shared_ptr<Light> >& LightInfluence::uniform_lights() const
+{
+    return uniform_lights_;
+}
+
+/**
+// Mark this influence as affecting all of space.
+//
+// Ambient and solar lights and light shaders whose illumination can't be 
+// described by a single illuminate statement are never culled.
+//
+// @param cutoff
+//  The cutoff intensity in effect when this influence was inferred.
+*/
+void LightInfluence::set_unbounded( float cutoff )
+{
+    inferred_ = true;
+    cutoff_ = cutoff;
+    position_ = vec3( 0.0f, 0.0f, 0.0f );
+    axis_ = vec3( 0.0f, 0.0f, 1.0f );
+    angle_ = 0.0f;
+    radius_ = FLT_MAX;
+    bounded_ = false;
+    uniform_lights_.clear();
+}
+
+/**
+// Bound this influence by a cone and/or a sphere around the light's 
+// position.
+//
+// @param cutoff
+//  The cutoff intensity in effect when this influence was inferred.
+//
+// @param position
+//  The camera space position of the light.
+//
+// @param axis
+//  The camera space axis of the light's cone (needn't be normalized).
+//
+// @param angle
+//  The half angle of the light's cone or 0 if the light illuminates in all
+//  directions.
+//
+// @param radius
+//  The distance from the light beyond which it has no influence or FLT_MAX
+//  if the light's influence isn't bounded by distance.
+*/
+void LightInfluence::set_bounded( float cutoff, const math::vec3& position, const math::vec3& axis, float angle, float radius )
+{
+    REYES_ASSERT( angle >= 0.0f );
+    REYES_ASSERT( radius >= 0.0f );
+
+    inferred_ = true;
+    cutoff_ = cutoff;
+    position_ = position;
+    axis_ = length( axis ) > 0.0f ? normalize( axis ) : vec3( 0.0f, 0.0f, 1.0f );
+    angle_ = angle < float(M_PI) / 2.0f ? angle : 0.0f;
+    radius_ = radius;
+    bounded_ = angle_ > 0.0f || radius_ < FLT_MAX;
+    uniform_lights_.clear();
+}
+
+/**
+// Set the lights shared between all grids lit by a light shader that 
+// doesn't depend on the surface being lit.
+//
+// @param uniform_lights
+//  The lights to share between grids (their color and opacity values are 
+//  expected to be uniform).
+*/
+void LightInfluence::set_uniform_lights( const std::vector<std::shared_ptr<Light> >& uniform_lights )
+{
+    uniform_lights_ = uniform_lights;
+}
+
+/**
+// Does this influence reach into a sphere?
+//
+// The test is conservative; it may report that a sphere is affected when it
+// lies just outside of the influence but never the reverse.
+//
+// @param center
+//  The camera space center of the sphere.
+//
+// @param radius
+//  The radius of the sphere.
+//
+// @return
+//  True if any point in the sphere may receive light otherwise false.
+*/
+bool LightInfluence::affects( const math::vec3& center, float radius ) const
+{
+    if ( !bounded_ )
+    {
+        return true;
+    }
+
+    const vec3 to_center = center - position_;
+    if ( radius_ < FLT_MAX && length(to_center) - radius > radius_ )
+    {
+        return false;
+    }
+
+    if ( angle_ > 0.0f )
+    {
+        const float distance_along_axis = dot( to_center, axis_ );
+        const float distance_from_axis = length( to_center - axis_ * distance_along_axis );
+        if ( distance_from_axis * cosf(angle_) - distance_along_axis * sinf(angle_) > radius )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
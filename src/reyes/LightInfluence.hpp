@@ -0,0 +1,57 @@
+#ifndef REYES_LIGHTINFLUENCE_HPP_INCLUDED
+#define REYES_LIGHTINFLUENCE_HPP_INCLUDED
+
+#include <math/vec3.hpp>
+#include <vector>
+#include <memory>
+
+namespace reyes
+{
+
+class Light;
+
+/**
+// The region of space that a light shader can illuminate.
+//
+// Grids that lie entirely outside of a light's influence receive no light 
+// from it and so the light shader doesn't need to be run for them.  The 
+// influence is inferred from the illuminate statement that the light shader
+// executes and is bounded by the cone of that statement and, when a cutoff 
+// intensity is set, by the distance at which the light's intensity falls 
+// below the cutoff.
+//
+// Light shaders that don't read the surface position or normal produce the
+// same lights for every grid.  Those lights are evaluated once, stored with
+// uniform color and opacity, and shared between grids.
+*/
+class LightInfluence
+{
+    bool inferred_; ///< True if this influence has been inferred from its light shader.
+    float cutoff_; ///< The cutoff intensity that this influence was inferred with.
+    math::vec3 position_; ///< The position of the light.
+    math::vec3 axis_; ///< The normalized axis of the light's cone.
+    float angle_; ///< The half angle of the light's cone or 0 if the light has no cone.
+    float radius_; ///< The distance beyond which the light has no influence (FLT_MAX for unbounded).
+    bool bounded_; ///< True if this influence is bounded (false for lights that affect everything).
+    std::vector<std::shared_ptr<Light> > uniform_lights_; ///< The lights shared between grids for light shaders that don't depend on the surface.
+
+public:
+    LightInfluence();
+
+    bool inferred( float cutoff ) const;
+    bool bounded() const;
+    const math::vec3& position() const;
+    const math::vec3& axis() const;
+    float angle() const;
+    float radius() const;
+    const std::vector<std::shared_ptr<Light> >& uniform_lights() const;
+
+    void set_unbounded( float cutoff );
+    void set_bounded( float cutoff, const math::vec3& position, const math::vec3& axis, float angle, float radius );
+    void set_uniform_lights( const std::vector<std::shared_ptr<Light> >& uniform_lights );
+    bool affects( const math::vec3& center, float radius ) const;
+};
+
+}
+
+#endif
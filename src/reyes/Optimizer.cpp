@@ -0,0 +1,1483 @@
+//
+// Optimizer.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "Optimizer.hpp"
+#include "Encoder.hpp"
+#include "Value.hpp"
+#include <reyes/reyes_virtual_machine/Instruction.hpp>
+#include <reyes/reyes_virtual_machine/InstructionMetadata.hpp>
+#include <reyes/reyes_virtual_machine/Dispatch.hpp>
+#include "assert.hpp"
+#include <algorithm>
+#include <map>
+
+using std::map;
+using std::max;
+using std::sort;
+using std::unique;
+using std::vector;
+using namespace reyes;
+
+/**
+// Get the width in floats of the operand described by one half of a 
+// dispatch code.
+*/
+static int dispatch_width( int dispatch )
+{
+    return (dispatch & 0x0f) + 1;
+}
+
+Optimizer::Optimizer()
+: operations_(),
+  code_(),
+  lines_(),
+  initialize_address_( 0 ),
+  shade_address_( 0 ),
+  permanent_registers_( 0 ),
+  shade_operation_( 0 ),
+  removed_( 0 ),
+  fused_( 0 ),
+  folded_( 0 ),
+  eliminated_( 0 ),
+  values_(),
+  written_(),
+  locals_(),
+  branch_registers_()
+{
+}
+
+const std::vector<unsigned char>& Optimizer::code() const
+{
+    return code_;
+}
+
+const std::vector<SourceLine>& Optimizer::lines() const
+{
+    return lines_;
+}
+
+int Optimizer::initialize_address() const
+{
+    return initialize_address_;
+}
+
+int Optimizer::shade_address() const
+{
+    return shade_address_;
+}
+
+int Optimizer::removed() const
+{
+    return removed_;
+}
+
+int Optimizer::fused() const
+{
+    return fused_;
+}
+
+int Optimizer::folded() const
+{
+    return folded_;
+}
+
+int Optimizer::eliminated() const
+{
+    return eliminated_;
+}
+
+const std::vector<int>& Optimizer::branch_registers() const
+{
+    return branch_registers_;
+}
+
+/**
+// Optimize byte code.
+//
+// The optimized code, lines, and addresses are available from code(), 
+// lines(), initialize_address(), and shade_address() afterwards.  They are
+// unchanged copies of \e code, \e lines, and addresses if nothing could be 
+// optimized or \e code couldn't be decoded.
+//
+// @param code
+//  The byte code to optimize.
+//
+// @param lines
+//  The lines of source that \e code was generated for (see 
+//  CodeGenerator::lines()).
+//
+// @param initialize_address
+//  The address of the initialize code in \e code.
+//
+// @param shade_address
+//  The address of the shade code in \e code.
+//
+// @param permanent_registers
+//  The number of registers that hold parameters, constants, variables, 
+//  and globals; registers from this index up are temporaries allocated by
+//  the instructions that write them.
+//
+// @param local_registers
+//  The registers of the local variables declared by the shader (see 
+//  CodeGenerator::local_registers()); assignments to these that are never
+//  read are removed.
+*/
+void Optimizer::optimize( const std::vector<unsigned char>& code, const std::vector<SourceLine>& lines, int initialize_address, int shade_address, int permanent_registers, const std::vector<int>& local_registers )
+{
+    rewrite( code, lines, initialize_address, shade_address, permanent_registers, vector<const Value*>(), local_registers );
+}
+
+/**
+// Specialize byte code on known values for some of its registers and then
+// optimize it as optimize() does.
+//
+// Each if statement in the shade code whose condition depends only on 
+// known values, through comparisons, logical operators, and arithmetic on 
+// uniform floats, is folded.  If the condition is true the condition mask
+// and any else statement are removed.  If the condition is false the 
+// statement and the condition mask are removed leaving any else statement
+// to run unmasked.  Statements are only removed when no jump enters or 
+// leaves them.
+//
+// @param code
+//  The byte code to specialize.
+//
+// @param lines
+//  The lines of source that \e code was generated for.
+//
+// @param initialize_address
+//  The address of the initialize code in \e code.
+//
+// @param shade_address
+//  The address of the shade code in \e code.
+//
+// @param permanent_registers
+//  The number of registers that hold parameters, constants, variables, 
+//  and globals.
+//
+// @param values
+//  The values to specialize on indexed by register (null where a register's
+//  value isn't known).  Only uniform float and integer values of permanent
+//  registers that the shade code doesn't write to are used.
+*/
+void Optimizer::specialize( const std::vector<unsigned char>& code, const std::vector<SourceLine>& lines, int initialize_address, int shade_address, int permanent_registers, const std::vector<const Value*>& values )
+{
+    rewrite( code, lines, initialize_address, shade_address, permanent_registers, values, vector<int>() );
+}
+
+/**
+// Find the permanent registers that the conditions of if statements in 
+// the shade code depend on through operations that specialize() can 
+// evaluate.
+//
+// The registers are available from branch_registers() afterwards.  
+// Specializing on the values of any other registers folds no conditions.
+//
+// @param code
+//  The byte code to search.
+//
+// @param initialize_address
+//  The address of the initialize code in \e code.
+//
+// @param shade_address
+//  The address of the shade code in \e code.
+//
+// @param permanent_registers
+//  The number of registers that hold parameters, constants, variables, 
+//  and globals.
+*/
+void Optimizer::find_branch_registers( const std::vector<unsigned char>& code, int initialize_address, int shade_address, int permanent_registers )
+{
+    permanent_registers_ = permanent_registers;
+    branch_registers_.clear();
+    if ( decode(code, initialize_address, shade_address) )
+    {
+        find_written_registers();
+        for ( int i = shade_operation_; i < int(operations_.size()); ++i )
+        {
+            if ( conditional(i) )
+            {
+                collect_branch_registers( i, operations_[i].arguments[0] );
+            }
+        }
+        sort( branch_registers_.begin(), branch_registers_.end() );
+        branch_registers_.erase( unique(branch_registers_.begin(), branch_registers_.end()), branch_registers_.end() );
+    }
+    operations_.clear();
+}
+
+/**
+// Specialize and optimize byte code for optimize() and specialize().
+*/
+void Optimizer::rewrite( const std::vector<unsigned char>& code, const std::vector<SourceLine>& lines, int initialize_address, int shade_address, int permanent_registers, const std::vector<const Value*>& values, const std::vector<int>& local_registers )
+{
+    code_ = code;
+    lines_ = lines;
+    initialize_address_ = initialize_address;
+    shade_address_ = shade_address;
+    permanent_registers_ = permanent_registers;
+    removed_ = 0;
+    fused_ = 0;
+    folded_ = 0;
+    eliminated_ = 0;
+
+    if ( !decode(code, initialize_address, shade_address) )
+    {
+        return;
+    }
+
+    locals_.assign( permanent_registers_, false );
+    for ( vector<int>::const_iterator i = local_registers.begin(); i != local_registers.end(); ++i )
+    {
+        if ( *i >= 0 && *i < permanent_registers_ )
+        {
+            locals_[*i] = true;
+        }
+    }
+
+    if ( !values.empty() )
+    {
+        values_ = values;
+        find_written_registers();
+        remove_dead_branches();
+    }
+
+    bool changed = true;
+    while ( changed )
+    {
+        changed = remove_promotions();
+        changed = remove_conversions() || changed;
+        changed = fuse_multiply_adds() || changed;
+        changed = remove_self_assignments() || changed;
+        changed = remove_dead_code() || changed;
+    }
+
+    if ( removed_ > 0 && !encode() )
+    {
+        code_ = code;
+        lines_ = lines;
+        initialize_address_ = initialize_address;
+        shade_address_ = shade_address;
+        removed_ = 0;
+        fused_ = 0;
+        folded_ = 0;
+        eliminated_ = 0;
+    }
+    operations_.clear();
+    values_.clear();
+    locals_.clear();
+}
+
+/**
+// Decode byte code into operations, simulating the implicit allocation of
+// result registers made by the virtual machine and resolving jumps to the
+// operations that they jump to.
+//
+// @return
+//  True if the code was decoded or false if it contains something that 
+//  this optimizer doesn't understand (in which case it is left alone).
+*/
+bool Optimizer::decode( const std::vector<unsigned char>& code, int initialize_address, int shade_address )
+{
+    operations_.clear();
+    shade_operation_ = 0;
+    if ( code.empty() || initialize_address != 0 || shade_address < initialize_address )
+    {
+        return false;
+    }
+
+    map<int, int> operation_by_address;
+    const unsigned char* begin = &code[0];
+    const unsigned char* end = begin + code.size();
+    const unsigned char* position = begin;
+    int register_index = permanent_registers_;
+    while ( position < end )
+    {
+        const int address = int(position - begin);
+        if ( address == shade_address )
+        {
+            shade_operation_ = int(operations_.size());
+            register_index = permanent_registers_;
+        }
+
+        if ( position + sizeof(short) > end )
+        {
+            return false;
+        }
+        const int instruction = *reinterpret_cast<const short*>( position );
+        position += sizeof(short);
+        if ( instruction <= INSTRUCTION_NULL || instruction >= INSTRUCTION_COUNT )
+        {
+            return false;
+        }
+
+        const InstructionMetadata& metadata = instruction_metadata( instruction );
+        if ( position + metadata.words * sizeof(short) + metadata.arguments * sizeof(int) > end )
+        {
+            return false;
+        }
+
+        Operation operation;
+        operation.instruction = instruction;
+        operation.dispatch = *reinterpret_cast<const short*>( position );
+        operation.addend_dispatch = metadata.words > 1 ? *reinterpret_cast<const short*>( position + sizeof(short) ) : 0;
+        position += metadata.words * sizeof(short);
+        for ( int i = 0; i < metadata.arguments; ++i )
+        {
+            operation.arguments.push_back( *reinterpret_cast<const int*>(position) );
+            position += sizeof(int);
+        }
+        operation.address = address;
+        operation.result = -1;
+        operation.target = metadata.jump ? int(position - begin) + operation.arguments[0] : -1;
+        operation.jumped_to = false;
+        operation.removed = false;
+
+        if ( instruction == INSTRUCTION_RESET )
+        {
+            register_index = operation.arguments[0];
+        }
+        else if ( metadata.result )
+        {
+            operation.result = register_index;
+            ++register_index;
+        }
+
+        operation_by_address[address] = int(operations_.size());
+        operations_.push_back( operation );
+    }
+
+    if ( shade_address >= int(code.size()) || operations_[shade_operation_].address != shade_address )
+    {
+        return false;
+    }
+
+    for ( vector<Operation>::iterator i = operations_.begin(); i != operations_.end(); ++i )
+    {
+        Operation& operation = *i;
+        if ( operation.target >= 0 )
+        {
+            map<int, int>::const_iterator target = operation_by_address.find( operation.target );
+            if ( target == operation_by_address.end() )
+            {
+                return false;
+            }
+            operation.target = target->second;
+            operations_[target->second].jumped_to = true;
+        }
+    }
+    return true;
+}
+
+/**
+// Remove promotions of uniform values that are only read by arithmetic 
+// with a varying value.
+//
+// The uniform value is passed directly to the arithmetic which then uses
+// its uniform/varying kernel rather than reading a promoted copy.
+*/
+bool Optimizer::remove_promotions()
+{
+    bool changed = false;
+    for ( int i = 0; i < int(operations_.size()); ++i )
+    {
+        Operation& promote = operations_[i];
+        if ( promote.removed || promote.instruction != INSTRUCTION_PROMOTE )
+        {
+            continue;
+        }
+
+        int position = 0;
+        int reader = find_only_reader( i, &position );
+        if ( reader < 0 )
+        {
+            continue;
+        }
+
+        Operation& operation = operations_[reader];
+        if ( operation.instruction != INSTRUCTION_MULTIPLY && operation.instruction != INSTRUCTION_DIVIDE && operation.instruction != INSTRUCTION_ADD && operation.instruction != INSTRUCTION_SUBTRACT )
+        {
+            continue;
+        }
+
+        const int other = position == 0 ? operation.dispatch & 0xff : (operation.dispatch >> 8) & 0xff;
+        if ( !(other & DISPATCH_VARYING) )
+        {
+            continue;
+        }
+
+        const int uniform = promote.dispatch & 0xff;
+        operation.dispatch = position == 0 ? (uniform << 8) | other : (other << 8) | uniform;
+        operation.arguments[position] = promote.arguments[0];
+        promote.removed = true;
+        ++removed_;
+        changed = true;
+    }
+    return changed;
+}
+
+/**
+// Remove conversions of floats to vec3 values that are only multiplied by
+// another vec3.
+//
+// Multiplication is commutative so the operands are swapped if necessary 
+// to place the float on the right hand side where the kernels that scale
+// a vec3 by a float expect it.
+//
+// The float keeps the storage that it had before conversion so the 
+// conversion is only removed when its source and result have the same 
+// storage and the multiplication reads the result with that storage too.
+*/
+bool Optimizer::remove_conversions()
+{
+    bool changed = false;
+    for ( int i = 0; i < int(operations_.size()); ++i )
+    {
+        Operation& convert = operations_[i];
+        if ( convert.removed || convert.instruction != INSTRUCTION_CONVERT )
+        {
+            continue;
+        }
+
+        const int from = convert.dispatch & 0xff;
+        const int to = (convert.dispatch >> 8) & 0xff;
+        if ( dispatch_width(from) != 1 || dispatch_width(to) != 3 || (from & DISPATCH_VARYING) != (to & DISPATCH_VARYING) )
+        {
+            continue;
+        }
+
+        int position = 0;
+        int reader = find_only_reader( i, &position );
+        if ( reader < 0 || operations_[reader].instruction != INSTRUCTION_MULTIPLY )
+        {
+            continue;
+        }
+
+        Operation& multiply = operations_[reader];
+        const int converted = position == 0 ? (multiply.dispatch >> 8) & 0xff : multiply.dispatch & 0xff;
+        const int other = position == 0 ? multiply.dispatch & 0xff : (multiply.dispatch >> 8) & 0xff;
+        if ( converted != to || dispatch_width(other) != 3 )
+        {
+            continue;
+        }
+
+        const int other_argument = multiply.arguments[1 - position];
+        multiply.dispatch = (other << 8) | from;
+        multiply.arguments[0] = other_argument;
+        multiply.arguments[1] = convert.arguments[0];
+        convert.removed = true;
+        ++removed_;
+        changed = true;
+    }
+    return changed;
+}
+
+/**
+// Fuse multiplications that are only read by an addition into a single
+// multiply-add.
+//
+// The multiply-add replaces the addition so that the product is 
+// calculated where it is used; no instructions between the two write to 
+// any register other than their own result so the factors are unchanged.
+*/
+bool Optimizer::fuse_multiply_adds()
+{
+    bool changed = false;
+    for ( int i = 0; i < int(operations_.size()); ++i )
+    {
+        Operation& multiply = operations_[i];
+        if ( multiply.removed || multiply.instruction != INSTRUCTION_MULTIPLY )
+        {
+            continue;
+        }
+
+        const int lhs_width = dispatch_width( (multiply.dispatch >> 8) & 0xff );
+        const int rhs_width = dispatch_width( multiply.dispatch & 0xff );
+        if ( (lhs_width != 1 && lhs_width != 3) || (rhs_width != lhs_width && rhs_width != 1) )
+        {
+            continue;
+        }
+
+        int position = 0;
+        int reader = find_only_reader( i, &position );
+        if ( reader < 0 || operations_[reader].instruction != INSTRUCTION_ADD )
+        {
+            continue;
+        }
+
+        Operation& add = operations_[reader];
+        const int addend_dispatch = position == 0 ? add.dispatch & 0xff : (add.dispatch >> 8) & 0xff;
+        if ( dispatch_width(addend_dispatch) != lhs_width )
+        {
+            continue;
+        }
+
+        const int addend = add.arguments[1 - position];
+        add.instruction = INSTRUCTION_MULTIPLY_ADD;
+        add.dispatch = multiply.dispatch;
+        add.addend_dispatch = addend_dispatch;
+        add.arguments.clear();
+        add.arguments.push_back( multiply.arguments[0] );
+        add.arguments.push_back( multiply.arguments[1] );
+        add.arguments.push_back( addend );
+        multiply.removed = true;
+        ++removed_;
+        ++fused_;
+        changed = true;
+    }
+    return changed;
+}
+
+/**
+// Remove assignments of a variable to itself.
+*/
+bool Optimizer::remove_self_assignments()
+{
+    bool changed = false;
+    for ( vector<Operation>::iterator i = operations_.begin(); i != operations_.end(); ++i )
+    {
+        Operation& operation = *i;
+        if ( !operation.removed && operation.instruction == INSTRUCTION_ASSIGN && operation.arguments[0] == operation.arguments[1] )
+        {
+            operation.removed = true;
+            ++removed_;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+// Remove operations in the shade code whose results never reach anything
+// visible once the shader has run.
+//
+// Operations that write parameters or global variables, calls, jumps, and
+// the other operations with side effects are live.  Any operation that
+// writes a temporary or local variable read by a live operation is live, 
+// as are the masks of the if statements that live operations run in and 
+// the operations that calculate their conditions.  Everything else is 
+// dead and is removed, including if statements that only calculate dead 
+// values and local variables that are only read to calculate themselves.
+//
+// The initialize code is left alone as parameters with typecast defaults 
+// are bound directly to the temporaries that it writes to.
+*/
+bool Optimizer::remove_dead_code()
+{
+    const int operations = int(operations_.size());
+
+    // Find the condition mask that each operation runs under; the mask of
+    // inversions and clears is the mask that they invert or clear.
+    vector<int> masks( operations, -1 );
+    vector<int> generate_masks;
+    for ( int i = shade_operation_; i < operations; ++i )
+    {
+        const Operation& operation = operations_[i];
+        masks[i] = generate_masks.empty() ? -1 : generate_masks.back();
+        if ( operation.removed )
+        {
+            continue;
+        }
+        if ( operation.instruction == INSTRUCTION_GENERATE_MASK )
+        {
+            generate_masks.push_back( i );
+        }
+        else if ( operation.instruction == INSTRUCTION_CLEAR_MASK && !generate_masks.empty() )
+        {
+            generate_masks.pop_back();
+        }
+    }
+
+    vector<bool> live( operations, false );
+    vector<int> pending;
+    for ( int i = shade_operation_; i < operations; ++i )
+    {
+        const Operation& operation = operations_[i];
+        const int instruction = operation.instruction;
+        const bool dead = 
+            operation.removed ||
+            pure( operation ) ||
+            (assignment(operation) && local(operation.arguments[0])) ||
+            (instruction == INSTRUCTION_GENERATE_MASK && conditional(i)) ||
+            instruction == INSTRUCTION_INVERT_MASK ||
+            instruction == INSTRUCTION_CLEAR_MASK ||
+            instruction == INSTRUCTION_RESET
+        ;
+        if ( !dead )
+        {
+            live[i] = true;
+            pending.push_back( i );
+        }
+    }
+
+    vector<bool> read_locals( permanent_registers_, false );
+    while ( !pending.empty() )
+    {
+        const int index = pending.back();
+        pending.pop_back();
+        const Operation& operation = operations_[index];
+
+        vector<int> writers;
+        writers.push_back( masks[index] );
+        if ( operation.instruction == INSTRUCTION_GENERATE_MASK )
+        {
+            int invert = -1;
+            int clear = -1;
+            find_mask_end( index, &invert, &clear );
+            writers.push_back( invert );
+            writers.push_back( clear );
+        }
+
+        const bool overwrite = operation.instruction == INSTRUCTION_ASSIGN || operation.instruction == INSTRUCTION_ASSIGN_STRING;
+        for ( int j = overwrite ? 1 : 0; j < int(operation.arguments.size()); ++j )
+        {
+            const int argument = operation.arguments[j];
+            if ( !register_argument(operation, j) || argument < 0 )
+            {
+                continue;
+            }
+            if ( argument >= permanent_registers_ )
+            {
+                writers.push_back( find_writer(index, argument) );
+            }
+            else if ( local(argument) && !read_locals[argument] )
+            {
+                read_locals[argument] = true;
+                for ( int i = shade_operation_; i < operations; ++i )
+                {
+                    if ( !operations_[i].removed && assignment(operations_[i]) && operations_[i].arguments[0] == argument )
+                    {
+                        writers.push_back( i );
+                    }
+                }
+            }
+        }
+
+        for ( vector<int>::const_iterator i = writers.begin(); i != writers.end(); ++i )
+        {
+            if ( *i >= 0 && !live[*i] )
+            {
+                live[*i] = true;
+                pending.push_back( *i );
+            }
+        }
+    }
+
+    bool changed = false;
+    for ( int i = shade_operation_; i < operations; ++i )
+    {
+        Operation& operation = operations_[i];
+        if ( !operation.removed && !live[i] && operation.instruction != INSTRUCTION_RESET )
+        {
+            operation.removed = true;
+            ++removed_;
+            ++eliminated_;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+// Fold the if statements in the shade code whose conditions evaluate to
+// known values.
+*/
+bool Optimizer::remove_dead_branches()
+{
+    bool changed = false;
+    for ( int i = shade_operation_; i < int(operations_.size()); ++i )
+    {
+        Operation& generate_mask = operations_[i];
+        Constant condition;
+        int invert = -1;
+        int clear = -1;
+        if ( generate_mask.removed || !conditional(i) || !constant(i, generate_mask.arguments[0], &condition) || !condition.integer || !find_mask_end(i, &invert, &clear) )
+        {
+            continue;
+        }
+
+        if ( condition.int_value != 0 )
+        {
+            const int first = invert >= 0 ? invert : clear;
+            if ( !removable(first, clear) )
+            {
+                continue;
+            }
+            remove_operations( i, i );
+            remove_operations( first, clear );
+        }
+        else
+        {
+            const int last = invert >= 0 ? invert : clear;
+            if ( !removable(i, last) )
+            {
+                continue;
+            }
+            remove_operations( i, last );
+            remove_operations( clear, clear );
+        }
+
+        remove_condition( i, generate_mask.arguments[0] );
+        ++folded_;
+        changed = true;
+    }
+    return changed;
+}
+
+/**
+// Remove the operations between \e first and \e last inclusive.
+//
+// Resets are kept so that the numbering of the temporaries allocated by 
+// later operations can still be followed when the code is encoded.
+*/
+void Optimizer::remove_operations( int first, int last )
+{
+    REYES_ASSERT( first >= 0 && first <= last && last < int(operations_.size()) );
+    for ( int i = first; i <= last; ++i )
+    {
+        Operation& operation = operations_[i];
+        if ( !operation.removed && operation.instruction != INSTRUCTION_RESET )
+        {
+            operation.removed = true;
+            ++removed_;
+        }
+    }
+}
+
+/**
+// Remove the operations that calculated the condition of a folded if 
+// statement once nothing else reads their results.
+//
+// @param index
+//  The index of the operation that read the condition.
+//
+// @param argument
+//  The register that the condition was read from.
+*/
+void Optimizer::remove_condition( int index, int argument )
+{
+    if ( argument < permanent_registers_ )
+    {
+        return;
+    }
+
+    const int definition = find_definition( index, argument );
+    if ( definition < 0 || !foldable(operations_[definition]) || !unread(definition) )
+    {
+        return;
+    }
+
+    Operation& operation = operations_[definition];
+    operation.removed = true;
+    ++removed_;
+    for ( int j = 0; j < int(operation.arguments.size()); ++j )
+    {
+        remove_condition( definition, operation.arguments[j] );
+    }
+}
+
+/**
+// Find the permanent registers that may be written to by the shade code.
+//
+// Assignments write to their first argument.  Calls and other operations
+// that don't only write the register allocated for their result are 
+// assumed to write to all of their register arguments.
+*/
+void Optimizer::find_written_registers()
+{
+    written_.assign( permanent_registers_, false );
+    for ( int i = shade_operation_; i < int(operations_.size()); ++i )
+    {
+        const Operation& operation = operations_[i];
+        if ( operation.removed || pure(operation) || operation.instruction == INSTRUCTION_GENERATE_MASK )
+        {
+            continue;
+        }
+
+        const int instruction = operation.instruction;
+        const bool assignment = instruction >= INSTRUCTION_ASSIGN && instruction <= INSTRUCTION_DIVIDE_ASSIGN;
+        const int arguments = assignment ? 1 : int(operation.arguments.size());
+        for ( int j = 0; j < arguments; ++j )
+        {
+            const int argument = operation.arguments[j];
+            if ( argument < permanent_registers_ && register_argument(operation, j) )
+            {
+                written_[argument] = true;
+            }
+        }
+    }
+}
+
+/**
+// Add the permanent registers that a register read by an operation 
+// depends on through operations that can be evaluated to 
+// branch_registers_.
+*/
+void Optimizer::collect_branch_registers( int index, int argument )
+{
+    if ( argument < permanent_registers_ )
+    {
+        if ( !written_[argument] )
+        {
+            branch_registers_.push_back( argument );
+        }
+        return;
+    }
+
+    const int definition = find_definition( index, argument );
+    if ( definition >= 0 && foldable(operations_[definition]) )
+    {
+        const Operation& operation = operations_[definition];
+        for ( int j = 0; j < int(operation.arguments.size()); ++j )
+        {
+            collect_branch_registers( definition, operation.arguments[j] );
+        }
+    }
+}
+
+/**
+// Is an operation the generation of the condition mask for an if 
+// statement?
+//
+// Loops generate their condition masks in the same way but follow them 
+// with a jump out of the loop when the mask is empty.
+*/
+bool Optimizer::conditional( int index ) const
+{
+    REYES_ASSERT( index >= 0 && index < int(operations_.size()) );
+    return 
+        operations_[index].instruction == INSTRUCTION_GENERATE_MASK &&
+        (index + 1 >= int(operations_.size()) || operations_[index + 1].instruction != INSTRUCTION_JUMP_EMPTY)
+    ;
+}
+
+/**
+// Find the operations that invert and clear the condition mask generated
+// by an operation.
+//
+// @param index
+//  The index of the operation that generates the condition mask.
+//
+// @param invert
+//  Set to the index of the operation that inverts the mask for an else 
+//  statement or -1 if there is no else statement.
+//
+// @param clear
+//  Set to the index of the operation that clears the mask.
+//
+// @return
+//  True if the mask is cleared in the same section of code otherwise 
+//  false.
+*/
+bool Optimizer::find_mask_end( int index, int* invert, int* clear ) const
+{
+    REYES_ASSERT( invert );
+    REYES_ASSERT( clear );
+
+    *invert = -1;
+    *clear = -1;
+    int depth = 0;
+    const int end = end_of_section( index );
+    for ( int i = index + 1; i < end; ++i )
+    {
+        const Operation& operation = operations_[i];
+        if ( operation.removed )
+        {
+            continue;
+        }
+
+        if ( operation.instruction == INSTRUCTION_GENERATE_MASK )
+        {
+            ++depth;
+        }
+        else if ( operation.instruction == INSTRUCTION_INVERT_MASK && depth == 0 )
+        {
+            *invert = i;
+        }
+        else if ( operation.instruction == INSTRUCTION_CLEAR_MASK )
+        {
+            if ( depth == 0 )
+            {
+                *clear = i;
+                return true;
+            }
+            --depth;
+        }
+    }
+    return false;
+}
+
+/**
+// Can the operations between \e first and \e last inclusive be removed 
+// without changing where any remaining jump goes?
+//
+// @return
+//  False if an operation in the range jumps to somewhere other than 
+//  within or just after the range (a break or continue) or an operation 
+//  outside the range jumps into it otherwise true.
+*/
+bool Optimizer::removable( int first, int last ) const
+{
+    for ( int i = 0; i < int(operations_.size()); ++i )
+    {
+        const Operation& operation = operations_[i];
+        if ( operation.removed || operation.target < 0 )
+        {
+            continue;
+        }
+
+        const bool inside = i >= first && i <= last;
+        const bool target_inside = operation.target >= first && operation.target <= last;
+        if ( inside && !target_inside && operation.target != last + 1 )
+        {
+            return false;
+        }
+        if ( !inside && target_inside )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+// Find the operation that wrote the value of a temporary read by an 
+// operation.
+//
+// @return
+//  The index of the operation or -1 if it isn't in the same straight line
+//  code as the reader.
+*/
+int Optimizer::find_definition( int index, int argument ) const
+{
+    REYES_ASSERT( index >= 0 && index < int(operations_.size()) );
+
+    const int begin = index < shade_operation_ ? 0 : shade_operation_;
+    for ( int i = index - 1; i >= begin; --i )
+    {
+        const Operation& operation = operations_[i];
+        if ( operations_[i + 1].jumped_to || operation.target >= 0 )
+        {
+            return -1;
+        }
+        if ( operation.result == argument )
+        {
+            return operation.removed ? -1 : i;
+        }
+    }
+    return -1;
+}
+
+/**
+// Find the operation that wrote the value of a temporary read by an 
+// operation in the shade code.
+//
+// The code generator resets temporaries before every jump back to the 
+// start of a loop so the value read is always the one written most 
+// recently before the reader in the order that operations appear.
+//
+// @return
+//  The index of the operation or -1 if there isn't one.
+*/
+int Optimizer::find_writer( int index, int argument ) const
+{
+    REYES_ASSERT( index >= shade_operation_ && index < int(operations_.size()) );
+    for ( int i = index - 1; i >= shade_operation_; --i )
+    {
+        const Operation& operation = operations_[i];
+        if ( operation.result == argument )
+        {
+            return operation.removed ? -1 : i;
+        }
+    }
+    return -1;
+}
+
+/**
+// Is the temporary written by an operation never read?
+*/
+bool Optimizer::unread( int index ) const
+{
+    REYES_ASSERT( index >= 0 && index < int(operations_.size()) );
+
+    const int result = operations_[index].result;
+    if ( result < permanent_registers_ )
+    {
+        return false;
+    }
+
+    const int end = end_of_section( index );
+    for ( int i = index + 1; i < end; ++i )
+    {
+        const Operation& operation = operations_[i];
+        if ( operation.removed )
+        {
+            continue;
+        }
+        for ( int j = 0; j < int(operation.arguments.size()); ++j )
+        {
+            if ( operation.arguments[j] == result && register_argument(operation, j) )
+            {
+                return false;
+            }
+        }
+        if ( operation.result == result )
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+// Get the known value of a register read by an operation.
+//
+// @param index
+//  The index of the operation that reads the register.
+//
+// @param argument
+//  The register read.
+//
+// @param value
+//  Set to the value of the register if it is known.
+//
+// @return
+//  True if the value of the register is known otherwise false.
+*/
+bool Optimizer::constant( int index, int argument, Constant* value ) const
+{
+    REYES_ASSERT( value );
+
+    if ( argument < permanent_registers_ )
+    {
+        const Value* known = argument < int(values_.size()) ? values_[argument] : NULL;
+        if ( !known || written_[argument] || known->storage() == STORAGE_VARYING || known->size() == 0 )
+        {
+            return false;
+        }
+
+        value->integer = known->type() == TYPE_INTEGER;
+        value->int_value = known->type() == TYPE_INTEGER ? known->int_values()[0] : 0;
+        value->float_value = known->type() == TYPE_FLOAT ? known->float_values()[0] : 0.0f;
+        return known->type() == TYPE_INTEGER || known->type() == TYPE_FLOAT;
+    }
+
+    const int definition = find_definition( index, argument );
+    return definition >= 0 && evaluate( definition, value );
+}
+
+/**
+// Evaluate an operation whose arguments are all known.
+//
+// @return
+//  True if the operation could be evaluated otherwise false.
+*/
+bool Optimizer::evaluate( int index, Constant* value ) const
+{
+    REYES_ASSERT( index >= 0 && index < int(operations_.size()) );
+    REYES_ASSERT( value );
+
+    const Operation& operation = operations_[index];
+    Constant lhs;
+    if ( !foldable(operation) || !constant(index, operation.arguments[0], &lhs) )
+    {
+        return false;
+    }
+
+    if ( operation.instruction == INSTRUCTION_PROMOTE )
+    {
+        *value = lhs;
+        return true;
+    }
+
+    if ( operation.instruction == INSTRUCTION_NEGATE )
+    {
+        value->integer = false;
+        value->int_value = 0;
+        value->float_value = -lhs.float_value;
+        return !lhs.integer;
+    }
+
+    Constant rhs;
+    const bool logical = operation.instruction == INSTRUCTION_AND || operation.instruction == INSTRUCTION_OR;
+    if ( !constant(index, operation.arguments[1], &rhs) || lhs.integer != logical || rhs.integer != logical )
+    {
+        return false;
+    }
+
+    const float l = lhs.float_value;
+    const float r = rhs.float_value;
+    value->integer = true;
+    value->int_value = 0;
+    value->float_value = 0.0f;
+    switch ( operation.instruction )
+    {
+        case INSTRUCTION_GREATER:
+            value->int_value = l > r;
+            break;
+
+        case INSTRUCTION_GREATER_EQUAL:
+            value->int_value = l >= r;
+            break;
+
+        case INSTRUCTION_LESS:
+            value->int_value = l < r;
+            break;
+
+        case INSTRUCTION_LESS_EQUAL:
+            value->int_value = l <= r;
+            break;
+
+        case INSTRUCTION_EQUAL:
+            value->int_value = l == r;
+            break;
+
+        case INSTRUCTION_NOT_EQUAL:
+            value->int_value = l != r;
+            break;
+
+        case INSTRUCTION_AND:
+            value->int_value = lhs.int_value && rhs.int_value;
+            break;
+
+        case INSTRUCTION_OR:
+            value->int_value = lhs.int_value || rhs.int_value;
+            break;
+
+        case INSTRUCTION_MULTIPLY:
+            value->integer = false;
+            value->float_value = l * r;
+            break;
+
+        case INSTRUCTION_DIVIDE:
+            value->integer = false;
+            value->float_value = l / r;
+            break;
+
+        case INSTRUCTION_ADD:
+            value->integer = false;
+            value->float_value = l + r;
+            break;
+
+        case INSTRUCTION_SUBTRACT:
+            value->integer = false;
+            value->float_value = l - r;
+            break;
+
+        default:
+            REYES_ASSERT( false );
+            return false;
+    }
+    return true;
+}
+
+/**
+// Can an operation be evaluated by specialization when its arguments are
+// known?
+//
+// Only operations on uniform scalars are evaluated; they are all that the
+// conditions of if statements on uniform parameters usually need.
+*/
+bool Optimizer::foldable( const Operation& operation ) const
+{
+    switch ( operation.instruction )
+    {
+        case INSTRUCTION_PROMOTE:
+            return (operation.dispatch & 0xff) == DISPATCH_U1;
+
+        case INSTRUCTION_NEGATE:
+            return operation.dispatch == DISPATCH_U1;
+
+        case INSTRUCTION_GREATER:
+        case INSTRUCTION_GREATER_EQUAL:
+        case INSTRUCTION_LESS:
+        case INSTRUCTION_LESS_EQUAL:
+        case INSTRUCTION_EQUAL:
+        case INSTRUCTION_NOT_EQUAL:
+        case INSTRUCTION_AND:
+        case INSTRUCTION_OR:
+        case INSTRUCTION_MULTIPLY:
+        case INSTRUCTION_DIVIDE:
+        case INSTRUCTION_ADD:
+        case INSTRUCTION_SUBTRACT:
+            return operation.dispatch == DISPATCH_U1U1;
+
+        default:
+            return false;
+    }
+}
+
+/**
+// Find the only operation that reads the result of an operation.
+//
+// @param index
+//  The index of the operation whose result is read.
+//
+// @param position
+//  Set to the position of the result in the arguments of the reader.
+//
+// @return
+//  The index of the operation that reads the result or -1 if the result
+//  is read more than once, isn't read at all, or isn't read in the same 
+//  straight line code with only pure operations in between.
+*/
+int Optimizer::find_only_reader( int index, int* position ) const
+{
+    REYES_ASSERT( index >= 0 && index < int(operations_.size()) );
+    REYES_ASSERT( position );
+
+    const int result = operations_[index].result;
+    if ( result < permanent_registers_ )
+    {
+        return -1;
+    }
+
+    int reader = -1;
+    int reads = 0;
+    const int end = end_of_section( index );
+    for ( int i = index + 1; i < end; ++i )
+    {
+        const Operation& operation = operations_[i];
+        if ( operation.removed )
+        {
+            continue;
+        }
+
+        if ( reader < 0 && operation.jumped_to )
+        {
+            return -1;
+        }
+
+        int operation_reads = 0;
+        for ( int j = 0; j < int(operation.arguments.size()); ++j )
+        {
+            if ( operation.arguments[j] == result && register_argument(operation, j) )
+            {
+                *position = j;
+                ++operation_reads;
+            }
+        }
+
+        if ( reader < 0 )
+        {
+            if ( operation_reads > 0 )
+            {
+                reader = i;
+            }
+            else if ( !pure(operation) )
+            {
+                return -1;
+            }
+        }
+        reads += operation_reads;
+
+        if ( operation.result == result )
+        {
+            break;
+        }
+    }
+    return reads == 1 ? reader : -1;
+}
+
+int Optimizer::end_of_section( int index ) const
+{
+    return index < shade_operation_ ? shade_operation_ : int(operations_.size());
+}
+
+/**
+// Encode the operations that haven't been removed into code_.
+//
+// Temporaries are renumbered to match the registers that the virtual 
+// machine will allocate now that removed operations no longer allocate 
+// them and jump distances and section addresses are patched to the new 
+// addresses of the operations that they refer to.
+//
+// @return
+//  True if the operations were encoded or false if the register 
+//  allocation couldn't be followed.
+*/
+bool Optimizer::encode()
+{
+    int registers = permanent_registers_;
+    for ( vector<Operation>::const_iterator i = operations_.begin(); i != operations_.end(); ++i )
+    {
+        const Operation& operation = *i;
+        registers = max( registers, operation.result + 1 );
+        for ( int j = 0; j < int(operation.arguments.size()); ++j )
+        {
+            if ( register_argument(operation, j) )
+            {
+                registers = max( registers, operation.arguments[j] + 1 );
+            }
+        }
+    }
+
+    Encoder encoder;
+    vector<SourceLine> lines;
+    vector<int> addresses( operations_.size() + 1, 0 );
+    vector<int> renumbered_registers;
+    map<int, int> renumbered_indices;
+    vector<std::pair<int, int> > jumps;
+    int index = permanent_registers_;
+    int renumbered_index = permanent_registers_;
+
+    for ( int i = 0; i < int(operations_.size()); ++i )
+    {
+        const Operation& operation = operations_[i];
+        if ( i == 0 || i == shade_operation_ )
+        {
+            index = permanent_registers_;
+            renumbered_index = permanent_registers_;
+            renumbered_registers.assign( registers, -1 );
+            renumbered_indices.clear();
+            renumbered_indices[index] = renumbered_index;
+        }
+
+        addresses[i] = int(encoder.address());
+        const InstructionMetadata& metadata = instruction_metadata( operation.instruction );
+        if ( operation.removed )
+        {
+            if ( metadata.result )
+            {
+                ++index;
+                renumbered_indices[index] = renumbered_index;
+            }
+            continue;
+        }
+
+        const int line = source_line( lines_, operation.address );
+        if ( lines.empty() || lines.back().line != line )
+        {
+            SourceLine source_line = { addresses[i], line };
+            lines.push_back( source_line );
+        }
+
+        encoder.word( operation.instruction );
+        encoder.word( operation.dispatch );
+        if ( metadata.words > 1 )
+        {
+            encoder.word( operation.addend_dispatch );
+        }
+
+        if ( operation.instruction == INSTRUCTION_RESET )
+        {
+            map<int, int>::const_iterator renumbered = renumbered_indices.find( operation.arguments[0] );
+            if ( renumbered == renumbered_indices.end() )
+            {
+                return false;
+            }
+            index = operation.arguments[0];
+            renumbered_index = renumbered->second;
+            encoder.argument( renumbered_index );
+        }
+        else if ( operation.target >= 0 )
+        {
+            jumps.push_back( std::make_pair(encoder.argument_for_patching(), operation.target) );
+        }
+        else
+        {
+            for ( int j = 0; j < int(operation.arguments.size()); ++j )
+            {
+                int argument = operation.arguments[j];
+                if ( argument >= permanent_registers_ && register_argument(operation, j) )
+                {
+                    argument = renumbered_registers[argument];
+                    if ( argument < 0 )
+                    {
+                        return false;
+                    }
+                }
+                encoder.argument( argument );
+            }
+        }
+
+        if ( metadata.result )
+        {
+            REYES_ASSERT( operation.result == index );
+            renumbered_registers[index] = renumbered_index;
+            ++index;
+            ++renumbered_index;
+            renumbered_indices[index] = renumbered_index;
+        }
+    }
+    addresses[operations_.size()] = int(encoder.address());
+
+    for ( int i = int(operations_.size()) - 1; i >= 0; --i )
+    {
+        if ( operations_[i].removed )
+        {
+            addresses[i] = addresses[i + 1];
+        }
+    }
+
+    for ( vector<std::pair<int, int> >::const_iterator i = jumps.begin(); i != jumps.end(); ++i )
+    {
+        const int address = i->first;
+        const int target = i->second;
+        encoder.patch_argument( address, addresses[target] - (address + int(sizeof(int))) );
+    }
+
+    code_ = encoder.code();
+    lines_.swap( lines );
+    initialize_address_ = addresses[0];
+    shade_address_ = addresses[shade_operation_];
+    return true;
+}
+
+/**
+// Is an argument to an operation the index of a register?
+//
+// Every argument is a register except for the argument to a reset (the 
+// index to allocate registers from next), the distance to jump, and the
+// index of the symbol of the function called by calls.
+*/
+bool Optimizer::register_argument( const Operation& operation, int index ) const
+{
+    const int instruction = operation.instruction;
+    if ( instruction == INSTRUCTION_RESET || operation.target >= 0 )
+    {
+        return false;
+    }
+    if ( instruction >= INSTRUCTION_CALL_0 && instruction <= INSTRUCTION_CALL_5 )
+    {
+        return index > 0;
+    }
+    return true;
+}
+
+/**
+// Is an operation pure; that is does it only write the register that it
+// allocates for its result?
+//
+// Calls are treated as impure because built-in functions can write to 
+// output parameters.
+*/
+bool Optimizer::pure( const Operation& operation ) const
+{
+    const int instruction = operation.instruction;
+    return 
+        instruction_metadata(instruction).result &&
+        !(instruction >= INSTRUCTION_CALL_0 && instruction <= INSTRUCTION_CALL_5) &&
+        instruction != INSTRUCTION_ILLUMINANCE_AXIS_ANGLE
+    ;
+}
+
+/**
+// Does a register hold a local variable?
+*/
+bool Optimizer::local( int register_index ) const
+{
+    return register_index >= 0 && register_index < int(locals_.size()) && locals_[register_index];
+}
+
+/**
+// Is an operation an assignment; that is does it write to the register 
+// passed as its first argument?
+*/
+bool Optimizer::assignment( const Operation& operation ) const
+{
+    return operation.instruction >= INSTRUCTION_ASSIGN && operation.instruction <= INSTRUCTION_DIVIDE_ASSIGN;
+}
@@ -0,0 +1,130 @@
+#ifndef REYES_OPTIMIZER_HPP_INCLUDED
+#define REYES_OPTIMIZER_HPP_INCLUDED
+
+#include "SourceLine.hpp"
+#include <vector>
+
+namespace reyes
+{
+
+class Value;
+
+/**
+// Optimize the byte code generated for a shader with peephole rewrites 
+// that reduce the number of passes made over each grid.
+//
+// Promotions of uniform operands to arithmetic with varying operands are
+// removed in favour of the uniform/varying kernels, conversions of floats 
+// to vec3 in multiplications are removed in favour of the scaling kernels,
+// multiplications whose result is only added are fused into a single 
+// multiply-add, and assignments of variables to themselves are removed.
+//
+// Each instruction implicitly allocates the register that it writes its 
+// result to so removing instructions renumbers the temporary registers 
+// allocated after them and jumps and section addresses are patched to 
+// match.  Rewrites only apply within straight line code between jumps and
+// jump targets and only to temporaries read exactly once.
+//
+// Dead code is removed too.  Operations in the shade code whose results 
+// never reach a parameter, a global variable, or an operation with side 
+// effects are removed along with if statements left without anything to 
+// do.  Parameters and global variables are always assumed to be read after
+// the shader has run; local variables are identified by the code 
+// generator.
+//
+// Code can also be specialized on known values for some of its registers
+// (typically the uniform parameters of a shader).  Conditions of if 
+// statements in the shade code that depend only on known values are 
+// evaluated and the masks and statements that they select between are 
+// removed before the rewrites above are applied.
+//
+// The lines of source that the code was generated for are moved along with
+// the instructions that remain.
+*/
+class Optimizer
+{
+    struct Operation
+    {
+        int instruction; ///< The instruction.
+        int dispatch; ///< The dispatch code for the instruction.
+        int addend_dispatch; ///< The dispatch code for the addend of fused multiply-adds (otherwise 0).
+        std::vector<int> arguments; ///< The arguments to the instruction.
+        int address; ///< The address of the instruction in the original code.
+        int result; ///< The register allocated for the result of the instruction or -1 if the instruction doesn't allocate a register.
+        int target; ///< The index of the Operation jumped to by jump instructions or -1 for other instructions.
+        bool jumped_to; ///< True if this Operation is the target of a jump.
+        bool removed; ///< True if this Operation has been removed.
+    };
+
+    struct Constant
+    {
+        bool integer; ///< True if this constant is an integer (the result of a comparison or logical operator) otherwise it is a float.
+        int int_value; ///< The value of this constant if it is an integer.
+        float float_value; ///< The value of this constant if it is a float.
+    };
+
+    std::vector<Operation> operations_; ///< The decoded instructions.
+    std::vector<unsigned char> code_; ///< The optimized byte code.
+    std::vector<SourceLine> lines_; ///< The lines of source that the optimized byte code was generated for.
+    int initialize_address_; ///< The address of the initialize code in the optimized byte code.
+    int shade_address_; ///< The address of the shade code in the optimized byte code.
+    int permanent_registers_; ///< The number of registers that aren't temporaries.
+    int shade_operation_; ///< The index of the first Operation in the shade code.
+    int removed_; ///< The number of instructions removed by the most recent optimization.
+    int fused_; ///< The number of instructions fused by the most recent optimization.
+    int folded_; ///< The number of conditions folded by the most recent specialization.
+    int eliminated_; ///< The number of dead instructions removed by the most recent optimization.
+    std::vector<const Value*> values_; ///< The known values of registers indexed by register (null where not known) while specializing.
+    std::vector<bool> written_; ///< True for each permanent register that may be written by the shade code.
+    std::vector<bool> locals_; ///< True for each permanent register that holds a local variable while optimizing.
+    std::vector<int> branch_registers_; ///< The registers found by the most recent call to find_branch_registers().
+
+public:
+    Optimizer();
+    const std::vector<unsigned char>& code() const;
+    const std::vector<SourceLine>& lines() const;
+    int initialize_address() const;
+    int shade_address() const;
+    int removed() const;
+    int fused() const;
+    int folded() const;
+    int eliminated() const;
+    const std::vector<int>& branch_registers() const;
+    void optimize( const std::vector<unsigned char>& code, const std::vector<SourceLine>& lines, int initialize_address, int shade_address, int permanent_registers, const std::vector<int>& local_registers );
+    void specialize( const std::vector<unsigned char>& code, const std::vector<SourceLine>& lines, int initialize_address, int shade_address, int permanent_registers, const std::vector<const Value*>& values );
+    void find_branch_registers( const std::vector<unsigned char>& code, int initialize_address, int shade_address, int permanent_registers );
+
+private:
+    void rewrite( const std::vector<unsigned char>& code, const std::vector<SourceLine>& lines, int initialize_address, int shade_address, int permanent_registers, const std::vector<const Value*>& values, const std::vector<int>& local_registers );
+    bool decode( const std::vector<unsigned char>& code, int initialize_address, int shade_address );
+    bool remove_promotions();
+    bool remove_conversions();
+    bool fuse_multiply_adds();
+    bool remove_self_assignments();
+    bool remove_dead_code();
+    bool remove_dead_branches();
+    void remove_operations( int first, int last );
+    void remove_condition( int index, int argument );
+    void find_written_registers();
+    void collect_branch_registers( int index, int argument );
+    bool conditional( int index ) const;
+    bool find_mask_end( int index, int* invert, int* clear ) const;
+    bool removable( int first, int last ) const;
+    int find_definition( int index, int argument ) const;
+    int find_writer( int index, int argument ) const;
+    bool unread( int index ) const;
+    bool constant( int index, int argument, Constant* value ) const;
+    bool evaluate( int index, Constant* value ) const;
+    bool foldable( const Operation& operation ) const;
+    int find_only_reader( int index, int* position ) const;
+    int end_of_section( int index ) const;
+    bool encode();
+    bool register_argument( const Operation& operation, int index ) const;
+    bool pure( const Operation& operation ) const;
+    bool assignment( const Operation& operation ) const;
+    bool local( int register_index ) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,317 @@
+//
+// Profile.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "Profile.hpp"
+#include "Shader.hpp"
+#include <reyes/reyes_virtual_machine/DecodedInstruction.hpp>
+#include <reyes/reyes_virtual_machine/InstructionMetadata.hpp>
+#include "assert.hpp"
+#include <algorithm>
+#include <stdio.h>
+#include <stdarg.h>
+
+using std::map;
+using std::string;
+using std::vector;
+using namespace reyes;
+
+/**
+// The counters for one line of one shader's source.
+*/
+struct LineCounters
+{
+    int line; ///< The line in the shader source (or 0 if not known).
+    Profile::Counters counters; ///< The sum of the counters of the instructions generated for the line.
+};
+
+/**
+// The counters for one shader summed over its instructions and lines.
+*/
+struct ShaderCounters
+{
+    const string* name; ///< The name of the shader.
+    const vector<int>* instructions; ///< The instruction of each decoded instruction of the shader.
+    const vector<int>* lines; ///< The line of each decoded instruction of the shader.
+    const vector<Profile::Counters>* instruction_counters; ///< The counters of each decoded instruction of the shader.
+    Profile::Counters counters; ///< The sum of the counters of all of the shader's instructions.
+    vector<LineCounters> line_counters; ///< The counters for each line from most to least time spent.
+};
+
+/**
+// Add one set of counters to another.
+*/
+static void accumulate( Profile::Counters* counters, const Profile::Counters& other )
+{
+    REYES_ASSERT( counters );
+    counters->executions += other.executions;
+    counters->elements += other.elements;
+    counters->nanoseconds += other.nanoseconds;
+}
+
+static bool more_nanoseconds_line( const LineCounters& lhs, const LineCounters& rhs )
+{
+    return lhs.counters.nanoseconds > rhs.counters.nanoseconds || (lhs.counters.nanoseconds == rhs.counters.nanoseconds && lhs.line < rhs.line);
+}
+
+static bool more_nanoseconds_shader( const ShaderCounters& lhs, const ShaderCounters& rhs )
+{
+    return lhs.counters.nanoseconds > rhs.counters.nanoseconds || (lhs.counters.nanoseconds == rhs.counters.nanoseconds && *lhs.name < *rhs.name);
+}
+
+/**
+// Append printf() style formatted text to a string.
+*/
+static void append( string* text, const char* format, ... )
+{
+    REYES_ASSERT( text );
+    REYES_ASSERT( format );
+    char buffer [1024];
+    va_list args;
+    va_start( args, format );
+    vsnprintf( buffer, sizeof(buffer), format, args );
+    va_end( args );
+    buffer[sizeof(buffer) - 1] = 0;
+    text->append( buffer );
+}
+
+/**
+// Append a string to JSON as a quoted and escaped JSON string.
+*/
+static void append_json_string( string* json, const string& value )
+{
+    REYES_ASSERT( json );
+    json->push_back( '"' );
+    for ( string::const_iterator i = value.begin(); i != value.end(); ++i )
+    {
+        const unsigned char character = static_cast<unsigned char>( *i );
+        if ( character == '"' || character == '\\' )
+        {
+            json->push_back( '\\' );
+            json->push_back( char(character) );
+        }
+        else if ( character < 0x20 )
+        {
+            append( json, "\\u%04x", int(character) );
+        }
+        else
+        {
+            json->push_back( char(character) );
+        }
+    }
+    json->push_back( '"' );
+}
+
+/**
+// Append counters to JSON as the members of an object.
+*/
+static void append_json_counters( string* json, const Profile::Counters& counters )
+{
+    append( json, "\"executions\": %llu, \"elements\": %llu, \"nanoseconds\": %llu", 
+        (unsigned long long) counters.executions, 
+        (unsigned long long) counters.elements, 
+        (unsigned long long) counters.nanoseconds 
+    );
+}
+
+/**
+// Sum the counters of the profiled shaders per shader and per line.
+//
+// @return
+//  The counters of each shader from most to least time spent.
+*/
+template <class Entries>
+static vector<ShaderCounters> summarize( const Entries& entries )
+{
+    vector<ShaderCounters> shaders;
+    shaders.reserve( entries.size() );
+    for ( typename Entries::const_iterator i = entries.begin(); i != entries.end(); ++i )
+    {
+        ShaderCounters shader;
+        shader.name = &i->second.name;
+        shader.instructions = &i->second.instructions;
+        shader.lines = &i->second.lines;
+        shader.instruction_counters = &i->second.counters;
+        shader.counters = Profile::Counters();
+
+        map<int, Profile::Counters> counters_by_line;
+        for ( unsigned int j = 0; j < i->second.counters.size(); ++j )
+        {
+            const Profile::Counters& counters = i->second.counters[j];
+            accumulate( &shader.counters, counters );
+            map<int, Profile::Counters>::iterator line = counters_by_line.insert( std::make_pair(i->second.lines[j], Profile::Counters()) ).first;
+            accumulate( &line->second, counters );
+        }
+
+        for ( map<int, Profile::Counters>::const_iterator j = counters_by_line.begin(); j != counters_by_line.end(); ++j )
+        {
+            if ( j->second.executions > 0 )
+            {
+                LineCounters line_counters = { j->first, j->second };
+                shader.line_counters.push_back( line_counters );
+            }
+        }
+        std::sort( shader.line_counters.begin(), shader.line_counters.end(), &more_nanoseconds_line );
+        shaders.push_back( shader );
+    }
+    std::sort( shaders.begin(), shaders.end(), &more_nanoseconds_shader );
+    return shaders;
+}
+
+Profile::Profile()
+: entries_()
+{
+}
+
+/**
+// Get the counters for the instructions of a shader.
+//
+// @param shader
+//  The shader to get counters for.
+//
+// @return
+//  The counters for each of the decoded instructions of \e shader (see 
+//  Shader::instructions()), zeroed the first time that \e shader is
+//  profiled.
+*/
+Profile::Counters* Profile::counters( const Shader& shader )
+{
+    map<const Shader*, Entry>::iterator i = entries_.find( &shader );
+    if ( i == entries_.end() )
+    {
+        const vector<DecodedInstruction>& instructions = shader.instructions();
+        Entry& entry = entries_[&shader];
+        entry.name = shader.name();
+        entry.instructions.reserve( instructions.size() );
+        entry.lines.reserve( instructions.size() );
+        for ( vector<DecodedInstruction>::const_iterator j = instructions.begin(); j != instructions.end(); ++j )
+        {
+            entry.instructions.push_back( j->instruction );
+            entry.lines.push_back( j->line );
+        }
+        entry.counters.insert( entry.counters.end(), instructions.size(), Counters() );
+        i = entries_.find( &shader );
+    }
+    REYES_ASSERT( i != entries_.end() );
+    return i->second.counters.empty() ? NULL : &i->second.counters[0];
+}
+
+/**
+// Find the counters for the instructions of a shader.
+//
+// @param shader
+//  The shader to find counters for.
+//
+// @return
+//  The counters for each of the decoded instructions of \e shader or null
+//  if \e shader hasn't been profiled.
+*/
+const Profile::Counters* Profile::find_counters( const Shader& shader ) const
+{
+    map<const Shader*, Entry>::const_iterator i = entries_.find( &shader );
+    return i != entries_.end() && !i->second.counters.empty() ? &i->second.counters[0] : NULL;
+}
+
+/**
+// @return
+//  The number of shaders profiled.
+*/
+int Profile::shaders() const
+{
+    return int(entries_.size());
+}
+
+/**
+// Discard the counters of all shaders (usually at the start of a frame).
+*/
+void Profile::clear()
+{
+    entries_.clear();
+}
+
+/**
+// Report the counters as text.
+//
+// Lists each shader from most to least time spent with the time spent, 
+// executions, and elements processed for each of the lines in its source 
+// that were executed, again from most to least time spent.
+//
+// @return
+//  The report.
+*/
+string Profile::text_report() const
+{
+    string text;
+    const vector<ShaderCounters> shaders = summarize( entries_ );
+    for ( vector<ShaderCounters>::const_iterator i = shaders.begin(); i != shaders.end(); ++i )
+    {
+        const ShaderCounters& shader = *i;
+        append( &text, "%s: %llu ns, %llu executions, %llu elements\n", 
+            shader.name->empty() ? "(from memory)" : shader.name->c_str(), 
+            (unsigned long long) shader.counters.nanoseconds, 
+            (unsigned long long) shader.counters.executions, 
+            (unsigned long long) shader.counters.elements 
+        );
+        for ( vector<LineCounters>::const_iterator j = shader.line_counters.begin(); j != shader.line_counters.end(); ++j )
+        {
+            const double percent = shader.counters.nanoseconds > 0 ? 100.0 * double(j->counters.nanoseconds) / double(shader.counters.nanoseconds) : 0.0;
+            append( &text, "  line %d: %llu ns (%.1f%%), %llu executions, %llu elements\n", 
+                j->line, 
+                (unsigned long long) j->counters.nanoseconds, 
+                percent,
+                (unsigned long long) j->counters.executions, 
+                (unsigned long long) j->counters.elements 
+            );
+        }
+    }
+    return text;
+}
+
+/**
+// Report the counters as JSON.
+//
+// The report is an object with a "shaders" array that has an object for
+// each shader from most to least time spent.  Each shader has its "name",
+// its total counters, a "lines" array of the counters for each line 
+// executed from most to least time spent, and an "instructions" array of
+// the counters, instruction name, and line of each decoded instruction.
+//
+// @return
+//  The report.
+*/
+string Profile::json_report() const
+{
+    string json;
+    json.append( "{\"shaders\": [" );
+    const vector<ShaderCounters> shaders = summarize( entries_ );
+    for ( vector<ShaderCounters>::const_iterator i = shaders.begin(); i != shaders.end(); ++i )
+    {
+        const ShaderCounters& shader = *i;
+        json.append( i != shaders.begin() ? ", {\"name\": " : "{\"name\": " );
+        append_json_string( &json, *shader.name );
+        json.append( ", " );
+        append_json_counters( &json, shader.counters );
+
+        json.append( ", \"lines\": [" );
+        for ( vector<LineCounters>::const_iterator j = shader.line_counters.begin(); j != shader.line_counters.end(); ++j )
+        {
+            append( &json, "%s{\"line\": %d, ", j != shader.line_counters.begin() ? ", " : "", j->line );
+            append_json_counters( &json, j->counters );
+            json.append( "}" );
+        }
+
+        json.append( "], \"instructions\": [" );
+        for ( unsigned int j = 0; j < shader.instruction_counters->size(); ++j )
+        {
+            const InstructionMetadata& metadata = instruction_metadata( (*shader.instructions)[j] );
+            append( &json, "%s{\"index\": %d, \"instruction\": \"%s\", \"line\": %d, ", j > 0 ? ", " : "", int(j), metadata.name, (*shader.lines)[j] );
+            append_json_counters( &json, (*shader.instruction_counters)[j] );
+            json.append( "}" );
+        }
+        json.append( "]}" );
+    }
+    json.append( "]}\n" );
+    return json;
+}
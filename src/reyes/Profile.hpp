@@ -0,0 +1,68 @@
+#ifndef REYES_PROFILE_HPP_INCLUDED
+#define REYES_PROFILE_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+namespace reyes
+{
+
+class Shader;
+
+/**
+// Counts of how often and for how long the instructions of shaders are 
+// executed.
+//
+// A Profile is passed to the virtual machine (see Renderer::set_profile())
+// to switch it to executing shaders with counters.  The virtual machine 
+// then adds the executions, elements processed, and elapsed time of each 
+// instruction that it executes to the counters for that instruction of 
+// the shader that it is executing.  The counters are reported per shader
+// and per line of shader source as text or JSON or annotated onto the 
+// instructions dumped by Debugger::dump_code().
+//
+// The name, instructions, and lines of a shader are copied the first time
+// that it is profiled so reports can be made after the shader has been 
+// destroyed.  Shaders are identified by address so a Profile should be 
+// cleared before a shader is destroyed if another shader may be created 
+// at the same address and profiled in the same Profile.
+*/
+class Profile
+{
+public:
+    /**
+    // The counters for one instruction.
+    */
+    struct Counters
+    {
+        uint64_t executions; ///< The number of times that the instruction was executed.
+        uint64_t elements; ///< The number of elements processed (the active elements of the grid each time that the instruction was executed).
+        uint64_t nanoseconds; ///< The time spent executing the instruction in nanoseconds.
+    };
+
+private:
+    struct Entry
+    {
+        std::string name; ///< The name of the profiled shader.
+        std::vector<int> instructions; ///< The instruction of each decoded instruction of the shader.
+        std::vector<int> lines; ///< The line of source of each decoded instruction of the shader.
+        std::vector<Counters> counters; ///< The counters for each decoded instruction of the shader.
+    };
+
+    std::map<const Shader*, Entry> entries_; ///< The shaders profiled so far.
+
+public:
+    Profile();
+    Counters* counters( const Shader& shader );
+    const Counters* find_counters( const Shader& shader ) const;
+    int shaders() const;
+    void clear();
+    std::string text_report() const;
+    std::string json_report() const;
+};
+
+}
+
+#endif
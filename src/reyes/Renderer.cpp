@@ -9,7 +9,9 @@
 #include "SampleBuffer.hpp"
 #include "ImageBuffer.hpp"
 #include "Sampler.hpp"
+#include "GridBatch.hpp"
 #include "Grid.hpp"
+#include "Identifier.hpp"
 #include "Cone.hpp"
 #include "Sphere.hpp"
 #include "Cylinder.hpp"
@@ -23,9 +25,11 @@
 #include "Shader.hpp"
 #include "Light.hpp"
 #include "Texture.hpp"
+#include "AssetCache.hpp"
 #include "Value.hpp"
 #include "SymbolTable.hpp"
 #include "VirtualMachine.hpp"
+#include "Profile.hpp"
 #include "SymbolTable.hpp"
 #include "Attributes.hpp"
 #include "ErrorPolicy.hpp"
@@ -61,12 +65,19 @@ using namespace reyes;
 
 static const int ATTRIBUTES_RESERVE = 32;
 static const int MAXIMUM_VERTICES_PER_GRID = 64 * 64;
+static const int MAXIMUM_VERTICES_PER_BATCHED_GRID = 8 * 8;
 static const char* NULL_SURFACE_SHADER = "surface null() { Ci = Cs; Oi = Os; }";
 
 /**
 // Constructor.
+//
+// @param asset_cache
+//  The cache to load shaders and textures through or null to create a cache
+//  that is private to this renderer.  Renderers running on different threads
+//  may share the same cache to avoid compiling shaders and decoding textures
+//  more than once.
 */
-Renderer::Renderer()
+Renderer::Renderer( std::shared_ptr<AssetCache> asset_cache )
 : error_policy_( NULL ),
   symbol_table_( NULL ),
   virtual_machine_( NULL ),
@@ -74,16 +85,24 @@ Renderer::Renderer()
   sample_buffer_( NULL ),
   image_buffer_( NULL ),
   sampler_( NULL ),
+  grid_batch_( NULL ),
+  geometries_(),
   screen_transform_( math::identity() ),
   camera_transform_( math::identity() ),
+  asset_cache_( asset_cache ),
   textures_(),
   shaders_(),
   options_( NULL ),
   attributes_()
 {
+    if ( !asset_cache_ )
+    {
+        asset_cache_.reset( new AssetCache );
+    }
     error_policy_ = new ErrorPolicy;
     symbol_table_ = new SymbolTable();
     virtual_machine_ = new VirtualMachine( *this );
+    grid_batch_ = new GridBatch();
     null_surface_shader_ = new Shader( NULL_SURFACE_SHADER, NULL_SURFACE_SHADER + strlen(NULL_SURFACE_SHADER), symbol_table(), error_policy() );
     options_ = new Options();
     attributes_.reserve( ATTRIBUTES_RESERVE );
@@ -95,26 +114,15 @@ Renderer::Renderer()
 Renderer::~Renderer()
 {
     attributes_.clear();
-
-    for ( map<string, Shader*>::const_iterator i = shaders_.begin(); i != shaders_.end(); ++i )
-    {
-        Shader* shader = i->second;
-        REYES_ASSERT( shader );
-        delete shader;
-    }
     shaders_.clear();
-    
-    for ( map<string, Texture*>::const_iterator i = textures_.begin(); i != textures_.end(); ++i )
-    {
-        Texture* texture = i->second;
-        REYES_ASSERT( texture );
-        delete texture;
-    }
     textures_.clear();
 
     delete sampler_;
     sampler_ = NULL;
 
+    delete grid_batch_;
+    grid_batch_ = NULL;
+
     delete image_buffer_;
     image_buffer_ = NULL;
 
@@ -159,6 +167,18 @@ SymbolTable& Renderer::symbol_table() const
     return *symbol_table_;
 }
 
+/**
+// Get the cache that shaders and textures are loaded through.
+//
+// @return
+//  The AssetCache used by this renderer (pass to other renderers to share
+//  loaded shaders and textures with them).
+*/
+std::shared_ptr<AssetCache> Renderer::asset_cache() const
+{
+    return asset_cache_;
+}
+
 /**
 // Set the global options used when rendering.
 //
@@ -185,6 +205,37 @@ const Options& Renderer::options() const
     return *options_;
 }
 
+/**
+// Set the Profile that shaders executed by this renderer are profiled 
+// into.
+//
+// The Profile is cleared at the beginning of each frame marked by a call
+// to Renderer::begin() so that after Renderer::end() it holds the cost of
+// the shaders executed for that frame.
+//
+// @param profile
+//  The Profile to count shader instructions into or null to execute 
+//  shaders without profiling (the default).
+*/
+void Renderer::set_profile( Profile* profile )
+{
+    REYES_ASSERT( virtual_machine_ );
+    virtual_machine_->set_profile( profile );
+}
+
+/**
+// Get the Profile that shaders executed by this renderer are profiled 
+// into.
+//
+// @return
+//  The Profile or null if shaders aren't being profiled.
+*/
+Profile* Renderer::profile() const
+{
+    REYES_ASSERT( virtual_machine_ );
+    return virtual_machine_->profile();
+}
+
 /**
 // Push a copy of the the current render state onto the attribute stack.
 */
@@ -322,6 +373,23 @@ void Renderer::opacity( const math::vec3& opacity )
     attributes().set_opacity( opacity );
 }
 
+/**
+// Set the light cutoff intensity.
+//
+// Lights whose intensity falls off with the inverse square of distance (or
+// faster) are skipped for grids that lie beyond the distance at which their
+// intensity drops below the cutoff.  The default cutoff of 0 only culls 
+// lights against the cones of their illuminate statements.
+//
+// @param light_cutoff
+//  The intensity below which light is ignored (0 to disable distance 
+//  culling).
+*/
+void Renderer::light_cutoff( float light_cutoff )
+{
+    attributes().set_light_cutoff( light_cutoff );
+}
+
 /**
 // Mark the beginning of a frame.
 //
@@ -357,6 +425,11 @@ void Renderer::begin()
     screen_transform_ = math::identity();
     camera_transform_ = math::identity();
 
+    if ( virtual_machine_->profile() )
+    {
+        virtual_machine_->profile()->clear();
+    }
+
     shared_ptr<Attributes> attributes( new Attributes(virtual_machine_) );
     attributes_.clear();
     attributes_.push_back( attributes );    
@@ -396,9 +469,9 @@ void Renderer::begin_world()
     camera_transform_ = current_transform();
     identity();
 
-    add_coordinate_system( "screen", inverse(screen_transform_) );
-    add_coordinate_system( "camera", math::identity() );
-    add_coordinate_system( "world", camera_transform_ );
+    add_coordinate_system( IDENTIFIER_SCREEN, inverse(screen_transform_) );
+    add_coordinate_system( IDENTIFIER_CAMERA, math::identity() );
+    add_coordinate_system( IDENTIFIER_WORLD, camera_transform_ );
     
     push_attributes();
 }
@@ -414,9 +487,9 @@ void Renderer::end_world()
 {
     identity();
     
-    remove_coordinate_system( "world" );
-    remove_coordinate_system( "camera" );
-    remove_coordinate_system( "screen" );
+    remove_coordinate_system( IDENTIFIER_WORLD );
+    remove_coordinate_system( IDENTIFIER_CAMERA );
+    remove_coordinate_system( IDENTIFIER_SCREEN );
     
     pop_attributes();
 }
@@ -470,6 +543,22 @@ void Renderer::add_coordinate_system( const char* name, const math::mat4x4& tran
     attributes().add_coordinate_system( name, transform );
 }
 
+/**
+// Add a named coordinate system to the current render state by the 
+// interned identifier of its name.
+//
+// @param identifier
+//  The interned identifier of the name of the coordinate system (see 
+//  Identifier).
+//
+// @param transform
+//  The transform from the named coordinate system to "camera" space.
+*/
+void Renderer::add_coordinate_system( int identifier, const math::mat4x4& transform )
+{
+    attributes().add_coordinate_system( identifier, transform );
+}
+
 /**
 // Remove a named coordinate system from the current render state.
 //
@@ -481,6 +570,18 @@ void Renderer::remove_coordinate_system( const char* name )
     attributes().remove_coordinate_system( name );    
 }
 
+/**
+// Remove a named coordinate system from the current render state by the
+// interned identifier of its name.
+//
+// @param identifier
+//  The interned identifier of the name of the coordinate system to remove.
+*/
+void Renderer::remove_coordinate_system( int identifier )
+{
+    attributes().remove_coordinate_system( identifier );
+}
+
 /**
 // Get the transformation from the coordinate system specified by \e name
 // to "camera" space.
@@ -502,6 +603,26 @@ math::mat4x4 Renderer::transform_from( const std::string& name ) const
     return attributes().transform_from( name );    
 }
 
+/**
+// Get the transformation from the coordinate system whose name interns to
+// \e identifier to "camera" space.
+//
+// Shaders intern the names of coordinate systems when they're compiled so 
+// this is a single lookup with no string comparisons.
+//
+// @param identifier
+//  The interned identifier of the name of the coordinate system (see
+//  Value::string_identifier()).
+//
+// @return
+//  The transform to "camera" space from the coordinate system or the 
+//  identity transform if no such coordinate system is defined.
+*/
+const math::mat4x4& Renderer::transform_from( int identifier ) const
+{
+    return attributes().transform_from( identifier );
+}
+
 /**
 // Get the transformation from "camera" space to the coordinate system 
 // specified by \e name.
@@ -515,7 +636,26 @@ math::mat4x4 Renderer::transform_from( const std::string& name ) const
 */
 math::mat4x4 Renderer::transform_to( const std::string& name ) const
 {
-    return inverse( transform_from(name) );
+    return transform_to( intern_identifier(name) );
+}
+
+/**
+// Get the transformation from "camera" space to the coordinate system whose
+// name interns to \e identifier.
+//
+// The inverse is calculated once when it is first needed after the 
+// coordinate system is added rather than for every transform.
+//
+// @param identifier
+//  The interned identifier of the name of the coordinate system.
+//
+// @return
+//  The transform from "camera" space to the coordinate system or the 
+//  identity transform if there is no such coordinate system defined.
+*/
+const math::mat4x4& Renderer::transform_to( int identifier ) const
+{
+    return attributes().transform_to( identifier );
 }
 
 /**
@@ -537,6 +677,25 @@ math::mat4x4 Renderer::transform_between( const std::string& from, const std::st
     return transform_to( to ) * transform_from( from );
 }
 
+/**
+// Get the transformation between two coordinate systems by the interned 
+// identifiers of their names.
+//
+// @param from
+//  The interned identifier of the coordinate system to transform from.
+//
+// @param to
+//  The interned identifier of the coordinate system to transform to.
+//
+// @return
+//  The transformation that transforms from coordinate system \e from to the
+//  coordinates system \e to.
+*/
+math::mat4x4 Renderer::transform_between( int from, int to ) const
+{
+    return transform_to( to ) * transform_from( from );
+}
+
 /**
 // Push the current transform onto a new level of the transform stack.
 */
@@ -732,7 +891,7 @@ const math::mat4x4& Renderer::current_transform() const
 // @return
 //  A grid that can be used to set the uniform parameters used by the shader.
 */
-Grid& Renderer::displacement_shader( Shader* displacement_shader )
+Grid& Renderer::displacement_shader( const Shader* displacement_shader )
 {
     REYES_ASSERT( !attributes_.empty() );
     Attributes& attributes = Renderer::attributes();
@@ -751,7 +910,7 @@ Grid& Renderer::displacement_shader( Shader* displacement_shader )
 // @return
 //  A grid that can be used to set the uniform parameters used by the shader.
 */
-Grid& Renderer::surface_shader( Shader* surface_shader )
+Grid& Renderer::surface_shader( const Shader* surface_shader )
 {
     REYES_ASSERT( !attributes_.empty() );
     Attributes& attributes = Renderer::attributes();
@@ -770,7 +929,7 @@ Grid& Renderer::surface_shader( Shader* surface_shader )
 //  and also to activate and/or deactivate that particular light for different
 //  pieces of geometry.
 */
-Grid& Renderer::light_shader( Shader* light_shader )
+Grid& Renderer::light_shader( const Shader* light_shader )
 {
     return attributes().add_light_shader( light_shader, camera_transform_ );
 }
@@ -1266,7 +1425,14 @@ void Renderer::polygon_mesh( int polygons, const int* vertices, const int* indic
 // that can be referred to in shaders at this point.
 //
 // Once a grid has been split small enough it is shaded, sampled, and then
-// discarded.
+// discarded.  Grids of only a few vertices are queued and shaded together 
+// with the other small grids diced from the same geometry instead (see 
+// GridBatch and Renderer::shade_grid_batch()).
+//
+// Geometry that can be diced without splitting is diced directly and every 
+// grid is diced into a grid recycled by the GridBatch so that, once grids 
+// and their values have grown to size, dicing and shading geometry doesn't 
+// allocate.
 //
 // @param geometry
 //  The geometry to split.
@@ -1274,95 +1440,150 @@ void Renderer::polygon_mesh( int polygons, const int* vertices, const int* indic
 void Renderer::split( const Geometry& geometry )
 {
     const mat4x4 transform = camera_transform_ * current_transform();
-    add_coordinate_system( "object", transform );
+    add_coordinate_system( IDENTIFIER_OBJECT, transform );
+
+    REYES_ASSERT( geometries_.empty() );
+    split_or_dice( geometry, transform );
+    while ( !geometries_.empty() )
+    {
+        const shared_ptr<Geometry>& geometry = geometries_.front();
+        REYES_ASSERT( geometry );
+        split_or_dice( *geometry, transform );
+        geometries_.pop_front();
+    }
 
+    shade_grid_batch();
+    remove_coordinate_system( IDENTIFIER_OBJECT );
+}
+
+/**
+// Cull, dice, or split one piece of geometry for split().
+//
+// Geometry small enough to dice is diced into the next grid of the 
+// GridBatch.  Grids larger than MAXIMUM_VERTICES_PER_BATCHED_GRID are 
+// shaded and sampled on their own straight away.  Geometry that is split
+// has its pieces added to the back of the list of geometry to split.
+//
+// @param geometry
+//  The geometry to cull, dice, or split.
+//
+// @param transform
+//  The transform from object space to camera space for \e geometry.
+*/
+void Renderer::split_or_dice( const Geometry& geometry, const math::mat4x4& transform )
+{
     const float WIDTH = float(sample_buffer_->width() - 1);
     const float HEIGHT = float(sample_buffer_->height() - 1);
     const float SAMPLES_PER_PIXEL = float(options_->horizontal_sampling_rate() * options_->vertical_sampling_rate());
 
-    list<shared_ptr<Geometry>> geometries;
-    geometries.push_back( shared_ptr<Geometry>(const_cast<Geometry*>(&geometry), [](Geometry* /*geometry*/){}) );
-    while ( !geometries.empty() )
-    {
-        const shared_ptr<Geometry>& geometry = geometries.front();
-        REYES_ASSERT( geometry );
-
-        vec3 minimum = vec3( 0.0f, 0.0f, 0.0f );
-        vec3 maximum = vec3( 0.0f, 0.0f, 0.0f );
+    vec3 minimum = vec3( 0.0f, 0.0f, 0.0f );
+    vec3 maximum = vec3( 0.0f, 0.0f, 0.0f );
 
-        bool primitive_spans_epsilon_plane = false;
-        int width = 0;
-        int height = 0;
+    bool primitive_spans_epsilon_plane = false;
+    int width = 0;
+    int height = 0;
+    
+    if ( geometry.boundable() )
+    {
+        geometry.bound( transform, &minimum, &maximum );        
+        if ( minimum.z > options_->far_clip_distance() || maximum.z < options_->near_clip_distance() )
+        {
+            return;
+        }
         
-        if ( geometry->boundable() )
+        const float EPSILON = 0.01f;
+        primitive_spans_epsilon_plane = minimum.z < EPSILON && geometry.splittable();
+        if ( !primitive_spans_epsilon_plane )
         {
-            geometry->bound( transform, &minimum, &maximum );        
-            if ( minimum.z > options_->far_clip_distance() || maximum.z < options_->near_clip_distance() )
+            vec3 s[8];
+            s[0] = vec3( raster(vec3(minimum.x, minimum.y, minimum.z)) );
+            s[1] = vec3( raster(vec3(minimum.x, maximum.y, minimum.z)) );
+            s[2] = vec3( raster(vec3(maximum.x, minimum.y, minimum.z)) );
+            s[3] = vec3( raster(vec3(maximum.x, maximum.y, minimum.z)) );
+            s[4] = vec3( raster(vec3(minimum.x, minimum.y, maximum.z)) );
+            s[5] = vec3( raster(vec3(minimum.x, maximum.y, maximum.z)) );
+            s[6] = vec3( raster(vec3(maximum.x, minimum.y, maximum.z)) );
+            s[7] = vec3( raster(vec3(maximum.x, maximum.y, maximum.z)) );
+
+            vec2 screen_minimum( FLT_MAX, FLT_MAX );
+            vec2 screen_maximum( -FLT_MAX, -FLT_MAX );
+            for ( int i = 0; i < 8; ++i )
             {
-                geometries.pop_front();   
-                continue;
+                screen_minimum.x = std::min( screen_minimum.x, s[i].x );
+                screen_minimum.y = std::min( screen_minimum.y, s[i].y );
+                screen_maximum.x = std::max( screen_maximum.x, s[i].x );
+                screen_maximum.y = std::max( screen_maximum.y, s[i].y );
             }
             
-            const float EPSILON = 0.01f;
-            primitive_spans_epsilon_plane = minimum.z < EPSILON && geometry->splittable();
-            if ( !primitive_spans_epsilon_plane )
+            float x0 = screen_minimum.x;
+            float x1 = screen_maximum.x;
+            float y0 = screen_minimum.y;
+            float y1 = screen_maximum.y;
+
+            if ( x1 < 0.0f || x0 >= WIDTH || y1 < 0.0f || y0 >= HEIGHT )
             {
-                vec3 s[8];
-                s[0] = vec3( raster(vec3(minimum.x, minimum.y, minimum.z)) );
-                s[1] = vec3( raster(vec3(minimum.x, maximum.y, minimum.z)) );
-                s[2] = vec3( raster(vec3(maximum.x, minimum.y, minimum.z)) );
-                s[3] = vec3( raster(vec3(maximum.x, maximum.y, minimum.z)) );
-                s[4] = vec3( raster(vec3(minimum.x, minimum.y, maximum.z)) );
-                s[5] = vec3( raster(vec3(minimum.x, maximum.y, maximum.z)) );
-                s[6] = vec3( raster(vec3(maximum.x, minimum.y, maximum.z)) );
-                s[7] = vec3( raster(vec3(maximum.x, maximum.y, maximum.z)) );
-
-                vec2 screen_minimum( FLT_MAX, FLT_MAX );
-                vec2 screen_maximum( -FLT_MAX, -FLT_MAX );
-                for ( int i = 0; i < 8; ++i )
-                {
-                    screen_minimum.x = std::min( screen_minimum.x, s[i].x );
-                    screen_minimum.y = std::min( screen_minimum.y, s[i].y );
-                    screen_maximum.x = std::max( screen_maximum.x, s[i].x );
-                    screen_maximum.y = std::max( screen_maximum.y, s[i].y );
-                }
-                
-                float x0 = screen_minimum.x;
-                float x1 = screen_maximum.x;
-                float y0 = screen_minimum.y;
-                float y1 = screen_maximum.y;
-
-                if ( x1 < 0.0f || x0 >= WIDTH || y1 < 0.0f || y0 >= HEIGHT )
-                {
-                    geometries.pop_front();
-                    continue;
-                }
-
-                float pixels = (x1 - x0) * (y1 - y0) / SAMPLES_PER_PIXEL;
-                float micropolygons = pixels / attributes().shading_rate();
-                int power = std::max( 0, int(ceilf(lb(micropolygons) / 2.0f)) );
-                width = std::min( 1 << power, SHRT_MAX );
-                height = std::min( 1 << power, SHRT_MAX );
+                return;
             }
+
+            float pixels = (x1 - x0) * (y1 - y0) / SAMPLES_PER_PIXEL;
+            float micropolygons = pixels / attributes().shading_rate();
+            int power = std::max( 0, int(ceilf(lb(micropolygons) / 2.0f)) );
+            width = std::min( 1 << power, SHRT_MAX );
+            height = std::min( 1 << power, SHRT_MAX );
         }
-        
-        if ( !primitive_spans_epsilon_plane && width * height <= MAXIMUM_VERTICES_PER_GRID && geometry->diceable() )
+    }
+    
+    if ( !primitive_spans_epsilon_plane && width * height <= MAXIMUM_VERTICES_PER_GRID && geometry.diceable() )
+    {
+        const bool batched = width * height <= MAXIMUM_VERTICES_PER_BATCHED_GRID;
+        Grid& grid = grid_batch_->next();
+        geometry.dice( transform, width, height, &grid );
+        if ( !batched || !grid_batch_->accepts(grid, MAXIMUM_VERTICES_PER_GRID) )
         {
-            Grid grid;
-            geometry->dice( transform, width, height, &grid );
-            displacement_shade( grid );
-            surface_shade( grid );
-            sample( grid );
+            shade_grid_batch();
         }
-        else if ( geometry->splittable() )
+        grid_batch_->push();
+        if ( !batched )
         {
-            geometry->split( &geometries );
+            shade_grid_batch();
         }
-        
-        geometries.pop_front();
     }
+    else if ( geometry.splittable() )
+    {
+        geometry.split( &geometries_ );
+    }
+}
 
-    remove_coordinate_system( "object" );
+/**
+// Shade and sample the small grids queued by split().
+//
+// The grids are concatenated into one grid and shaded in a single pass
+// through the displacement, light, and surface shaders.  The shaded values
+// are then copied back into each grid and each grid is sampled on its own.
+// A single queued grid is shaded directly.
+*/
+void Renderer::shade_grid_batch()
+{
+    REYES_ASSERT( grid_batch_ );
+    if ( grid_batch_->grids() == 1 )
+    {
+        Grid& grid = grid_batch_->grid( 0 );
+        displacement_shade( grid );
+        surface_shade( grid );
+        sample( grid );
+    }
+    else if ( grid_batch_->grids() > 1 )
+    {
+        Grid& grid = grid_batch_->gather();
+        displacement_shade( grid );
+        surface_shade( grid );
+        grid_batch_->scatter();
+        for ( int i = 0; i < grid_batch_->grids(); ++i )
+        {
+            sample( grid_batch_->grid(i) );
+        }
+    }
+    grid_batch_->clear();
 }
 
 /**
@@ -1539,11 +1760,9 @@ void Renderer::texture( const char* filename )
 {
     REYES_ASSERT( filename );
     
-    Texture* texture = find_texture( filename );
-    if ( !texture )
+    if ( !find_texture(filename) )
     {
-        texture = new Texture( filename, TEXTURE_COLOR, error_policy_ );
-        textures_.insert( make_pair(filename, texture) );
+        set_texture( filename, asset_cache_->texture(filename, TEXTURE_COLOR, error_policy_) );
     }
 }
 
@@ -1559,11 +1778,11 @@ void Renderer::texture( const char* filename )
 */
 void Renderer::environment( const char* filename )
 {
-    Texture* texture = find_texture( filename );
-    if ( !texture )
+    REYES_ASSERT( filename );
+
+    if ( !find_texture(filename) )
     {
-        texture = new Texture( filename, TEXTURE_LATLONG_ENVIRONMENT, error_policy_ );
-        textures_.insert( make_pair(filename, texture) );
+        set_texture( filename, asset_cache_->texture(filename, TEXTURE_LATLONG_ENVIRONMENT, error_policy_) );
     }
 }
 
@@ -1584,11 +1803,11 @@ void Renderer::environment( const char* filename )
 */
 void Renderer::cubic_environment( const char* filename )
 {
-    Texture* texture = find_texture( filename );
-    if ( !texture )
+    REYES_ASSERT( filename );
+
+    if ( !find_texture(filename) )
     {
-        texture = new Texture( filename, TEXTURE_CUBIC_ENVIRONMENT, error_policy_ );
-        textures_.insert( make_pair(filename, texture) );
+        set_texture( filename, asset_cache_->texture(filename, TEXTURE_CUBIC_ENVIRONMENT, error_policy_) );
     }
 }
 
@@ -1598,6 +1817,11 @@ void Renderer::cubic_environment( const char* filename )
 // To refer to the shadow map each shader should use the same string value as 
 // passed to \e name to identify it in a shadow() call.
 //
+// Shadow maps generated from the framebuffer are private to this renderer 
+// and replace any earlier texture with the same name rather than being 
+// written into so that textures are never modified once they're visible to
+// shaders.
+//
 // @param name
 //  The name to identify the shadow map with (assumed not null).
 */
@@ -1605,15 +1829,9 @@ void Renderer::shadow_from_framebuffer( const char* name )
 {
     REYES_ASSERT( name );
 
-    Texture* texture = find_texture( name );
-    if ( !texture )
-    {
-        texture = new Texture( TEXTURE_SHADOW, camera_transform_, screen_transform_ );
-        textures_.insert( make_pair(name, texture) );
-    }
-
-    REYES_ASSERT( texture->type() == TEXTURE_SHADOW );
+    shared_ptr<Texture> texture( new Texture(TEXTURE_SHADOW, camera_transform_, screen_transform_) );
     sample_buffer_->pack( DISPLAY_MODE_Z, texture->image_buffers() );
+    set_texture( name, texture );
 }
 
 /**
@@ -1622,6 +1840,9 @@ void Renderer::shadow_from_framebuffer( const char* name )
 // To refer to the texture map each shader should use the same string value as 
 // passed to \e name to identify it in a texture() call.
 //
+// Like shadow maps textures generated from the framebuffer are private to
+// this renderer and replace any earlier texture with the same name.
+//
 // @param name
 //  The name to identify the texture with (assumed not null).
 */
@@ -1629,15 +1850,9 @@ void Renderer::texture_from_framebuffer( const char* name )
 {
     REYES_ASSERT( name );
 
-    Texture* texture = find_texture( name );
-    if ( !texture )
-    {
-        texture = new Texture( TEXTURE_COLOR, math::identity(), math::identity() );
-        textures_.insert( make_pair(name, texture) );
-    }    
-
-    REYES_ASSERT( texture->type() == TEXTURE_COLOR );
+    shared_ptr<Texture> texture( new Texture(TEXTURE_COLOR, math::identity(), math::identity()) );
     sample_buffer_->pack( DISPLAY_MODE_RGB | DISPLAY_MODE_A, texture->image_buffers() );
+    set_texture( name, texture );
 }
 
 /**
@@ -1649,12 +1864,29 @@ void Renderer::texture_from_framebuffer( const char* name )
 // @return 
 //  The texture or null if no such texture could be found.
 */
-Texture* Renderer::find_texture( const char* filename ) const
+const Texture* Renderer::find_texture( const char* filename ) const
 {
     REYES_ASSERT( filename );
-    
-    map<string, Texture*>::const_iterator i = textures_.find( filename );
-    return i != textures_.end() ? i->second : NULL;
+    return find_texture( intern_identifier(filename) );
+}
+
+/**
+// Find a loaded texture by the interned identifier of its filename or name.
+//
+// Shaders look up textures this way using the identifier interned when the
+// string value naming the texture was set so that looking up a texture is 
+// an index into an array rather than a string comparison.
+//
+// @param identifier
+//  The interned identifier of the string that identifies the texture or -1
+//  for the empty string.
+//
+// @return 
+//  The texture or null if no such texture could be found.
+*/
+const Texture* Renderer::find_texture( int identifier ) const
+{
+    return identifier >= 0 && identifier < int(textures_.size()) ? textures_[identifier].get() : NULL;
 }
 
 /**
@@ -1662,7 +1894,8 @@ Texture* Renderer::find_texture( const char* filename ) const
 //
 // Looks for an existing loaded shader that was loaded using the same 
 // filename and returns that.  If there is no existing loaded shader with
-// that filename then a new shader is loaded and returned.
+// that filename then the shader is requested from the asset cache, which 
+// compiles it only if no other renderer sharing the cache already has.
 //
 // @param filename
 //  The filename of the shader to find or load.
@@ -1670,19 +1903,47 @@ Texture* Renderer::find_texture( const char* filename ) const
 // @return
 //  The shader.
 */
-Shader* Renderer::shader( const char* filename )
+const Shader* Renderer::shader( const char* filename )
 {
     REYES_ASSERT( filename );
 
-    Shader* shader = find_shader( filename );
+    const Shader* shader = find_shader( filename );
     if ( !shader )
     {
-        shader = new Shader( filename, symbol_table(), error_policy() );
-        shaders_.insert( make_pair(filename, shader) );
+        shared_ptr<const Shader> cached_shader = asset_cache_->shader( filename, symbol_table(), error_policy() );
+        shaders_.insert( make_pair(filename, cached_shader) );
+        shader = cached_shader.get();
     }
     return shader;
 }
 
+/**
+// Load or find existing shaders, compiling those that aren't already loaded
+// concurrently.
+//
+// Typically called once at scene load with every shader that the scene 
+// uses so that compilation isn't serialized on the first use of each 
+// shader.  Compilation errors are reported to this renderer's ErrorPolicy 
+// in the order that the shaders are listed and the shaders are added to 
+// this renderer together once they have all been compiled.
+//
+// @param filenames
+//  The filenames of the shaders to find or load.
+//
+// @param threads
+//  The maximum number of threads to compile shaders on or 0 to use one
+//  thread per hardware thread.
+*/
+void Renderer::load_shaders( const std::vector<std::string>& filenames, int threads )
+{
+    vector<shared_ptr<const Shader>> shaders = asset_cache_->shaders( filenames, symbol_table(), error_policy(), threads );
+    REYES_ASSERT( shaders.size() == filenames.size() );
+    for ( unsigned int i = 0; i < filenames.size(); ++i )
+    {
+        shaders_.insert( make_pair(filenames[i], shaders[i]) );
+    }
+}
+
 /**
 // Find an existing shader.
 //
@@ -1692,12 +1953,12 @@ Shader* Renderer::shader( const char* filename )
 // @return
 //  The shader or null if no matching shader was found.
 */
-Shader* Renderer::find_shader( const char* filename ) const
+const Shader* Renderer::find_shader( const char* filename ) const
 {
     REYES_ASSERT( filename );
     
-    map<string, Shader*>::const_iterator i = shaders_.find( filename );
-    return i != shaders_.end() ? i->second : NULL;
+    map<string, shared_ptr<const Shader>>::const_iterator i = shaders_.find( filename );
+    return i != shaders_.end() ? i->second.get() : NULL;
 }
 
 /**
@@ -1815,3 +2076,24 @@ float Renderer::lb( float x ) const
 {
     return log( x ) / log( 2.0f );
 }
+
+/**
+// Add or replace the texture identified by a filename or name.
+//
+// @param name
+//  The filename or name that shaders use to refer to the texture (assumed
+//  not null).
+//
+// @param texture
+//  The texture.
+*/
+void Renderer::set_texture( const char* name, std::shared_ptr<const Texture> texture )
+{
+    REYES_ASSERT( name );
+    const int identifier = intern_identifier( name );
+    if ( identifier >= int(textures_.size()) )
+    {
+        textures_.resize( identifier + 1 );
+    }
+    textures_[identifier] = texture;
+}
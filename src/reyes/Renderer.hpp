@@ -7,6 +7,7 @@
 #include <memory>
 #include <utility>
 #include <vector>
+#include <list>
 #include <map>
 #include <string>
 
@@ -14,13 +15,16 @@ namespace reyes
 {
 
 class ErrorPolicy;
+class AssetCache;
 class SampleBuffer;
 class ImageBuffer;
 class Options;
 class Attributes;
 class SymbolTable;
 class VirtualMachine;
+class Profile;
 class Sampler;
+class GridBatch;
 class Value;
 class Grid;
 class Geometry;
@@ -39,22 +43,28 @@ class Renderer
     SampleBuffer* sample_buffer_; ///< The sample buffer that grids are sampled into.
     ImageBuffer* image_buffer_; ///< The image buffer that the final image is filtered, exposed, and quantized into.
     Sampler* sampler_; ///< The sampler that samples grids into the sample buffer.
+    GridBatch* grid_batch_; ///< The small grids queued to be shaded together.
+    std::list<std::shared_ptr<Geometry>> geometries_; ///< The pieces of split geometry waiting to be diced or split again (see split()).
     math::mat4x4 screen_transform_; ///< Transform camera space to screen space.    
     math::mat4x4 camera_transform_; ///< Transform world space to camera space.
-    std::map<std::string, Texture*> textures_; ///< The textures that have been loaded (by filename).
-    std::map<std::string, Shader*> shaders_; ///< The shaders that have been loaded (by filename).
+    std::shared_ptr<AssetCache> asset_cache_; ///< The cache of shaders and textures loaded from files (possibly shared with other renderers).
+    std::vector<std::shared_ptr<const Texture>> textures_; ///< The textures used by this renderer indexed by the interned identifier of their filename or name (null where there is no texture).
+    std::map<std::string, std::shared_ptr<const Shader>> shaders_; ///< The shaders used by this renderer (by filename).
     Options* options_; /// The options used for this renderer.
     std::vector<std::shared_ptr<Attributes>> attributes_; ///< The attributes stack.
 
     public:
-        Renderer();
+        Renderer( std::shared_ptr<AssetCache> asset_cache = std::shared_ptr<AssetCache>() );
         ~Renderer();
                         
         ErrorPolicy& error_policy() const;
         SymbolTable& symbol_table() const;
+        std::shared_ptr<AssetCache> asset_cache() const;
         
         void set_options( const Options& options );
         const Options& options() const;
+        void set_profile( Profile* profile );
+        Profile* profile() const;
 
         void push_attributes();
         void pop_attributes();
@@ -69,6 +79,7 @@ class Renderer
         void orient_right_handed();
         void color( const math::vec3& color );        
         void opacity( const math::vec3& opacity );
+        void light_cutoff( float light_cutoff );
         
         void begin();
         void end();        
@@ -79,10 +90,15 @@ class Renderer
         const math::mat4x4& camera_transform() const;
         
         void add_coordinate_system( const char* name, const math::mat4x4& transform );
+        void add_coordinate_system( int identifier, const math::mat4x4& transform );
         void remove_coordinate_system( const char* name );
+        void remove_coordinate_system( int identifier );
         math::mat4x4 transform_from( const std::string& name ) const;
+        const math::mat4x4& transform_from( int identifier ) const;
         math::mat4x4 transform_to( const std::string& name ) const;
+        const math::mat4x4& transform_to( int identifier ) const;
         math::mat4x4 transform_between( const std::string& from, const std::string& to ) const;        
+        math::mat4x4 transform_between( int from, int to ) const;
 
         void begin_transform();
         void end_transform();
@@ -98,9 +114,9 @@ class Renderer
         void look_at( const math::vec3& at, const math::vec3& eye, const math::vec3& up );
         const math::mat4x4& current_transform() const;
         
-        Grid& displacement_shader( Shader* displacement_shader );
-        Grid& surface_shader( Shader* surface_shader );        
-        Grid& light_shader( Shader* light_shader );
+        Grid& displacement_shader( const Shader* displacement_shader );
+        Grid& surface_shader( const Shader* surface_shader );        
+        Grid& light_shader( const Shader* light_shader );
         Grid& displacement_shader( const char* filename );
         Grid& surface_shader( const char* filename );
         Grid& light_shader( const char* filename );
@@ -121,6 +137,8 @@ class Renderer
         void polygon_mesh( int polygons, const int* vertices, const int* indices, const math::vec3* positions, const math::vec3* normals, const math::vec2* texture_coordinates );
 
         void split( const Geometry& geometry );        
+        void split_or_dice( const Geometry& geometry, const math::mat4x4& transform );
+        void shade_grid_batch();
         void displacement_shade( Grid& grid );
         void surface_shade( Grid& grid );
         void light_shade( Grid& grid );
@@ -136,10 +154,12 @@ class Renderer
         void cubic_environment( const char* filename );
         void shadow_from_framebuffer( const char* name );
         void texture_from_framebuffer( const char* name );
-        Texture* find_texture( const char* filename ) const;
+        const Texture* find_texture( const char* filename ) const;
+        const Texture* find_texture( int identifier ) const;
 
-        Shader* shader( const char* filename );
-        Shader* find_shader( const char* filename ) const;
+        const Shader* shader( const char* filename );
+        void load_shaders( const std::vector<std::string>& filenames, int threads = 0 );
+        const Shader* find_shader( const char* filename ) const;
 
         const math::vec4* bezier_basis() const;
         const math::vec4* bspline_basis() const;
@@ -151,6 +171,7 @@ class Renderer
         float min( float a, float b, float c, float d ) const;
         float max( float a, float b, float c, float d ) const;
         float lb( float x ) const;
+        void set_texture( const char* name, std::shared_ptr<const Texture> texture );
 };
 
 }
@@ -7,6 +7,7 @@
 #include "Sampler.hpp"
 #include "SampleBuffer.hpp"
 #include "Grid.hpp"
+#include "Identifier.hpp"
 #include "Value.hpp"
 #include <math/vec2.ipp>
 #include <math/vec3.ipp>
@@ -71,9 +72,9 @@ void Sampler::sample( const math::mat4x4& screen_transform, const Grid& grid, bo
 
     polygons_ = 0;
 
-    const vec3* colors = !matte ? grid["Ci"].vec3_values() : NULL;
-    const vec3* opacities = !matte ? grid["Oi"].vec3_values() : NULL;
-    const vec3* positions = grid["P"].vec3_values();
+    const vec3* colors = !matte ? grid[IDENTIFIER_CI].vec3_values() : NULL;
+    const vec3* opacities = !matte ? grid[IDENTIFIER_OI].vec3_values() : NULL;
+    const vec3* positions = grid[IDENTIFIER_P].vec3_values();
     const int vertices = grid.size();
     
     calculate_raster_positions( screen_transform, positions, vertices );
@@ -17,6 +17,7 @@
 #include <stdio.h>
 
 using std::max;
+using std::find;
 using std::string;
 using std::vector;
 using std::shared_ptr;
@@ -65,6 +66,7 @@ void SemanticAnalyzer::analyze( SyntaxNode* node, const char* name )
     if ( node && error_policy_->errors() == 0 )
     {
         analyze_ambient_lighting( node->node(0) );
+        infer_storage( node->node(0) );
         analyze_node( node->node(0) );
 
         if ( errors_ > 0 && error_policy_ )
@@ -176,6 +178,10 @@ void SemanticAnalyzer::analyze_node( SyntaxNode* node ) const
         case SHADER_NODE_CALL:
             analyze_call( node );
             break;
+
+        case SHADER_NODE_INLINE_CALL:
+            analyze_inline_call( node );
+            break;
     
         case SHADER_NODE_IF:
         case SHADER_NODE_IF_ELSE:
@@ -311,6 +317,256 @@ void SemanticAnalyzer::analyze_node( SyntaxNode* node ) const
     }
 }
 
+/**
+// Infer the narrowest storage for the variables declared without an explicit
+// 'uniform' or 'varying' in a shader.
+//
+// Each variable starts out uniform and is only made varying when it is 
+// assigned a varying value or assigned under a condition mask (in an if 
+// statement; in a loop with a varying condition or containing a break or 
+// continue; or in an illuminance, illuminate, or solar statement).  Making a
+// variable varying can make the values assigned from it varying so the 
+// assignments are revisited until no more variables change.  Expressions 
+// already take the greatest storage of their operands and are only promoted
+// where they meet a varying value so uniform variables keep everything that 
+// only depends on uniform parameters and constants computed once per grid.
+//
+// @param node
+//  The shader definition node to infer variable storage for.
+*/
+void SemanticAnalyzer::infer_storage( SyntaxNode* node ) const
+{
+    REYES_ASSERT( node );
+
+    vector<Symbol*> symbols;
+    collect_inferred_symbols( node, &symbols );
+    
+    bool changed = !symbols.empty();
+    while ( changed )
+    {
+        changed = false;
+        infer_expression_storage( node, false, symbols, &changed );
+    }
+}
+
+void SemanticAnalyzer::collect_inferred_symbols( SyntaxNode* node, std::vector<Symbol*>* symbols ) const
+{
+    REYES_ASSERT( node );
+    REYES_ASSERT( symbols );
+    
+    Symbol* symbol = node->symbol().get();
+    if ( node->node_type() == SHADER_NODE_VARIABLE && symbol && symbol->storage() == STORAGE_NULL )
+    {
+        symbol->set_storage( STORAGE_UNIFORM );
+        symbols->push_back( symbol );
+    }
+
+    const vector<shared_ptr<SyntaxNode>>& nodes = node->nodes();
+    for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = nodes.begin(); i != nodes.end(); ++i )
+    {
+        SyntaxNode* syntax_node = i->get();
+        REYES_ASSERT( syntax_node );
+        collect_inferred_symbols( syntax_node, symbols );
+    }
+}
+
+ValueStorage SemanticAnalyzer::infer_expression_storage( SyntaxNode* node, bool varying, const std::vector<Symbol*>& symbols, bool* changed ) const
+{
+    REYES_ASSERT( node );
+    REYES_ASSERT( changed );
+    
+    ValueStorage storage = STORAGE_CONSTANT;
+    switch ( node->node_type() )
+    {
+        case SHADER_NODE_VARIABLE:
+        case SHADER_NODE_ASSIGN:
+        case SHADER_NODE_ADD_ASSIGN:
+        case SHADER_NODE_SUBTRACT_ASSIGN:
+        case SHADER_NODE_MULTIPLY_ASSIGN:
+        case SHADER_NODE_DIVIDE_ASSIGN:
+        {
+            ValueStorage assigned_storage = infer_expression_storage( node->node(0), varying, symbols, changed );
+            Symbol* symbol = node->symbol().get();
+            if ( symbol )
+            {
+                if ( node->node(0)->node_type() != SHADER_NODE_NULL )
+                {
+                    infer_assigned_storage( symbol, assigned_storage, varying, symbols, changed );
+                }
+                storage = symbol->storage();
+            }
+            break;
+        }
+        
+        case SHADER_NODE_IF:
+        case SHADER_NODE_IF_ELSE:
+            // Statements in if statements are always executed under a 
+            // condition mask even when the condition is uniform.
+            infer_expression_storage( node->node(0), varying, symbols, changed );
+            for ( unsigned int i = 1; i < node->nodes().size(); ++i )
+            {
+                infer_expression_storage( node->node(i), true, symbols, changed );
+            }
+            break;
+            
+        case SHADER_NODE_WHILE:
+        {
+            ValueStorage condition_storage = infer_expression_storage( node->node(0), varying, symbols, changed );
+            bool varying_loop = varying || condition_storage == STORAGE_VARYING || contains_jump( node->node(1) );
+            infer_expression_storage( node->node(1), varying_loop, symbols, changed );
+            break;
+        }
+        
+        case SHADER_NODE_FOR:
+        {
+            infer_expression_storage( node->node(0), varying, symbols, changed );
+            ValueStorage condition_storage = infer_expression_storage( node->node(1), varying, symbols, changed );
+            bool varying_loop = varying || condition_storage == STORAGE_VARYING || contains_jump( node->node(3) );
+            infer_expression_storage( node->node(2), varying_loop, symbols, changed );
+            infer_expression_storage( node->node(3), varying_loop, symbols, changed );
+            break;
+        }
+            
+        case SHADER_NODE_SOLAR:
+        case SHADER_NODE_ILLUMINATE:
+        case SHADER_NODE_ILLUMINANCE:
+            infer_expression_storage( node->node(0), varying, symbols, changed );
+            infer_expression_storage( node->node(1), true, symbols, changed );
+            break;
+            
+        case SHADER_NODE_CALL:
+            storage = infer_call_storage( node, varying, symbols, changed );
+            break;
+
+        case SHADER_NODE_INLINE_CALL:
+            infer_expression_storage( node->node(0), varying, symbols, changed );
+            storage = infer_expression_storage( node->node(1), varying, symbols, changed );
+            break;
+            
+        case SHADER_NODE_IDENTIFIER:
+            storage = node->symbol() ? node->symbol()->storage() : STORAGE_VARYING;
+            break;
+            
+        case SHADER_NODE_INTEGER:
+        case SHADER_NODE_REAL:
+        case SHADER_NODE_STRING:
+        case SHADER_NODE_TRIPLE:
+        case SHADER_NODE_SIXTEENTUPLE:
+            storage = STORAGE_CONSTANT;
+            break;
+            
+        case SHADER_NODE_TEXTURE:
+        case SHADER_NODE_SHADOW:
+        case SHADER_NODE_ENVIRONMENT:
+        {
+            const vector<shared_ptr<SyntaxNode>>& nodes = node->nodes();
+            for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = nodes.begin(); i != nodes.end(); ++i )
+            {
+                infer_expression_storage( i->get(), varying, symbols, changed );
+            }
+            storage = STORAGE_VARYING;
+            break;
+        }
+            
+        default:
+        {
+            const vector<shared_ptr<SyntaxNode>>& nodes = node->nodes();
+            for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = nodes.begin(); i != nodes.end(); ++i )
+            {
+                storage = max( storage, infer_expression_storage(i->get(), varying, symbols, changed) );
+            }
+            break;
+        }
+    }
+    return storage;
+}
+
+/**
+// Infer the storage returned from a call to a function.
+//
+// A call is uniform when none of its arguments are varying and the function
+// has an overload that takes and returns uniform values.  Calls without 
+// arguments are always varying so that functions overloaded only on their 
+// return storage, like random(), still return a different value for each 
+// vertex.  Functions that don't return a value write to their arguments so 
+// variables passed to them are treated as being assigned the greatest 
+// storage of the arguments.
+//
+// @return
+//  The inferred storage of the value returned from the call.
+*/
+ValueStorage SemanticAnalyzer::infer_call_storage( SyntaxNode* node, bool varying, const std::vector<Symbol*>& symbols, bool* changed ) const
+{
+    REYES_ASSERT( node );
+    REYES_ASSERT( node->node_type() == SHADER_NODE_CALL );
+    
+    ValueStorage storage = STORAGE_CONSTANT;
+    const vector<shared_ptr<SyntaxNode>>& arguments = node->nodes();
+    for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = arguments.begin(); i != arguments.end(); ++i )
+    {
+        storage = max( storage, infer_expression_storage(i->get(), varying, symbols, changed) );
+    }
+    
+    bool uniform_overload = false;
+    bool assigns_arguments = false;
+    const vector<shared_ptr<Symbol>> overloads = symbol_table_.find_symbols( node->lexeme() );
+    for ( vector<shared_ptr<Symbol>>::const_iterator i = overloads.begin(); i != overloads.end(); ++i )
+    {
+        const Symbol* overload = i->get();
+        REYES_ASSERT( overload );
+        const vector<SymbolParameter>& parameters = overload->parameters();
+        if ( parameters.size() == arguments.size() )
+        {
+            bool uniform = !parameters.empty() && overload->storage() != STORAGE_VARYING;
+            for ( vector<SymbolParameter>::const_iterator j = parameters.begin(); j != parameters.end(); ++j )
+            {
+                uniform = uniform && j->storage() != STORAGE_VARYING;
+            }
+            uniform_overload = uniform_overload || uniform;
+            assigns_arguments = assigns_arguments || overload->type() == TYPE_NULL;
+        }
+    }
+    
+    if ( assigns_arguments )
+    {
+        for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = arguments.begin(); i != arguments.end(); ++i )
+        {
+            const SyntaxNode* argument = i->get();
+            if ( argument->node_type() == SHADER_NODE_IDENTIFIER && argument->symbol() )
+            {
+                infer_assigned_storage( argument->symbol().get(), storage, varying, symbols, changed );
+            }
+        }
+    }
+
+    return storage == STORAGE_VARYING || !uniform_overload ? STORAGE_VARYING : STORAGE_UNIFORM;
+}
+
+void SemanticAnalyzer::infer_assigned_storage( Symbol* symbol, ValueStorage storage, bool varying, const std::vector<Symbol*>& symbols, bool* changed ) const
+{
+    REYES_ASSERT( symbol );
+    REYES_ASSERT( changed );
+    
+    if ( (storage == STORAGE_VARYING || varying) && symbol->storage() != STORAGE_VARYING && find(symbols.begin(), symbols.end(), symbol) != symbols.end() )
+    {
+        symbol->set_storage( STORAGE_VARYING );
+        *changed = true;
+    }
+}
+
+bool SemanticAnalyzer::contains_jump( const SyntaxNode* node ) const
+{
+    REYES_ASSERT( node );
+    
+    bool jump = node->node_type() == SHADER_NODE_BREAK || node->node_type() == SHADER_NODE_CONTINUE;
+    const vector<shared_ptr<SyntaxNode>>& nodes = node->nodes();
+    for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = nodes.begin(); i != nodes.end() && !jump; ++i )
+    {
+        jump = contains_jump( i->get() );
+    }
+    return jump;
+}
+
 void SemanticAnalyzer::analyze_assign_expectations( SyntaxNode* node ) const
 {
     REYES_ASSERT( node );
@@ -445,6 +701,22 @@ void SemanticAnalyzer::analyze_call( SyntaxNode* node ) const
     }
 }
 
+/**
+// Analyze a call to a function that the parser has inlined.
+//
+// The statements copied from the function's body have already been 
+// analyzed along with the rest of the shader; the call has the type and 
+// storage of the variable that the copy of the function's result is 
+// assigned to.
+*/
+void SemanticAnalyzer::analyze_inline_call( SyntaxNode* node ) const
+{
+    REYES_ASSERT( node );
+    REYES_ASSERT( node->node_type() == SHADER_NODE_INLINE_CALL );
+    node->set_type( node->node(1)->type() );
+    node->set_storage( node->node(1)->storage() );
+}
+
 void SemanticAnalyzer::analyze_assign( SyntaxNode* node ) const
 {
     shared_ptr<Symbol> symbol = node->symbol();
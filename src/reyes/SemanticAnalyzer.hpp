@@ -5,10 +5,12 @@
 #include "ValueType.hpp"
 #include "ValueStorage.hpp"
 #include <string>
+#include <vector>
 
 namespace reyes
 {
 
+class Symbol;
 class SyntaxNode;
 class SymbolTable;
 class ErrorPolicy;
@@ -34,6 +36,13 @@ private:
 
     void analyze_ambient_lighting( SyntaxNode* node );
     void analyze_node( SyntaxNode* node ) const;
+
+    void infer_storage( SyntaxNode* node ) const;
+    void collect_inferred_symbols( SyntaxNode* node, std::vector<Symbol*>* symbols ) const;
+    ValueStorage infer_expression_storage( SyntaxNode* node, bool varying, const std::vector<Symbol*>& symbols, bool* changed ) const;
+    ValueStorage infer_call_storage( SyntaxNode* node, bool varying, const std::vector<Symbol*>& symbols, bool* changed ) const;
+    void infer_assigned_storage( Symbol* symbol, ValueStorage storage, bool varying, const std::vector<Symbol*>& symbols, bool* changed ) const;
+    bool contains_jump( const SyntaxNode* node ) const;
     
     void analyze_assign_expectations( SyntaxNode* node ) const;
     void analyze_typecast_expectations( SyntaxNode* node ) const;
@@ -46,6 +55,7 @@ private:
     void analyze_illuminate_statement( SyntaxNode* node ) const;    
     void analyze_illuminance_statement( SyntaxNode* node ) const;    
     void analyze_call( SyntaxNode* node ) const;
+    void analyze_inline_call( SyntaxNode* node ) const;
     void analyze_assign( SyntaxNode* node ) const;
     void analyze_dot( SyntaxNode* node ) const;
     void analyze_cross( SyntaxNode* node ) const;
@@ -9,41 +9,100 @@
 #include "ShaderParser.hpp"
 #include "SemanticAnalyzer.hpp"
 #include "CodeGenerator.hpp"
+#include "Optimizer.hpp"
+#include "Decoder.hpp"
 #include "Symbol.hpp"
 #include "SymbolTable.hpp"
+#include "ShaderGlobal.hpp"
+#include "Identifier.hpp"
+#include "Grid.hpp"
+#include "Value.hpp"
 #include "assert.hpp"
+#include <algorithm>
+#include <string.h>
 
 using std::map;
+using std::find;
+using std::lock_guard;
+using std::mutex;
 using std::string;
 using std::vector;
 using std::shared_ptr;
 using namespace reyes;
 
+static const unsigned int MAXIMUM_SPECIALIZATIONS = 64;
+
+/**
+// Is a symbol a pure function; that is one that returns the same value 
+// each time it is called with the same arguments and that writes nothing 
+// but its result?
+//
+// Functions that return nothing write their results to their arguments 
+// (e.g. fresnel() and setxcomp()), setcomp() on a matrix writes the matrix,
+// and random() returns a different value each time it is called.
+*/
+static bool pure_function( const Symbol& symbol )
+{
+    const string& identifier = symbol.identifier();
+    return 
+        symbol.function() &&
+        symbol.type() != TYPE_NULL &&
+        identifier != "random" &&
+        identifier.compare( 0, 3, "set" ) != 0
+    ;
+}
+
 Shader::Shader()
-: symbols_(),
+: name_(),
+  symbols_(),
   values_(),
   code_(),
+  lines_(),
   initialize_address_( 0 ),
   shade_address_( 0 ),
+  instructions_(),
+  initialize_instruction_( 0 ),
+  shade_instruction_( 0 ),
   parameters_( 0 ),
   variables_( 0 ),
   constants_( 0 ),
   permanent_registers_( 0 ),
-  registers_( 0 )
+  registers_( 0 ),
+  uses_lights_( false ),
+  globals_( SHADER_GLOBAL_NULL ),
+  solar_and_illuminate_statements_( 0 ),
+  symbols_by_identifier_(),
+  specialized_( false ),
+  specialized_parameters_(),
+  specializations_mutex_(),
+  specializations_()
 {
 }
 
 Shader::Shader( const char* filename, SymbolTable& symbol_table, ErrorPolicy& error_policy )
-: symbols_(),
+: name_( filename ? filename : "" ),
+  symbols_(),
   values_(),
   code_(),
+  lines_(),
   initialize_address_( 0 ),
   shade_address_( 0 ),
+  instructions_(),
+  initialize_instruction_( 0 ),
+  shade_instruction_( 0 ),
   parameters_( 0 ),
   variables_( 0 ),
   constants_( 0 ),
   permanent_registers_( 0 ),
-  registers_( 0 )
+  registers_( 0 ),
+  uses_lights_( false ),
+  globals_( SHADER_GLOBAL_NULL ),
+  solar_and_illuminate_statements_( 0 ),
+  symbols_by_identifier_(),
+  specialized_( false ),
+  specialized_parameters_(),
+  specializations_mutex_(),
+  specializations_()
 {
     REYES_ASSERT( filename );
     
@@ -58,28 +117,58 @@ Shader::Shader( const char* filename, SymbolTable& symbol_table, ErrorPolicy& er
     
     symbols_.swap( code_generator.symbols() );
     values_.swap( code_generator.values() );
-    code_ = code_generator.code();
 
-    initialize_address_ = code_generator.initialize_address();
-    shade_address_ = code_generator.shade_address();
+    Optimizer optimizer;
+    optimizer.optimize( code_generator.code(), code_generator.lines(), code_generator.initialize_address(), code_generator.shade_address(), code_generator.permanent_registers(), code_generator.local_registers() );
+    code_ = optimizer.code();
+    lines_ = optimizer.lines();
+
+    initialize_address_ = optimizer.initialize_address();
+    shade_address_ = optimizer.shade_address();
     parameters_ = code_generator.parameters();
     variables_ = code_generator.variables();
     constants_ = code_generator.constants();
     permanent_registers_ = code_generator.permanent_registers();
-    registers_ = code_generator.registers();
+    uses_lights_ = code_generator.uses_lights();
+    globals_ = code_generator.globals();
+    solar_and_illuminate_statements_ = shader_parser.solar_and_illuminate_statements();
+
+    decode();
+    bind();
 }
 
-Shader::Shader( const char* start, const char* finish, SymbolTable& symbol_table, ErrorPolicy& error_policy )
-: symbols_(),
+/**
+// Compile a shader from source in memory.
+//
+// @param optimized
+//  Whether or not to optimize the generated byte code (see Optimizer); 
+//  unoptimized shaders give the reference results that optimized shaders
+//  are checked against.
+*/
+Shader::Shader( const char* start, const char* finish, SymbolTable& symbol_table, ErrorPolicy& error_policy, bool optimized )
+: name_(),
+  symbols_(),
   values_(),
   code_(),
+  lines_(),
   initialize_address_( 0 ),
   shade_address_( 0 ),
+  instructions_(),
+  initialize_instruction_( 0 ),
+  shade_instruction_( 0 ),
   parameters_( 0 ),
   variables_( 0 ),
   constants_( 0 ),
   permanent_registers_( 0 ),
-  registers_( 0 )
+  registers_( 0 ),
+  uses_lights_( false ),
+  globals_( SHADER_GLOBAL_NULL ),
+  solar_and_illuminate_statements_( 0 ),
+  symbols_by_identifier_(),
+  specialized_( false ),
+  specialized_parameters_(),
+  specializations_mutex_(),
+  specializations_()
 {
     REYES_ASSERT( start );
     REYES_ASSERT( finish );
@@ -96,15 +185,85 @@ Shader::Shader( const char* start, const char* finish, SymbolTable& symbol_table
     
     symbols_.swap( code_generator.symbols() );
     values_.swap( code_generator.values() );
-    code_ = code_generator.code();
 
-    initialize_address_ = code_generator.initialize_address();
-    shade_address_ = code_generator.shade_address();
+    if ( optimized )
+    {
+        Optimizer optimizer;
+        optimizer.optimize( code_generator.code(), code_generator.lines(), code_generator.initialize_address(), code_generator.shade_address(), code_generator.permanent_registers(), code_generator.local_registers() );
+        code_ = optimizer.code();
+        lines_ = optimizer.lines();
+        initialize_address_ = optimizer.initialize_address();
+        shade_address_ = optimizer.shade_address();
+    }
+    else
+    {
+        code_ = code_generator.code();
+        lines_ = code_generator.lines();
+        initialize_address_ = code_generator.initialize_address();
+        shade_address_ = code_generator.shade_address();
+    }
     parameters_ = code_generator.parameters();
     variables_ = code_generator.variables();
     constants_ = code_generator.constants();
     permanent_registers_ = code_generator.permanent_registers();
-    registers_ = code_generator.registers();
+    uses_lights_ = code_generator.uses_lights();
+    globals_ = code_generator.globals();
+    solar_and_illuminate_statements_ = shader_parser.solar_and_illuminate_statements();
+
+    decode();
+    bind();
+}
+
+/**
+// Construct a variant of a shader specialized on the values of some of its
+// registers.
+//
+// @param shader
+//  The shader to specialize.
+//
+// @param values
+//  The values to specialize on indexed by register (null where a 
+//  register's value isn't known; see Optimizer::specialize()).
+*/
+Shader::Shader( const Shader& shader, const std::vector<const Value*>& values )
+: name_( shader.name_ ),
+  symbols_( shader.symbols_ ),
+  values_( shader.values_ ),
+  code_(),
+  lines_(),
+  initialize_address_( 0 ),
+  shade_address_( 0 ),
+  instructions_(),
+  initialize_instruction_( 0 ),
+  shade_instruction_( 0 ),
+  parameters_( shader.parameters_ ),
+  variables_( shader.variables_ ),
+  constants_( shader.constants_ ),
+  permanent_registers_( shader.permanent_registers_ ),
+  registers_( shader.registers_ ),
+  uses_lights_( shader.uses_lights_ ),
+  globals_( shader.globals_ ),
+  solar_and_illuminate_statements_( shader.solar_and_illuminate_statements_ ),
+  symbols_by_identifier_(),
+  specialized_( false ),
+  specialized_parameters_(),
+  specializations_mutex_(),
+  specializations_()
+{
+    Optimizer optimizer;
+    optimizer.specialize( shader.code_, shader.lines_, shader.initialize_address_, shader.shade_address_, shader.permanent_registers_, values );
+    code_ = optimizer.code();
+    lines_ = optimizer.lines();
+    initialize_address_ = optimizer.initialize_address();
+    shade_address_ = optimizer.shade_address();
+
+    decode();
+    bind();
+}
+
+const std::string& Shader::name() const
+{
+    return name_;
 }
 
 const std::vector<std::shared_ptr<Symbol> >& Shader::symbols() const
@@ -122,6 +281,11 @@ const std::vector<unsigned char>& Shader::code() const
     return code_;
 }
 
+const std::vector<SourceLine>& Shader::lines() const
+{
+    return lines_;
+}
+
 int Shader::initialize_address() const
 {
     return initialize_address_;
@@ -137,6 +301,26 @@ int Shader::end_address() const
     return int(code_.size());
 }
 
+const std::vector<DecodedInstruction>& Shader::instructions() const
+{
+    return instructions_;
+}
+
+int Shader::initialize_instruction() const
+{
+    return initialize_instruction_;
+}
+
+int Shader::shade_instruction() const
+{
+    return shade_instruction_;
+}
+
+int Shader::end_instruction() const
+{
+    return int(instructions_.size());
+}
+
 int Shader::parameters() const
 {
     return parameters_;
@@ -162,6 +346,21 @@ int Shader::registers() const
     return registers_;
 }
 
+bool Shader::uses_lights() const
+{
+    return uses_lights_;
+}
+
+int Shader::globals() const
+{
+    return globals_;
+}
+
+int Shader::solar_and_illuminate_statements() const
+{
+    return solar_and_illuminate_statements_;
+}
+
 std::shared_ptr<Symbol> Shader::find_symbol( const std::string& identifier ) const
 {
     vector<shared_ptr<Symbol>>::const_iterator i = symbols_.begin();
@@ -171,3 +370,182 @@ std::shared_ptr<Symbol> Shader::find_symbol( const std::string& identifier ) con
     }
     return i != symbols_.end() ? *i : shared_ptr<Symbol>();
 }
+
+/**
+// Find the symbol that a grid value is bound to when this shader is run.
+//
+// @param identifier
+//  The interned identifier of the grid value (see Identifier).
+//
+// @return
+//  The symbol or null if no symbol in this shader has that identifier.
+*/
+const Symbol* Shader::find_symbol( int identifier ) const
+{
+    REYES_ASSERT( identifier >= 0 );
+    return identifier < int(symbols_by_identifier_.size()) ? symbols_by_identifier_[identifier] : NULL;
+}
+
+/**
+// Opt in to (or out of) specializing this shader on the values of its 
+// uniform parameters.
+//
+// Only float parameters that the conditions of if statements depend on and
+// that this shader never writes to are specialized on so parameters like
+// colors and texture names that vary between objects don't create extra
+// variants.
+//
+// @param specialized
+//  True to run variants of this shader specialized on its parameter values
+//  or false to always run this shader's own code.
+*/
+void Shader::set_specialized( bool specialized )
+{
+    specialized_ = specialized;
+    specialized_parameters_.clear();
+    if ( specialized_ )
+    {
+        Optimizer optimizer;
+        optimizer.find_branch_registers( code_, initialize_address_, shade_address_, permanent_registers_ );
+        const vector<int>& branch_registers = optimizer.branch_registers();
+        for ( int i = 0; i < parameters_; ++i )
+        {
+            const Symbol* symbol = symbols_[i].get();
+            REYES_ASSERT( symbol );
+            const int register_index = symbol->register_index();
+            if ( symbol->type() == TYPE_FLOAT && register_index < permanent_registers_ && find(branch_registers.begin(), branch_registers.end(), register_index) != branch_registers.end() )
+            {
+                SpecializedParameter specialized_parameter = { intern_identifier(symbol->identifier()), register_index };
+                specialized_parameters_.push_back( specialized_parameter );
+            }
+        }
+    }
+}
+
+bool Shader::specialized() const
+{
+    return specialized_;
+}
+
+/**
+// Get the variant of this shader to run with a set of parameter values.
+//
+// The variant is compiled the first time that a set of parameter values is
+// seen and reused for every later set of equal values.  Variants are kept 
+// in a map keyed by the bits of the values that they were specialized on so
+// that NaNs match.  At most MAXIMUM_SPECIALIZATIONS variants are compiled;
+// parameter values seen after that run this shader instead so that 
+// parameters that take many different values don't compile a variant for 
+// each.
+//
+// @param parameters
+//  The parameters that the shader will be run with.
+//
+// @return
+//  The variant specialized on the values in \e parameters or this shader 
+//  if it isn't specialized, doesn't have any parameters to specialize on,
+//  any of those parameters aren't set to uniform floats, or it already has
+//  the most variants allowed.
+*/
+const Shader* Shader::specialization( const Grid& parameters ) const
+{
+    if ( !specialized_ || specialized_parameters_.empty() )
+    {
+        return this;
+    }
+
+    const vector<shared_ptr<Value>>& values = parameters.values_by_identifier();
+    vector<unsigned int> key;
+    key.reserve( specialized_parameters_.size() );
+    for ( vector<SpecializedParameter>::const_iterator i = specialized_parameters_.begin(); i != specialized_parameters_.end(); ++i )
+    {
+        const Value* value = i->identifier < int(values.size()) ? values[i->identifier].get() : NULL;
+        if ( !value || value->type() != TYPE_FLOAT || value->storage() == STORAGE_VARYING || value->size() == 0 )
+        {
+            return this;
+        }
+        unsigned int bits = 0;
+        memcpy( &bits, value->float_values(), sizeof(bits) );
+        key.push_back( bits );
+    }
+
+    lock_guard<mutex> lock( specializations_mutex_ );
+    map<vector<unsigned int>, shared_ptr<Shader>>::const_iterator specialization = specializations_.find( key );
+    if ( specialization != specializations_.end() )
+    {
+        return specialization->second.get();
+    }
+    if ( specializations_.size() >= MAXIMUM_SPECIALIZATIONS )
+    {
+        return this;
+    }
+
+    vector<const Value*> known_values( permanent_registers_, static_cast<const Value*>(NULL) );
+    for ( int i = 0; i < constants_ && i < permanent_registers_; ++i )
+    {
+        known_values[i] = values_[i].get();
+    }
+    for ( vector<SpecializedParameter>::const_iterator i = specialized_parameters_.begin(); i != specialized_parameters_.end(); ++i )
+    {
+        known_values[i->register_index] = values[i->identifier].get();
+    }
+    shared_ptr<Shader>& shader = specializations_[key];
+    shader.reset( new Shader(*this, known_values) );
+    return shader.get();
+}
+
+/**
+// Decode this shader's byte code into the instructions executed by the
+// virtual machine.
+//
+// The decoder shares common subexpressions and moves loop invariant 
+// instructions, including calls to pure functions, out of loops and then
+// reuses temporary registers once the values in them are no longer read 
+// so the peak number of registers is taken from it.
+*/
+void Shader::decode()
+{
+    vector<bool> pure_functions( symbols_.size(), false );
+    for ( unsigned int i = 0; i < symbols_.size(); ++i )
+    {
+        pure_functions[i] = pure_function( *symbols_[i] );
+    }
+
+    Decoder decoder;
+    decoder.decode( code_, lines_, initialize_address_, shade_address_, permanent_registers_, pure_functions );
+    instructions_.swap( decoder.instructions() );
+    registers_ = decoder.registers();
+    initialize_instruction_ = decoder.initialize_instruction();
+    shade_instruction_ = decoder.shade_instruction();
+}
+
+/**
+// Intern the identifiers of this shader's symbols and build the table that
+// binds grid values to symbols (and so to registers) by interned 
+// identifier.
+//
+// Function symbols are never bound.  If more than one symbol has the same 
+// identifier then the first is bound, as with find_symbol().
+*/
+void Shader::bind()
+{
+    symbols_by_identifier_.assign( IDENTIFIER_COUNT, NULL );
+    for ( vector<shared_ptr<Symbol>>::const_iterator i = symbols_.begin(); i != symbols_.end(); ++i )
+    {
+        const Symbol* symbol = i->get();
+        REYES_ASSERT( symbol );
+        if ( !symbol->function() )
+        {
+            int identifier = intern_identifier( symbol->identifier() );
+            if ( identifier >= int(symbols_by_identifier_.size()) )
+            {
+                symbols_by_identifier_.resize( identifier + 1, NULL );
+            }
+            if ( !symbols_by_identifier_[identifier] )
+            {
+                symbols_by_identifier_[identifier] = symbol;
+            }
+        }
+    }
+}
+
@@ -5,6 +5,9 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <reyes/reyes_virtual_machine/DecodedInstruction.hpp>
+#include <reyes/SourceLine.hpp>
 
 namespace reyes
 {
@@ -19,38 +22,85 @@ class ErrorPolicy;
 
 /**
 // A displacement, surface, or light shader.
+//
+// Shaders can opt in to being specialized on the values of their uniform 
+// parameters (see set_specialized()).  A specialized shader compiles a 
+// variant of its code for each distinct set of values of the float 
+// parameters that its if statements depend on, evaluating those 
+// conditions and removing the statements that they disable, and runs that
+// variant instead of its own code.
 */
 class Shader
 {
+    friend class ShaderCache;
+
+    struct SpecializedParameter
+    {
+        int identifier; ///< The interned identifier of the parameter.
+        int register_index; ///< The register that the parameter is bound to.
+    };
+
+    std::string name_; ///< The name of the file that the shader was loaded from (empty if compiled from memory).
     std::vector<std::shared_ptr<Symbol>> symbols_; ///< The symbols that are used in the shader.
     std::vector<std::shared_ptr<Value>> values_; ///< The values of any constants used in the shader (including default parameter values).
     std::vector<unsigned char> code_; ///< The byte code generated for the shader.
+    std::vector<SourceLine> lines_; ///< The lines of source that the byte code was generated for.
     int initialize_address_; ///< The index of the start of the initialize code fragment.
     int shade_address_; ///< The index of the start of the shade code fragment.
+    std::vector<DecodedInstruction> instructions_; ///< The byte code decoded for execution by the virtual machine.
+    int initialize_instruction_; ///< The index of the first decoded instruction of the initialize code fragment.
+    int shade_instruction_; ///< The index of the first decoded instruction of the shade code fragment.
     int parameters_; ///< The number of parameters to the shader.
     int variables_; ///< The number of variables in the shader.
     int constants_; ///< The number of constants in the shader.
     int permanent_registers_; ///< The number of registers used by constant and uniform values in this shader.
-    int registers_; ///< The maximum number of registers that are used by this shader (variables and temporaries).
+    int registers_; ///< The peak number of registers that are used by this shader (variables and temporaries reused once they're dead).
+    bool uses_lights_; ///< True if this shader reads lights (through illuminance statements or lighting functions).
+    int globals_; ///< The bitmask of ShaderGlobal values for the global variables used by this shader.
+    int solar_and_illuminate_statements_; ///< The number of solar and illuminate statements in this shader.
+    std::vector<const Symbol*> symbols_by_identifier_; ///< The symbols that grid values are bound to indexed by interned identifier (null where there is no symbol).
+    bool specialized_; ///< True if this shader runs variants specialized on its parameter values.
+    std::vector<SpecializedParameter> specialized_parameters_; ///< The parameters that variants of this shader are specialized on.
+    mutable std::mutex specializations_mutex_; ///< Guards specializations_ as shaders may be shared between renderers.
+    mutable std::map<std::vector<unsigned int>, std::shared_ptr<Shader>> specializations_; ///< The variants compiled for this shader so far keyed by the bits of the values that they were specialized on.
 
 public:
     Shader();
     Shader( const char* filename, SymbolTable& symbol_table, ErrorPolicy& error_policy );
-    Shader( const char* start, const char* finish, SymbolTable& symbol_table, ErrorPolicy& error_policy );
+    Shader( const char* start, const char* finish, SymbolTable& symbol_table, ErrorPolicy& error_policy, bool optimized = true );
     
+    const std::string& name() const;
     const std::vector<std::shared_ptr<Symbol> >& symbols() const;
     const std::vector<std::shared_ptr<Value> >& values() const;
     const std::vector<unsigned char>& code() const;
+    const std::vector<SourceLine>& lines() const;
     int initialize_address() const;
     int shade_address() const;
     int end_address() const;
+    const std::vector<DecodedInstruction>& instructions() const;
+    int initialize_instruction() const;
+    int shade_instruction() const;
+    int end_instruction() const;
     int parameters() const;
     int variables() const;
     int constants() const;
     int permanent_registers() const;
     int registers() const;
+    bool uses_lights() const;
+    int globals() const;
+    int solar_and_illuminate_statements() const;
 
     std::shared_ptr<Symbol> find_symbol( const std::string& identitifer ) const;
+    const Symbol* find_symbol( int identifier ) const;
+
+    void set_specialized( bool specialized );
+    bool specialized() const;
+    const Shader* specialization( const Grid& parameters ) const;
+
+private:
+    Shader( const Shader& shader, const std::vector<const Value*>& values );
+    void decode();
+    void bind();
 };
 
 }
@@ -0,0 +1,582 @@
+//
+// ShaderCache.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "ShaderCache.hpp"
+#include "Shader.hpp"
+#include "Symbol.hpp"
+#include "SymbolTable.hpp"
+#include "Value.hpp"
+#include "ErrorPolicy.hpp"
+#include "assert.hpp"
+#include <stdio.h>
+#include <string.h>
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using namespace reyes;
+
+/**
+// The version of the compiler and the format of cached shaders.
+//
+// Increment this whenever a change to the parser, semantic analyzer, code
+// generator, optimizer, byte code, or built-in functions changes the 
+// shaders that are compiled from the same source so that shaders cached 
+// by earlier versions are compiled again rather than loaded.
+*/
+const int ShaderCache::VERSION = 5;
+
+static const int MAGIC = 0x43485352; ///< Identifies cached shader files ("RSHC").
+
+/**
+// Calculate a 64 bit FNV-1a hash.
+*/
+static uint64_t hash( const unsigned char* begin, const unsigned char* end, uint64_t hash )
+{
+    const uint64_t PRIME = 1099511628211ULL;
+    for ( const unsigned char* i = begin; i != end; ++i )
+    {
+        hash ^= *i;
+        hash *= PRIME;
+    }
+    return hash;
+}
+
+static const uint64_t HASH_BASIS = 14695981039346656037ULL;
+
+static void write_bytes( vector<unsigned char>* data, const void* bytes, size_t size )
+{
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>( bytes );
+    data->insert( data->end(), begin, begin + size );
+}
+
+static void write_integer( vector<unsigned char>* data, int value )
+{
+    write_bytes( data, &value, sizeof(value) );
+}
+
+static void write_real( vector<unsigned char>* data, float value )
+{
+    write_bytes( data, &value, sizeof(value) );
+}
+
+static void write_string( vector<unsigned char>* data, const string& value )
+{
+    write_integer( data, int(value.size()) );
+    write_bytes( data, value.data(), value.size() );
+}
+
+/**
+// Read values back from the data for a cached shader.
+//
+// Reading past the end of the data fails, leaving the reader invalid and
+// returning zero, rather than reading past the end of the buffer.
+*/
+class CacheReader
+{
+    const unsigned char* position_; ///< The next byte to read.
+    const unsigned char* end_; ///< One past the last byte that can be read.
+    bool valid_; ///< False if any read has failed.
+
+public:
+    CacheReader( const unsigned char* begin, const unsigned char* end )
+    : position_( begin ),
+      end_( end ),
+      valid_( begin <= end )
+    {
+    }
+
+    bool valid() const
+    {
+        return valid_;
+    }
+
+    bool finished() const
+    {
+        return valid_ && position_ == end_;
+    }
+
+    const unsigned char* position() const
+    {
+        return position_;
+    }
+
+    bool bytes( void* bytes, size_t size )
+    {
+        valid_ = valid_ && size_t(end_ - position_) >= size;
+        if ( valid_ )
+        {
+            memcpy( bytes, position_, size );
+            position_ += size;
+        }
+        return valid_;
+    }
+
+    int integer()
+    {
+        int value = 0;
+        bytes( &value, sizeof(value) );
+        return value;
+    }
+
+    float real()
+    {
+        float value = 0.0f;
+        bytes( &value, sizeof(value) );
+        return value;
+    }
+
+    string text()
+    {
+        const int size = integer();
+        valid_ = valid_ && size >= 0 && size <= end_ - position_;
+        if ( valid_ )
+        {
+            string value( reinterpret_cast<const char*>(position_), size );
+            position_ += size;
+            return value;
+        }
+        return string();
+    }
+};
+
+/**
+// Find the built-in function matching a function symbol read from a cached
+// shader.
+//
+// Functions are overloaded so the symbol must match the return type, 
+// storage, and parameters of the cached symbol as well as its identifier.
+//
+// @return
+//  The function symbol or null if there is no matching function.
+*/
+static shared_ptr<Symbol> find_function( const SymbolTable& symbol_table, const Symbol& cached_symbol )
+{
+    const vector<shared_ptr<Symbol>> symbols = symbol_table.find_symbols( cached_symbol.identifier() );
+    for ( vector<shared_ptr<Symbol>>::const_iterator i = symbols.begin(); i != symbols.end(); ++i )
+    {
+        const shared_ptr<Symbol>& symbol = *i;
+        const vector<SymbolParameter>& parameters = symbol->parameters();
+        const vector<SymbolParameter>& cached_parameters = cached_symbol.parameters();
+        bool matches = 
+            symbol->function() &&
+            symbol->type() == cached_symbol.type() &&
+            symbol->storage() == cached_symbol.storage() &&
+            parameters.size() == cached_parameters.size()
+        ;
+        for ( unsigned int j = 0; matches && j < parameters.size(); ++j )
+        {
+            matches = 
+                parameters[j].type() == cached_parameters[j].type() &&
+                parameters[j].storage() == cached_parameters[j].storage()
+            ;
+        }
+        if ( matches )
+        {
+            return symbol;
+        }
+    }
+    return shared_ptr<Symbol>();
+}
+
+/**
+// Constructor.
+//
+// @param directory
+//  The directory to store cached shaders in (assumed not null and to 
+//  exist).
+*/
+ShaderCache::ShaderCache( const char* directory )
+: directory_( directory )
+{
+    REYES_ASSERT( directory );
+}
+
+const std::string& ShaderCache::directory() const
+{
+    return directory_;
+}
+
+/**
+// Get the name of the file that the shader compiled from a source file is 
+// (or would be) cached in.
+//
+// @param filename
+//  The filename of the shader's source (assumed not null).
+//
+// @return
+//  The filename of the cached shader or an empty string if the source
+//  couldn't be read.
+*/
+std::string ShaderCache::cache_filename( const char* filename ) const
+{
+    REYES_ASSERT( filename );
+    vector<unsigned char> source;
+    return read_file( filename, &source ) ? cache_filename( key(source) ) : string();
+}
+
+/**
+// Load a shader from this cache or compile it and add it to this cache.
+//
+// Shaders that fail to compile aren't cached so that their errors are 
+// reported again by later runs.  Failing to read or write the cache isn't
+// an error; the shader is just compiled.
+//
+// @param filename
+//  The filename of the shader's source (assumed not null).
+//
+// @param symbol_table
+//  The SymbolTable to use when compiling the shader and to find the 
+//  built-in functions called by cached shaders in.
+//
+// @param error_policy
+//  The ErrorPolicy to report compilation errors to.
+//
+// @return
+//  The shader.
+*/
+std::shared_ptr<Shader> ShaderCache::shader( const char* filename, SymbolTable& symbol_table, ErrorPolicy& error_policy ) const
+{
+    REYES_ASSERT( filename );
+
+    vector<unsigned char> source;
+    if ( !read_file(filename, &source) )
+    {
+        return shared_ptr<Shader>( new Shader(filename, symbol_table, error_policy) );
+    }
+
+    const uint64_t source_key = key( source );
+    const string path = cache_filename( source_key );
+    vector<unsigned char> data;
+    if ( read_file(path.c_str(), &data) )
+    {
+        shared_ptr<Shader> shader = load( data, source_key, symbol_table );
+        if ( shader )
+        {
+            shader->name_ = filename;
+            return shader;
+        }
+    }
+
+    const int errors = error_policy.total_errors();
+    shared_ptr<Shader> shader( new Shader(filename, symbol_table, error_policy) );
+    if ( error_policy.total_errors() == errors )
+    {
+        data.clear();
+        save( *shader, source_key, &data );
+        write_file( path.c_str(), data );
+    }
+    return shader;
+}
+
+/**
+// Read the entire contents of a file.
+//
+// @return
+//  True if the file was read otherwise false.
+*/
+bool ShaderCache::read_file( const char* filename, std::vector<unsigned char>* data ) const
+{
+    REYES_ASSERT( filename );
+    REYES_ASSERT( data );
+
+    struct ReadFileGuard
+    {
+        FILE* file;
+        
+        ReadFileGuard()
+        : file( NULL )
+        {
+        }
+        
+        ~ReadFileGuard()
+        {
+            if ( file )
+            {
+                fclose( file );
+                file = NULL;
+            }
+        }        
+    };
+
+    ReadFileGuard guard;
+    guard.file = fopen( filename, "rb" );
+    if ( !guard.file || fseek(guard.file, 0, SEEK_END) != 0 )
+    {
+        return false;
+    }
+
+    const long size = ftell( guard.file );
+    if ( size < 0 || fseek(guard.file, 0, SEEK_SET) != 0 )
+    {
+        return false;
+    }
+
+    data->resize( size );
+    return size == 0 || fread( &(*data)[0], 1, size, guard.file ) == size_t(size);
+}
+
+/**
+// Write a file replacing any existing file.
+//
+// The data is written to a temporary file that is renamed once it has been
+// completely written so that other threads and processes never read a 
+// partially written file.
+//
+// @return
+//  True if the file was written otherwise false.
+*/
+bool ShaderCache::write_file( const char* filename, const std::vector<unsigned char>& data ) const
+{
+    REYES_ASSERT( filename );
+
+    const string temporary_filename = string( filename ) + ".tmp";
+    FILE* file = fopen( temporary_filename.c_str(), "wb" );
+    if ( !file )
+    {
+        return false;
+    }
+    
+    bool written = data.empty() || fwrite( &data[0], 1, data.size(), file ) == data.size();
+    written = fclose( file ) == 0 && written;
+    if ( !written || rename(temporary_filename.c_str(), filename) != 0 )
+    {
+        remove( temporary_filename.c_str() );
+        return false;
+    }
+    return true;
+}
+
+/**
+// Calculate the key that identifies the shader compiled from \e source by
+// this version of the compiler.
+*/
+uint64_t ShaderCache::key( const std::vector<unsigned char>& source ) const
+{
+    const unsigned char* begin = source.empty() ? NULL : &source[0];
+    const uint64_t source_hash = hash( begin, begin + source.size(), HASH_BASIS );
+    const unsigned char* version = reinterpret_cast<const unsigned char*>( &VERSION );
+    return hash( version, version + sizeof(VERSION), source_hash );
+}
+
+std::string ShaderCache::cache_filename( uint64_t key ) const
+{
+    char name [32];
+    sprintf( name, "%08x%08x.shader", (unsigned int) (key >> 32), (unsigned int) (key & 0xffffffff) );
+    return directory_.empty() ? string( name ) : directory_ + "/" + name;
+}
+
+/**
+// Load a shader from the data read from a cache file.
+//
+// Function symbols are found by matching them against the functions 
+// in \e symbol_table so that calls are made through the function pointers 
+// of this process.
+//
+// @return
+//  The shader or null if the data isn't a valid shader cached for \e key
+//  (for example if it was written by a different version or calls a 
+//  function that no longer exists).
+*/
+std::shared_ptr<Shader> ShaderCache::load( const std::vector<unsigned char>& data, uint64_t key, const SymbolTable& symbol_table ) const
+{
+    if ( data.empty() )
+    {
+        return shared_ptr<Shader>();
+    }
+
+    CacheReader reader( &data[0], &data[0] + data.size() );
+    uint64_t cached_key = 0;
+    uint64_t checksum = 0;
+    const int magic = reader.integer();
+    const int version = reader.integer();
+    reader.bytes( &cached_key, sizeof(cached_key) );
+    reader.bytes( &checksum, sizeof(checksum) );
+    if ( !reader.valid() || magic != MAGIC || version != VERSION || cached_key != key || hash(reader.position(), &data[0] + data.size(), HASH_BASIS) != checksum )
+    {
+        return shared_ptr<Shader>();
+    }
+
+    shared_ptr<Shader> shader( new Shader );
+    shader->initialize_address_ = reader.integer();
+    shader->shade_address_ = reader.integer();
+    shader->parameters_ = reader.integer();
+    shader->variables_ = reader.integer();
+    shader->constants_ = reader.integer();
+    shader->permanent_registers_ = reader.integer();
+    shader->registers_ = reader.integer();
+    shader->uses_lights_ = reader.integer() != 0;
+    shader->globals_ = reader.integer();
+    shader->solar_and_illuminate_statements_ = reader.integer();
+
+    const int symbols = reader.integer();
+    for ( int i = 0; i < symbols && reader.valid(); ++i )
+    {
+        shared_ptr<Symbol> symbol( new Symbol(reader.text()) );
+        symbol->set_type( ValueType(reader.integer()) );
+        symbol->set_storage( ValueStorage(reader.integer()) );
+        symbol->set_elements( reader.integer() );
+        symbol->set_index( reader.integer() );
+        symbol->set_register_index( reader.integer() );
+        symbol->set_value( reader.real() );
+        const bool function = reader.integer() != 0;
+        const int parameters = reader.integer();
+        for ( int j = 0; j < parameters && reader.valid(); ++j )
+        {
+            const ValueType type = ValueType( reader.integer() );
+            const ValueStorage storage = ValueStorage( reader.integer() );
+            symbol->add_parameter( type, storage );
+        }
+        if ( function )
+        {
+            symbol = find_function( symbol_table, *symbol );
+            if ( !symbol )
+            {
+                return shared_ptr<Shader>();
+            }
+        }
+        shader->symbols_.push_back( symbol );
+    }
+
+    const int values = reader.integer();
+    for ( int i = 0; i < values && reader.valid(); ++i )
+    {
+        const ValueType type = ValueType( reader.integer() );
+        const ValueStorage storage = ValueStorage( reader.integer() );
+        const int size = reader.integer();
+        if ( type <= TYPE_NULL || type >= TYPE_COUNT || storage <= STORAGE_NULL || storage >= STORAGE_COUNT || size != 1 )
+        {
+            return shared_ptr<Shader>();
+        }
+
+        shared_ptr<Value> value( new Value(type, storage, size) );
+        if ( type == TYPE_STRING )
+        {
+            value->set_string( reader.text() );
+        }
+        else
+        {
+            reader.bytes( value->values(), size * value->element_size() );
+        }
+        shader->values_.push_back( value );
+    }
+
+    const int code_size = reader.integer();
+    if ( !reader.valid() || code_size <= 0 )
+    {
+        return shared_ptr<Shader>();
+    }
+    shader->code_.resize( code_size );
+    reader.bytes( &shader->code_[0], code_size );
+
+    const int lines = reader.integer();
+    for ( int i = 0; i < lines && reader.valid(); ++i )
+    {
+        SourceLine line;
+        line.address = reader.integer();
+        line.line = reader.integer();
+        if ( line.address < 0 || line.address >= code_size )
+        {
+            return shared_ptr<Shader>();
+        }
+        shader->lines_.push_back( line );
+    }
+
+    const bool valid = 
+        reader.finished() &&
+        int(shader->symbols_.size()) == symbols &&
+        int(shader->values_.size()) == shader->constants_ &&
+        int(shader->lines_.size()) == lines &&
+        shader->initialize_address_ >= 0 && shader->initialize_address_ < code_size &&
+        shader->shade_address_ >= 0 && shader->shade_address_ < code_size
+    ;
+    if ( !valid )
+    {
+        return shared_ptr<Shader>();
+    }
+
+    shader->decode();
+    shader->bind();
+    return shader;
+}
+
+/**
+// Save a shader to the data written to a cache file.
+*/
+void ShaderCache::save( const Shader& shader, uint64_t key, std::vector<unsigned char>* data ) const
+{
+    REYES_ASSERT( data );
+
+    vector<unsigned char> payload;
+    write_integer( &payload, shader.initialize_address_ );
+    write_integer( &payload, shader.shade_address_ );
+    write_integer( &payload, shader.parameters_ );
+    write_integer( &payload, shader.variables_ );
+    write_integer( &payload, shader.constants_ );
+    write_integer( &payload, shader.permanent_registers_ );
+    write_integer( &payload, shader.registers_ );
+    write_integer( &payload, shader.uses_lights_ ? 1 : 0 );
+    write_integer( &payload, shader.globals_ );
+    write_integer( &payload, shader.solar_and_illuminate_statements_ );
+
+    write_integer( &payload, int(shader.symbols_.size()) );
+    for ( vector<shared_ptr<Symbol>>::const_iterator i = shader.symbols_.begin(); i != shader.symbols_.end(); ++i )
+    {
+        const Symbol* symbol = i->get();
+        REYES_ASSERT( symbol );
+        write_string( &payload, symbol->identifier() );
+        write_integer( &payload, symbol->type() );
+        write_integer( &payload, symbol->storage() );
+        write_integer( &payload, symbol->elements() );
+        write_integer( &payload, symbol->index() );
+        write_integer( &payload, symbol->register_index() );
+        write_real( &payload, symbol->value() );
+        write_integer( &payload, symbol->function() ? 1 : 0 );
+        const vector<SymbolParameter>& parameters = symbol->parameters();
+        write_integer( &payload, int(parameters.size()) );
+        for ( vector<SymbolParameter>::const_iterator j = parameters.begin(); j != parameters.end(); ++j )
+        {
+            write_integer( &payload, j->type() );
+            write_integer( &payload, j->storage() );
+        }
+    }
+
+    write_integer( &payload, int(shader.values_.size()) );
+    for ( vector<shared_ptr<Value>>::const_iterator i = shader.values_.begin(); i != shader.values_.end(); ++i )
+    {
+        const Value* value = i->get();
+        REYES_ASSERT( value );
+        write_integer( &payload, value->type() );
+        write_integer( &payload, value->storage() );
+        write_integer( &payload, int(value->size()) );
+        if ( value->type() == TYPE_STRING )
+        {
+            write_string( &payload, value->string_value() );
+        }
+        else
+        {
+            write_bytes( &payload, value->values(), value->size() * value->element_size() );
+        }
+    }
+
+    write_integer( &payload, int(shader.code_.size()) );
+    write_bytes( &payload, shader.code_.empty() ? NULL : &shader.code_[0], shader.code_.size() );
+
+    write_integer( &payload, int(shader.lines_.size()) );
+    for ( vector<SourceLine>::const_iterator i = shader.lines_.begin(); i != shader.lines_.end(); ++i )
+    {
+        write_integer( &payload, i->address );
+        write_integer( &payload, i->line );
+    }
+
+    const unsigned char* begin = payload.empty() ? NULL : &payload[0];
+    const uint64_t checksum = hash( begin, begin + payload.size(), HASH_BASIS );
+    write_integer( data, MAGIC );
+    write_integer( data, VERSION );
+    write_bytes( data, &key, sizeof(key) );
+    write_bytes( data, &checksum, sizeof(checksum) );
+    data->insert( data->end(), payload.begin(), payload.end() );
+}
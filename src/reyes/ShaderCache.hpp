@@ -0,0 +1,48 @@
+#ifndef REYES_SHADERCACHE_HPP_INCLUDED
+#define REYES_SHADERCACHE_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+namespace reyes
+{
+
+class Shader;
+class SymbolTable;
+class ErrorPolicy;
+
+/**
+// A cache of compiled shaders stored in files in a directory so that 
+// shaders compiled by one run are loaded without parsing by later runs.
+//
+// Each compiled shader is stored in a file named for a hash of its source
+// text and the version of the compiler.  Changing the source of a shader
+// or the compiler gives a different file so stale files are never loaded;
+// they're just left unused in the directory.
+*/
+class ShaderCache
+{
+    std::string directory_; ///< The directory that cached shaders are stored in.
+
+public:
+    static const int VERSION; ///< The version of the compiler and the format of cached shaders.
+
+    ShaderCache( const char* directory );
+    const std::string& directory() const;
+    std::string cache_filename( const char* filename ) const;
+    std::shared_ptr<Shader> shader( const char* filename, SymbolTable& symbol_table, ErrorPolicy& error_policy ) const;
+
+private:
+    bool read_file( const char* filename, std::vector<unsigned char>* data ) const;
+    bool write_file( const char* filename, const std::vector<unsigned char>& data ) const;
+    uint64_t key( const std::vector<unsigned char>& source ) const;
+    std::string cache_filename( uint64_t key ) const;
+    std::shared_ptr<Shader> load( const std::vector<unsigned char>& data, uint64_t key, const SymbolTable& symbol_table ) const;
+    void save( const Shader& shader, uint64_t key, std::vector<unsigned char>* data ) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef REYES_SHADERGLOBAL_HPP_INCLUDED
+#define REYES_SHADERGLOBAL_HPP_INCLUDED
+
+namespace reyes
+{
+
+/**
+// A bitmask that specifies which global variables a shader reads so that
+// the renderer only sets up those globals before the shader is run.
+*/
+enum ShaderGlobal
+{
+    SHADER_GLOBAL_NULL = 0x00,
+    SHADER_GLOBAL_P = 0x01,
+    SHADER_GLOBAL_N = 0x02,
+    SHADER_GLOBAL_I = 0x04,
+    SHADER_GLOBAL_CS = 0x08,
+    SHADER_GLOBAL_OS = 0x10,
+    SHADER_GLOBAL_S = 0x20,
+    SHADER_GLOBAL_T = 0x40,
+    SHADER_GLOBAL_PS = 0x80
+};
+
+}
+
+#endif
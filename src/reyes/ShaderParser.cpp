@@ -13,6 +13,7 @@
 #include <lalr/Parser.hpp>
 #include <lalr/PositionIterator.hpp>
 #include "assert.hpp"
+#include <algorithm>
 #include <fstream>
 #include <iterator>
 #include <functional>
@@ -29,14 +30,44 @@ using std::shared_ptr;
 using namespace std::placeholders;
 using namespace reyes;
 
+// The most syntax nodes that inlining calls to functions may copy into a 
+// shader; this stops deeply nested calls to small functions from growing 
+// shaders without bound.
+static const int MAXIMUM_INLINED_NODES = 65536;
+
 template <class Iterator>
 class ShaderParserContext : public lalr::ErrorPolicy
 {
+    /**
+    // A function defined in the shader source.
+    //
+    // The virtual machine only calls built-in functions so calls to these
+    // functions are replaced by a copy of the function's body where they're 
+    // parsed (see inline_call()).  Functions must be defined before they're
+    // called.
+    */
+    struct Function
+    {
+        shared_ptr<SyntaxNode> node; ///< The function's definition.
+        vector<shared_ptr<Symbol>> parameters; ///< The function's parameters in order.
+        vector<bool> outputs; ///< Whether or not each parameter is an output parameter.
+        vector<bool> substitutable; ///< Whether or not each parameter can be replaced by a variable passed to it.
+        vector<shared_ptr<Symbol>> symbols; ///< The parameters, variables, and result declared by the function.
+        vector<shared_ptr<Symbol>> externs; ///< The symbols that stand in for the variables that the function declares extern.
+        shared_ptr<Symbol> result; ///< The variable that the function's return value is assigned to (or null for void functions).
+    };
+
     SymbolTable& symbol_table_;
     reyes::ErrorPolicy* error_policy_;
     const lalr::Parser<lalr::PositionIterator<Iterator>, shared_ptr<SyntaxNode>, char>* parser_;
     int solar_and_illuminate_statements_;
     int errors_;
+    bool shader_;
+    map<string, Function> functions_;
+    vector<shared_ptr<Symbol>> function_symbols_;
+    vector<shared_ptr<Symbol>> function_externs_;
+    vector<shared_ptr<Symbol>> function_outputs_;
+    int inlined_nodes_;
 
 public:
     ShaderParserContext( SymbolTable& symbol_table, reyes::ErrorPolicy* error_policy )
@@ -45,7 +76,13 @@ public:
       error_policy_( error_policy ),
       parser_( NULL ),
       solar_and_illuminate_statements_( 0 ),
-      errors_( 0 )
+      errors_( 0 ),
+      shader_( false ),
+      functions_(),
+      function_symbols_(),
+      function_externs_(),
+      function_outputs_(),
+      inlined_nodes_( 0 )
     {    
     }
 
@@ -321,6 +358,7 @@ public:
         }
     
         pop_scope();
+        shader_ = false;
         return shader;
     }
 
@@ -330,17 +368,290 @@ public:
         return shader_parser_context->shader_definition_( start, finish );
     }
     
+    /**
+    // Record a function definition so that later calls to it are inlined.
+    //
+    // Functions that return a value must return it from their last 
+    // statement and from nowhere else; conditional code is executed under
+    // a mask rather than jumped over so there is no way to return early 
+    // from some elements and not others.  The parameters, variables, and 
+    // extern declarations parsed since the last definition are the 
+    // function's and are dropped from the symbol table along with its 
+    // scope.
+    //
+    // @return
+    //  An empty list so that function definitions don't appear in the 
+    //  syntax tree; only the copies inlined at each call do.
+    */
     shared_ptr<SyntaxNode> function_definition_( const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* start, const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* finish )
     {
-        shared_ptr<SyntaxNode> function( new SyntaxNode(SHADER_NODE_FUNCTION, start[0].line(), start[1].lexeme()) );
-        shared_ptr<Symbol> symbol = symbol_table_.add_symbol( start[1].lexeme() );
-        symbol->set_type( type_from_syntax_node(start[0].user_data()) );
-        function->set_symbol( symbol );
+        const string& identifier = start[1].lexeme();
+        const int line = start[0].line();
         const shared_ptr<SyntaxNode>& formals = start[3].user_data();
-        function->add_node( formals );
         const shared_ptr<SyntaxNode>& statements = start[6].user_data();
-        function->add_node( statements );
-        return function;
+
+        Function function;
+        function.node.reset( new SyntaxNode(SHADER_NODE_FUNCTION, line, identifier) );
+        function.node->add_node( formals );
+        function.node->add_node( statements );
+        if ( start[0].user_data()->node_type() != SHADER_NODE_VOID_TYPE )
+        {
+            function.result.reset( new Symbol("return") );
+            function.result->set_type( type_from_syntax_node(start[0].user_data()) );
+            function_symbols_.push_back( function.result );
+        }
+        function.symbols.swap( function_symbols_ );
+        function.externs.swap( function_externs_ );
+
+        vector<const Symbol*> assigned;
+        find_assigned_symbols( statements.get(), &assigned );
+        bool assigns_externs = false;
+        for ( vector<shared_ptr<Symbol>>::const_iterator i = function.externs.begin(); i != function.externs.end(); ++i )
+        {
+            assigns_externs = assigns_externs || find( assigned.begin(), assigned.end(), i->get() ) != assigned.end();
+        }
+
+        const vector<shared_ptr<SyntaxNode>>& parameters = formals->nodes();
+        for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = parameters.begin(); i != parameters.end(); ++i )
+        {
+            const shared_ptr<Symbol>& parameter = (*i)->symbol();
+            REYES_ASSERT( parameter );
+            bool output = find( function_outputs_.begin(), function_outputs_.end(), parameter ) != function_outputs_.end();
+            function.parameters.push_back( parameter );
+            function.outputs.push_back( output );
+            function.substitutable.push_back( !output && !assigns_externs && find(assigned.begin(), assigned.end(), parameter.get()) == assigned.end() );
+        }
+        function_outputs_.clear();
+
+        const vector<shared_ptr<SyntaxNode>>& body = statements->nodes();
+        const int returns = count_nodes( statements.get(), SHADER_NODE_RETURN );
+        if ( !function.result && returns > 0 )
+        {
+            error( line, "Return of a value from void function '%s'", identifier.c_str() );
+        }
+        else if ( function.result && (returns != 1 || body.empty() || body.back()->node_type() != SHADER_NODE_RETURN) )
+        {
+            error( line, "Function '%s' must return a value from its last statement only", identifier.c_str() );
+        }
+        
+        if ( functions_.find(identifier) != functions_.end() )
+        {
+            error( line, "Function '%s' is already defined", identifier.c_str() );
+        }
+        functions_[identifier] = function;
+
+        // Solar and illuminate statements in the function only end up in 
+        // the shader once for each time that the function is inlined.
+        solar_and_illuminate_statements_ -= count_solar_and_illuminate_statements( statements.get() );
+
+        pop_scope();
+        symbol_table_.push_scope();
+        return shared_ptr<SyntaxNode>( new SyntaxNode(SHADER_NODE_LIST, line) );
+    }
+
+    int count_nodes( const SyntaxNode* node, SyntaxNodeType node_type ) const
+    {
+        REYES_ASSERT( node );
+        int count = node->node_type() == node_type ? 1 : 0;
+        const vector<shared_ptr<SyntaxNode>>& nodes = node->nodes();
+        for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = nodes.begin(); i != nodes.end(); ++i )
+        {
+            count += count_nodes( i->get(), node_type );
+        }
+        return count;
+    }
+
+    int count_solar_and_illuminate_statements( const SyntaxNode* node ) const
+    {
+        return count_nodes( node, SHADER_NODE_SOLAR ) + count_nodes( node, SHADER_NODE_ILLUMINATE );
+    }
+
+    /**
+    // Find the symbols that might be written by the statements at and 
+    // below a node; that is those assigned to, declared, or passed directly
+    // to a function (built-in functions that return nothing write their 
+    // arguments).
+    */
+    void find_assigned_symbols( const SyntaxNode* node, vector<const Symbol*>* assigned ) const
+    {
+        REYES_ASSERT( node );
+        REYES_ASSERT( assigned );
+
+        const SyntaxNodeType node_type = node->node_type();
+        if ( (node_type == SHADER_NODE_VARIABLE || (node_type >= SHADER_NODE_ASSIGN && node_type <= SHADER_NODE_DIVIDE_ASSIGN)) && node->symbol() )
+        {
+            assigned->push_back( node->symbol().get() );
+        }
+
+        const vector<shared_ptr<SyntaxNode>>& nodes = node->nodes();
+        for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = nodes.begin(); i != nodes.end(); ++i )
+        {
+            const SyntaxNode* child = i->get();
+            if ( node_type == SHADER_NODE_CALL && child->node_type() == SHADER_NODE_IDENTIFIER && child->symbol() )
+            {
+                assigned->push_back( child->symbol().get() );
+            }
+            find_assigned_symbols( child, assigned );
+        }
+    }
+
+    /**
+    // Replace a call to a function defined in the shader source with a 
+    // copy of the function's body.
+    //
+    // The copy gets its own copies of the function's parameters, variables,
+    // and result so that storage is inferred separately for each call and 
+    // later calls don't overwrite the values returned by earlier calls in 
+    // the same expression.  Parameters are assigned the arguments passed to
+    // them except for parameters that the function never writes that are 
+    // passed a variable; the copy reads that variable directly instead.  
+    // Output parameters are assigned back to the variables passed to them 
+    // after the body.  Returns assign to the copy of the result and the 
+    // variables that the function declares extern are bound to the 
+    // variables with the same identifiers where the function is called.
+    //
+    // @return
+    //  An inline call node with the list of statements to execute as its
+    //  first node and an identifier for the result (or a null node for void
+    //  functions) as its second.
+    */
+    shared_ptr<SyntaxNode> inline_call( const Function& function, int line, const vector<shared_ptr<SyntaxNode>>& arguments )
+    {
+        const string& identifier = function.node->lexeme();
+        if ( arguments.size() != function.parameters.size() )
+        {
+            error( line, "Wrong number of arguments in call to '%s'", identifier.c_str() );
+            shared_ptr<SyntaxNode> call( new SyntaxNode(SHADER_NODE_CALL, line, identifier) );
+            call->add_nodes_at_end( arguments.begin(), arguments.end() );
+            return call;
+        }
+
+        map<const Symbol*, shared_ptr<Symbol>> symbols;
+        for ( vector<shared_ptr<Symbol>>::const_iterator i = function.symbols.begin(); i != function.symbols.end(); ++i )
+        {
+            const Symbol* symbol = i->get();
+            shared_ptr<Symbol> copy( new Symbol(identifier + "." + symbol->identifier()) );
+            copy->set_type( symbol->type() );
+            copy->set_storage( symbol->storage() );
+            copy->set_elements( symbol->elements() );
+            symbols[symbol] = copy;
+            if ( !shader_ )
+            {
+                function_symbols_.push_back( copy );
+            }
+        }
+        for ( vector<shared_ptr<Symbol>>::const_iterator i = function.externs.begin(); i != function.externs.end(); ++i )
+        {
+            shared_ptr<Symbol> symbol = symbol_table_.find_symbol( (*i)->identifier() );
+            if ( !symbol )
+            {
+                error( line, "Unknown identifier '%s' declared extern in '%s'", (*i)->identifier().c_str(), identifier.c_str() );
+            }
+            symbols[i->get()] = symbol;
+        }
+
+        shared_ptr<SyntaxNode> statements( new SyntaxNode(SHADER_NODE_LIST, line) );
+        for ( unsigned int i = 0; i < arguments.size(); ++i )
+        {
+            const shared_ptr<SyntaxNode>& argument = arguments[i];
+            const Symbol* parameter = function.parameters[i].get();
+            if ( function.substitutable[i] && argument->node_type() == SHADER_NODE_IDENTIFIER && argument->symbol() )
+            {
+                symbols[parameter] = argument->symbol();
+            }
+            else
+            {
+                shared_ptr<SyntaxNode> variable( new SyntaxNode(SHADER_NODE_VARIABLE, line, symbols[parameter]->identifier()) );
+                variable->set_symbol( symbols[parameter] );
+                variable->add_node( argument );
+                statements->add_node( variable );
+            }
+        }
+
+        shared_ptr<SyntaxNode> result;
+        if ( function.result )
+        {
+            const shared_ptr<Symbol>& symbol = symbols[function.result.get()];
+            shared_ptr<SyntaxNode> variable( new SyntaxNode(SHADER_NODE_VARIABLE, line, symbol->identifier()) );
+            variable->set_symbol( symbol );
+            variable->add_node( shared_ptr<SyntaxNode>(new SyntaxNode(SHADER_NODE_NULL, line)) );
+            statements->add_node( variable );
+            result.reset( new SyntaxNode(SHADER_NODE_IDENTIFIER, line, symbol->identifier()) );
+            result->set_symbol( symbol );
+        }
+        else
+        {
+            result.reset( new SyntaxNode(SHADER_NODE_NULL, line) );
+        }
+
+        const int inlined_nodes = inlined_nodes_;
+        const vector<shared_ptr<SyntaxNode>>& body = function.node->node(1)->nodes();
+        for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = body.begin(); i != body.end(); ++i )
+        {
+            statements->add_node( copy_node(i->get(), symbols, result->symbol()) );
+        }
+        if ( inlined_nodes <= MAXIMUM_INLINED_NODES && inlined_nodes_ > MAXIMUM_INLINED_NODES )
+        {
+            error( line, "Inlining calls to '%s' makes the shader too large", identifier.c_str() );
+        }
+        solar_and_illuminate_statements_ += count_solar_and_illuminate_statements( statements.get() );
+
+        for ( unsigned int i = 0; i < arguments.size(); ++i )
+        {
+            if ( function.outputs[i] )
+            {
+                const shared_ptr<SyntaxNode>& argument = arguments[i];
+                if ( argument->node_type() == SHADER_NODE_IDENTIFIER && argument->symbol() )
+                {
+                    const shared_ptr<Symbol>& parameter = symbols[function.parameters[i].get()];
+                    shared_ptr<SyntaxNode> value( new SyntaxNode(SHADER_NODE_IDENTIFIER, line, parameter->identifier()) );
+                    value->set_symbol( parameter );
+                    shared_ptr<SyntaxNode> assign( new SyntaxNode(SHADER_NODE_ASSIGN, line, argument->lexeme()) );
+                    assign->set_symbol( argument->symbol() );
+                    assign->add_node( value );
+                    statements->add_node( assign );
+                }
+                else
+                {
+                    error( line, "Output argument %d in call to '%s' isn't a variable", i + 1, identifier.c_str() );
+                }
+            }
+        }
+
+        shared_ptr<SyntaxNode> inline_call( new SyntaxNode(SHADER_NODE_INLINE_CALL, line, identifier) );
+        inline_call->add_node( statements );
+        inline_call->add_node( result );
+        return inline_call;
+    }
+
+    /**
+    // Copy the syntax tree at a node for inlining, replacing the symbols 
+    // found in \e symbols and returns with assignments to \e result.
+    */
+    shared_ptr<SyntaxNode> copy_node( const SyntaxNode* node, const map<const Symbol*, shared_ptr<Symbol>>& symbols, const shared_ptr<Symbol>& result )
+    {
+        REYES_ASSERT( node );
+
+        shared_ptr<SyntaxNode> copy;
+        if ( node->node_type() == SHADER_NODE_RETURN && result )
+        {
+            copy.reset( new SyntaxNode(SHADER_NODE_ASSIGN, node->line(), result->identifier()) );
+            copy->set_symbol( result );
+        }
+        else
+        {
+            copy.reset( new SyntaxNode(node->node_type(), node->line(), node->lexeme()) );
+            map<const Symbol*, shared_ptr<Symbol>>::const_iterator symbol = symbols.find( node->symbol().get() );
+            copy->set_symbol( symbol != symbols.end() ? symbol->second : node->symbol() );
+        }
+        ++inlined_nodes_;
+
+        const vector<shared_ptr<SyntaxNode>>& nodes = node->nodes();
+        for ( vector<shared_ptr<SyntaxNode>>::const_iterator i = nodes.begin(); i != nodes.end(); ++i )
+        {
+            copy->add_node( copy_node(i->get(), symbols, result) );
+        }
+        return copy;
     }
     
     static shared_ptr<SyntaxNode> add_to_list( const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* start, const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* finish )
@@ -381,8 +692,12 @@ public:
     
     shared_ptr<SyntaxNode> formal_( const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* start, const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* finish )
     {       
-        ValueStorage storage = storage_from_syntax_node( start[1].user_data(), STORAGE_UNIFORM );
+        // Shader parameters default to uniform; the storage of function 
+        // parameters without 'uniform' or 'varying' is inferred separately
+        // for each call from the arguments passed to them.
+        ValueStorage storage = storage_from_syntax_node( start[1].user_data(), shader_ ? STORAGE_UNIFORM : STORAGE_NULL );
         ValueType type = type_from_syntax_node( start[2].user_data() );
+        bool output = start[0].user_data()->node_type() == SHADER_NODE_OUTPUT;
         
         const vector<shared_ptr<SyntaxNode> >& nodes = start[3].user_data()->nodes();
         for ( vector<shared_ptr<SyntaxNode> >::const_iterator i = nodes.begin(); i != nodes.end(); ++i )
@@ -394,6 +709,14 @@ public:
             symbol->set_type( type );
             symbol->set_storage( storage );
             variable_node->set_symbol( symbol );
+            if ( !shader_ )
+            {
+                function_symbols_.push_back( symbol );
+                if ( output )
+                {
+                    function_outputs_.push_back( symbol );
+                }
+            }
         }
         
         shared_ptr<SyntaxNode> variable( new SyntaxNode(SHADER_NODE_LIST, start[0].line()) );
@@ -403,10 +726,37 @@ public:
 
     shared_ptr<SyntaxNode> variable_definition_( const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* start, const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* finish )
     {
-        ValueStorage storage = storage_from_syntax_node( start[1].user_data(), STORAGE_VARYING );
+        // Variables declared without 'uniform' or 'varying' are left with 
+        // null storage so that SemanticAnalyzer infers their storage.
+        ValueStorage storage = storage_from_syntax_node( start[1].user_data(), STORAGE_NULL );
         ValueType type = type_from_syntax_node( start[2].user_data() );
         
+        // Extern declarations don't declare variables; in a shader the 
+        // variable is already in scope and in a function the symbol added 
+        // here stands in for the variable in scope where the function is 
+        // called (see inline_call()).
         const vector<shared_ptr<SyntaxNode> >& nodes = start[3].user_data()->nodes();
+        if ( start[0].user_data()->node_type() == SHADER_NODE_EXTERN )
+        {
+            for ( vector<shared_ptr<SyntaxNode> >::const_iterator i = nodes.begin(); i != nodes.end(); ++i )
+            {
+                const SyntaxNode* variable_node = i->get();
+                REYES_ASSERT( variable_node );
+                if ( shader_ )
+                {
+                    find_symbol( variable_node->lexeme() );
+                }
+                else
+                {
+                    shared_ptr<Symbol> symbol = symbol_table_.add_symbol( variable_node->lexeme() );
+                    symbol->set_type( type );
+                    symbol->set_storage( storage );
+                    function_externs_.push_back( symbol );
+                }
+            }
+            return shared_ptr<SyntaxNode>( new SyntaxNode(SHADER_NODE_LIST, start[0].line()) );
+        }
+
         for ( vector<shared_ptr<SyntaxNode> >::const_iterator i = nodes.begin(); i != nodes.end(); ++i )
         {
             SyntaxNode* variable_node = i->get();
@@ -416,6 +766,10 @@ public:
             symbol->set_type( type );
             symbol->set_storage( storage );
             variable_node->set_symbol( symbol );
+            if ( !shader_ )
+            {
+                function_symbols_.push_back( symbol );
+            }
         }
         
         shared_ptr<SyntaxNode> variable( new SyntaxNode(SHADER_NODE_LIST, start[0].line()) );
@@ -442,6 +796,7 @@ public:
     shared_ptr<SyntaxNode> light_shader( const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* start, const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* finish )
     {
         push_light_scope();       
+        shader_ = true;
         shared_ptr<SyntaxNode> light_shader( new SyntaxNode(SHADER_NODE_LIGHT_SHADER, start[0].line()) );
         return light_shader;
     }
@@ -449,6 +804,7 @@ public:
     shared_ptr<SyntaxNode> surface_shader( const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* start, const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* finish )
     {
         push_surface_scope();
+        shader_ = true;
         shared_ptr<SyntaxNode> surface_shader( new SyntaxNode(SHADER_NODE_SURFACE_SHADER, start[0].line()) );
         return surface_shader;
     }
@@ -456,6 +812,7 @@ public:
     shared_ptr<SyntaxNode> volume_shader( const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* start, const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* finish )
     {
         push_volume_scope();
+        shader_ = true;
         shared_ptr<SyntaxNode> volume_shader( new SyntaxNode(SHADER_NODE_VOLUME_SHADER, start[0].line()) );
         return volume_shader;
     }
@@ -463,6 +820,7 @@ public:
     shared_ptr<SyntaxNode> displacement_shader( const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* start, const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* finish )
     {
         push_displacement_scope();
+        shader_ = true;
         shared_ptr<SyntaxNode> displacement_shader( new SyntaxNode(SHADER_NODE_DISPLACEMENT_SHADER, start[0].line()) );
         return displacement_shader;
     }
@@ -470,6 +828,7 @@ public:
     shared_ptr<SyntaxNode> imager_shader( const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* start, const lalr::ParserNode<shared_ptr<SyntaxNode>, char>* finish )
     {
         push_imager_scope();
+        shader_ = true;
         shared_ptr<SyntaxNode> imager_shader( new SyntaxNode(SHADER_NODE_IMAGER_SHADER, start[0].line()) );
         return imager_shader;
     }
@@ -1095,6 +1454,12 @@ public:
         REYES_ASSERT( expressions );
         REYES_ASSERT( expressions->node_type() == SHADER_NODE_LIST );
     
+        typename map<string, Function>::const_iterator function = functions_.find( start[0].lexeme() );
+        if ( function != functions_.end() )
+        {
+            return inline_call( function->second, start[0].line(), expressions->nodes() );
+        }
+    
         shared_ptr<SyntaxNode> call( new SyntaxNode(SHADER_NODE_CALL, start[0].line(), start[0].lexeme()) );
         call->add_nodes_at_end( expressions->nodes().begin(), expressions->nodes().end() );
         return call;
@@ -1232,9 +1597,13 @@ public:
             ( "shadow_expression", bind(&ShaderParserContext::shadow_expression_, this, _1, _2) )
         ;
 
+        // Each function definition gets a scope of its own for its 
+        // parameters and variables (see function_definition_()).
         errors_ = 0;
         parser_ = &parser;
+        symbol_table_.push_scope();
         parser.parse( lalr::PositionIterator<Iterator>(start, finish), lalr::PositionIterator<Iterator>() );
+        symbol_table_.pop_scope();
         shared_ptr<SyntaxNode> syntax_node;
         if ( parser.accepted() && parser.full() && errors_ == 0 )
         {
@@ -1246,12 +1615,30 @@ public:
         }
         return syntax_node;
     }
+
+    int solar_and_illuminate_statements() const
+    {
+        return solar_and_illuminate_statements_;
+    }
 };
 
 ShaderParser::ShaderParser( SymbolTable& symbol_table, ErrorPolicy* error_policy )
 : symbol_table_( symbol_table ),
-  error_policy_( error_policy )
+  error_policy_( error_policy ),
+  solar_and_illuminate_statements_( 0 )
+{
+}
+
+/**
+// Get the number of solar and illuminate statements in the shader parsed 
+// by the most recent call to parse().
+//
+// Statements in functions are counted once for each call that the function
+// is inlined at.
+*/
+int ShaderParser::solar_and_illuminate_statements() const
 {
+    return solar_and_illuminate_statements_;
 }
 
 shared_ptr<SyntaxNode> ShaderParser::parse( const char* filename )
@@ -1266,6 +1653,7 @@ shared_ptr<SyntaxNode> ShaderParser::parse( const char* filename )
         stream.exceptions( std::iostream::badbit );        
         ShaderParserContext<istream_iterator<char>> shader_parser_context( symbol_table_, error_policy_ );
         syntax_node = shader_parser_context.parse( istream_iterator<char>(stream), istream_iterator<char>(), filename );
+        solar_and_illuminate_statements_ = shader_parser_context.solar_and_illuminate_statements();
     }
     else if ( error_policy_ )
     {
@@ -1281,5 +1669,7 @@ shared_ptr<SyntaxNode> ShaderParser::parse( const char* start, const char* finis
     REYES_ASSERT( start <= finish );
 
     ShaderParserContext<const char*> shader_parser_context( symbol_table_, error_policy_ );
-    return shader_parser_context.parse( start, finish, "from memory" );
+    shared_ptr<SyntaxNode> syntax_node = shader_parser_context.parse( start, finish, "from memory" );
+    solar_and_illuminate_statements_ = shader_parser_context.solar_and_illuminate_statements();
+    return syntax_node;
 }
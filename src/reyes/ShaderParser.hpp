@@ -18,11 +18,13 @@ class ShaderParser
 {
     SymbolTable& symbol_table_; ///< The symbol table to use when parsing (preloaded with functions and variables).
     ErrorPolicy* error_policy_; ///< The error policy to report errors to.
+    int solar_and_illuminate_statements_; ///< The number of solar and illuminate statements in the most recently parsed shader.
 
 public:
     ShaderParser( SymbolTable& symbol_table, ErrorPolicy* error_policy = 0 );
     std::shared_ptr<SyntaxNode> parse( const char* filename );
     std::shared_ptr<SyntaxNode> parse( const char* begin, const char* end );
+    int solar_and_illuminate_statements() const;
 };
 
 }
@@ -0,0 +1,40 @@
+//
+// SourceLine.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "SourceLine.hpp"
+#include <algorithm>
+
+using std::upper_bound;
+using std::vector;
+
+namespace reyes
+{
+
+static bool before( int address, const SourceLine& source_line )
+{
+    return address < source_line.address;
+}
+
+/**
+// Find the line of shader source that the instruction at an address was
+// generated for.
+//
+// @param lines
+//  The source lines to search sorted by address.
+//
+// @param address
+//  The address of the instruction.
+//
+// @return
+//  The line or 0 if no line is known for \e address.
+*/
+int source_line( const std::vector<SourceLine>& lines, int address )
+{
+    vector<SourceLine>::const_iterator i = upper_bound( lines.begin(), lines.end(), address, &before );
+    return i != lines.begin() ? (i - 1)->line : 0;
+}
+
+}
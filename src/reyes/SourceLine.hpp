@@ -0,0 +1,29 @@
+#ifndef REYES_SOURCELINE_HPP_INCLUDED
+#define REYES_SOURCELINE_HPP_INCLUDED
+
+#include <vector>
+
+namespace reyes
+{
+
+/**
+// The line of shader source that byte code was generated for from an 
+// address on.
+//
+// The code generator records one of these wherever the line changes and 
+// the optimizer and decoder carry them through to the instructions that 
+// the virtual machine executes so that the cost of executing those 
+// instructions can be reported against the source that they came from 
+// (see Profile).
+*/
+struct SourceLine
+{
+    int address; ///< The address of the first instruction generated for the line.
+    int line; ///< The line in the shader source (or 0 if not known).
+};
+
+int source_line( const std::vector<SourceLine>& lines, int address );
+
+}
+
+#endif
@@ -19,6 +19,7 @@ Symbol::Symbol()
   register_index_( 0 ),
   value_( 0.0f ),
   function_( NULL ),
+  writes_arguments_( false ),
   parameters_()
 {
 }
@@ -32,6 +33,7 @@ Symbol::Symbol( const std::string& identifier )
   register_index_( 0 ),
   value_( 0.0f ),
   function_( NULL ),
+  writes_arguments_( false ),
   parameters_()
 {
 }
@@ -76,6 +78,11 @@ void* Symbol::function() const
     return function_;
 }
 
+bool Symbol::writes_arguments() const
+{
+    return writes_arguments_;
+}
+
 bool Symbol::operator<( const Symbol& symbol ) const
 {
     return identifier_ < symbol.identifier_;
@@ -157,6 +164,11 @@ void Symbol::set_function( void* function )
     function_ = function;
 }
 
+void Symbol::set_writes_arguments( bool writes_arguments )
+{
+    writes_arguments_ = writes_arguments;
+}
+
 void Symbol::add_parameter( ValueType type, ValueStorage storage )
 {
     parameters_.push_back( SymbolParameter(type, storage) );
@@ -23,6 +23,7 @@ class Symbol
     int register_index_; ///< The register index of the symbol in the registers assigned to a shader.
     float value_; ///< The floating point value of this symbol.
     void* function_; ///< The function value of this symbol (or null if this symbol isn't a function).
+    bool writes_arguments_; ///< True if the function writes to output arguments passed after its input arguments.
     std::vector<SymbolParameter> parameters_; ///< The parameter types of this symbol.
     
 public:
@@ -37,6 +38,7 @@ public:
     int register_index() const;
     float value() const;
     void* function() const;
+    bool writes_arguments() const;
     bool operator<( const Symbol& symbol ) const;
     bool matches_return( ValueType type, ValueStorage storage ) const;
 
@@ -47,6 +49,7 @@ public:
     void set_register_index( int register_index );
     void set_value( float value );
     void set_function( void* function );
+    void set_writes_arguments( bool writes_arguments );
     
     void add_parameter( ValueType type, ValueStorage storage );
     const std::vector<SymbolParameter>& parameters() const;
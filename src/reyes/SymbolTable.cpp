@@ -315,6 +315,26 @@ SymbolTable::SymbolTable()
     ;
 }
 
+/**
+// Construct a SymbolTable for compiling a shader on another thread.
+//
+// Only the outermost scope of built-in functions and constants is shared 
+// with \e symbol_table.  Parameters and variables are added to scopes that
+// belong to this SymbolTable so that shaders compiled concurrently don't 
+// see or modify each other's symbols.
+//
+// @param symbol_table
+//  The SymbolTable to share built-in functions and constants with (assumed
+//  not null and not being modified while this SymbolTable is constructed).
+*/
+SymbolTable::SymbolTable( const SymbolTable* symbol_table )
+: symbols_()
+{
+    REYES_ASSERT( symbol_table );
+    REYES_ASSERT( !symbol_table->symbols_.empty() );
+    symbols_.push_back( symbol_table->symbols_.front() );
+}
+
 AddSymbolHelper SymbolTable::add_symbols()
 {
     return AddSymbolHelper( this );
@@ -390,6 +410,35 @@ std::shared_ptr<Symbol> SymbolTable::find_symbol( const SyntaxNode* node ) const
     return i != symbols_.rend() && j != i->end() && j->first == node->lexeme() ? j->second : shared_ptr<Symbol>();
 }
 
+/**
+// Find all of the overloads of \e identifier.
+//
+// @param identifier
+//  The identifier to find the overloads of.
+//
+// @return
+//  The symbols defined for \e identifier in the innermost scope that defines
+//  it or an empty vector if \e identifier isn't defined.
+*/
+std::vector<std::shared_ptr<Symbol>> SymbolTable::find_symbols( const std::string& identifier ) const
+{
+    REYES_ASSERT( !symbols_.empty() );
+
+    vector<shared_ptr<Symbol>> symbols;
+    list<multimap<string, shared_ptr<Symbol>>>::const_reverse_iterator i = symbols_.rbegin();
+    while ( i != symbols_.rend() && symbols.empty() )
+    {
+        multimap<string, shared_ptr<Symbol>>::const_iterator j = i->lower_bound( identifier );
+        while ( j != i->end() && j->first == identifier )
+        {
+            symbols.push_back( j->second );
+            ++j;
+        }
+        ++i;
+    }
+    return symbols;
+}
+
 bool SymbolTable::matches( const std::shared_ptr<Symbol>& symbol, const SyntaxNode* node, const std::vector<std::shared_ptr<SyntaxNode>>& node_parameters )
 {
     REYES_ASSERT( symbol );
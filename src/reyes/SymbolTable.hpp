@@ -5,6 +5,7 @@
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 #include <memory>
 
 namespace reyes
@@ -24,12 +25,14 @@ class SymbolTable
 
 public:
     SymbolTable();
+    explicit SymbolTable( const SymbolTable* symbol_table );
     AddSymbolHelper add_symbols();
     void push_scope();
     void pop_scope();    
     std::shared_ptr<Symbol> add_symbol( const std::string& identifier );
     std::shared_ptr<Symbol> find_symbol( const std::string& identifier ) const;
     std::shared_ptr<Symbol> find_symbol( const SyntaxNode* node ) const;
+    std::vector<std::shared_ptr<Symbol>> find_symbols( const std::string& identifier ) const;
     static bool matches( const std::shared_ptr<Symbol>& symbol, const SyntaxNode* node, const std::vector<std::shared_ptr<SyntaxNode>>& node_parameters );
 };
 
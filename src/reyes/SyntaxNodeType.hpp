@@ -29,6 +29,7 @@ enum SyntaxNodeType
     SHADER_NODE_VARIABLE,
     SHADER_NODE_TYPE,
     SHADER_NODE_CALL,
+    SHADER_NODE_INLINE_CALL,
     SHADER_NODE_RETURN,
     SHADER_NODE_BREAK,
     SHADER_NODE_CONTINUE,
@@ -9,6 +9,7 @@
 #include "Texture.hpp"
 #include "Grid.hpp"
 #include "Light.hpp"
+#include "Identifier.hpp"
 #include <math/vec2.ipp>
 #include <math/vec3.ipp>
 #include <math/vec4.ipp>
@@ -18,38 +19,151 @@
 #include "assert.hpp"
 #include <math.h>
 #include <memory.h>
+#include <mutex>
 
 using std::min;
 using std::max;
 using std::vector;
+using std::mutex;
+using std::lock_guard;
 using namespace math;
 using namespace reyes;
 
-// @todo
-//  Make sure that MAXIMUM_VERTICES_PER_GRID in Value.cpp is unified with the
-//  same variable in Renderer.
-static const int MAXIMUM_VERTICES_PER_GRID = 64 * 64;
+static const unsigned int SMALLEST_POOLED_BUFFER = 256;
+static const int POOLED_BUFFER_SIZE_CLASSES = 24;
+static const unsigned int MAXIMUM_FREE_BUFFERS_PER_SIZE_CLASS = 64;
+
+/**
+// Buffers released by values that are kept for reuse by later values.
+*/
+struct ValueBufferPool
+{
+    mutex mutex_; ///< Guards access to the free lists.
+    vector<void*> free_buffers_[POOLED_BUFFER_SIZE_CLASSES]; ///< The free buffers in each size class.
+};
+
+/**
+// Get the pool of value buffers.
+//
+// The pool is deliberately never destroyed so that values destroyed during
+// static destruction can still release their buffers to it.
+//
+// @return
+//  The pool of value buffers.
+*/
+static ValueBufferPool& value_buffer_pool()
+{
+    static ValueBufferPool* pool = new ValueBufferPool;
+    return *pool;
+}
+
+/**
+// Find the smallest size class whose buffers hold at least \e bytes.
+//
+// @param bytes
+//  The number of bytes required.
+//
+// @return
+//  The index of the size class.
+*/
+static int size_class( unsigned int bytes )
+{
+    int size_class = 0;
+    unsigned int buffer_size = SMALLEST_POOLED_BUFFER;
+    while ( buffer_size < bytes )
+    {
+        buffer_size <<= 1;
+        ++size_class;
+    }
+    REYES_ASSERT( size_class < POOLED_BUFFER_SIZE_CLASSES );
+    return size_class;
+}
+
+/**
+// Acquire a buffer of at least \e bytes from the pool, allocating a new one
+// if there are no free buffers of the right size class.
+//
+// @param bytes
+//  The number of bytes required.
+//
+// @param buffer_size
+//  Set to the actual size of the returned buffer (in bytes).
+//
+// @return
+//  The buffer.
+*/
+static void* acquire_buffer( unsigned int bytes, unsigned int* buffer_size )
+{
+    REYES_ASSERT( buffer_size );
+    const int index = size_class( bytes );
+    *buffer_size = SMALLEST_POOLED_BUFFER << index;
+    ValueBufferPool& pool = value_buffer_pool();
+    {
+        lock_guard<mutex> lock( pool.mutex_ );
+        vector<void*>& free_buffers = pool.free_buffers_[index];
+        if ( !free_buffers.empty() )
+        {
+            void* buffer = free_buffers.back();
+            free_buffers.pop_back();
+            return buffer;
+        }
+    }
+    return malloc( *buffer_size );
+}
+
+/**
+// Release a buffer acquired with acquire_buffer() back to the pool or free
+// it if its size class already holds enough free buffers.
+//
+// @param buffer
+//  The buffer to release (assumed not null).
+//
+// @param buffer_size
+//  The size of the buffer as returned from acquire_buffer().
+*/
+static void release_buffer( void* buffer, unsigned int buffer_size )
+{
+    REYES_ASSERT( buffer );
+    const int index = size_class( buffer_size );
+    ValueBufferPool& pool = value_buffer_pool();
+    {
+        lock_guard<mutex> lock( pool.mutex_ );
+        vector<void*>& free_buffers = pool.free_buffers_[index];
+        if ( free_buffers.size() < MAXIMUM_FREE_BUFFERS_PER_SIZE_CLASS )
+        {
+            free_buffers.push_back( buffer );
+            return;
+        }
+    }
+    free( buffer );
+}
 
 Value::Value()
 : type_( TYPE_NULL ),
   storage_( STORAGE_NULL ),
   string_value_(),
-  values_( NULL ),
+  string_identifier_( -1 ),
+  values_( inline_values_ ),
   size_( 0 ),
-  capacity_( 0 )
+  capacity_( 0 ),
+  buffer_size_( sizeof(inline_values_) ),
+  owns_values_( false ),
+  inline_values_()
 {
-    allocate();
 }
 
 Value::Value( const Value& value )
 : type_( value.type_ ),
   storage_( value.storage_ ),
   string_value_( value.string_value_ ),
-  values_( NULL ),
+  string_identifier_( value.string_identifier_ ),
+  values_( inline_values_ ),
   size_( 0 ),
-  capacity_( 0 )
+  capacity_( 0 ),
+  buffer_size_( sizeof(inline_values_) ),
+  owns_values_( false ),
+  inline_values_()
 {
-    allocate();
     if ( value.capacity_ > 0 )
     {
         reserve( value.capacity_ );
@@ -65,6 +179,8 @@ Value& Value::operator=( const Value& value )
         type_ = value.type_;
         storage_ = value.storage_;
         string_value_ = value.string_value_;
+        string_identifier_ = value.string_identifier_;
+        allocate( buffer_bytes(value.capacity_) );
         size_ = value.size_;
         capacity_ = value.capacity_;
         memcpy( values_, value.values_, size_ * element_size() );
@@ -76,32 +192,67 @@ Value::Value( ValueType type, ValueStorage storage )
 : type_( type ),
   storage_( storage ),
   string_value_(),
-  values_( NULL ),
+  string_identifier_( -1 ),
+  values_( inline_values_ ),
   size_( 0 ),
-  capacity_( 0 )
+  capacity_( 0 ),
+  buffer_size_( sizeof(inline_values_) ),
+  owns_values_( false ),
+  inline_values_()
 {
-    allocate();
 }
 
 Value::Value( ValueType type, ValueStorage storage, unsigned int capacity )
 : type_( type ),
   storage_( storage ),
   string_value_(),
-  values_( NULL ),
+  string_identifier_( -1 ),
+  values_( inline_values_ ),
   size_( 0 ),
-  capacity_( 0 )
+  capacity_( 0 ),
+  buffer_size_( sizeof(inline_values_) ),
+  owns_values_( false ),
+  inline_values_()
 {
-    allocate();
     reserve( capacity );
-    size_ = capacity;
+}
+
+/**
+// Construct a value that stores its values in a buffer owned elsewhere.
+//
+// The VirtualMachine uses this to lay its temporary registers out in a 
+// single contiguous block of memory.  A value that outgrows the buffer 
+// moves to a pooled buffer of its own.
+//
+// @param values
+//  The buffer to store values in (assumed not null).
+//
+// @param buffer_size
+//  The size of the buffer (in bytes).
+*/
+Value::Value( void* values, unsigned int buffer_size )
+: type_( TYPE_NULL ),
+  storage_( STORAGE_NULL ),
+  string_value_(),
+  string_identifier_( -1 ),
+  values_( values ),
+  size_( 0 ),
+  capacity_( 0 ),
+  buffer_size_( buffer_size ),
+  owns_values_( false ),
+  inline_values_()
+{
+    REYES_ASSERT( values_ );
 }
 
 Value::~Value()
 {
-    if ( values_ )
+    if ( owns_values_ )
     {
-        free( values_ );
+        release_buffer( values_, buffer_size_ );
         values_ = NULL;
+        buffer_size_ = 0;
+        owns_values_ = false;
     }
 }
 
@@ -161,6 +312,7 @@ Value& Value::operator=( const char* value )
     REYES_ASSERT( value );
     reset( TYPE_STRING, STORAGE_UNIFORM, 1 );
     string_value_ = value;
+    string_identifier_ = !string_value_.empty() ? intern_identifier( string_value_ ) : -1;
     return *this;
 }
 
@@ -233,14 +385,23 @@ void Value::zero()
     size_ = capacity_;
 }
 
+/**
+// Clear this value so that it can be reused for another value.
+//
+// The buffer is kept so that a cleared value reset to a similar size 
+// doesn't allocate (see Grid::clear()).
+*/
 void Value::clear()
 {
+    string_value_.clear();
+    string_identifier_ = -1;
     size_ = 0;
     capacity_ = 0;
 }
 
 void Value::reserve( unsigned int capacity )
 {
+    allocate( buffer_bytes(capacity) );
     capacity_ = capacity;
     size_ = capacity;
 }
@@ -249,6 +410,7 @@ void Value::reset( ValueType type, ValueStorage storage, unsigned int capacity )
 {
     type_ = type;
     storage_ = storage;    
+    allocate( buffer_bytes(capacity) );
     capacity_ = capacity;
     size_ = capacity;
 }
@@ -262,6 +424,7 @@ void Value::set_string( const std::string& value )
 {
     reset( TYPE_STRING, STORAGE_UNIFORM, 1 );
     string_value_ = value;
+    string_identifier_ = !string_value_.empty() ? intern_identifier( string_value_ ) : -1;
 }
 
 const std::string& Value::string_value() const
@@ -270,6 +433,23 @@ const std::string& Value::string_value() const
     return string_value_;
 }
 
+/**
+// Get the interned identifier of this value's string.
+//
+// Strings are interned when they are set, typically when a shader is 
+// compiled, so that named coordinate systems can be looked up by interned
+// identifier while shading.
+//
+// @return
+//  The interned identifier of this value's string or -1 if the string is
+//  empty.
+*/
+int Value::string_identifier() const
+{
+    REYES_ASSERT( type_ == TYPE_STRING );
+    return string_identifier_;
+}
+
 const math::mat4x4& Value::mat4x4_value() const
 {
     REYES_ASSERT( storage_ == STORAGE_UNIFORM );
@@ -319,7 +499,7 @@ math::vec3 Value::vec3_value() const
 //
 // This is used to calculate "L" in a light shader's illuminate statement.
 */
-void Value::light_to_surface_vector( std::shared_ptr<Value> position, const math::vec3& light_position )
+void Value::light_to_surface_vector( const Value* position, const math::vec3& light_position )
 {
     REYES_ASSERT( position );
     REYES_ASSERT( position->storage() == STORAGE_VARYING );
@@ -343,7 +523,7 @@ void Value::light_to_surface_vector( std::shared_ptr<Value> position, const math
 // This is used to calculate "L" in a surface shader's illuminance statement 
 // from the surface position and the currently active light.
 */
-void Value::surface_to_light_vector( std::shared_ptr<Value> position, const Light* light )
+void Value::surface_to_light_vector( const Value* position, const Light* light )
 {
     REYES_ASSERT( position );
     REYES_ASSERT( position->storage() == STORAGE_VARYING );
@@ -366,7 +546,7 @@ void Value::surface_to_light_vector( std::shared_ptr<Value> position, const Ligh
 // Calculate a mask based on the axis and angle passed to an illuminance 
 // statement and the light from \e light.
 */
-void Value::illuminance_axis_angle( std::shared_ptr<Value> position, std::shared_ptr<Value> axis, std::shared_ptr<Value> angle, const Light* light )
+void Value::illuminance_axis_angle( const Value* position, const Value* axis, const Value* angle, const Light* light )
 {
     REYES_ASSERT( position );
     REYES_ASSERT( position->storage() == STORAGE_VARYING );
@@ -411,7 +591,7 @@ void Value::illuminance_axis_angle( std::shared_ptr<Value> position, std::shared
     }        
 }
 
-void Value::assign_string( std::shared_ptr<Value> value, const unsigned char* mask )
+void Value::assign_string( const Value* value, const unsigned char* mask )
 {
     REYES_ASSERT( value );
     REYES_ASSERT( value->storage() != STORAGE_VARYING );
@@ -419,10 +599,50 @@ void Value::assign_string( std::shared_ptr<Value> value, const unsigned char* ma
 
     reset( value->type(), value->storage(), value->size() );               
     string_value_ = value->string_value_;
+    string_identifier_ = value->string_identifier_;
 }
 
-void Value::allocate()
+/**
+// Calculate the number of bytes needed to store \e capacity elements of 
+// this value's type.
+//
+// Values whose type isn't known yet are sized as if they stored vectors.
+//
+// @param capacity
+//  The number of elements to store.
+//
+// @return
+//  The number of bytes needed.
+*/
+unsigned int Value::buffer_bytes( unsigned int capacity ) const
 {
-    REYES_ASSERT( !values_ );
-    values_ = malloc( sizeof(vec3) * MAXIMUM_VERTICES_PER_GRID );
+    return capacity * (type_ != TYPE_NULL ? element_size() : sizeof(vec3));
+}
+
+/**
+// Make sure that this value's buffer holds at least \e bytes.
+//
+// A larger buffer is acquired from the pool when the current one is too 
+// small; the contents of the current buffer are preserved and it is 
+// released back to the pool if it came from there.  Buffers never shrink so 
+// a value reused across grids of similar size stops allocating.
+//
+// @param bytes
+//  The number of bytes required.
+*/
+void Value::allocate( unsigned int bytes )
+{
+    if ( bytes > buffer_size_ )
+    {
+        unsigned int buffer_size = 0;
+        void* values = acquire_buffer( bytes, &buffer_size );
+        memcpy( values, values_, buffer_size_ );
+        if ( owns_values_ )
+        {
+            release_buffer( values_, buffer_size_ );
+        }
+        values_ = values;
+        buffer_size_ = buffer_size;
+        owns_values_ = true;
+    }
 }
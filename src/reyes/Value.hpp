@@ -22,15 +22,24 @@ class Renderer;
 /**
 // A value stored by the renderer for a shader parameter or a varying variable
 // used in a diced grid of micropolygon vertices.
+//
+// Values small enough to fit (up to a single matrix) are stored inline so 
+// that uniform values never allocate.  Larger values are stored in buffers
+// sized to their capacity and drawn from a pool of power of two size 
+// classes so that buffers released by one grid are reused by the next.
 */
 class Value
 {
     ValueType type_; ///< The type stored in this value.
     ValueStorage storage_; ///< The storage of this value.
     std::string string_value_; ///< The string value of this value.
+    int string_identifier_; ///< The interned identifier of the string value of this value or -1 if it is empty (see Identifier).
     void* values_; ///< A pointer to the buffer of floating point values that this value can use.
     unsigned int size_; ///< The number of values stored in this value.
     unsigned int capacity_; ///< The capacity of this value.
+    unsigned int buffer_size_; ///< The size of the buffer pointed to by values_ (in bytes).
+    bool owns_values_; ///< True if this value acquired its buffer from the pool (and releases it) or false if the buffer is inline or owned elsewhere.
+    float inline_values_[16]; ///< The inline buffer used for values no larger than a matrix.
 
 public:
     Value();
@@ -38,6 +47,7 @@ public:
     Value& operator=( const Value& value );
     Value( ValueType type, ValueStorage storage );
     Value( ValueType type, ValueStorage storage, unsigned int capacity );
+    Value( void* values, unsigned int buffer_size );
     ~Value();
     
     Value& operator=( float value );
@@ -61,6 +71,7 @@ public:
     bool empty() const;
     void set_string( const std::string& value );
     const std::string& string_value() const;
+    int string_identifier() const;
     const math::mat4x4& mat4x4_value() const;
     int* int_values() const;
     float* float_values() const;
@@ -69,13 +80,14 @@ public:
     float float_value() const;
     math::vec3 vec3_value() const;
     
-    void light_to_surface_vector( std::shared_ptr<Value> position, const math::vec3& light_position );
-    void surface_to_light_vector( std::shared_ptr<Value> position, const Light* light );
-    void illuminance_axis_angle( std::shared_ptr<Value> position, std::shared_ptr<Value> axis, std::shared_ptr<Value> angle, const Light* light );
-    void assign_string( std::shared_ptr<Value> value, const unsigned char* mask );
+    void light_to_surface_vector( const Value* position, const math::vec3& light_position );
+    void surface_to_light_vector( const Value* position, const Light* light );
+    void illuminance_axis_angle( const Value* position, const Value* axis, const Value* angle, const Light* light );
+    void assign_string( const Value* value, const unsigned char* mask );
     
 private:
-    void allocate();
+    unsigned int buffer_bytes( unsigned int capacity ) const;
+    void allocate( unsigned int bytes );
 };
 
 }
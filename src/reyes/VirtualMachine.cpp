@@ -12,20 +12,12 @@
 #include "Texture.hpp"
 #include "Grid.hpp"
 #include "Light.hpp"
+#include "Profile.hpp"
 #include <reyes/reyes_virtual_machine/Instruction.hpp>
+#include <reyes/reyes_virtual_machine/DecodedInstruction.hpp>
 #include <reyes/reyes_virtual_machine/color_functions.hpp>
-#include <reyes/reyes_virtual_machine/add.hpp>
-#include <reyes/reyes_virtual_machine/subtract.hpp>
-#include <reyes/reyes_virtual_machine/multiply.hpp>
-#include <reyes/reyes_virtual_machine/divide.hpp>
+#include <reyes/reyes_virtual_machine/multiply_add.hpp>
 #include <reyes/reyes_virtual_machine/dot.hpp>
-#include <reyes/reyes_virtual_machine/negate.hpp>
-#include <reyes/reyes_virtual_machine/equal.hpp>
-#include <reyes/reyes_virtual_machine/not_equal.hpp>
-#include <reyes/reyes_virtual_machine/greater.hpp>
-#include <reyes/reyes_virtual_machine/greater_equal.hpp>
-#include <reyes/reyes_virtual_machine/less.hpp>
-#include <reyes/reyes_virtual_machine/less_equal.hpp>
 #include <reyes/reyes_virtual_machine/logical_and.hpp>
 #include <reyes/reyes_virtual_machine/logical_or.hpp>
 #include <reyes/reyes_virtual_machine/assign.hpp>
@@ -47,30 +39,180 @@
 #include <math/mat4x4.ipp>
 #include "assert.hpp"
 #include <algorithm>
+#include <chrono>
 #include <limits.h>
+#include <stdint.h>
 
 using std::max;
 using std::swap;
 using std::make_pair;
-using std::map;
 using std::string;
 using std::vector;
 using std::shared_ptr;
 using namespace math;
 using namespace reyes;
 
+/**
+// Get the number of floats between consecutive elements of an operand 
+// described by one half of a dispatch code.
+//
+// @return
+//  The number of floats in each element if the operand is varying or 0 if
+//  the operand is uniform (and the same element is used for every element
+//  of the result).
+*/
+static unsigned int dispatch_stride( int dispatch )
+{
+    return (dispatch & DISPATCH_VARYING) ? (dispatch & 0x0f) + 1 : 0;
+}
+
+/**
+// Get the number of floats in each element of an operand described by one
+// half of a dispatch code.
+*/
+static unsigned int dispatch_width( int dispatch )
+{
+    return (dispatch & 0x0f) + 1;
+}
+
+/**
+// Get the number of elements between consecutive results of a kernel that
+// writes integers.
+//
+// Comparisons and logical operators write one integer per element whatever
+// the width of their operands.
+*/
+static unsigned int dispatch_result_stride( const int* /*result*/, unsigned int /*operand_width*/ )
+{
+    return 1;
+}
+
+/**
+// Get the number of floats between consecutive results of a kernel that 
+// writes floats.
+//
+// Arithmetic writes elements as wide as its widest operand.
+*/
+static unsigned int dispatch_result_stride( const float* /*result*/, unsigned int operand_width )
+{
+    return operand_width;
+}
+
+/**
+// Execute a binary kernel on just the elements processed by a sparse 
+// condition mask.
+//
+// The kernel is executed once on every element if there is no sparse mask
+// or once for each run of processed elements with varying operands offset
+// to the start of each run.  Elements outside of the runs are left 
+// unchanged in \e result; they are never read because assignments are 
+// masked and nested masks are combined with the masks that enclose them.
+//
+// @param function
+//  The kernel to execute.
+//
+// @param dispatch
+//  The dispatch code passed to the kernel.
+//
+// @param result
+//  The value to write results into (sized to \e length).
+//
+// @param lhs
+//  The left hand side operand.
+//
+// @param rhs
+//  The right hand side operand.
+//
+// @param length
+//  The number of elements to execute the kernel on.
+//
+// @param sparse_mask
+//  The sparse condition mask to execute under or null to execute on every
+//  element.
+*/
+template <class Result, class Operand>
+static void execute_binary( void (*function)(int, Result*, const Operand*, const Operand*, unsigned int), int dispatch, Value* result, const Value* lhs, const Value* rhs, unsigned int length, const ConditionMask* sparse_mask )
+{
+    Result* result_values = reinterpret_cast<Result*>( result->values() );
+    const Operand* lhs_values = reinterpret_cast<const Operand*>( lhs->values() );
+    const Operand* rhs_values = reinterpret_cast<const Operand*>( rhs->values() );
+    if ( !sparse_mask || sparse_mask->mask().size() != length )
+    {
+        (*function)( dispatch, result_values, lhs_values, rhs_values, length );
+        return;
+    }
+
+    const unsigned int lhs_stride = dispatch_stride( (dispatch >> 8) & 0xff );
+    const unsigned int rhs_stride = dispatch_stride( dispatch & 0xff );
+    const unsigned int operand_width = max( dispatch_width((dispatch >> 8) & 0xff), dispatch_width(dispatch & 0xff) );
+    const unsigned int result_stride = dispatch_result_stride( result_values, operand_width );
+    const vector<ConditionMask::Run>& runs = sparse_mask->runs();
+    for ( vector<ConditionMask::Run>::const_iterator i = runs.begin(); i != runs.end(); ++i )
+    {
+        const ConditionMask::Run& run = *i;
+        (*function)( 
+            dispatch, 
+            result_values + run.begin * result_stride, 
+            lhs_values + run.begin * lhs_stride, 
+            rhs_values + run.begin * rhs_stride, 
+            run.length 
+        );
+    }
+}
+
+/**
+// Execute a kernel already selected for \e dispatch on just the elements 
+// processed by a sparse condition mask.
+//
+// @see execute_binary() above.
+*/
+template <class Result>
+static void execute_binary( void (*kernel)(Result*, const float*, const float*, unsigned int), int dispatch, Value* result, const Value* lhs, const Value* rhs, unsigned int length, const ConditionMask* sparse_mask )
+{
+    REYES_ASSERT( kernel );
+    Result* result_values = reinterpret_cast<Result*>( result->values() );
+    const float* lhs_values = reinterpret_cast<const float*>( lhs->values() );
+    const float* rhs_values = reinterpret_cast<const float*>( rhs->values() );
+    if ( !sparse_mask || sparse_mask->mask().size() != length )
+    {
+        (*kernel)( result_values, lhs_values, rhs_values, length );
+        return;
+    }
+
+    const unsigned int lhs_stride = dispatch_stride( (dispatch >> 8) & 0xff );
+    const unsigned int rhs_stride = dispatch_stride( dispatch & 0xff );
+    const unsigned int operand_width = max( dispatch_width((dispatch >> 8) & 0xff), dispatch_width(dispatch & 0xff) );
+    const unsigned int result_stride = dispatch_result_stride( result_values, operand_width );
+    const vector<ConditionMask::Run>& runs = sparse_mask->runs();
+    for ( vector<ConditionMask::Run>::const_iterator i = runs.begin(); i != runs.end(); ++i )
+    {
+        const ConditionMask::Run& run = *i;
+        (*kernel)( 
+            result_values + run.begin * result_stride, 
+            lhs_values + run.begin * lhs_stride, 
+            rhs_values + run.begin * rhs_stride, 
+            run.length 
+        );
+    }
+}
+
 VirtualMachine::VirtualMachine()
 : renderer_( NULL ),
   grid_( NULL ),
   shader_( NULL ),
+  memory_(),
+  register_floats_( 0 ),
   values_(),
   registers_(),
-  register_index_( 0 ),
   light_index_( INT_MAX ),
-  code_begin_( NULL ),
-  code_end_( NULL ),
+  instructions_( NULL ),
+  instructions_begin_( NULL ),
+  instructions_end_( NULL ),
+  instruction_( NULL ),
   masks_(),
-  code_( NULL )
+  free_masks_(),
+  lights_(),
+  profile_( NULL )
 {
 }
 
@@ -78,18 +220,23 @@ VirtualMachine::VirtualMachine( const Renderer& renderer )
 : renderer_( &renderer ),
   grid_( NULL ),
   shader_( NULL ),
+  memory_(),
+  register_floats_( 0 ),
   values_(),
   registers_(),
-  register_index_( 0 ),
   light_index_( INT_MAX ),
-  code_begin_( NULL ),
-  code_end_( NULL ),
+  instructions_( NULL ),
+  instructions_begin_( NULL ),
+  instructions_end_( NULL ),
+  instruction_( NULL ),
   masks_(),
-  code_( NULL )
+  free_masks_(),
+  lights_(),
+  profile_( NULL )
 {
 }
 
-void VirtualMachine::initialize( Grid& parameters, Shader& shader )
+void VirtualMachine::initialize( Grid& parameters, const Shader& shader )
 {
     // @todo
     //  It's not really correct to set VirtualMachine::grid_ to the address of
@@ -107,7 +254,7 @@ void VirtualMachine::initialize( Grid& parameters, Shader& shader )
         parameters.add_value( symbol->identifier(), symbol->type() );
     }
 
-    construct( shader.initialize_address(), shader.shade_address() );
+    construct( shader.initialize_instruction(), shader.shade_instruction() );
     initialize_registers( parameters );
     execute();
     
@@ -115,57 +262,102 @@ void VirtualMachine::initialize( Grid& parameters, Shader& shader )
     grid_ = NULL;
 }
 
-void VirtualMachine::shade( Grid& globals, Grid& parameters, Shader& shader )
+void VirtualMachine::shade( Grid& globals, Grid& parameters, const Shader& shader )
 {   
     grid_ = &globals;
     shader_ = &shader;
     
-    construct( shader.shade_address(), shader.end_address() );
+    construct( shader.shade_instruction(), shader.end_instruction() );
     initialize_registers( parameters );
     initialize_registers( globals );
+    promote_registers( globals );
     execute();
     
     shader_ = NULL;
     grid_ = NULL;
 }
 
+/**
+// Set the Profile that this virtual machine counts the instructions that
+// it executes into.
+//
+// Without a Profile instructions are executed without counting so that 
+// profiling costs nothing when it isn't used.
+//
+// @param profile
+//  The Profile to count executions, elements processed, and elapsed time
+//  of each instruction into or null to stop counting.
+*/
+void VirtualMachine::set_profile( Profile* profile )
+{
+    profile_ = profile;
+}
+
+Profile* VirtualMachine::profile() const
+{
+    return profile_;
+}
+
+/**
+// Get the number of temporary registers laid out in this virtual machine's
+// contiguous block of register memory.
+//
+// @return
+//  The number of temporary registers (at least as many as the largest 
+//  number of registers used by any shader executed so far).
+*/
+int VirtualMachine::temporary_registers() const
+{
+    return int(values_.size());
+}
+
+/**
+// Get a temporary register.
+//
+// @param index
+//  The index of the temporary register to get (assumed to be in the range
+//  [0, temporary_registers())).
+//
+// @return
+//  The temporary register.
+*/
+const Value& VirtualMachine::temporary_register( int index ) const
+{
+    REYES_ASSERT( index >= 0 && index < int(values_.size()) );
+    return values_[index];
+}
+
 void VirtualMachine::construct( int start, int finish )
 {
     REYES_ASSERT( shader_ );
-    REYES_ASSERT( !shader_->code().empty() );
-    REYES_ASSERT( start >= 0 && start <= int(shader_->code().size()) );
-    REYES_ASSERT( finish >= 0 && finish <= int(shader_->code().size()) );
+    REYES_ASSERT( !shader_->instructions().empty() );
+    REYES_ASSERT( start >= 0 && start <= shader_->end_instruction() );
+    REYES_ASSERT( finish >= 0 && finish <= shader_->end_instruction() );
     REYES_ASSERT( start <= finish );
 
-    code_begin_ = &shader_->code().front() + start;
-    code_end_ = &shader_->code().front() + finish;
-    register_index_ = shader_->permanent_registers();
+    instructions_ = &shader_->instructions().front();
+    instructions_begin_ = instructions_ + start;
+    instructions_end_ = instructions_ + finish;
     
-    values_.reserve( shader_->registers() );
-    while ( values_.size() < shader_->registers() )
-    {
-        shared_ptr<Value> value( new Value() );
-        values_.push_back( value );
-    }
+    allocate_registers( shader_->registers(), grid_->size() );
     
     registers_.clear();
     registers_.reserve( shader_->registers() );
-    registers_.insert( registers_.end(), max(shader_->registers() - int(registers_.size()), 0), shared_ptr<Value>() );
+    registers_.insert( registers_.end(), max(shader_->registers() - int(registers_.size()), 0), static_cast<Value*>(NULL) );
 
     // Initialize registers for constants.
     REYES_ASSERT( shader_->constants() == int(shader_->values().size()) );
     unsigned int register_index = 0;
     while ( register_index < shader_->values().size() )
     {
-        shared_ptr<Value>& value = values_[register_index];
-        registers_[register_index] = shader_->values()[register_index];
+        registers_[register_index] = shader_->values()[register_index].get();
         ++register_index;
     }
        
     // Initialize registers for global, local, and temporary values.
     while ( register_index < shader_->registers() )
     {
-        registers_[register_index] = values_[register_index];
+        registers_[register_index] = &values_[register_index];
         ++register_index;
     }
 
@@ -176,246 +368,263 @@ void VirtualMachine::construct( int start, int finish )
     //  or code generation.
     const unsigned int MASKS_RESERVE = 8;
     masks_.reserve( MASKS_RESERVE );
+    free_masks_.reserve( MASKS_RESERVE );
 }
 
+/**
+// Lay out the temporary registers used to execute a shader in one 
+// contiguous block of memory.
+//
+// Each register gets a slot large enough to hold a varying vec3 across the
+// grid being shaded (or a uniform matrix), rounded up to a whole number of
+// 64 byte cache lines.  The block only grows so it is reused unchanged 
+// across grids of the same or smaller size.
+//
+// @param registers
+//  The number of registers used by the shader being executed.
+//
+// @param grid_size
+//  The number of vertices in the grid being shaded.
+*/
+void VirtualMachine::allocate_registers( int registers, int grid_size )
+{
+    REYES_ASSERT( registers >= 0 );
+    REYES_ASSERT( grid_size >= 0 );
+
+    const unsigned int FLOATS_PER_CACHE_LINE = 64 / sizeof(float);
+    const unsigned int MINIMUM_REGISTER_FLOATS = sizeof(mat4x4) / sizeof(float);
+    unsigned int register_floats = max( static_cast<unsigned int>(grid_size) * 3, MINIMUM_REGISTER_FLOATS );
+    register_floats = (register_floats + FLOATS_PER_CACHE_LINE - 1) / FLOATS_PER_CACHE_LINE * FLOATS_PER_CACHE_LINE;
+
+    if ( int(values_.size()) < registers || register_floats_ < register_floats )
+    {
+        register_floats_ = max( register_floats_, register_floats );
+        const unsigned int register_count = max( (unsigned int) registers, (unsigned int) values_.size() );
+        values_.clear();
+        memory_.clear();
+        memory_.resize( register_floats_ * register_count + FLOATS_PER_CACHE_LINE );
+
+        // Align the first register to a cache line so that every register is 
+        // cache line aligned.
+        float* memory = &memory_[0];
+        while ( reinterpret_cast<uintptr_t>(memory) % 64 != 0 )
+        {
+            ++memory;
+        }
+
+        values_.reserve( register_count );
+        for ( unsigned int i = 0; i < register_count; ++i )
+        {
+            values_.emplace_back( memory + i * register_floats_, register_floats_ * (unsigned int) sizeof(float) );
+        }
+    }
+}
+
+/**
+// Bind the values in \e grid to the registers of the symbols that they are
+// bound to in the shader being executed.
+//
+// Values and symbols are matched by interned identifier through the 
+// shader's binding table so no strings are compared or hashed here.
+//
+// @param grid
+//  The grid of values to bind to registers.
+*/
 void VirtualMachine::initialize_registers( Grid& grid )
 {
-    const map<string, shared_ptr<Value>>& values = grid.values_by_identifier();
-    for ( map<string, shared_ptr<Value>>::const_iterator i = values.begin(); i != values.end(); ++i )
+    const vector<int>& identifiers = grid.identifiers();
+    const vector<shared_ptr<Value>>& values = grid.values_by_identifier();
+    for ( vector<int>::const_iterator i = identifiers.begin(); i != identifiers.end(); ++i )
     {
-        Symbol* symbol = shader_->find_symbol( i->first ).get();
+        const Symbol* symbol = shader_->find_symbol( *i );
         if ( symbol )
         {
-            registers_[symbol->register_index()] = i->second;
+            registers_[symbol->register_index()] = values[*i].get();
         }
     }
 }
 
-void VirtualMachine::execute()
+/**
+// Promote uniform values from \e grid that are bound to varying symbols.
+//
+// Globals like "Cs" and "Os" are provided as uniform values and only 
+// expanded here, into this virtual machine's own registers, when a shader
+// reads them as varying values.
+//
+// @param grid
+//  The grid of global values that has just been used to initialize 
+//  registers.
+*/
+void VirtualMachine::promote_registers( const Grid& grid )
 {
-    REYES_ASSERT( code_begin_ );
-    REYES_ASSERT( code_end_ );
-    REYES_ASSERT( code_begin_ <= code_end_ );
-    
-    code_ = code_begin_;
-    while ( code_ < code_end_ )
+    const vector<int>& identifiers = grid.identifiers();
+    const vector<shared_ptr<Value>>& values = grid.values_by_identifier();
+    for ( vector<int>::const_iterator i = identifiers.begin(); i != identifiers.end(); ++i )
     {
-        switch ( instruction() )
+        const Symbol* symbol = shader_->find_symbol( *i );
+        const Value* value = values[*i].get();
+        if ( symbol && symbol->storage() == STORAGE_VARYING && value->storage() == STORAGE_UNIFORM )
         {
-            case INSTRUCTION_HALT:    
-                execute_halt();
-                break;                
-
-            case INSTRUCTION_RESET:
-                execute_reset();
-                break;
-                
-            case INSTRUCTION_CLEAR_MASK:
-                execute_clear_mask();
-                break;
-            
-            case INSTRUCTION_GENERATE_MASK:
-                execute_generate_mask();
-                break;
-                
-            case INSTRUCTION_INVERT_MASK:
-                execute_invert_mask();
-                break;
+            int dispatch = 0;
+            switch ( value->type() )
+            {
+                case TYPE_FLOAT:
+                    dispatch = DISPATCH_V1U1;
+                    break;
                 
-            case INSTRUCTION_JUMP_EMPTY:
-                execute_jump_empty();
-                break;
+                case TYPE_COLOR:
+                case TYPE_POINT:
+                case TYPE_VECTOR:
+                case TYPE_NORMAL:
+                    dispatch = DISPATCH_V3U3;
+                    break;
+                    
+                default:
+                    break;
+            }
             
-            case INSTRUCTION_JUMP_NOT_EMPTY:
-                execute_jump_not_empty();
-                break;
-            
-            case INSTRUCTION_JUMP_ILLUMINANCE:
-                execute_jump_illuminance();
-                break;
-            
-            case INSTRUCTION_JUMP:
-                execute_jump();
-                break;
-            
-            case INSTRUCTION_TRANSFORM_POINT:
-                execute_transform_point();
-                break;
-                
-            case INSTRUCTION_TRANSFORM_VECTOR:
-                execute_transform_vector();
-                break;
-                
-            case INSTRUCTION_TRANSFORM_NORMAL:
-                execute_transform_normal();
-                break;
-                
-            case INSTRUCTION_TRANSFORM_COLOR:
-                execute_transform_color();
-                break;
-                
-            case INSTRUCTION_TRANSFORM_MATRIX:
-                execute_transform_matrix();
-                break;
-                
-            case INSTRUCTION_DOT:
-                execute_dot();
-                break;
-                
-            case INSTRUCTION_MULTIPLY:
-                execute_multiply();
-                break;
-                
-            case INSTRUCTION_DIVIDE:
-                execute_divide();
-                break;
-                
-            case INSTRUCTION_ADD:
-                execute_add();
-                break;
-            
-            case INSTRUCTION_SUBTRACT:
-                execute_subtract();
-                break;
-            
-            case INSTRUCTION_GREATER:
-                execute_greater();
-                break;
-            
-            case INSTRUCTION_GREATER_EQUAL:
-                execute_greater_equal();
-                break;
-            
-            case INSTRUCTION_LESS:
-                execute_less();
-                break;
-            
-            case INSTRUCTION_LESS_EQUAL:
-                execute_less_equal();
-                break;
-            
-            case INSTRUCTION_AND:
-                execute_and();
-                break;
-            
-            case INSTRUCTION_OR:
-                execute_or();
-                break;
-            
-            case INSTRUCTION_EQUAL:
-                execute_equal();
-                break;
-            
-            case INSTRUCTION_NOT_EQUAL:
-                execute_not_equal();
-                break;
-                        
-            case INSTRUCTION_NEGATE:
-                execute_negate();
-                break;
-                
-            case INSTRUCTION_CONVERT:
-                execute_convert();
-                break;
+            if ( dispatch != 0 )
+            {
+                Value* promoted_value = &values_[symbol->register_index()];
+                promoted_value->reset( value->type(), STORAGE_VARYING, grid.size() );
+                promote( 
+                    dispatch, 
+                    reinterpret_cast<float*>(promoted_value->values()),
+                    reinterpret_cast<const float*>(value->values()),
+                    grid.size()
+                );
+                registers_[symbol->register_index()] = promoted_value;
+            }
+        }
+    }
+}
 
-            case INSTRUCTION_PROMOTE:
-                execute_promote();
-                break;
-            
-            case INSTRUCTION_ASSIGN:
-                execute_assign();
-                break;
-                        
-            case INSTRUCTION_ASSIGN_STRING:
-                execute_assign_string();
-                break;
-            
-            case INSTRUCTION_ADD_ASSIGN:
-                execute_add_assign();
-                break;
-            
-            case INSTRUCTION_MULTIPLY_ASSIGN:
-                execute_multiply_assign();
-                break;
-            
-            case INSTRUCTION_DIVIDE_ASSIGN:
-                execute_divide_assign();
-                break;
-            
-            case INSTRUCTION_FLOAT_TEXTURE:
-                execute_float_texture();
-                break;
-            
-            case INSTRUCTION_VEC3_TEXTURE:
-                execute_vec3_texture();
-                break;
-            
-            case INSTRUCTION_FLOAT_ENVIRONMENT:
-                execute_float_environment();
-                break;
-            
-            case INSTRUCTION_VEC3_ENVIRONMENT:
-                execute_vec3_environment();
-                break;
-            
-            case INSTRUCTION_SHADOW:
-                execute_shadow();
-                break;
-                
-            case INSTRUCTION_CALL_0:
-                execute_call_0();
-                break;
-                
-            case INSTRUCTION_CALL_1:
-                execute_call_1();
-                break;
-                
-            case INSTRUCTION_CALL_2:
-                execute_call_2();
-                break;
-            
-            case INSTRUCTION_CALL_3:
-                execute_call_3();
-                break;
+/**
+// The functions that execute each instruction indexed by instruction.
+//
+// Each decoded instruction is executed by calling through this table 
+// rather than by switching on its instruction; the table is indexed in the
+// order that instructions are declared in Instruction.
+*/
+const VirtualMachine::ExecuteFunction VirtualMachine::execute_functions_[] =
+{
+    &VirtualMachine::execute_null, // INSTRUCTION_NULL
+    &VirtualMachine::execute_halt,
+    &VirtualMachine::execute_null, // INSTRUCTION_RESET (removed by Decoder)
+    &VirtualMachine::execute_clear_mask,
+    &VirtualMachine::execute_generate_mask,
+    &VirtualMachine::execute_invert_mask,
+    &VirtualMachine::execute_jump_empty,
+    &VirtualMachine::execute_jump_not_empty,
+    &VirtualMachine::execute_jump_illuminance,
+    &VirtualMachine::execute_jump,
+    &VirtualMachine::execute_transform_point,
+    &VirtualMachine::execute_transform_vector,
+    &VirtualMachine::execute_transform_normal,
+    &VirtualMachine::execute_transform_color,
+    &VirtualMachine::execute_transform_matrix,
+    &VirtualMachine::execute_dot,
+    &VirtualMachine::execute_multiply,
+    &VirtualMachine::execute_divide,
+    &VirtualMachine::execute_add,
+    &VirtualMachine::execute_subtract,
+    &VirtualMachine::execute_multiply_add,
+    &VirtualMachine::execute_greater,
+    &VirtualMachine::execute_greater_equal,
+    &VirtualMachine::execute_less,
+    &VirtualMachine::execute_less_equal,
+    &VirtualMachine::execute_and,
+    &VirtualMachine::execute_or,
+    &VirtualMachine::execute_equal,
+    &VirtualMachine::execute_not_equal,
+    &VirtualMachine::execute_negate,
+    &VirtualMachine::execute_convert,
+    &VirtualMachine::execute_promote,
+    &VirtualMachine::execute_assign,
+    &VirtualMachine::execute_assign_string,
+    &VirtualMachine::execute_add_assign,
+    &VirtualMachine::execute_subtract_assign,
+    &VirtualMachine::execute_multiply_assign,
+    &VirtualMachine::execute_divide_assign,
+    &VirtualMachine::execute_float_texture,
+    &VirtualMachine::execute_vec3_texture,
+    &VirtualMachine::execute_float_environment,
+    &VirtualMachine::execute_vec3_environment,
+    &VirtualMachine::execute_shadow,
+    &VirtualMachine::execute_call_0,
+    &VirtualMachine::execute_call_1,
+    &VirtualMachine::execute_call_2,
+    &VirtualMachine::execute_call_3,
+    &VirtualMachine::execute_call_4,
+    &VirtualMachine::execute_call_5,
+    &VirtualMachine::execute_ambient,
+    &VirtualMachine::execute_solar_axis_angle, // INSTRUCTION_SOLAR
+    &VirtualMachine::execute_solar_axis_angle,
+    &VirtualMachine::execute_illuminate,
+    &VirtualMachine::execute_illuminate_axis_angle,
+    &VirtualMachine::execute_illuminance_axis_angle
+};
 
-            case INSTRUCTION_CALL_4:
-                execute_call_4();
-                break;
+void VirtualMachine::execute()
+{
+    REYES_ASSERT( sizeof(execute_functions_) / sizeof(execute_functions_[0]) == INSTRUCTION_COUNT );
+    REYES_ASSERT( instructions_begin_ );
+    REYES_ASSERT( instructions_end_ );
+    REYES_ASSERT( instructions_begin_ <= instructions_end_ );
+    
+    if ( profile_ )
+    {
+        execute_profiled();
+        return;
+    }
 
-            case INSTRUCTION_CALL_5:
-                execute_call_5();                
-                break;
+    instruction_ = instructions_begin_;
+    while ( instruction_ < instructions_end_ )
+    {
+        const DecodedInstruction& instruction = *instruction_;
+        REYES_ASSERT( instruction.instruction > INSTRUCTION_NULL && instruction.instruction < INSTRUCTION_COUNT );
+        ++instruction_;
+        (this->*execute_functions_[instruction.instruction])( instruction );
+    }
+}
 
-            case INSTRUCTION_AMBIENT:
-                execute_ambient();
-                break;
-            
-            case INSTRUCTION_SOLAR:
-            case INSTRUCTION_SOLAR_AXIS_ANGLE:
-                execute_solar_axis_angle();
-                break;
-            
-            case INSTRUCTION_ILLUMINATE:
-                execute_illuminate();
-                break;
+/**
+// Execute the loaded code counting the executions, elements processed, 
+// and elapsed time of each instruction into the counters for the current
+// shader in the current Profile.
+//
+// The elements processed by an instruction are the elements of the grid
+// that are active in the current condition mask when it is executed.
+*/
+void VirtualMachine::execute_profiled()
+{
+    using std::chrono::steady_clock;
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
 
-            case INSTRUCTION_ILLUMINATE_AXIS_ANGLE:
-                execute_illuminate_axis_angle();
-                break;
-            
-            case INSTRUCTION_ILLUMINANCE_AXIS_ANGLE:
-                execute_illuminance_axis_angle();
-                break;
-
-            default:    
-                REYES_ASSERT( false );
-                execute_halt();
-                break;                
-        }
+    REYES_ASSERT( profile_ );
+    REYES_ASSERT( shader_ );
+    REYES_ASSERT( grid_ );
+
+    Profile::Counters* counters = profile_->counters( *shader_ );
+    REYES_ASSERT( counters );
+    instruction_ = instructions_begin_;
+    while ( instruction_ < instructions_end_ )
+    {
+        const DecodedInstruction& instruction = *instruction_;
+        REYES_ASSERT( instruction.instruction > INSTRUCTION_NULL && instruction.instruction < INSTRUCTION_COUNT );
+        ++instruction_;
+        Profile::Counters& instruction_counters = counters[&instruction - instructions_];
+        const int elements = masks_.empty() ? grid_->size() : masks_.back().processed();
+        const steady_clock::time_point start = steady_clock::now();
+        (this->*execute_functions_[instruction.instruction])( instruction );
+        instruction_counters.nanoseconds += uint64_t(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+        instruction_counters.executions += 1;
+        instruction_counters.elements += uint64_t(elements);
     }
 }
 
-void VirtualMachine::jump_illuminance( int distance )
+void VirtualMachine::jump_illuminance( int target )
 {
     const int lights = int(grid_->lights().size());
     if ( light_index_ < lights )    
@@ -435,169 +644,134 @@ void VirtualMachine::jump_illuminance( int distance )
     if ( light_index_ >= lights )
     {
         light_index_ = INT_MAX;
-        jump( distance );
+        jump( target );
     }
 }
 
-void VirtualMachine::jump( int distance )
-{
-    REYES_ASSERT( code_ + distance >= code_begin_ && code_ + distance < code_end_ );
-    code_ += distance;
-}
-
-int VirtualMachine::instruction()
-{
-    return word();
-}
-
-int VirtualMachine::argument()
-{
-    return quad();
-}
-
-int VirtualMachine::word()
-{
-    REYES_ASSERT( code_ );
-    REYES_ASSERT( code_end_ );
-    REYES_ASSERT( code_ < code_end_ );
-    int value = *(const short*) code_;
-    code_ += sizeof(short);
-    return value;
-}
-
-int VirtualMachine::quad()
+/**
+// Continue execution from another instruction.
+//
+// @param target
+//  The index of the instruction to continue from in the instructions
+//  decoded for the current shader.
+*/
+void VirtualMachine::jump( int target )
 {
-    REYES_ASSERT( code_ );
-    REYES_ASSERT( code_end_ );
-    REYES_ASSERT( code_ < code_end_ );
-    int value = *(const int*) code_;
-    code_ += sizeof(int);
-    return value;
+    REYES_ASSERT( instructions_ + target >= instructions_begin_ && instructions_ + target < instructions_end_ );
+    instruction_ = instructions_ + target;
 }
 
-void VirtualMachine::execute_halt()
+void VirtualMachine::execute_null( const DecodedInstruction& /*instruction*/ )
 {
-    code_ = code_end_;
+    REYES_ASSERT( false );
+    instruction_ = instructions_end_;
 }
 
-void VirtualMachine::execute_reset()
+void VirtualMachine::execute_halt( const DecodedInstruction& /*instruction*/ )
 {
-    word();
-    int index = argument();
-    reset_register( index );
+    instruction_ = instructions_end_;
 }
 
-void VirtualMachine::execute_clear_mask()
+void VirtualMachine::execute_clear_mask( const DecodedInstruction& /*instruction*/ )
 {
-    word();
     pop_mask();
 }
 
-void VirtualMachine::execute_generate_mask()
+void VirtualMachine::execute_generate_mask( const DecodedInstruction& instruction )
 {
-    word();
-    int mask = argument();
+    int mask = instruction.arguments[0];
     push_mask( registers_[mask] );
 }
 
-void VirtualMachine::execute_invert_mask()
+void VirtualMachine::execute_invert_mask( const DecodedInstruction& /*instruction*/ )
 {
-    word();
     invert_mask();
 }
 
-void VirtualMachine::execute_jump_empty()
+void VirtualMachine::execute_jump_empty( const DecodedInstruction& instruction )
 {
-    word();
-    int distance = argument();
     if ( mask_empty() )
     {
-        jump( distance );
+        jump( instruction.jump );
         pop_mask();
     }
 }
 
-void VirtualMachine::execute_jump_not_empty()
+void VirtualMachine::execute_jump_not_empty( const DecodedInstruction& instruction )
 {
-    word();
-    int distance = argument();
     if ( !mask_empty() )
     {
-        jump( distance );
+        jump( instruction.jump );
     }
 }
 
-void VirtualMachine::execute_jump_illuminance()
+void VirtualMachine::execute_jump_illuminance( const DecodedInstruction& instruction )
 {
-    word();
-    int distance = argument();
-    jump_illuminance( distance );
+    jump_illuminance( instruction.jump );
 }
 
-void VirtualMachine::execute_jump()
+void VirtualMachine::execute_jump( const DecodedInstruction& instruction )
 {
-    word();
-    int distance = argument();
-    jump( distance );
+    jump( instruction.jump );
 }
 
-void VirtualMachine::execute_transform_point()
+void VirtualMachine::execute_transform_point( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    const shared_ptr<Value>& result = registers_[allocate_register()];
-    const shared_ptr<Value>& fromspace = registers_[argument()];
-    const shared_ptr<Value>& point = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* fromspace = registers_[instruction.arguments[0]];
+    Value* point = registers_[instruction.arguments[1]];
     REYES_ASSERT( renderer_ );
     result->reset( point->type(), point->storage(), point->size() );
     transform( 
         dispatch,
         result->vec3_values(),
-        renderer_->transform_from( fromspace->string_value() ),
+        renderer_->transform_from( fromspace->string_identifier() ),
         point->vec3_values(),
         point->size()
     );
 }
 
-void VirtualMachine::execute_transform_vector()
+void VirtualMachine::execute_transform_vector( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& fromspace = registers_[argument()];
-    const shared_ptr<Value>& vector = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* fromspace = registers_[instruction.arguments[0]];
+    Value* vector = registers_[instruction.arguments[1]];
     REYES_ASSERT( renderer_ );
     result->reset( vector->type(), vector->storage(), vector->size() );
     vtransform( 
         dispatch,
         result->vec3_values(),
-        renderer_->transform_from( fromspace->string_value() ),
+        renderer_->transform_from( fromspace->string_identifier() ),
         vector->vec3_values(),
         vector->size()
     );
 }
 
-void VirtualMachine::execute_transform_normal()
+void VirtualMachine::execute_transform_normal( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& fromspace = registers_[argument()];
-    const shared_ptr<Value>& normal = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* fromspace = registers_[instruction.arguments[0]];
+    Value* normal = registers_[instruction.arguments[1]];
     REYES_ASSERT( renderer_ );
     result->reset( normal->type(), normal->storage(), normal->size() );
     ntransform( 
         dispatch,
         result->vec3_values(),
-        renderer_->transform_from(fromspace->string_value()),
+        renderer_->transform_from( fromspace->string_identifier() ),
         normal->vec3_values(),
         normal->size()
     );
 }
 
-void VirtualMachine::execute_transform_color()
+void VirtualMachine::execute_transform_color( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    const shared_ptr<Value>& result = registers_[allocate_register()];
-    const shared_ptr<Value>& fromspace = registers_[argument()];
-    const shared_ptr<Value>& color = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* fromspace = registers_[instruction.arguments[0]];
+    Value* color = registers_[instruction.arguments[1]];
     result->reset( TYPE_COLOR, color->storage(), color->size() );
     ctransform( 
         color->size() == 1 ? DISPATCH_U3 : DISPATCH_V3,
@@ -608,29 +782,29 @@ void VirtualMachine::execute_transform_color()
     );
 }
 
-void VirtualMachine::execute_transform_matrix()
+void VirtualMachine::execute_transform_matrix( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    const shared_ptr<Value>& result = registers_[allocate_register()];
-    const shared_ptr<Value>& tospace = registers_[argument()];
-    const shared_ptr<Value>& matrix = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* tospace = registers_[instruction.arguments[0]];
+    Value* matrix = registers_[instruction.arguments[1]];
     REYES_ASSERT( renderer_ );
     result->reset( TYPE_MATRIX, matrix->storage(), matrix->size() );
     mtransform( 
         dispatch,
         result->mat4x4_values(),
-        renderer_->transform_to(tospace->string_value()),
+        renderer_->transform_to( tospace->string_identifier() ),
         matrix->mat4x4_values(),
         matrix->size()
     );
 }
 
-void VirtualMachine::execute_dot()
+void VirtualMachine::execute_dot( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     const unsigned int length = max( lhs->size(), rhs->size() );
     result->reset( TYPE_FLOAT, max(lhs->storage(), rhs->storage()), length );
     dot( 
@@ -642,210 +816,191 @@ void VirtualMachine::execute_dot()
     );
 }
 
-void VirtualMachine::execute_multiply()
+void VirtualMachine::execute_multiply( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
-    result->reset( lhs->type(), max(lhs->storage(), rhs->storage()), lhs->size() );
-    multiply( 
-        dispatch, 
-        reinterpret_cast<float*>(result->values()),
-        reinterpret_cast<const float*>(lhs->values()),
-        reinterpret_cast<const float*>(rhs->values()),
-        lhs->size()
-    );
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
+    const unsigned int length = max( lhs->size(), rhs->size() );
+    result->reset( lhs->type(), max(lhs->storage(), rhs->storage()), length );
+    execute_binary( instruction.kernel.binary, dispatch, result, lhs, rhs, length, get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_divide()
+void VirtualMachine::execute_divide( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
-    result->reset( lhs->type(), max(lhs->storage(), rhs->storage()), lhs->size() );
-    divide( 
-        dispatch, 
-        reinterpret_cast<float*>(result->values()), 
-        reinterpret_cast<const float*>(lhs->values()),
-        reinterpret_cast<const float*>(rhs->values()),
-        lhs->size()
-    );
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
+    const unsigned int length = max( lhs->size(), rhs->size() );
+    result->reset( lhs->type(), max(lhs->storage(), rhs->storage()), length );
+    execute_binary( instruction.kernel.binary, dispatch, result, lhs, rhs, length, get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_add()
+void VirtualMachine::execute_add( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
-    result->reset( lhs->type(), max(lhs->storage(), rhs->storage()), lhs->size() );
-    add( 
-        dispatch, 
-        reinterpret_cast<float*>(result->values()),
-        reinterpret_cast<const float*>(lhs->values()),
-        reinterpret_cast<const float*>(rhs->values()),
-        lhs->size()
-    );
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
+    const unsigned int length = max( lhs->size(), rhs->size() );
+    result->reset( lhs->type(), max(lhs->storage(), rhs->storage()), length );
+    execute_binary( instruction.kernel.binary, dispatch, result, lhs, rhs, length, get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_subtract()
+void VirtualMachine::execute_subtract( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
-    result->reset( lhs->type(), max(lhs->storage(), rhs->storage()), lhs->size() );
-    subtract( 
-        dispatch,
-        reinterpret_cast<float*>(result->values()),
-        reinterpret_cast<const float*>(lhs->values()),
-        reinterpret_cast<const float*>(rhs->values()),
-        lhs->size()
-    );
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
+    const unsigned int length = max( lhs->size(), rhs->size() );
+    result->reset( lhs->type(), max(lhs->storage(), rhs->storage()), length );
+    execute_binary( instruction.kernel.binary, dispatch, result, lhs, rhs, length, get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_greater()
+/**
+// Execute a multiply-add fused from a multiply whose result was only used
+// by an add (see Optimizer).
+//
+// The product and sum are calculated in one pass so the product is never
+// written to a register.  The result takes the type of the addend.
+*/
+void VirtualMachine::execute_multiply_add( const DecodedInstruction& instruction )
+{
+    int dispatch = instruction.dispatch;
+    int addend_dispatch = instruction.addend_dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
+    Value* addend = registers_[instruction.arguments[2]];
+    const unsigned int length = max( max(lhs->size(), rhs->size()), addend->size() );
+    const ValueStorage storage = max( max(lhs->storage(), rhs->storage()), addend->storage() );
+    result->reset( addend->type(), storage, length );
+
+    float* result_values = reinterpret_cast<float*>( result->values() );
+    const float* lhs_values = reinterpret_cast<const float*>( lhs->values() );
+    const float* rhs_values = reinterpret_cast<const float*>( rhs->values() );
+    const float* addend_values = reinterpret_cast<const float*>( addend->values() );
+    const ConditionMask* sparse_mask = get_sparse_mask( result );
+    if ( !sparse_mask || sparse_mask->mask().size() != length )
+    {
+        multiply_add( dispatch, addend_dispatch, result_values, lhs_values, rhs_values, addend_values, length );
+        return;
+    }
+
+    const unsigned int lhs_stride = dispatch_stride( (dispatch >> 8) & 0xff );
+    const unsigned int rhs_stride = dispatch_stride( dispatch & 0xff );
+    const unsigned int addend_stride = dispatch_stride( addend_dispatch );
+    const unsigned int result_stride = dispatch_width( addend_dispatch );
+    const vector<ConditionMask::Run>& runs = sparse_mask->runs();
+    for ( vector<ConditionMask::Run>::const_iterator i = runs.begin(); i != runs.end(); ++i )
+    {
+        const ConditionMask::Run& run = *i;
+        multiply_add( 
+            dispatch, 
+            addend_dispatch,
+            result_values + run.begin * result_stride, 
+            lhs_values + run.begin * lhs_stride, 
+            rhs_values + run.begin * rhs_stride, 
+            addend_values + run.begin * addend_stride, 
+            run.length 
+        );
+    }
+}
+
+void VirtualMachine::execute_greater( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     result->reset( TYPE_INTEGER, max(lhs->storage(), rhs->storage()), lhs->size() );
-    greater(
-        dispatch,
-        reinterpret_cast<int*>(result->values()),
-        reinterpret_cast<const float*>(lhs->values()),
-        reinterpret_cast<const float*>(rhs->values()),
-        lhs->size() 
-    );
+    execute_binary( instruction.kernel.comparison, dispatch, result, lhs, rhs, lhs->size(), get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_greater_equal()
+void VirtualMachine::execute_greater_equal( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     result->reset( TYPE_INTEGER, max(lhs->storage(), rhs->storage()), lhs->size() );
-    greater_equal(
-        dispatch,
-        reinterpret_cast<int*>(result->values()),
-        reinterpret_cast<const float*>(lhs->values()),
-        reinterpret_cast<const float*>(rhs->values()),
-        lhs->size() 
-    );
+    execute_binary( instruction.kernel.comparison, dispatch, result, lhs, rhs, lhs->size(), get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_less()
+void VirtualMachine::execute_less( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     result->reset( TYPE_INTEGER, max(lhs->storage(), rhs->storage()), lhs->size() );
-    less(
-        dispatch,
-        reinterpret_cast<int*>(result->values()),
-        reinterpret_cast<const float*>(lhs->values()),
-        reinterpret_cast<const float*>(rhs->values()),
-        lhs->size() 
-    );
+    execute_binary( instruction.kernel.comparison, dispatch, result, lhs, rhs, lhs->size(), get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_less_equal()
+void VirtualMachine::execute_less_equal( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     result->reset( TYPE_INTEGER, max(lhs->storage(), rhs->storage()), lhs->size() );
-    less_equal(
-        dispatch,
-        reinterpret_cast<int*>(result->values()),
-        reinterpret_cast<const float*>(lhs->values()),
-        reinterpret_cast<const float*>(rhs->values()),
-        lhs->size() 
-    );
+    execute_binary( instruction.kernel.comparison, dispatch, result, lhs, rhs, lhs->size(), get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_and()
+void VirtualMachine::execute_and( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     result->reset( TYPE_INTEGER, max(lhs->storage(), rhs->storage()), lhs->size() );
-    logical_and( 
-        dispatch,
-        reinterpret_cast<int*>(result->values()),
-        reinterpret_cast<const int*>(lhs->values()),
-        reinterpret_cast<const int*>(rhs->values()),
-        lhs->size()
-    );
+    execute_binary( logical_and, dispatch, result, lhs, rhs, lhs->size(), get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_or()
+void VirtualMachine::execute_or( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     result->reset( TYPE_INTEGER, max(lhs->storage(), rhs->storage()), lhs->size() );
-    logical_or( 
-        dispatch,
-        reinterpret_cast<int*>(result->values()),
-        reinterpret_cast<const int*>(lhs->values()),
-        reinterpret_cast<const int*>(rhs->values()),
-        lhs->size()
-    );
+    execute_binary( logical_or, dispatch, result, lhs, rhs, lhs->size(), get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_equal()
+void VirtualMachine::execute_equal( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     result->reset( lhs->type(), max(lhs->storage(), rhs->storage()), lhs->size() );
-    equal(
-        dispatch,
-        reinterpret_cast<int*>(result->values()),
-        reinterpret_cast<const float*>(lhs->values()),
-        reinterpret_cast<const float*>(rhs->values()),
-        lhs->size()
-    );
+    execute_binary( instruction.kernel.comparison, dispatch, result, lhs, rhs, lhs->size(), get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_not_equal()
+void VirtualMachine::execute_not_equal( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& lhs = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* lhs = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     result->reset( TYPE_INTEGER, max(lhs->storage(), rhs->storage()), lhs->size() );
-    not_equal( 
-        dispatch,
-        reinterpret_cast<int*>(result->values()),
-        reinterpret_cast<const float*>(lhs->values()),
-        reinterpret_cast<const float*>(rhs->values()),
-        lhs->size()
-    );
+    execute_binary( instruction.kernel.comparison, dispatch, result, lhs, rhs, lhs->size(), get_sparse_mask(result) );
 }
 
-void VirtualMachine::execute_negate()
+void VirtualMachine::execute_negate( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& value = registers_[argument()];
+    Value* result = registers_[instruction.result];
+    Value* value = registers_[instruction.arguments[0]];
     result->reset( value->type(), value->storage(), value->size() );
-    negate( dispatch, reinterpret_cast<float*>(result->values()), reinterpret_cast<const float*>(value->values()), value->size() );
+    (*instruction.kernel.unary)( reinterpret_cast<float*>(result->values()), reinterpret_cast<const float*>(value->values()), value->size() );
 }
 
-void VirtualMachine::execute_convert()
+void VirtualMachine::execute_convert( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
+    int dispatch = instruction.dispatch;
     ValueType type = TYPE_NULL;
     switch ( dispatch >> 8 )
     {
@@ -868,8 +1023,8 @@ void VirtualMachine::execute_convert()
             break;
     }    
 
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    Value* result = registers_[instruction.result];
+    Value* rhs = registers_[instruction.arguments[0]];
     result->reset( type, rhs->storage(), rhs->size() );
     convert( 
         dispatch,
@@ -879,11 +1034,11 @@ void VirtualMachine::execute_convert()
     );
 }
 
-void VirtualMachine::execute_promote()
+void VirtualMachine::execute_promote( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.result];
+    Value* rhs = registers_[instruction.arguments[0]];
     result->reset( rhs->type(), STORAGE_VARYING, grid_->size() );
     promote( 
         dispatch,
@@ -893,11 +1048,11 @@ void VirtualMachine::execute_promote()
     );
 }
 
-void VirtualMachine::execute_assign()
+void VirtualMachine::execute_assign( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     const unsigned char* mask = rhs->storage() == STORAGE_VARYING ? get_mask() : NULL;
     result->reset( rhs->type(), rhs->storage(), rhs->size() );
     assign(
@@ -909,20 +1064,19 @@ void VirtualMachine::execute_assign()
     );
 }
 
-void VirtualMachine::execute_assign_string()
+void VirtualMachine::execute_assign_string( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[argument()];
-    shared_ptr<Value> value = registers_[argument()];
+    Value* result = registers_[instruction.arguments[0]];
+    Value* value = registers_[instruction.arguments[1]];
     const unsigned char* mask = value->storage() == STORAGE_VARYING ? get_mask() : NULL;
     result->assign_string( value, mask );
 }
 
-void VirtualMachine::execute_add_assign()
+void VirtualMachine::execute_add_assign( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     const unsigned char* mask = rhs->storage() == STORAGE_VARYING ? get_mask() : NULL;
     add_assign( 
         dispatch, 
@@ -933,11 +1087,11 @@ void VirtualMachine::execute_add_assign()
     );
 }
 
-void VirtualMachine::execute_subtract_assign()
+void VirtualMachine::execute_subtract_assign( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     const unsigned char* mask = rhs->storage() == STORAGE_VARYING ? get_mask() : NULL;
     subtract_assign( 
         dispatch, 
@@ -948,11 +1102,11 @@ void VirtualMachine::execute_subtract_assign()
     );
 }
 
-void VirtualMachine::execute_multiply_assign()
+void VirtualMachine::execute_multiply_assign( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     const unsigned char* mask = rhs->storage() == STORAGE_VARYING ? get_mask() : NULL;
     multiply_assign( 
         dispatch, 
@@ -963,11 +1117,11 @@ void VirtualMachine::execute_multiply_assign()
     );
 }
 
-void VirtualMachine::execute_divide_assign()
+void VirtualMachine::execute_divide_assign( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    shared_ptr<Value> result = registers_[argument()];
-    const shared_ptr<Value>& rhs = registers_[argument()];
+    int dispatch = instruction.dispatch;
+    Value* result = registers_[instruction.arguments[0]];
+    Value* rhs = registers_[instruction.arguments[1]];
     const unsigned char* mask = rhs->storage() == STORAGE_VARYING ? get_mask() : NULL;
     divide_assign( 
         dispatch, 
@@ -978,245 +1132,217 @@ void VirtualMachine::execute_divide_assign()
     );
 }
 
-void VirtualMachine::execute_float_texture()
+void VirtualMachine::execute_float_texture( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    int texturename = argument();
-    int s = argument();
-    int t = argument();
+    Value* result = registers_[instruction.result];
+    int texturename = instruction.arguments[0];
+    int s = instruction.arguments[1];
+    int t = instruction.arguments[2];
     REYES_ASSERT( renderer_ );
     float_texture( *renderer_, result, registers_[texturename], registers_[s], registers_[t] );
 }
 
-void VirtualMachine::execute_vec3_texture()
+void VirtualMachine::execute_vec3_texture( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    int texturename = argument();
-    int s = argument();
-    int t = argument();
+    Value* result = registers_[instruction.result];
+    int texturename = instruction.arguments[0];
+    int s = instruction.arguments[1];
+    int t = instruction.arguments[2];
     REYES_ASSERT( renderer_ );
     vec3_texture( *renderer_, result, registers_[texturename], registers_[s], registers_[t] );
 }
 
-void VirtualMachine::execute_float_environment()
+void VirtualMachine::execute_float_environment( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    int texturename = argument();
-    int direction = argument();
+    Value* result = registers_[instruction.result];
+    int texturename = instruction.arguments[0];
+    int direction = instruction.arguments[1];
     REYES_ASSERT( renderer_ );
     float_environment( *renderer_, result, registers_[texturename], registers_[direction] );
 }
 
-void VirtualMachine::execute_vec3_environment()
+void VirtualMachine::execute_vec3_environment( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    int texturename = argument();
-    int direction = argument();
+    Value* result = registers_[instruction.result];
+    int texturename = instruction.arguments[0];
+    int direction = instruction.arguments[1];
     REYES_ASSERT( renderer_ );
     vec3_environment( *renderer_, result, registers_[texturename], registers_[direction] );
 }
 
-void VirtualMachine::execute_shadow()
+void VirtualMachine::execute_shadow( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    int texturename = argument();
-    int position = argument();
-    int bias = argument();
+    Value* result = registers_[instruction.result];
+    int texturename = instruction.arguments[0];
+    int position = instruction.arguments[1];
+    int bias = instruction.arguments[2];
     REYES_ASSERT( renderer_ );
     shadow( *renderer_, result, registers_[texturename], registers_[position], registers_[bias] );
 }
 
-void VirtualMachine::execute_call_0()
+void VirtualMachine::execute_call_0( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    shared_ptr<Symbol> symbol = shader_->symbols()[argument()];
+    Value* result = registers_[instruction.result];
+    const Symbol* symbol = shader_->symbols()[instruction.arguments[0]].get();
     REYES_ASSERT( symbol->function() );
-    typedef void (*FunctionType)( const Renderer&, const Grid&, shared_ptr<Value> );
+    typedef void (*FunctionType)( const Renderer&, const Grid&, Value* );
     FunctionType function = reinterpret_cast<FunctionType>( symbol->function() );
     REYES_ASSERT( renderer_ );
     (*function)( *renderer_, *grid_, result );
 }
 
-void VirtualMachine::execute_call_1()
+void VirtualMachine::execute_call_1( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    shared_ptr<Symbol> symbol = shader_->symbols()[argument()];
-    shared_ptr<Value> arg0 = registers_[argument()];
-    typedef void (*FunctionType)( const Renderer&, const Grid&, shared_ptr<Value>, shared_ptr<Value> );
+    Value* result = registers_[instruction.result];
+    const Symbol* symbol = shader_->symbols()[instruction.arguments[0]].get();
+    Value* arg0 = registers_[instruction.arguments[1]];
+    typedef void (*FunctionType)( const Renderer&, const Grid&, Value*, const Value* );
     FunctionType function = reinterpret_cast<FunctionType>( symbol->function() );
     REYES_ASSERT( renderer_ );
     (*function)( *renderer_, *grid_, result, arg0 );
 }
 
-void VirtualMachine::execute_call_2()
+void VirtualMachine::execute_call_2( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    shared_ptr<Symbol> symbol = shader_->symbols()[argument()];
-    shared_ptr<Value> arg0 = registers_[argument()];
-    shared_ptr<Value> arg1 = registers_[argument()];
-    typedef void (*FunctionType)( const Renderer&, const Grid&, shared_ptr<Value>, shared_ptr<Value>, shared_ptr<Value> );
+    Value* result = registers_[instruction.result];
+    const Symbol* symbol = shader_->symbols()[instruction.arguments[0]].get();
+    Value* arg0 = registers_[instruction.arguments[1]];
+    Value* arg1 = registers_[instruction.arguments[2]];
+    typedef void (*FunctionType)( const Renderer&, const Grid&, Value*, const Value*, const Value* );
     FunctionType function = reinterpret_cast<FunctionType>( symbol->function() );
     REYES_ASSERT( renderer_ );
     (*function)( *renderer_, *grid_, result, arg0, arg1 );
 }
 
-void VirtualMachine::execute_call_3()
+void VirtualMachine::execute_call_3( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    shared_ptr<Symbol> symbol = shader_->symbols()[argument()];
-    shared_ptr<Value> arg0 = registers_[argument()];
-    shared_ptr<Value> arg1 = registers_[argument()];
-    shared_ptr<Value> arg2 = registers_[argument()];
-    typedef void (*FunctionType)( const Renderer&, const Grid&, shared_ptr<Value>, shared_ptr<Value>, shared_ptr<Value>, shared_ptr<Value> );
+    Value* result = registers_[instruction.result];
+    const Symbol* symbol = shader_->symbols()[instruction.arguments[0]].get();
+    Value* arg0 = registers_[instruction.arguments[1]];
+    Value* arg1 = registers_[instruction.arguments[2]];
+    Value* arg2 = registers_[instruction.arguments[3]];
+    typedef void (*FunctionType)( const Renderer&, const Grid&, Value*, const Value*, const Value*, const Value* );
     FunctionType function = reinterpret_cast<FunctionType>( symbol->function() );
     REYES_ASSERT( renderer_ );
     (*function)( *renderer_, *grid_, result, arg0, arg1, arg2 );
 }
 
-void VirtualMachine::execute_call_4()
+void VirtualMachine::execute_call_4( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    shared_ptr<Symbol> symbol = shader_->symbols()[argument()];
-    shared_ptr<Value> arg0 = registers_[argument()];
-    shared_ptr<Value> arg1 = registers_[argument()];
-    shared_ptr<Value> arg2 = registers_[argument()];
-    shared_ptr<Value> arg3 = registers_[argument()];
-    typedef void (*FunctionType)( const Renderer&, const Grid&, shared_ptr<Value>, shared_ptr<Value>, shared_ptr<Value>, shared_ptr<Value>, shared_ptr<Value> );
+    Value* result = registers_[instruction.result];
+    const Symbol* symbol = shader_->symbols()[instruction.arguments[0]].get();
+    Value* arg0 = registers_[instruction.arguments[1]];
+    Value* arg1 = registers_[instruction.arguments[2]];
+    Value* arg2 = registers_[instruction.arguments[3]];
+    Value* arg3 = registers_[instruction.arguments[4]];
+    typedef void (*FunctionType)( const Renderer&, const Grid&, Value*, const Value*, const Value*, const Value*, const Value* );
     FunctionType function = reinterpret_cast<FunctionType>( symbol->function() );
     REYES_ASSERT( renderer_ );
     (*function)( *renderer_, *grid_, result, arg0, arg1, arg2, arg3 );
 }
 
-void VirtualMachine::execute_call_5()
+void VirtualMachine::execute_call_5( const DecodedInstruction& instruction )
 {
-    word();
-    shared_ptr<Value> result = registers_[allocate_register()];
-    shared_ptr<Symbol> symbol = shader_->symbols()[argument()];
-    shared_ptr<Value> arg0 = registers_[argument()];
-    shared_ptr<Value> arg1 = registers_[argument()];
-    shared_ptr<Value> arg2 = registers_[argument()];
-    shared_ptr<Value> arg3 = registers_[argument()];
-    shared_ptr<Value> arg4 = registers_[argument()];
-    typedef void (*FunctionType)( const Renderer&, const Grid&, shared_ptr<Value>, shared_ptr<Value>, shared_ptr<Value>, shared_ptr<Value>, shared_ptr<Value>, shared_ptr<Value> );
-    FunctionType function = reinterpret_cast<FunctionType>( symbol->function() );
+    Value* result = registers_[instruction.result];
+    const Symbol* symbol = shader_->symbols()[instruction.arguments[0]].get();
+    Value* arg0 = registers_[instruction.arguments[1]];
+    Value* arg1 = registers_[instruction.arguments[2]];
+    Value* arg2 = registers_[instruction.arguments[3]];
+    Value* arg3 = registers_[instruction.arguments[4]];
+    Value* arg4 = registers_[instruction.arguments[5]];
     REYES_ASSERT( renderer_ );
-    (*function)( *renderer_, *grid_, result, arg0, arg1, arg2, arg3, arg4 );
+    if ( symbol->writes_arguments() )
+    {
+        typedef void (*FunctionType)( const Renderer&, const Grid&, Value*, const Value*, const Value*, const Value*, Value*, Value* );
+        FunctionType function = reinterpret_cast<FunctionType>( symbol->function() );
+        (*function)( *renderer_, *grid_, result, arg0, arg1, arg2, arg3, arg4 );
+    }
+    else
+    {
+        typedef void (*FunctionType)( const Renderer&, const Grid&, Value*, const Value*, const Value*, const Value*, const Value*, const Value* );
+        FunctionType function = reinterpret_cast<FunctionType>( symbol->function() );
+        (*function)( *renderer_, *grid_, result, arg0, arg1, arg2, arg3, arg4 );
+    }
 }
 
-void VirtualMachine::execute_ambient()
+void VirtualMachine::execute_ambient( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    (void) dispatch;
-
-    shared_ptr<Value>& light_color = registers_[argument()];
-    shared_ptr<Value>& light_opacity = registers_[argument()];
-
-    light_color.reset( new Value(TYPE_COLOR, STORAGE_VARYING, grid_->size()) );
-    light_color->zero();    
-    light_opacity.reset( new Value(TYPE_COLOR, STORAGE_VARYING, grid_->size()) );
-    light_opacity->zero();
-    
-    shared_ptr<Light> light( new Light(LIGHT_AMBIENT, light_color, light_opacity, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 0.0f), 0.0f) );
+    shared_ptr<Light> light = allocate_light( LIGHT_AMBIENT, instruction.arguments[0], instruction.arguments[1], vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 0.0f), 0.0f );
     grid_->add_light( light );                
 }
 
-void VirtualMachine::execute_solar_axis_angle()
+void VirtualMachine::execute_solar_axis_angle( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    (void) dispatch;
-
-    const shared_ptr<Value>& axis = registers_[argument()];
-    const shared_ptr<Value>& angle = registers_[argument()];    
-    shared_ptr<Value>& light_color = registers_[argument()];
-    shared_ptr<Value>& light_opacity = registers_[argument()];
-
-    light_color.reset( new Value(TYPE_COLOR, STORAGE_VARYING, grid_->size()) );
-    light_color->zero();
-    light_opacity.reset( new Value(TYPE_COLOR, STORAGE_VARYING, grid_->size()) );
-    light_opacity->zero();
-
-    shared_ptr<Light> light( new Light(LIGHT_SOLAR_AXIS_ANGLE, light_color, light_opacity, axis->vec3_value(), axis->vec3_value(), angle->float_value()) );
+    Value* axis = registers_[instruction.arguments[0]];
+    Value* angle = registers_[instruction.arguments[1]];    
+    shared_ptr<Light> light = allocate_light( LIGHT_SOLAR_AXIS_ANGLE, instruction.arguments[2], instruction.arguments[3], axis->vec3_value(), axis->vec3_value(), angle->float_value() );
     grid_->add_light( light );             
 }
 
-void VirtualMachine::execute_illuminate()
+void VirtualMachine::execute_illuminate( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    (void) dispatch;
-
-    const shared_ptr<Value>& P = registers_[argument()];
-    const shared_ptr<Value>& Ps = registers_[argument()];
-    const shared_ptr<Value>& L = registers_[argument()];
-    shared_ptr<Value>& light_color = registers_[argument()];
-    shared_ptr<Value>& light_opacity = registers_[argument()];
+    Value* P = registers_[instruction.arguments[0]];
+    Value* Ps = registers_[instruction.arguments[1]];
+    Value* L = registers_[instruction.arguments[2]];
+    shared_ptr<Light> light = allocate_light( LIGHT_ILLUMINATE, instruction.arguments[3], instruction.arguments[4], P->vec3_value(), vec3(0.0f, 0.0f, 0.0f), 0.0f );
 
     L->light_to_surface_vector( Ps, P->vec3_value() );
-    light_color.reset( new Value(TYPE_COLOR, STORAGE_VARYING, grid_->size()) );
-    light_color->zero();
-    light_opacity.reset( new Value(TYPE_COLOR, STORAGE_VARYING, grid_->size()) );
-    light_opacity->zero();
-
-    shared_ptr<Light> light( new Light(LIGHT_ILLUMINATE, light_color, light_opacity, P->vec3_value(), vec3(0.0f, 0.0f, 0.0f), 0.0f) );
     grid_->add_light( light );
 }
 
-void VirtualMachine::execute_illuminate_axis_angle()
+void VirtualMachine::execute_illuminate_axis_angle( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    (void) dispatch;
-
-    const shared_ptr<Value>& P = registers_[argument()];
-    const shared_ptr<Value>& axis = registers_[argument()];
-    const shared_ptr<Value>& angle = registers_[argument()];                
-    const shared_ptr<Value>& Ps = registers_[argument()];
-    const shared_ptr<Value>& L = registers_[argument()];
-    shared_ptr<Value>& light_color = registers_[argument()];
-    shared_ptr<Value>& light_opacity = registers_[argument()];
+    Value* P = registers_[instruction.arguments[0]];
+    Value* axis = registers_[instruction.arguments[1]];
+    Value* angle = registers_[instruction.arguments[2]];                
+    Value* Ps = registers_[instruction.arguments[3]];
+    Value* L = registers_[instruction.arguments[4]];
+    shared_ptr<Light> light = allocate_light( LIGHT_ILLUMINATE_AXIS_ANGLE, instruction.arguments[5], instruction.arguments[6], P->vec3_value(), axis->vec3_value(), angle->float_value() );
 
     L->light_to_surface_vector( Ps, P->vec3_value() );
-    light_color.reset( new Value(TYPE_COLOR, STORAGE_VARYING, grid_->size()) );
-    light_color->zero();
-    light_opacity.reset( new Value(TYPE_COLOR, STORAGE_VARYING, grid_->size()) );
-    light_opacity->zero();
-
-    shared_ptr<Light> light( new Light(LIGHT_ILLUMINATE_AXIS_ANGLE, light_color, light_opacity, P->vec3_value(), axis->vec3_value(), angle->float_value()) );
     grid_->add_light( light );
 }
 
-void VirtualMachine::execute_illuminance_axis_angle()
+void VirtualMachine::execute_illuminance_axis_angle( const DecodedInstruction& instruction )
 {
-    int dispatch = word();
-    (void) dispatch;
-
-    const shared_ptr<Value>& P = registers_[argument()];
-    const shared_ptr<Value>& axis = registers_[argument()];
-    const shared_ptr<Value>& angle = registers_[argument()];
-    const shared_ptr<Value>& L = registers_[argument()];
-    const shared_ptr<Value>& light_color = registers_[argument()];
-    const shared_ptr<Value>& light_opacity = registers_[argument()];                
-    const shared_ptr<Value>& result = registers_[allocate_register()];
+    Value* P = registers_[instruction.arguments[0]];
+    Value* axis = registers_[instruction.arguments[1]];
+    Value* angle = registers_[instruction.arguments[2]];
+    Value* L = registers_[instruction.arguments[3]];
+    Value* light_color = registers_[instruction.arguments[4]];
+    Value* light_opacity = registers_[instruction.arguments[5]];                
+    Value* result = registers_[instruction.result];
 
     const Light* light = grid_->get_light( light_index_ );                
     result->illuminance_axis_angle( P, axis, angle, light );
     L->surface_to_light_vector( P, light );
+
+    // Lights evaluated once for all grids store uniform color and opacity
+    // that are broadcast into the varying registers read by the body of the
+    // illuminance statement.
     light_color->reset( TYPE_COLOR, STORAGE_VARYING, grid_->size() );
-    assign( DISPATCH_V3V3, (float*) light_color->values(), (const float*) light->color()->values(), nullptr, grid_->size() );
+    if ( light->color()->storage() == STORAGE_UNIFORM )
+    {
+        promote( DISPATCH_V3U3, (float*) light_color->values(), (const float*) light->color()->values(), grid_->size() );
+    }
+    else
+    {
+        assign( DISPATCH_V3V3, (float*) light_color->values(), (const float*) light->color()->values(), nullptr, grid_->size() );
+    }
+
     light_opacity->reset( TYPE_COLOR, STORAGE_VARYING, grid_->size() );
-    assign( DISPATCH_V3V3, (float*) light_opacity->values(), (const float*) light->opacity()->values(), nullptr, grid_->size() );
+    if ( light->opacity()->storage() == STORAGE_UNIFORM )
+    {
+        promote( DISPATCH_V3U3, (float*) light_opacity->values(), (const float*) light->opacity()->values(), grid_->size() );
+    }
+    else
+    {
+        assign( DISPATCH_V3V3, (float*) light_opacity->values(), (const float*) light->opacity()->values(), nullptr, grid_->size() );
+    }
 }
 
 
-void VirtualMachine::float_texture( const Renderer& renderer, std::shared_ptr<Value> result, std::shared_ptr<Value> texturename, std::shared_ptr<Value> s, std::shared_ptr<Value> t ) const
+void VirtualMachine::float_texture( const Renderer& renderer, Value* result, const Value* texturename, const Value* s, const Value* t ) const
 {
     REYES_ASSERT( result );
     REYES_ASSERT( texturename );
@@ -1231,7 +1357,7 @@ void VirtualMachine::float_texture( const Renderer& renderer, std::shared_ptr<Va
 
     result->reset( TYPE_FLOAT, STORAGE_VARYING, s->size() );
 
-    const Texture* texture = renderer.find_texture( texturename->string_value().c_str() );
+    const Texture* texture = renderer.find_texture( texturename->string_identifier() );
     if ( texture && texture->valid() )
     {
         const float* s_values = s->float_values();    
@@ -1248,7 +1374,7 @@ void VirtualMachine::float_texture( const Renderer& renderer, std::shared_ptr<Va
     }
 }
 
-void VirtualMachine::vec3_texture( const Renderer& renderer, std::shared_ptr<Value> result, std::shared_ptr<Value> texturename, std::shared_ptr<Value> s, std::shared_ptr<Value> t ) const
+void VirtualMachine::vec3_texture( const Renderer& renderer, Value* result, const Value* texturename, const Value* s, const Value* t ) const
 {
     REYES_ASSERT( result );
     REYES_ASSERT( texturename );
@@ -1263,7 +1389,7 @@ void VirtualMachine::vec3_texture( const Renderer& renderer, std::shared_ptr<Val
 
     result->reset( TYPE_COLOR, STORAGE_VARYING, s->size() );
 
-    const Texture* texture = renderer.find_texture( texturename->string_value().c_str() );
+    const Texture* texture = renderer.find_texture( texturename->string_identifier() );
     if ( texture && texture->valid() )
     {
         const float* s_values = s->float_values();    
@@ -1280,7 +1406,7 @@ void VirtualMachine::vec3_texture( const Renderer& renderer, std::shared_ptr<Val
     }
 }
 
-void VirtualMachine::float_environment( const Renderer& renderer, std::shared_ptr<Value> result, std::shared_ptr<Value> texturename, std::shared_ptr<Value> direction ) const
+void VirtualMachine::float_environment( const Renderer& renderer, Value* result, const Value* texturename, const Value* direction ) const
 {
     REYES_ASSERT( result );
     REYES_ASSERT( texturename );
@@ -1290,7 +1416,7 @@ void VirtualMachine::float_environment( const Renderer& renderer, std::shared_pt
 
     result->reset( TYPE_FLOAT, STORAGE_VARYING, direction->size() );
 
-    const Texture* texture = renderer.find_texture( texturename->string_value().c_str() );
+    const Texture* texture = renderer.find_texture( texturename->string_identifier() );
     if ( texture && texture->valid() )
     {
         const vec3* directions = direction->vec3_values();    
@@ -1306,7 +1432,7 @@ void VirtualMachine::float_environment( const Renderer& renderer, std::shared_pt
     }
 }
 
-void VirtualMachine::vec3_environment( const Renderer& renderer, std::shared_ptr<Value> result, std::shared_ptr<Value> texturename, std::shared_ptr<Value> direction ) const
+void VirtualMachine::vec3_environment( const Renderer& renderer, Value* result, const Value* texturename, const Value* direction ) const
 {
     REYES_ASSERT( result );
     REYES_ASSERT( texturename );
@@ -1316,7 +1442,7 @@ void VirtualMachine::vec3_environment( const Renderer& renderer, std::shared_ptr
 
     result->reset( TYPE_COLOR, STORAGE_VARYING, direction->size() );
 
-    const Texture* texture = renderer.find_texture( texturename->string_value().c_str() );
+    const Texture* texture = renderer.find_texture( texturename->string_identifier() );
     if ( texture && texture->valid() )
     {
         const vec3* directions = direction->vec3_values();    
@@ -1332,7 +1458,7 @@ void VirtualMachine::vec3_environment( const Renderer& renderer, std::shared_ptr
     }
 }
 
-void VirtualMachine::shadow( const Renderer& renderer, std::shared_ptr<Value> result, std::shared_ptr<Value> texturename, std::shared_ptr<Value> position, std::shared_ptr<Value> bias ) const
+void VirtualMachine::shadow( const Renderer& renderer, Value* result, const Value* texturename, const Value* position, const Value* bias ) const
 {
     REYES_ASSERT( result );
     REYES_ASSERT( texturename );
@@ -1345,7 +1471,7 @@ void VirtualMachine::shadow( const Renderer& renderer, std::shared_ptr<Value> re
 
     result->reset( TYPE_FLOAT, STORAGE_VARYING, position->size() );
 
-    const Texture* texture = renderer.find_texture( texturename->string_value().c_str() );
+    const Texture* texture = renderer.find_texture( texturename->string_identifier() );
     if ( texture && texture->valid() )
     {
         const mat4x4 world = inverse( renderer.camera_transform() );
@@ -1363,22 +1489,28 @@ void VirtualMachine::shadow( const Renderer& renderer, std::shared_ptr<Value> re
     }
 }
 
-void VirtualMachine::push_mask( std::shared_ptr<Value> value )
+void VirtualMachine::push_mask( const Value* value )
 {
     REYES_ASSERT( value );
     REYES_ASSERT( value->type() == TYPE_INTEGER );
 
-    if ( masks_.empty() )
+    // Masks popped earlier are swapped back onto the stack so that their 
+    // buffers are reused rather than allocated for every mask pushed.
+    REYES_ASSERT( masks_.capacity() > masks_.size() );
+    masks_.push_back( ConditionMask() );
+    if ( !free_masks_.empty() )
+    {
+        swap( masks_.back(), free_masks_.back() );
+        free_masks_.pop_back();
+    }
+
+    if ( masks_.size() == 1 )
     {
-        REYES_ASSERT( masks_.capacity() > masks_.size() );
-        masks_.push_back( ConditionMask() );
         masks_.back().generate( value );
     }
     else
     {    
-        REYES_ASSERT( masks_.capacity() > masks_.size() );
-        ConditionMask& existing_mask = masks_.back();
-        masks_.push_back( ConditionMask() );
+        const ConditionMask& existing_mask = masks_[masks_.size() - 2];
         masks_.back().generate( existing_mask, value );
     }
 }
@@ -1386,6 +1518,9 @@ void VirtualMachine::push_mask( std::shared_ptr<Value> value )
 void VirtualMachine::pop_mask()
 {
     REYES_ASSERT( !masks_.empty() );
+    REYES_ASSERT( free_masks_.capacity() > free_masks_.size() );
+    free_masks_.push_back( ConditionMask() );
+    swap( free_masks_.back(), masks_.back() );
     masks_.pop_back();
 }
 
@@ -1413,14 +1548,96 @@ const unsigned char* VirtualMachine::get_mask() const
     return !masks_.empty() ? &masks_.back().mask()[0] : NULL;
 }
 
-void VirtualMachine::reset_register( int index )
+/**
+// Get the current condition mask if operations writing to \e result should
+// only process the runs of elements that it processes.
+//
+// @param result
+//  The value that an operation is about to write its results to.
+//
+// @return
+//  The current condition mask if \e result is varying and the mask is 
+//  sparse otherwise null.
+*/
+const ConditionMask* VirtualMachine::get_sparse_mask( const Value* result ) const
 {
-    REYES_ASSERT( shader_ );
-    REYES_ASSERT( index >= shader_->permanent_registers() );
-    register_index_ = index;
+    REYES_ASSERT( result );
+    if ( result->storage() == STORAGE_VARYING && !masks_.empty() && masks_.back().sparse() )
+    {
+        return &masks_.back();
+    }
+    return NULL;
 }
 
-int VirtualMachine::allocate_register()
+/**
+// Allocate a light to return the results of an ambient, solar, or 
+// illuminate statement in and bind its color and opacity to registers.
+//
+// Lights are owned by the grids that they are added to rather than by this
+// virtual machine so that they outlive the execution of the light shader.
+// Lights that are no longer referred to by any grid are reused along with
+// their color and opacity values so that running light shaders doesn't 
+// allocate once enough lights have been allocated.
+//
+// @param type
+//  The type of light.
+//
+// @param color_index
+//  The index of the register to bind the light's color to.
+//
+// @param opacity_index
+//  The index of the register to bind the light's opacity to.
+//
+// @param position
+//  The position of the light.
+//
+// @param axis
+//  The axis of the light.
+//
+// @param angle
+//  The angle of the cone of light.
+//
+// @return
+//  The light.
+*/
+std::shared_ptr<Light> VirtualMachine::allocate_light( LightType type, int color_index, int opacity_index, const math::vec3& position, const math::vec3& axis, float angle )
 {
-    return register_index_++;
+    shared_ptr<Light> light;
+    for ( vector<shared_ptr<Light>>::const_iterator i = lights_.begin(); i != lights_.end() && !light; ++i )
+    {
+        if ( i->use_count() == 1 )
+        {
+            light = *i;
+        }
+    }
+
+    if ( !light )
+    {
+        light.reset( new Light(type, shared_ptr<Value>(new Value()), shared_ptr<Value>(new Value()), position, axis, angle) );
+        lights_.push_back( light );
+    }
+
+    light->reset( type, position, axis, angle );
+    bind_light_register( color_index, light->color().get() );
+    bind_light_register( opacity_index, light->opacity().get() );
+    return light;
+}
+
+/**
+// Reset a light's color or opacity to a zeroed, varying color and bind it 
+// to a register to receive the color or opacity calculated for the light.
+//
+// @param index
+//  The index of the register to bind \e value to.
+//
+// @param value
+//  The light's color or opacity (assumed not null).
+*/
+void VirtualMachine::bind_light_register( int index, Value* value )
+{
+    REYES_ASSERT( index >= 0 && index < int(registers_.size()) );
+    REYES_ASSERT( value );
+    value->reset( TYPE_COLOR, STORAGE_VARYING, grid_->size() );
+    value->zero();
+    registers_[index] = value;
 }
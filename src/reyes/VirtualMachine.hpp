@@ -2,6 +2,9 @@
 #define REYES_VIRTUALMACHINE_HPP_INCLUDED
 
 #include <reyes/reyes_virtual_machine/ConditionMask.hpp>
+#include <reyes/reyes_virtual_machine/DecodedInstruction.hpp>
+#include "Value.hpp"
+#include "LightType.hpp"
 #include <math/vec4.hpp>
 #include <math/vec3.hpp>
 #include <vector>
@@ -13,8 +16,10 @@ namespace reyes
 
 class Grid;
 class Value;
+class Light;
 class Shader;
 class Renderer;
+class Profile;
 
 /**
 // A virtual machine that interprets the code generated for shaders to execute
@@ -24,101 +29,114 @@ class VirtualMachine
 {
     const Renderer* renderer_; ///< The Renderer that this virtual machine is part of.
     Grid* grid_; ///< The grid of micropolygon vertices that is currently being shaded (null if no shader is being executed).
-    Shader* shader_; ///< The shader that is currently being executed (null if no shader is being executed).
-    std::vector<std::shared_ptr<Value> > values_; ///< The values allocated for use as temporary registers by this virtual machine.
-    std::vector<std::shared_ptr<Value> > registers_; ///< The values loaded into registers by this virtual machine (some from grid, some temporary).
-    int register_index_; ///< The index of the next available register.
+    const Shader* shader_; ///< The shader that is currently being executed (null if no shader is being executed).
+    std::vector<float> memory_; ///< The contiguous block of memory that stores the values of temporary registers.
+    unsigned int register_floats_; ///< The number of floats in each temporary register's slot in memory_.
+    std::vector<Value> values_; ///< The values allocated for use as temporary registers by this virtual machine (backed by memory_).
+    std::vector<Value*> registers_; ///< The values loaded into registers by this virtual machine (some from grid, some temporary).
     int light_index_; ///< The index of the current light (or INT_MAX if there is no current light).
-    const unsigned char* code_begin_; ///< The address of the beginning of loaded code.
-    const unsigned char* code_end_; ///< The address one past the end of loaded code.
-    const unsigned char* code_; ///< The currently executed instruction.
+    const DecodedInstruction* instructions_; ///< The first instruction decoded for the current shader (jumps are relative to this).
+    const DecodedInstruction* instructions_begin_; ///< The first instruction of the loaded code.
+    const DecodedInstruction* instructions_end_; ///< One past the last instruction of the loaded code.
+    const DecodedInstruction* instruction_; ///< The next instruction to execute.
     std::vector<ConditionMask> masks_; ///< The stack of condition masks that specify which elements to use during assignment.
+    std::vector<ConditionMask> free_masks_; ///< The condition masks popped from masks_ to be reused by push_mask().
+    std::vector<std::shared_ptr<Light>> lights_; ///< The lights returned by light shaders (reused once no grid refers to them).
+    Profile* profile_; ///< The Profile to count instructions executed into (null to execute without counting).
+
+    typedef void (VirtualMachine::*ExecuteFunction)( const DecodedInstruction& instruction );
+    static const ExecuteFunction execute_functions_[]; ///< The functions that execute each instruction indexed by instruction.
     
 public:
     VirtualMachine();
     VirtualMachine( const Renderer& renderer );
-    void initialize( Grid& parameters, Shader& shader );
-    void shade( Grid& globals, Grid& parameters, Shader& shader );
+    void initialize( Grid& parameters, const Shader& shader );
+    void shade( Grid& globals, Grid& parameters, const Shader& shader );
+    void set_profile( Profile* profile );
+    Profile* profile() const;
+    int temporary_registers() const;
+    const Value& temporary_register( int index ) const;
     
 private:
     void construct( int start, int finish );
+    void allocate_registers( int registers, int grid_size );
     void initialize_registers( Grid& grid );
+    void promote_registers( const Grid& grid );
     void execute();
-    void jump_illuminance( int distance );
-    void jump( int distance );
-    int instruction();
-    int argument();
-    int word();
-    int quad();
+    void execute_profiled();
+    void jump_illuminance( int target );
+    void jump( int target );
     
-    void execute_halt();
-    void execute_reset();
-    void execute_clear_mask();
-    void execute_generate_mask();
-    void execute_invert_mask();
-    void execute_jump_empty();
-    void execute_jump_not_empty();
-    void execute_jump_illuminance();
-    void execute_jump();
-    void execute_transform_point();
-    void execute_transform_vector();
-    void execute_transform_normal();
-    void execute_transform_color();
-    void execute_transform_matrix();
-    void execute_dot();
-    void execute_multiply();
-    void execute_divide();
-    void execute_add();
-    void execute_subtract();
-    void execute_greater();
-    void execute_greater_equal();
-    void execute_less();
-    void execute_less_equal();
-    void execute_and();
-    void execute_or();
-    void execute_equal();
-    void execute_not_equal();
-    void execute_negate();
-    void execute_convert();
-    void execute_promote();
-    void execute_assign();
-    void execute_assign_string();
-    void execute_add_assign();
-    void execute_subtract_assign();
-    void execute_multiply_assign();
-    void execute_divide_assign();
-    void execute_float_texture();
-    void execute_vec3_texture();
-    void execute_float_environment();
-    void execute_vec3_environment();
-    void execute_shadow();
-    void execute_call_0();
-    void execute_call_1();
-    void execute_call_2();
-    void execute_call_3();
-    void execute_call_4();
-    void execute_call_5();
-    void execute_ambient();
-    void execute_solar();
-    void execute_solar_axis_angle();
-    void execute_illuminate();
-    void execute_illuminate_axis_angle();
-    void execute_illuminance_axis_angle();
+    void execute_null( const DecodedInstruction& instruction );
+    void execute_halt( const DecodedInstruction& instruction );
+    void execute_clear_mask( const DecodedInstruction& instruction );
+    void execute_generate_mask( const DecodedInstruction& instruction );
+    void execute_invert_mask( const DecodedInstruction& instruction );
+    void execute_jump_empty( const DecodedInstruction& instruction );
+    void execute_jump_not_empty( const DecodedInstruction& instruction );
+    void execute_jump_illuminance( const DecodedInstruction& instruction );
+    void execute_jump( const DecodedInstruction& instruction );
+    void execute_transform_point( const DecodedInstruction& instruction );
+    void execute_transform_vector( const DecodedInstruction& instruction );
+    void execute_transform_normal( const DecodedInstruction& instruction );
+    void execute_transform_color( const DecodedInstruction& instruction );
+    void execute_transform_matrix( const DecodedInstruction& instruction );
+    void execute_dot( const DecodedInstruction& instruction );
+    void execute_multiply( const DecodedInstruction& instruction );
+    void execute_divide( const DecodedInstruction& instruction );
+    void execute_add( const DecodedInstruction& instruction );
+    void execute_subtract( const DecodedInstruction& instruction );
+    void execute_multiply_add( const DecodedInstruction& instruction );
+    void execute_greater( const DecodedInstruction& instruction );
+    void execute_greater_equal( const DecodedInstruction& instruction );
+    void execute_less( const DecodedInstruction& instruction );
+    void execute_less_equal( const DecodedInstruction& instruction );
+    void execute_and( const DecodedInstruction& instruction );
+    void execute_or( const DecodedInstruction& instruction );
+    void execute_equal( const DecodedInstruction& instruction );
+    void execute_not_equal( const DecodedInstruction& instruction );
+    void execute_negate( const DecodedInstruction& instruction );
+    void execute_convert( const DecodedInstruction& instruction );
+    void execute_promote( const DecodedInstruction& instruction );
+    void execute_assign( const DecodedInstruction& instruction );
+    void execute_assign_string( const DecodedInstruction& instruction );
+    void execute_add_assign( const DecodedInstruction& instruction );
+    void execute_subtract_assign( const DecodedInstruction& instruction );
+    void execute_multiply_assign( const DecodedInstruction& instruction );
+    void execute_divide_assign( const DecodedInstruction& instruction );
+    void execute_float_texture( const DecodedInstruction& instruction );
+    void execute_vec3_texture( const DecodedInstruction& instruction );
+    void execute_float_environment( const DecodedInstruction& instruction );
+    void execute_vec3_environment( const DecodedInstruction& instruction );
+    void execute_shadow( const DecodedInstruction& instruction );
+    void execute_call_0( const DecodedInstruction& instruction );
+    void execute_call_1( const DecodedInstruction& instruction );
+    void execute_call_2( const DecodedInstruction& instruction );
+    void execute_call_3( const DecodedInstruction& instruction );
+    void execute_call_4( const DecodedInstruction& instruction );
+    void execute_call_5( const DecodedInstruction& instruction );
+    void execute_ambient( const DecodedInstruction& instruction );
+    void execute_solar( const DecodedInstruction& instruction );
+    void execute_solar_axis_angle( const DecodedInstruction& instruction );
+    void execute_illuminate( const DecodedInstruction& instruction );
+    void execute_illuminate_axis_angle( const DecodedInstruction& instruction );
+    void execute_illuminance_axis_angle( const DecodedInstruction& instruction );
 
-    void float_texture( const Renderer& renderer, std::shared_ptr<Value> result, std::shared_ptr<Value> texturename, std::shared_ptr<Value> s, std::shared_ptr<Value> t ) const;
-    void vec3_texture( const Renderer& renderer, std::shared_ptr<Value> result, std::shared_ptr<Value> texturename, std::shared_ptr<Value> s, std::shared_ptr<Value> t ) const;
-    void float_environment( const Renderer& renderer, std::shared_ptr<Value> result, std::shared_ptr<Value> texturename, std::shared_ptr<Value> direction ) const;
-    void vec3_environment( const Renderer& renderer, std::shared_ptr<Value> result, std::shared_ptr<Value> texturename, std::shared_ptr<Value> direction ) const;
-    void shadow( const Renderer& renderer, std::shared_ptr<Value> result, std::shared_ptr<Value> texturename, std::shared_ptr<Value> position, std::shared_ptr<Value> bias ) const;
+    void float_texture( const Renderer& renderer, Value* result, const Value* texturename, const Value* s, const Value* t ) const;
+    void vec3_texture( const Renderer& renderer, Value* result, const Value* texturename, const Value* s, const Value* t ) const;
+    void float_environment( const Renderer& renderer, Value* result, const Value* texturename, const Value* direction ) const;
+    void vec3_environment( const Renderer& renderer, Value* result, const Value* texturename, const Value* direction ) const;
+    void shadow( const Renderer& renderer, Value* result, const Value* texturename, const Value* position, const Value* bias ) const;
     
-    void push_mask( std::shared_ptr<Value> value );
+    void push_mask( const Value* value );
     void pop_mask();
     void invert_mask();
     bool mask_empty() const;
     const unsigned char* get_mask() const;
+    const ConditionMask* get_sparse_mask( const Value* result ) const;
         
-    void reset_register( int index );
-    int allocate_register();
+    std::shared_ptr<Light> allocate_light( LightType type, int color_index, int opacity_index, const math::vec3& position, const math::vec3& axis, float angle );
+    void bind_light_register( int index, Value* value );
 };
 
 }
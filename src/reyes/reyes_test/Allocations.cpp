@@ -0,0 +1,120 @@
+
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Renderer.hpp>
+#include <reyes/Shader.hpp>
+#include <reyes/Grid.hpp>
+#include <reyes/Value.hpp>
+#include <reyes/assert.hpp>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace reyes;
+
+static bool count_allocations = false;
+static int allocations = 0;
+
+void* operator new( std::size_t size )
+{
+    if ( count_allocations )
+    {
+        ++allocations;
+    }
+    void* pointer = malloc( size > 0 ? size : 1 );
+    if ( !pointer )
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete( void* pointer ) noexcept
+{
+    free( pointer );
+}
+
+void operator delete( void* pointer, std::size_t /*size*/ ) noexcept
+{
+    free( pointer );
+}
+
+static const char* DISPLACEMENT_SHADER_SOURCE = 
+    "displacement allocations() { \n"
+    "   if ( s > 0.5 ) { \n"
+    "       P += 0.01 * normalize(N); \n"
+    "   } \n"
+    "   N = calculatenormal(P); \n"
+    "} \n"
+;
+
+SUITE( Allocations )
+{
+    struct AllocationTest
+    {
+        Renderer renderer;
+        Shader displacement_shader;
+        Shader surface_shader;
+        Shader point_light_shader;
+        Shader ambient_light_shader;
+
+        AllocationTest()
+        : renderer(),
+          displacement_shader( DISPLACEMENT_SHADER_SOURCE, DISPLACEMENT_SHADER_SOURCE + strlen(DISPLACEMENT_SHADER_SOURCE), renderer.symbol_table(), renderer.error_policy() ),
+          surface_shader( SHADERS_PATH "plastic.sl", renderer.symbol_table(), renderer.error_policy() ),
+          point_light_shader( SHADERS_PATH "pointlight.sl", renderer.symbol_table(), renderer.error_policy() ),
+          ambient_light_shader( SHADERS_PATH "ambientlight.sl", renderer.symbol_table(), renderer.error_policy() )
+        {
+            renderer.begin();
+            renderer.perspective( 3.14159f / 2.0f );
+            renderer.projection();
+            renderer.begin_world();
+            renderer.light_shader( &ambient_light_shader );
+            renderer.light_shader( &point_light_shader );
+            renderer.displacement_shader( &displacement_shader );
+            renderer.surface_shader( &surface_shader );
+
+            // Far enough away to dice into a single grid without splitting.
+            renderer.translate( 0.0f, 0.0f, 50.0f );
+        }
+
+        int count_allocations_in_spheres( int spheres )
+        {
+            allocations = 0;
+            count_allocations = true;
+            for ( int i = 0; i < spheres; ++i )
+            {
+                renderer.sphere( 1.0f );
+            }
+            count_allocations = false;
+            return allocations;
+        }
+    };
+
+    TEST_FIXTURE( AllocationTest, shading_grids_does_not_allocate_after_warm_up )
+    {
+        const int WARM_UP_SPHERES = 2;
+        for ( int i = 0; i < WARM_UP_SPHERES; ++i )
+        {
+            renderer.sphere( 1.0f );
+        }
+        CHECK_EQUAL( 0, count_allocations_in_spheres(4) );
+    }
+
+    TEST_FIXTURE( AllocationTest, cleared_grids_reuse_their_values )
+    {
+        Grid grid;
+        grid.resize( 8, 8 );
+        grid.add_value( "P", TYPE_POINT )->zero();
+        grid.add_value( "x", TYPE_FLOAT, STORAGE_UNIFORM )->zero();
+        grid.clear();
+
+        allocations = 0;
+        count_allocations = true;
+        grid.resize( 8, 8 );
+        grid.add_value( "P", TYPE_POINT )->zero();
+        grid.add_value( "x", TYPE_FLOAT, STORAGE_UNIFORM )->zero();
+        grid.clear();
+        count_allocations = false;
+        CHECK_EQUAL( 0, allocations );
+    }
+}
@@ -8,6 +8,7 @@
 #include <reyes/Value.hpp>
 #include <reyes/ErrorCode.hpp>
 #include <reyes/assert.hpp>
+#include <math/vec3.ipp>
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <string.h>
@@ -109,6 +110,40 @@ SUITE( AssignExpressions )
         );
         CHECK_CLOSE( 1.0f, x[0], TOLERANCE );
     }
+
+    TEST_FIXTURE( AssignExpressionTest, subtract_assign_varying_from_constant )
+    {
+        x[0] = 1.0f;
+        x[1] = 2.0f;
+        x[2] = 3.0f;
+        x[3] = 4.0f;
+        test(
+            "surface subtract_assign_varying_from_constant() { \n"
+            "   x -= 1; \n"
+            "}"
+        );
+        CHECK_CLOSE( 0.0f, x[0], TOLERANCE );
+        CHECK_CLOSE( 1.0f, x[1], TOLERANCE );
+        CHECK_CLOSE( 2.0f, x[2], TOLERANCE );
+        CHECK_CLOSE( 3.0f, x[3], TOLERANCE );
+    }
+
+    TEST_FIXTURE( AssignExpressionTest, subtract_assign_uniform_in_loop )
+    {
+        test(
+            "surface subtract_assign_uniform_in_loop() { \n"
+            "   uniform float i = 4; \n"
+            "   while ( i > 0 ) { \n"
+            "       y += 1; \n"
+            "       i -= 1; \n"
+            "   } \n"
+            "   x = i; \n"
+            "}"
+        );
+        CHECK_CLOSE( 0.0f, x[0], TOLERANCE );
+        CHECK_CLOSE( 4.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 4.0f, y[3], TOLERANCE );
+    }
     
     TEST_FIXTURE( AssignExpressionTest, assign_constant_from_constant_fails )
     {
@@ -166,4 +201,177 @@ SUITE( AssignExpressions )
         CHECK_CLOSE( float(M_PI), x[2], TOLERANCE );
         CHECK_CLOSE( float(M_PI), x[3], TOLERANCE );
     }
+    
+    TEST_FIXTURE( AssignExpressionTest, assign_to_inferred_storage )
+    {
+        x[1] = 1.0f;
+        x[3] = 1.0f;
+        test(
+            "surface assign_to_inferred_storage() { \n"
+            "   float a = 2; \n"
+            "   float b = a * 3; \n"
+            "   float c = 0; \n"
+            "   if ( x > 0.5 ) { \n"
+            "       c = b; \n"
+            "   } \n"
+            "   y = b + c; \n"
+            "}"
+        );
+        CHECK_CLOSE( 6.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 12.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 6.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 12.0f, y[3], TOLERANCE );
+    }
+
+    /**
+    // Evaluate expressions over a grid whose size isn't a multiple of four 
+    // so that the vectorized kernels process whole groups of four elements
+    // and then finish the remaining elements one at a time.
+    //
+    // The mask used by masked assignments (set where x > 0) is mixed in 
+    // the first group of four elements, clear in the second, set in the 
+    // third, and mixed in the remaining elements.
+    */
+    struct SimdExpressionTest
+    {
+        enum
+        {
+            SIZE = 15
+        };
+
+        Grid grid;
+        float* x;
+        float* y;
+        vec3* c;
+        vec3* d;
+
+        SimdExpressionTest()
+        : grid(),
+          x( NULL ),
+          y( NULL ),
+          c( NULL ),
+          d( NULL )
+        {
+            grid.resize( 5, 3 );
+            REYES_ASSERT( grid.size() == SIZE );
+
+            x = grid.add_value( "x", TYPE_FLOAT )->float_values();
+            y = grid.add_value( "y", TYPE_FLOAT )->float_values();
+            c = grid.add_value( "c", TYPE_COLOR )->vec3_values();
+            d = grid.add_value( "d", TYPE_COLOR )->vec3_values();
+
+            const bool MASK [SIZE] = { 
+                true, false, true, true, 
+                false, false, false, false, 
+                true, true, true, true, 
+                false, true, false 
+            };
+            for ( int i = 0; i < SIZE; ++i )
+            {
+                const float value = float(i + 1);
+                x[i] = MASK[i] ? value : -value;
+                y[i] = -1.0f;
+                c[i] = vec3( value, 2.0f * value, 3.0f * value );
+                d[i] = vec3( -1.0f, -1.0f, -1.0f );
+            }
+        }
+
+        void test( const char* source )
+        {
+            ErrorPolicy error_policy;
+            SymbolTable symbol_table;
+            symbol_table.add_symbols()
+                ( "x", TYPE_FLOAT )
+                ( "y", TYPE_FLOAT )
+                ( "c", TYPE_COLOR )
+                ( "d", TYPE_COLOR )
+            ;
+            Shader shader( source, source + strlen(source), symbol_table, error_policy );
+            VirtualMachine virtual_machine;
+            virtual_machine.initialize( grid, shader );
+            virtual_machine.shade( grid, grid, shader );
+        }
+
+        void check_close( const vec3& expected, const vec3& actual ) const
+        {
+            CHECK_CLOSE( expected.x, actual.x, TOLERANCE );
+            CHECK_CLOSE( expected.y, actual.y, TOLERANCE );
+            CHECK_CLOSE( expected.z, actual.z, TOLERANCE );
+        }
+    };
+
+    TEST_FIXTURE( SimdExpressionTest, varying_color_times_varying_float )
+    {
+        test(
+            "surface varying_color_times_varying_float() { \n"
+            "   d = c * x; \n"
+            "}"
+        );
+        for ( int i = 0; i < SIZE; ++i )
+        {
+            check_close( c[i] * x[i], d[i] );
+        }
+    }
+
+    TEST_FIXTURE( SimdExpressionTest, uniform_color_times_varying_float )
+    {
+        test(
+            "surface uniform_color_times_varying_float() { \n"
+            "   d = color(1, 2, 3) * x; \n"
+            "}"
+        );
+        for ( int i = 0; i < SIZE; ++i )
+        {
+            check_close( vec3(1.0f, 2.0f, 3.0f) * x[i], d[i] );
+        }
+    }
+
+    TEST_FIXTURE( SimdExpressionTest, uniform_color_plus_varying_color )
+    {
+        test(
+            "surface uniform_color_plus_varying_color() { \n"
+            "   d = color(1, 2, 3) + c; \n"
+            "}"
+        );
+        for ( int i = 0; i < SIZE; ++i )
+        {
+            check_close( vec3(1.0f, 2.0f, 3.0f) + c[i], d[i] );
+        }
+    }
+
+    TEST_FIXTURE( SimdExpressionTest, masked_assign_from_varying )
+    {
+        test(
+            "surface masked_assign_from_varying() { \n"
+            "   if ( x > 0 ) { \n"
+            "       y = x; \n"
+            "       d = c; \n"
+            "   } \n"
+            "}"
+        );
+        for ( int i = 0; i < SIZE; ++i )
+        {
+            const bool masked_in = x[i] > 0.0f;
+            CHECK_CLOSE( masked_in ? x[i] : -1.0f, y[i], TOLERANCE );
+            check_close( masked_in ? c[i] : vec3(-1.0f, -1.0f, -1.0f), d[i] );
+        }
+    }
+
+    TEST_FIXTURE( SimdExpressionTest, masked_assign_from_uniform )
+    {
+        test(
+            "surface masked_assign_from_uniform() { \n"
+            "   if ( x > 0 ) { \n"
+            "       y = 2; \n"
+            "       d = color(1, 2, 3); \n"
+            "   } \n"
+            "}"
+        );
+        for ( int i = 0; i < SIZE; ++i )
+        {
+            const bool masked_in = x[i] > 0.0f;
+            CHECK_CLOSE( masked_in ? 2.0f : -1.0f, y[i], TOLERANCE );
+            check_close( masked_in ? vec3(1.0f, 2.0f, 3.0f) : vec3(-1.0f, -1.0f, -1.0f), d[i] );
+        }
+    }
 }
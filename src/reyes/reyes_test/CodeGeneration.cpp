@@ -8,11 +8,13 @@
 #include <reyes/ShaderParser.hpp>
 #include <reyes/SemanticAnalyzer.hpp>
 #include <reyes/CodeGenerator.hpp>
+#include <reyes/ShaderGlobal.hpp>
 #include <reyes/Value.hpp>
 #include <reyes/reyes_virtual_machine/Instruction.hpp>
 #include <math/vec2.ipp>
 #include <math/vec3.ipp>
 #include <reyes/assert.hpp>
+#include <string.h>
 
 using std::vector;
 using std::shared_ptr;
@@ -50,6 +52,20 @@ SUITE( CodeGeneration )
             }
             return syntax_node != NULL;
         }
+
+        bool test_source( const char* source )
+        {
+            REYES_ASSERT( source );
+
+            shared_ptr<SyntaxNode> syntax_node = shader_parser.parse( source, source + strlen(source) );
+            CHECK( syntax_node );
+            if ( syntax_node )
+            {
+                semantic_analyzer.analyze( syntax_node.get(), "from memory" );
+                code_generator.generate( syntax_node.get(), "from memory" );
+            }
+            return syntax_node != NULL;
+        }
         
         void check_symbol( const char* identifier, ValueType type, ValueStorage storage )
         {
@@ -74,6 +90,8 @@ SUITE( CodeGeneration )
             check_symbol( "Os", TYPE_COLOR, STORAGE_VARYING );
             check_symbol( "Ci", TYPE_COLOR, STORAGE_VARYING );
             check_symbol( "Cs", TYPE_COLOR, STORAGE_VARYING );
+            CHECK( !code_generator.uses_lights() );
+            CHECK_EQUAL( SHADER_GLOBAL_CS | SHADER_GLOBAL_OS, code_generator.globals() );
         }
     }
     
@@ -95,6 +113,8 @@ SUITE( CodeGeneration )
             check_symbol( "ambient", TYPE_COLOR, STORAGE_VARYING );
             check_symbol( "Kd", TYPE_FLOAT, STORAGE_UNIFORM );
             check_symbol( "diffuse", TYPE_COLOR, STORAGE_VARYING );
+            CHECK( code_generator.uses_lights() );
+            CHECK_EQUAL( SHADER_GLOBAL_N | SHADER_GLOBAL_I | SHADER_GLOBAL_CS | SHADER_GLOBAL_OS, code_generator.globals() );
         }
     }
 
@@ -165,6 +185,36 @@ SUITE( CodeGeneration )
         }
     }
 
+    TEST_FIXTURE( CodeGenerationTest, InferredStorage )
+    {
+        const char* source = 
+            "surface inferred_storage( float Kd = 0.5; ) { \n"
+            "    float a = Kd * 2; \n"
+            "    float b = sin( a ) + 1; \n"
+            "    float c = a * s; \n"
+            "    float d = 0; \n"
+            "    if ( s > 0.5 ) { \n"
+            "        d = 1; \n"
+            "    } \n"
+            "    float e = 1; \n"
+            "    e = e * c; \n"
+            "    uniform float f = 1; \n"
+            "    varying float g = 1; \n"
+            "    Ci = a * b * c * d * e * f * g; \n"
+            "}"
+        ;
+        if ( test_source(source) )
+        {
+            check_symbol( "a", TYPE_FLOAT, STORAGE_UNIFORM );
+            check_symbol( "b", TYPE_FLOAT, STORAGE_UNIFORM );
+            check_symbol( "c", TYPE_FLOAT, STORAGE_VARYING );
+            check_symbol( "d", TYPE_FLOAT, STORAGE_VARYING );
+            check_symbol( "e", TYPE_FLOAT, STORAGE_VARYING );
+            check_symbol( "f", TYPE_FLOAT, STORAGE_UNIFORM );
+            check_symbol( "g", TYPE_FLOAT, STORAGE_VARYING );
+        }
+    }
+
     TEST_FIXTURE( CodeGenerationTest, DistantLight )
     {
         if ( test(SHADERS_PATH "distantlight.sl") )
@@ -0,0 +1,182 @@
+
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Renderer.hpp>
+#include <reyes/SymbolTable.hpp>
+#include <reyes/Shader.hpp>
+#include <reyes/Grid.hpp>
+#include <reyes/GridBatch.hpp>
+#include <reyes/Value.hpp>
+#include <reyes/assert.hpp>
+#include <math/vec3.ipp>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <string.h>
+
+using std::shared_ptr;
+using namespace math;
+using namespace reyes;
+
+static const float TOLERANCE = 0.01f;
+
+SUITE( GridBatching )
+{
+    struct GridBatchTest
+    {
+        GridBatch batch;
+
+        Grid& add_grid( int width, int height, float x0, float dx, float opacity = 1.0f )
+        {
+            Grid& grid = batch.next();
+            grid.resize( width, height );
+            grid.du_ = 1.0f;
+            grid.dv_ = 1.0f;
+            float* x = grid.add_value( "x", TYPE_FLOAT )->float_values();
+            vec3* P = grid.add_value( "P", TYPE_POINT )->vec3_values();
+            for ( int j = 0; j < height; ++j )
+            {
+                for ( int i = 0; i < width; ++i )
+                {
+                    x[j * width + i] = x0 + dx * float(i);
+                    P[j * width + i] = vec3( float(i), float(j), 0.0f );
+                }
+            }
+            *grid.add_value( "o", TYPE_FLOAT, STORAGE_UNIFORM ) = opacity;
+            return grid;
+        }
+    };
+
+    TEST_FIXTURE( GridBatchTest, gather_concatenates_grids_as_patches )
+    {
+        add_grid( 2, 2, 0.0f, 1.0f );
+        batch.push();
+        add_grid( 3, 2, 10.0f, 1.0f );
+        CHECK( batch.accepts(batch.next(), 64) );
+        batch.push();
+        CHECK_EQUAL( 2, batch.grids() );
+        CHECK_EQUAL( 10, batch.vertices() );
+
+        Grid& grid = batch.gather();
+        CHECK_EQUAL( 10, grid.size() );
+        CHECK_EQUAL( 2, grid.patches() );
+        CHECK_EQUAL( 0, grid.patch(0).offset );
+        CHECK_EQUAL( 2, grid.patch(0).width );
+        CHECK_EQUAL( 4, grid.patch(1).offset );
+        CHECK_EQUAL( 3, grid.patch(1).width );
+        CHECK_EQUAL( 2, grid.patch(1).height );
+
+        const float* x = grid.value( "x" ).float_values();
+        CHECK_CLOSE( 1.0f, x[1], TOLERANCE );
+        CHECK_CLOSE( 10.0f, x[4], TOLERANCE );
+        CHECK_CLOSE( 12.0f, x[9], TOLERANCE );
+        CHECK( grid.value("o").storage() == STORAGE_UNIFORM );
+    }
+
+    TEST_FIXTURE( GridBatchTest, scatter_copies_shaded_values_back )
+    {
+        add_grid( 2, 2, 0.0f, 1.0f );
+        batch.push();
+        add_grid( 2, 2, 10.0f, 1.0f );
+        batch.push();
+
+        Grid& grid = batch.gather();
+        float* y = grid.add_value( "y", TYPE_FLOAT )->float_values();
+        for ( int i = 0; i < grid.size(); ++i )
+        {
+            y[i] = float(i);
+        }
+        batch.scatter();
+
+        const Value& first_y = batch.grid( 0 ).value( "y" );
+        const Value& second_y = batch.grid( 1 ).value( "y" );
+        CHECK_EQUAL( 4u, first_y.size() );
+        CHECK_EQUAL( 4u, second_y.size() );
+        CHECK_CLOSE( 3.0f, first_y.float_values()[3], TOLERANCE );
+        CHECK_CLOSE( 4.0f, second_y.float_values()[0], TOLERANCE );
+        CHECK_CLOSE( 7.0f, second_y.float_values()[3], TOLERANCE );
+    }
+
+    TEST_FIXTURE( GridBatchTest, grids_with_different_uniform_values_are_not_batched )
+    {
+        add_grid( 2, 2, 0.0f, 1.0f, 1.0f );
+        batch.push();
+        add_grid( 2, 2, 0.0f, 1.0f, 0.5f );
+        CHECK( !batch.accepts(batch.next(), 64) );
+    }
+
+    TEST_FIXTURE( GridBatchTest, grids_are_not_batched_past_maximum_vertices )
+    {
+        add_grid( 4, 4, 0.0f, 1.0f );
+        batch.push();
+        add_grid( 4, 4, 0.0f, 1.0f );
+        CHECK( batch.accepts(batch.next(), 32) );
+        CHECK( !batch.accepts(batch.next(), 31) );
+    }
+
+    TEST_FIXTURE( GridBatchTest, normals_are_generated_per_patch )
+    {
+        add_grid( 2, 2, 0.0f, 1.0f );
+        batch.push();
+        Grid& second = add_grid( 2, 2, 0.0f, 1.0f );
+        vec3* P = second.value( "P", TYPE_POINT ).vec3_values();
+        for ( int i = 0; i < second.size(); ++i )
+        {
+            P[i] = vec3( 0.0f, P[i].y, P[i].x );
+        }
+        batch.push();
+
+        Grid& grid = batch.gather();
+        grid.generate_normals( false );
+        const vec3* N = grid.value( "N" ).vec3_values();
+        for ( int i = 0; i < 4; ++i )
+        {
+            CHECK_CLOSE( 0.0f, N[i].x, TOLERANCE );
+            CHECK_CLOSE( 1.0f, fabsf(N[i].z), TOLERANCE );
+        }
+        for ( int i = 4; i < 8; ++i )
+        {
+            CHECK_CLOSE( 1.0f, fabsf(N[i].x), TOLERANCE );
+            CHECK_CLOSE( 0.0f, N[i].z, TOLERANCE );
+        }
+    }
+
+    TEST_FIXTURE( GridBatchTest, derivatives_are_calculated_per_patch )
+    {
+        Renderer renderer;
+        renderer.begin();
+        renderer.perspective( float(M_PI) / 2.0f );
+        renderer.projection();
+        renderer.begin_world();
+
+        add_grid( 3, 2, 0.0f, 1.0f );
+        batch.push();
+        add_grid( 3, 2, 100.0f, 3.0f );
+        batch.push();
+        Grid& grid = batch.gather();
+        grid.add_value( "y", TYPE_FLOAT )->zero();
+        grid.add_value( "Ci", TYPE_COLOR )->zero();
+
+        const char* source = 
+            "surface derivatives_are_calculated_per_patch() { \n"
+            "   y = Du( x ); \n"
+            "}"
+        ;
+        renderer.symbol_table().add_symbols()
+            ( "x", TYPE_FLOAT )
+            ( "y", TYPE_FLOAT )
+        ;
+        Shader shader( source, source + strlen(source), renderer.symbol_table(), renderer.error_policy() );
+        renderer.surface_shader( &shader );
+        renderer.surface_shade( grid );
+        batch.scatter();
+
+        const float* first_y = batch.grid( 0 ).value( "y" ).float_values();
+        const float* second_y = batch.grid( 1 ).value( "y" ).float_values();
+        for ( int row = 0; row < 2; ++row )
+        {
+            CHECK_CLOSE( 1.0f, first_y[row * 3], TOLERANCE );
+            CHECK_CLOSE( 1.0f, first_y[row * 3 + 1], TOLERANCE );
+            CHECK_CLOSE( 3.0f, second_y[row * 3], TOLERANCE );
+            CHECK_CLOSE( 3.0f, second_y[row * 3 + 1], TOLERANCE );
+        }
+    }
+}
@@ -222,4 +222,49 @@ SUITE( IfStatements )
         CHECK_CLOSE( -2.0f, y[2], TOLERANCE );
         CHECK_CLOSE( -2.0f, y[3], TOLERANCE );
     }
+
+    TEST( if_statement_with_sparse_condition )
+    {
+        Grid grid;
+        grid.resize( 16, 16 );
+        float* x = grid.add_value( "x", TYPE_FLOAT )->float_values();
+        float* y = grid.add_value( "y", TYPE_FLOAT )->float_values();
+        for ( int i = 0; i < grid.size(); ++i )
+        {
+            x[i] = 0.0f;
+            y[i] = 0.0f;
+        }
+        x[37] = 1.0f;
+        x[200] = 2.0f;
+        x[201] = 3.0f;
+
+        const char* source = 
+            "surface if_statement_with_sparse_condition() { \n"
+            "   if ( x > 0 ) { \n"
+            "       y = 1 - 2 * x; \n"
+            "   } else { \n"
+            "       y = 3 * x + 4; \n"
+            "   } \n"
+            "}"
+        ;
+        ErrorPolicy error_policy;
+        SymbolTable symbol_table;
+        symbol_table.add_symbols()
+            ( "x", TYPE_FLOAT )
+            ( "y", TYPE_FLOAT )
+        ;
+        Shader shader( source, source + strlen(source), symbol_table, error_policy );
+        VirtualMachine virtual_machine;
+        virtual_machine.initialize( grid, shader );
+        virtual_machine.shade( grid, grid, shader );
+
+        CHECK_CLOSE( 4.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 4.0f, y[36], TOLERANCE );
+        CHECK_CLOSE( -1.0f, y[37], TOLERANCE );
+        CHECK_CLOSE( 4.0f, y[38], TOLERANCE );
+        CHECK_CLOSE( -3.0f, y[200], TOLERANCE );
+        CHECK_CLOSE( -5.0f, y[201], TOLERANCE );
+        CHECK_CLOSE( 4.0f, y[202], TOLERANCE );
+        CHECK_CLOSE( 4.0f, y[255], TOLERANCE );
+    }
 }
@@ -6,11 +6,27 @@
 #include <reyes/SymbolTable.hpp>
 #include <reyes/ErrorPolicy.hpp>
 #include <reyes/Renderer.hpp>
+#include <reyes/Light.hpp>
+#include <reyes/ShaderGlobal.hpp>
 #include <reyes/assert.hpp>
+#include <math/vec3.ipp>
+#include <string.h>
 
 using std::vector;
+using namespace math;
 using namespace reyes;
 
+static void set_positions( Grid& grid, const vec3& position )
+{
+    grid.clear();
+    grid.resize( 2, 2 );
+    vec3* positions = grid.value( "P", TYPE_POINT ).vec3_values();
+    for ( int i = 0; i < grid.size(); ++i )
+    {
+        positions[i] = position;
+    }
+}
+
 SUITE( TestLightShaders )
 {
     TEST( AmbientLight )
@@ -76,4 +92,191 @@ SUITE( TestLightShaders )
         renderer.light_shade( grid );
         CHECK( grid.lights().size() == 1 );
     }
+
+    TEST( ambient_light_evaluated_once )
+    {
+        Renderer renderer;
+        Shader shader( SHADERS_PATH "ambientlight.sl", renderer.symbol_table(), renderer.error_policy() );
+
+        renderer.begin();
+        renderer.light_shader( &shader );
+        Grid grid;
+        set_positions( grid, vec3(0.0f, 0.0f, 1.0f) );
+        renderer.light_shade( grid );
+        CHECK( grid.lights().size() == 1 );
+        CHECK( grid.lights().front()->color()->storage() == STORAGE_UNIFORM );
+        CHECK_CLOSE( 1.0f, grid.lights().front()->color()->vec3_value().x, 0.01f );
+
+        Grid other_grid;
+        set_positions( other_grid, vec3(0.0f, 0.0f, 10.0f) );
+        renderer.light_shade( other_grid );
+        CHECK( other_grid.lights().size() == 1 );
+        CHECK( other_grid.lights().front() == grid.lights().front() );
+    }
+
+    TEST( spot_light_culled_outside_cone )
+    {
+        Renderer renderer;
+        Shader shader( SHADERS_PATH "spotlight.sl", renderer.symbol_table(), renderer.error_policy() );
+
+        renderer.begin();
+        renderer.light_shader( &shader );
+        Grid grid;
+        set_positions( grid, vec3(0.0f, 0.0f, 10.0f) );
+        renderer.light_shade( grid );
+        CHECK( grid.lights().size() == 1 );
+
+        set_positions( grid, vec3(0.0f, 0.0f, -10.0f) );
+        renderer.light_shade( grid );
+        CHECK( grid.lights().size() == 0 );
+
+        set_positions( grid, vec3(10.0f, 0.0f, 1.0f) );
+        renderer.light_shade( grid );
+        CHECK( grid.lights().size() == 0 );
+    }
+
+    TEST( point_light_culled_beyond_cutoff )
+    {
+        Renderer renderer;
+        Shader shader( SHADERS_PATH "pointlight.sl", renderer.symbol_table(), renderer.error_policy() );
+
+        renderer.begin();
+        renderer.light_shader( &shader );
+        Grid grid;
+        set_positions( grid, vec3(0.0f, 0.0f, 20.0f) );
+        renderer.light_shade( grid );
+        CHECK( grid.lights().size() == 1 );
+
+        renderer.light_cutoff( 0.01f );
+        set_positions( grid, vec3(0.0f, 0.0f, 5.0f) );
+        renderer.light_shade( grid );
+        CHECK( grid.lights().size() == 1 );
+
+        set_positions( grid, vec3(0.0f, 0.0f, 20.0f) );
+        renderer.light_shade( grid );
+        CHECK( grid.lights().size() == 0 );
+    }
+
+    TEST( light_with_two_illuminate_statements_not_culled )
+    {
+        // The loop isn't entered for the probe at the origin so the probe
+        // only sees the illuminate statement pointing down -z.
+        Renderer renderer;
+        const char* source = 
+            "light light_with_two_illuminate_statements() { \n"
+            "   float i = 0; \n"
+            "   while ( i < zcomp(Ps) ) { \n"
+            "       illuminate( point(0, 0, 0), vector(0, 0, 1), 0.1 ) { \n"
+            "           Cl = color(1, 1, 1); \n"
+            "       } \n"
+            "       i += 100; \n"
+            "   } \n"
+            "   illuminate( point(0, 0, 0), vector(0, 0, -1), 0.1 ) { \n"
+            "       Cl = color(1, 1, 1); \n"
+            "   } \n"
+            "}"
+        ;
+        Shader shader( source, source + strlen(source), renderer.symbol_table(), renderer.error_policy() );
+        CHECK_EQUAL( 2, shader.solar_and_illuminate_statements() );
+
+        renderer.begin();
+        renderer.light_shader( &shader );
+        Grid grid;
+        set_positions( grid, vec3(0.0f, 0.0f, -10.0f) );
+        renderer.light_shade( grid );
+        CHECK( !grid.lights().empty() );
+
+        set_positions( grid, vec3(0.0f, 0.0f, 10.0f) );
+        renderer.light_shade( grid );
+        CHECK( !grid.lights().empty() );
+    }
+
+    TEST( light_reading_normals_lights_surface_not_reading_normals )
+    {
+        // The surface shader doesn't read "N" so normals are only generated 
+        // because the light shader reads them.
+        Renderer renderer;
+        const char* light_source = 
+            "light light_reading_normals() { \n"
+            "   illuminate( point(0, 0, 0) ) { \n"
+            "       float n = zcomp( normalize(N) ); \n"
+            "       Cl = color( 1, 1, 1 ) * (n * n); \n"
+            "   } \n"
+            "}"
+        ;
+        Shader light_shader( light_source, light_source + strlen(light_source), renderer.symbol_table(), renderer.error_policy() );
+        CHECK( (light_shader.globals() & SHADER_GLOBAL_N) != 0 );
+
+        const char* surface_source = 
+            "surface surface_not_reading_normals() { \n"
+            "   illuminance( P, -P, 3.14 / 2 ) { \n"
+            "       Ci += Cl; \n"
+            "   } \n"
+            "}"
+        ;
+        Shader surface_shader( surface_source, surface_source + strlen(surface_source), renderer.symbol_table(), renderer.error_policy() );
+        CHECK( (surface_shader.globals() & SHADER_GLOBAL_N) == 0 );
+
+        renderer.begin();
+        renderer.light_shader( &light_shader );
+        renderer.surface_shader( &surface_shader );
+        Grid grid;
+        grid.resize( 2, 2 );
+        vec3* positions = grid.value( "P", TYPE_POINT ).vec3_values();
+        positions[0] = vec3( 0.0f, 0.0f, 1.0f );
+        positions[1] = vec3( 1.0f, 0.0f, 1.0f );
+        positions[2] = vec3( 0.0f, 1.0f, 1.0f );
+        positions[3] = vec3( 1.0f, 1.0f, 1.0f );
+        renderer.surface_shade( grid );
+
+        CHECK( grid.find_value("N") );
+        const vec3* Ci = grid.value( "Ci", TYPE_COLOR ).vec3_values();
+        for ( int i = 0; i < grid.size(); ++i )
+        {
+            CHECK_CLOSE( 1.0f, Ci[i].x, 0.01f );
+        }
+    }
+
+    TEST( surface_not_using_lights_skips_light_shading )
+    {
+        // The surface shader doesn't use lights so no lights are added to the
+        // grid it shades; the color matches shading after the lights have 
+        // been run explicitly.
+        Renderer renderer;
+        Shader light_shader( SHADERS_PATH "pointlight.sl", renderer.symbol_table(), renderer.error_policy() );
+        const char* source = 
+            "surface surface_not_using_lights() { \n"
+            "   Ci = color( 1, 0.5, 0.25 ) * zcomp( P ); \n"
+            "}"
+        ;
+        Shader surface_shader( source, source + strlen(source), renderer.symbol_table(), renderer.error_policy() );
+        CHECK( !surface_shader.uses_lights() );
+
+        renderer.begin();
+        renderer.light_shader( &light_shader );
+        renderer.surface_shader( &surface_shader );
+        
+        Grid grid;
+        set_positions( grid, vec3(0.0f, 0.0f, 2.0f) );
+        renderer.surface_shade( grid );
+        CHECK( grid.lights().empty() );
+
+        Grid lit_grid;
+        set_positions( lit_grid, vec3(0.0f, 0.0f, 2.0f) );
+        renderer.light_shade( lit_grid );
+        CHECK( !lit_grid.lights().empty() );
+        renderer.surface_shade( lit_grid );
+
+        const vec3* Ci = grid.value( "Ci", TYPE_COLOR ).vec3_values();
+        const vec3* lit_Ci = lit_grid.value( "Ci", TYPE_COLOR ).vec3_values();
+        for ( int i = 0; i < grid.size(); ++i )
+        {
+            CHECK_CLOSE( 2.0f, Ci[i].x, 0.01f );
+            CHECK_CLOSE( 1.0f, Ci[i].y, 0.01f );
+            CHECK_CLOSE( 0.5f, Ci[i].z, 0.01f );
+            CHECK_CLOSE( lit_Ci[i].x, Ci[i].x, 0.01f );
+            CHECK_CLOSE( lit_Ci[i].y, Ci[i].y, 0.01f );
+            CHECK_CLOSE( lit_Ci[i].z, Ci[i].z, 0.01f );
+        }
+    }
 }
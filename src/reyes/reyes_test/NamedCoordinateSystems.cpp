@@ -5,6 +5,7 @@
 #include <reyes/Grid.hpp>
 #include <reyes/Value.hpp>
 #include <reyes/SymbolTable.hpp>
+#include <reyes/Identifier.hpp>
 #include <reyes/assert.hpp>
 #include <math/vec3.ipp>
 #include <math/mat4x4.ipp>
@@ -131,4 +132,31 @@ SUITE( NamedCoordinateSystems )
         ;
         check_transform_between_coordinate_systems( source, vec4(0.0f, 0.0f, 1.0f, 0.0f), TRANSFORM_WORLD_TO_CAMERA );
     }
+
+    TEST_FIXTURE( RendererFixture, transform_to_redefined_coordinate_system )
+    {
+        const char* source = "surface test()\n"
+            "{\n"
+            "   P = transform( \"named\", P );\n"
+            "}\n"
+        ;
+        Shader shader( source, source + strlen(source), renderer.symbol_table(), renderer.error_policy() );
+        renderer.begin_world();
+
+        renderer.add_coordinate_system( "named", translate(1.0f, 0.0f, 0.0f) );
+        shared_ptr<Value> positions = execute_shader( shader );
+        CHECK( positions );
+        CHECK_CLOSE( 0.0f, length(positions->vec3_values()[0] - vec3(-1.0f, 0.0f, 0.0f)), TOLERANCE );
+
+        // The cached inverse is recalculated when the coordinate system is
+        // redefined.
+        renderer.add_coordinate_system( intern_identifier("named"), translate(0.0f, 2.0f, 0.0f) );
+        positions = execute_shader( shader );
+        CHECK( positions );
+        CHECK_CLOSE( 0.0f, length(positions->vec3_values()[0] - vec3(0.0f, -2.0f, 0.0f)), TOLERANCE );
+        CHECK_CLOSE( -2.0f, renderer.transform_to("named").m[7], TOLERANCE );
+
+        renderer.remove_coordinate_system( "named" );
+        renderer.end_world();
+    }
 }
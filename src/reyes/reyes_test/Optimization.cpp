@@ -0,0 +1,492 @@
+
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Shader.hpp>
+#include <reyes/Grid.hpp>
+#include <reyes/Value.hpp>
+#include <reyes/ErrorPolicy.hpp>
+#include <reyes/SymbolTable.hpp>
+#include <reyes/VirtualMachine.hpp>
+#include <reyes/reyes_virtual_machine/Instruction.hpp>
+#include <reyes/reyes_virtual_machine/InstructionMetadata.hpp>
+#include <reyes/assert.hpp>
+#include <math/vec2.ipp>
+#include <math/vec3.ipp>
+#include <string.h>
+#include <math.h>
+
+using std::vector;
+using std::shared_ptr;
+using namespace math;
+using namespace reyes;
+
+static const float TOLERANCE = 0.01f;
+
+SUITE( Optimization )
+{
+    struct OptimizationTest
+    {
+        Grid grid;
+        float* x;
+        float* y;
+        vec3* Cx;
+        shared_ptr<Shader> shader;
+     
+        OptimizationTest()
+        : grid(),
+          x( NULL ),
+          y( NULL ),
+          Cx( NULL ),
+          shader()
+        {
+            grid.resize( 2, 2 );            
+            shared_ptr<Value> x_value = grid.add_value( "x", TYPE_FLOAT );
+            x_value->zero();
+            x = x_value->float_values();
+            x[0] = 1.0f;
+            x[1] = 2.0f;
+            x[2] = 3.0f;
+            x[3] = 4.0f;
+
+            shared_ptr<Value> y_value = grid.add_value( "y", TYPE_FLOAT );
+            y_value->zero();
+            y = y_value->float_values();
+
+            shared_ptr<Value> Cx_value = grid.add_value( "Cx", TYPE_COLOR );
+            Cx_value->zero();
+            Cx = Cx_value->vec3_values();
+        }
+        
+        void test( const char* source )
+        {
+            ErrorPolicy error_policy;
+            SymbolTable symbol_table;
+            symbol_table.add_symbols()
+                ( "x", TYPE_FLOAT )
+                ( "y", TYPE_FLOAT )
+                ( "Cx", TYPE_COLOR )
+            ;
+            shader.reset( new Shader(source, source + strlen(source), symbol_table, error_policy) );
+            VirtualMachine virtual_machine;
+            virtual_machine.initialize( grid, *shader );
+            virtual_machine.shade( grid, grid, *shader );
+        }
+
+        bool contains( int instruction ) const
+        {
+            REYES_ASSERT( shader );
+            const vector<unsigned char>& code = shader->code();
+            unsigned int address = 0;
+            while ( address < code.size() )
+            {
+                int code_instruction = *reinterpret_cast<const short*>( &code[address] );
+                if ( code_instruction == instruction )
+                {
+                    return true;
+                }
+                const InstructionMetadata& metadata = instruction_metadata( code_instruction );
+                address += sizeof(short) + metadata.words * sizeof(short) + metadata.arguments * sizeof(int);
+            }
+            return false;
+        }
+
+        int count( int instruction ) const
+        {
+            REYES_ASSERT( shader );
+            const vector<DecodedInstruction>& instructions = shader->instructions();
+            int instructions_found = 0;
+            for ( unsigned int i = shader->shade_instruction(); i < instructions.size(); ++i )
+            {
+                instructions_found += instructions[i].instruction == instruction ? 1 : 0;
+            }
+            return instructions_found;
+        }
+
+        /**
+        // Run a shader compiled with and without optimization on the same 
+        // inputs and check that both give the same results in y and Cx.
+        */
+        void compare( const char* source )
+        {
+            ErrorPolicy error_policy;
+            SymbolTable symbol_table;
+            symbol_table.add_symbols()
+                ( "x", TYPE_FLOAT )
+                ( "y", TYPE_FLOAT )
+                ( "Cx", TYPE_COLOR )
+            ;
+            Shader unoptimized( source, source + strlen(source), symbol_table, error_policy, false );
+            shader.reset( new Shader(source, source + strlen(source), symbol_table, error_policy) );
+            CHECK( shader->code() != unoptimized.code() );
+
+            vector<float> expected_y;
+            vector<vec3> expected_Cx;
+            shade( unoptimized, &expected_y, &expected_Cx );
+            vector<float> actual_y;
+            vector<vec3> actual_Cx;
+            shade( *shader, &actual_y, &actual_Cx );
+            for ( int i = 0; i < grid.size(); ++i )
+            {
+                CHECK_CLOSE( expected_y[i], actual_y[i], TOLERANCE );
+                CHECK_CLOSE( 0.0f, length(expected_Cx[i] - actual_Cx[i]), TOLERANCE );
+            }
+        }
+
+        void shade( const Shader& shader, vector<float>* ys, vector<vec3>* colors )
+        {
+            REYES_ASSERT( ys );
+            REYES_ASSERT( colors );
+            for ( int i = 0; i < grid.size(); ++i )
+            {
+                y[i] = 0.0f;
+                Cx[i] = vec3( x[i], 2.0f * x[i], 0.5f );
+            }
+            VirtualMachine virtual_machine;
+            virtual_machine.initialize( grid, shader );
+            virtual_machine.shade( grid, grid, shader );
+            ys->assign( y, y + grid.size() );
+            colors->assign( Cx, Cx + grid.size() );
+        }
+
+        int find( int instruction ) const
+        {
+            REYES_ASSERT( shader );
+            const vector<DecodedInstruction>& instructions = shader->instructions();
+            for ( unsigned int i = shader->shade_instruction(); i < instructions.size(); ++i )
+            {
+                if ( instructions[i].instruction == instruction )
+                {
+                    return int(i);
+                }
+            }
+            return -1;
+        }
+    };
+
+    TEST_FIXTURE( OptimizationTest, multiply_add )
+    {
+        test(
+            "surface multiply_add() { \n"
+            "   y = x * 2 + 1; \n"
+            "}"
+        );
+        CHECK_CLOSE( 3.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 5.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 7.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 9.0f, y[3], TOLERANCE );
+        CHECK( contains(INSTRUCTION_MULTIPLY_ADD) );
+        CHECK( !contains(INSTRUCTION_MULTIPLY) );
+        CHECK( !contains(INSTRUCTION_ADD) );
+        CHECK( !contains(INSTRUCTION_PROMOTE) );
+    }
+
+    TEST_FIXTURE( OptimizationTest, multiply_add_in_condition )
+    {
+        y[0] = 1.0f;
+        y[1] = 1.0f;
+        y[2] = 1.0f;
+        y[3] = 1.0f;
+        test(
+            "surface multiply_add_in_condition() { \n"
+            "   if ( x > 2 ) { \n"
+            "       y = x * x + y; \n"
+            "   } \n"
+            "}"
+        );
+        CHECK_CLOSE( 1.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 1.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 10.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 17.0f, y[3], TOLERANCE );
+        CHECK( contains(INSTRUCTION_MULTIPLY_ADD) );
+    }
+
+    TEST_FIXTURE( OptimizationTest, uniform_times_varying )
+    {
+        test(
+            "surface uniform_times_varying( float k = 3; ) { \n"
+            "   y = k * x; \n"
+            "}"
+        );
+        CHECK_CLOSE( 3.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 6.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 9.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 12.0f, y[3], TOLERANCE );
+        CHECK( !contains(INSTRUCTION_PROMOTE) );
+    }
+
+    TEST_FIXTURE( OptimizationTest, float_times_color )
+    {
+        test(
+            "surface float_times_color( color k = color(1, 2, 3); ) { \n"
+            "   Cx = x * k; \n"
+            "}"
+        );
+        CHECK_CLOSE( 0.0f, length(Cx[0] - vec3(1.0f, 2.0f, 3.0f)), TOLERANCE );
+        CHECK_CLOSE( 0.0f, length(Cx[1] - vec3(2.0f, 4.0f, 6.0f)), TOLERANCE );
+        CHECK_CLOSE( 0.0f, length(Cx[2] - vec3(3.0f, 6.0f, 9.0f)), TOLERANCE );
+        CHECK_CLOSE( 0.0f, length(Cx[3] - vec3(4.0f, 8.0f, 12.0f)), TOLERANCE );
+        CHECK( !contains(INSTRUCTION_CONVERT) );
+        CHECK( !contains(INSTRUCTION_PROMOTE) );
+    }
+
+    TEST_FIXTURE( OptimizationTest, scale_add_color )
+    {
+        Cx[0] = vec3( 1.0f, 1.0f, 1.0f );
+        Cx[1] = vec3( 1.0f, 1.0f, 1.0f );
+        Cx[2] = vec3( 1.0f, 1.0f, 1.0f );
+        Cx[3] = vec3( 1.0f, 1.0f, 1.0f );
+        test(
+            "surface scale_add_color() { \n"
+            "   Cx = Cx * x + Cx; \n"
+            "}"
+        );
+        CHECK_CLOSE( 0.0f, length(Cx[0] - vec3(2.0f, 2.0f, 2.0f)), TOLERANCE );
+        CHECK_CLOSE( 0.0f, length(Cx[1] - vec3(3.0f, 3.0f, 3.0f)), TOLERANCE );
+        CHECK_CLOSE( 0.0f, length(Cx[2] - vec3(4.0f, 4.0f, 4.0f)), TOLERANCE );
+        CHECK_CLOSE( 0.0f, length(Cx[3] - vec3(5.0f, 5.0f, 5.0f)), TOLERANCE );
+        CHECK( contains(INSTRUCTION_MULTIPLY_ADD) );
+        CHECK( !contains(INSTRUCTION_CONVERT) );
+    }
+
+    TEST_FIXTURE( OptimizationTest, dead_code )
+    {
+        test(
+            "surface dead_code() { \n"
+            "   float debug = x * x; \n"
+            "   if ( debug > 2 ) { \n"
+            "       debug = debug - 2; \n"
+            "   } \n"
+            "   y = x + 1; \n"
+            "}"
+        );
+        CHECK_CLOSE( 2.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 3.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 4.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 5.0f, y[3], TOLERANCE );
+        CHECK( !contains(INSTRUCTION_MULTIPLY) );
+        CHECK( !contains(INSTRUCTION_SUBTRACT) );
+        CHECK( !contains(INSTRUCTION_GREATER) );
+        CHECK( !contains(INSTRUCTION_GENERATE_MASK) );
+    }
+
+    TEST_FIXTURE( OptimizationTest, live_locals_are_kept )
+    {
+        test(
+            "surface live_locals_are_kept() { \n"
+            "   float squared = x * x; \n"
+            "   if ( squared > 2 ) { \n"
+            "       squared = squared - 2; \n"
+            "   } \n"
+            "   y = squared; \n"
+            "}"
+        );
+        CHECK_CLOSE( 1.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 2.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 7.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 14.0f, y[3], TOLERANCE );
+        CHECK( contains(INSTRUCTION_GENERATE_MASK) );
+    }
+
+    TEST_FIXTURE( OptimizationTest, temporary_registers_are_reused )
+    {
+        test(
+            "surface temporary_registers_are_reused() { \n"
+            "   y = ((((((x + 1) * (x + 2)) * (x + 3)) * (x + 4)) * (x + 5)) * (x + 6)); \n"
+            "}"
+        );
+        CHECK_CLOSE( 5040.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 20160.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 60480.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 151200.0f, y[3], TOLERANCE );
+        CHECK( shader->registers() - shader->permanent_registers() <= 3 );
+    }
+
+    TEST_FIXTURE( OptimizationTest, common_subexpressions )
+    {
+        test(
+            "surface common_subexpressions() { \n"
+            "   y = sin(x) * 2; \n"
+            "   y += sin(x); \n"
+            "}"
+        );
+        CHECK_CLOSE( 3.0f * sinf(1.0f), y[0], TOLERANCE );
+        CHECK_CLOSE( 3.0f * sinf(2.0f), y[1], TOLERANCE );
+        CHECK_CLOSE( 3.0f * sinf(3.0f), y[2], TOLERANCE );
+        CHECK_CLOSE( 3.0f * sinf(4.0f), y[3], TOLERANCE );
+        CHECK_EQUAL( 1, count(INSTRUCTION_CALL_1) );
+    }
+
+    TEST_FIXTURE( OptimizationTest, common_subexpressions_respect_masks )
+    {
+        test(
+            "surface common_subexpressions_respect_masks() { \n"
+            "   if ( x > 2 ) { \n"
+            "       y = sin(x); \n"
+            "   } else { \n"
+            "       y = sin(x) + 1; \n"
+            "   } \n"
+            "   y += sin(x); \n"
+            "}"
+        );
+        CHECK_CLOSE( 2.0f * sinf(1.0f) + 1.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 2.0f * sinf(2.0f) + 1.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 2.0f * sinf(3.0f), y[2], TOLERANCE );
+        CHECK_CLOSE( 2.0f * sinf(4.0f), y[3], TOLERANCE );
+        CHECK_EQUAL( 3, count(INSTRUCTION_CALL_1) );
+    }
+
+    TEST_FIXTURE( OptimizationTest, loop_invariants )
+    {
+        test(
+            "surface loop_invariants() { \n"
+            "   float i; \n"
+            "   y = 0; \n"
+            "   for ( i = 0; i < 4; i += 1 ) { \n"
+            "       y += sin(x) * 2; \n"
+            "   } \n"
+            "}"
+        );
+        CHECK_CLOSE( 8.0f * sinf(1.0f), y[0], TOLERANCE );
+        CHECK_CLOSE( 8.0f * sinf(2.0f), y[1], TOLERANCE );
+        CHECK_CLOSE( 8.0f * sinf(3.0f), y[2], TOLERANCE );
+        CHECK_CLOSE( 8.0f * sinf(4.0f), y[3], TOLERANCE );
+        CHECK_EQUAL( 1, count(INSTRUCTION_CALL_1) );
+        CHECK( find(INSTRUCTION_CALL_1) < find(INSTRUCTION_JUMP_EMPTY) );
+    }
+
+    TEST_FIXTURE( OptimizationTest, uniform_float_times_varying_color_matches_unoptimized )
+    {
+        compare(
+            "surface uniform_float_times_varying_color( float Ka = 0.5; ) { \n"
+            "   Cx = Cx * Ka; \n"
+            "}"
+        );
+    }
+
+    TEST_FIXTURE( OptimizationTest, scale_add_by_uniform_float_matches_unoptimized )
+    {
+        compare(
+            "surface scale_add_by_uniform_float( float Ka = 0.5; ) { \n"
+            "   Cx = Cx * Ka + Cx; \n"
+            "}"
+        );
+    }
+
+    TEST_FIXTURE( OptimizationTest, uniform_float_over_dot_product_times_color_matches_unoptimized )
+    {
+        compare(
+            "surface uniform_float_over_dot_product_times_color( float intensity = 2; ) { \n"
+            "   vector L = vector(1, 1, 2) * x; \n"
+            "   Cx = (intensity / (L . L)) * Cx; \n"
+            "}"
+        );
+    }
+
+    TEST_FIXTURE( OptimizationTest, point_light_intensity_matches_unoptimized )
+    {
+        compare(
+            "surface point_light_intensity( float intensity = 2; color lightcolor = color(1, 0.5, 0.25); ) { \n"
+            "   vector L = vector(1, 1, 2) * x; \n"
+            "   Cx = intensity * (lightcolor / (L . L)); \n"
+            "}"
+        );
+    }
+
+    TEST_FIXTURE( OptimizationTest, nested_loops_and_conditionals_are_decoded )
+    {
+        test(
+            "surface nested_loops_and_conditionals_are_decoded() { \n"
+            "   uniform float i, j; \n"
+            "   y = 0; \n"
+            "   for ( i = 0; i < 2; i += 1 ) { \n"
+            "       for ( j = 0; j < 3; j += 1 ) { \n"
+            "           if ( j < 1 ) { \n"
+            "               y += x * i; \n"
+            "           } else { \n"
+            "               y -= 1; \n"
+            "           } \n"
+            "       } \n"
+            "   } \n"
+            "}"
+        );
+        CHECK_CLOSE( -3.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( -2.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( -1.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 0.0f, y[3], TOLERANCE );
+
+        // Find the jump out of and the jump back to the start of each loop;
+        // the outer loop's jumps enclose the inner loop's jumps.
+        const vector<DecodedInstruction>& instructions = shader->instructions();
+        const int size = int(instructions.size());
+        vector<int> jumps_out;
+        vector<int> jumps_back;
+        for ( int i = shader->shade_instruction(); i < size; ++i )
+        {
+            if ( instructions[i].instruction == INSTRUCTION_JUMP_EMPTY )
+            {
+                jumps_out.push_back( i );
+            }
+            else if ( instructions[i].instruction == INSTRUCTION_JUMP )
+            {
+                jumps_back.push_back( i );
+            }
+        }
+        REQUIRE CHECK_EQUAL( 2, int(jumps_out.size()) );
+        REQUIRE CHECK_EQUAL( 2, int(jumps_back.size()) );
+        const int outer_out = jumps_out[0];
+        const int inner_out = jumps_out[1];
+        const int inner_back = jumps_back[0];
+        const int outer_back = jumps_back[1];
+        CHECK( outer_out < inner_out && inner_out < inner_back && inner_back < outer_back );
+
+        // Each loop exits to the instruction after its jump back and jumps 
+        // back to its condition, which is evaluated, promoted, and used to 
+        // generate the mask tested by its jump out.
+        CHECK_EQUAL( outer_back + 1, instructions[outer_out].jump );
+        CHECK_EQUAL( inner_back + 1, instructions[inner_out].jump );
+        const int loops [][2] = { {outer_back, outer_out}, {inner_back, inner_out} };
+        for ( int loop = 0; loop < 2; ++loop )
+        {
+            const DecodedInstruction& jump_back = instructions[loops[loop][0]];
+            const int jump_out = loops[loop][1];
+            REQUIRE CHECK( jump_back.jump >= shader->shade_instruction() && jump_back.jump < jump_out - 2 );
+            const DecodedInstruction& condition = instructions[jump_back.jump];
+            const DecodedInstruction& promote = instructions[jump_out - 2];
+            const DecodedInstruction& generate_mask = instructions[jump_out - 1];
+            CHECK_EQUAL( int(INSTRUCTION_LESS), condition.instruction );
+            CHECK_EQUAL( int(INSTRUCTION_PROMOTE), promote.instruction );
+            CHECK_EQUAL( int(INSTRUCTION_GENERATE_MASK), generate_mask.instruction );
+            CHECK_EQUAL( condition.result, promote.arguments[0] );
+            CHECK_EQUAL( promote.result, generate_mask.arguments[0] );
+        }
+
+        // The if and else are masked rather than jumped over.  The product
+        // is invariant in the inner loop so it is computed once per 
+        // iteration of the outer loop, into a temporary register that is 
+        // then read by the add assign in the if.
+        const int multiply = find( INSTRUCTION_MULTIPLY );
+        REQUIRE CHECK( multiply > outer_out && multiply < instructions[inner_back].jump );
+        int add_assigns_of_product = 0;
+        int invert_masks = 0;
+        for ( int i = inner_out + 1; i < inner_back; ++i )
+        {
+            if ( instructions[i].instruction == INSTRUCTION_ADD_ASSIGN && instructions[i].arguments[1] == instructions[multiply].result )
+            {
+                ++add_assigns_of_product;
+            }
+            else if ( instructions[i].instruction == INSTRUCTION_INVERT_MASK )
+            {
+                CHECK_EQUAL( 1, add_assigns_of_product );
+                ++invert_masks;
+            }
+        }
+        CHECK_EQUAL( 1, add_assigns_of_product );
+        CHECK_EQUAL( 1, invert_masks );
+
+        // Every result is written to a temporary register.
+        for ( int i = shader->shade_instruction(); i < size; ++i )
+        {
+            const int result = instructions[i].result;
+            CHECK( result == -1 || (result >= shader->permanent_registers() && result < shader->registers()) );
+        }
+    }
+}
@@ -0,0 +1,84 @@
+
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Shader.hpp>
+#include <reyes/Symbol.hpp>
+#include <reyes/Grid.hpp>
+#include <reyes/Value.hpp>
+#include <reyes/Identifier.hpp>
+#include <reyes/ErrorPolicy.hpp>
+#include <reyes/SymbolTable.hpp>
+#include <reyes/VirtualMachine.hpp>
+#include <reyes/assert.hpp>
+#include <string.h>
+
+using std::shared_ptr;
+using namespace reyes;
+
+static const float TOLERANCE = 0.01f;
+
+SUITE( ParameterBinding )
+{
+    TEST( global_variables_are_interned_first )
+    {
+        CHECK_EQUAL( int(IDENTIFIER_P), intern_identifier("P") );
+        CHECK_EQUAL( int(IDENTIFIER_CI), intern_identifier("Ci") );
+        CHECK_EQUAL( int(IDENTIFIER_PS), intern_identifier("Ps") );
+        int identifier = intern_identifier( "interned_identifier" );
+        CHECK( identifier >= IDENTIFIER_COUNT );
+        CHECK_EQUAL( identifier, intern_identifier("interned_identifier") );
+        CHECK_EQUAL( "interned_identifier", interned_identifier(identifier) );
+    }
+
+    TEST( grid_values_are_found_by_identifier_or_interned_identifier )
+    {
+        Grid grid;
+        grid.resize( 2, 2 );
+        shared_ptr<Value> Kd = grid.add_value( "Kd", TYPE_FLOAT, STORAGE_UNIFORM );
+        Value& P = grid.value( IDENTIFIER_P, TYPE_POINT );
+        CHECK( grid.find_value(intern_identifier("Kd")) == Kd );
+        CHECK( &grid["P"] == &P );
+        CHECK_EQUAL( 2, int(grid.identifiers().size()) );
+
+        Grid copied_grid( grid );
+        CHECK( copied_grid.find_value("Kd") && copied_grid.find_value("Kd") != Kd );
+        CHECK( copied_grid.find_value(IDENTIFIER_P) );
+
+        grid.clear();
+        CHECK( !grid.find_value("Kd") );
+        CHECK( !grid.find_value(IDENTIFIER_P) );
+        CHECK( grid.identifiers().empty() );
+    }
+
+    TEST( shaders_bind_grid_values_to_symbols_by_interned_identifier )
+    {
+        const char* source = 
+            "surface bind() { \n"
+            "   y = sin(x) + x; \n"
+            "}"
+        ;
+        ErrorPolicy error_policy;
+        SymbolTable symbol_table;
+        symbol_table.add_symbols()
+            ( "x", TYPE_FLOAT )
+            ( "y", TYPE_FLOAT )
+        ;
+        Shader shader( source, source + strlen(source), symbol_table, error_policy );
+        CHECK_EQUAL( 0, error_policy.total_errors() );
+        CHECK( shader.find_symbol(intern_identifier("x")) == shader.find_symbol("x").get() );
+        CHECK( shader.find_symbol(intern_identifier("y")) == shader.find_symbol("y").get() );
+        CHECK( !shader.find_symbol(intern_identifier("sin")) );
+
+        Grid grid;
+        grid.resize( 2, 2 );
+        shared_ptr<Value> y = grid.add_value( "y", TYPE_FLOAT );
+        y->zero();
+        shared_ptr<Value> x = grid.add_value( "x", TYPE_FLOAT );
+        x->zero();
+        x->float_values()[3] = 1.0f;
+        VirtualMachine virtual_machine;
+        virtual_machine.initialize( grid, shader );
+        virtual_machine.shade( grid, grid, shader );
+        CHECK_CLOSE( 0.0f, y->float_values()[0], TOLERANCE );
+        CHECK_CLOSE( 1.8415f, y->float_values()[3], TOLERANCE );
+    }
+}
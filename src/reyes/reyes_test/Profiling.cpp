@@ -0,0 +1,187 @@
+
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Shader.hpp>
+#include <reyes/Grid.hpp>
+#include <reyes/Value.hpp>
+#include <reyes/Profile.hpp>
+#include <reyes/ErrorPolicy.hpp>
+#include <reyes/SymbolTable.hpp>
+#include <reyes/VirtualMachine.hpp>
+#include <reyes/reyes_virtual_machine/Instruction.hpp>
+#include <reyes/reyes_virtual_machine/DecodedInstruction.hpp>
+#include <reyes/assert.hpp>
+#include <string>
+#include <string.h>
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using namespace reyes;
+
+static const float TOLERANCE = 0.01f;
+
+SUITE( Profiling )
+{
+    struct ProfilingTest
+    {
+        Grid grid;
+        float* x;
+        float* y;
+        shared_ptr<Shader> shader;
+        Profile profile;
+     
+        ProfilingTest()
+        : grid(),
+          x( NULL ),
+          y( NULL ),
+          shader(),
+          profile()
+        {
+            grid.resize( 2, 2 );            
+            shared_ptr<Value> x_value = grid.add_value( "x", TYPE_FLOAT );
+            x_value->zero();
+            x = x_value->float_values();
+            x[0] = 1.0f;
+            x[1] = 2.0f;
+            x[2] = 3.0f;
+            x[3] = 4.0f;
+
+            shared_ptr<Value> y_value = grid.add_value( "y", TYPE_FLOAT );
+            y_value->zero();
+            y = y_value->float_values();
+        }
+        
+        void test( const char* source, Profile* profile, int times = 1 )
+        {
+            ErrorPolicy error_policy;
+            SymbolTable symbol_table;
+            symbol_table.add_symbols()
+                ( "x", TYPE_FLOAT )
+                ( "y", TYPE_FLOAT )
+            ;
+            shader.reset( new Shader(source, source + strlen(source), symbol_table, error_policy) );
+            CHECK_EQUAL( 0, error_policy.total_errors() );
+
+            VirtualMachine virtual_machine;
+            virtual_machine.set_profile( profile );
+            virtual_machine.initialize( grid, *shader );
+            for ( int i = 0; i < times; ++i )
+            {
+                virtual_machine.shade( grid, grid, *shader );
+            }
+        }
+
+        int find_instruction( int instruction ) const
+        {
+            REYES_ASSERT( shader );
+            const vector<DecodedInstruction>& instructions = shader->instructions();
+            for ( int i = shader->shade_instruction(); i < shader->end_instruction(); ++i )
+            {
+                if ( instructions[i].instruction == instruction )
+                {
+                    return i;
+                }
+            }
+            return -1;
+        }
+    };
+
+    TEST_FIXTURE( ProfilingTest, executions_and_elements_are_counted )
+    {
+        test(
+            "surface executions_and_elements_are_counted() { \n"
+            "   y = x * 3; \n"
+            "}",
+            &profile, 2
+        );
+        CHECK_CLOSE( 12.0f, y[3], TOLERANCE );
+        const int multiply = find_instruction( INSTRUCTION_MULTIPLY );
+        CHECK( multiply >= 0 );
+        const Profile::Counters* counters = profile.find_counters( *shader );
+        CHECK( counters != NULL );
+        if ( counters && multiply >= 0 )
+        {
+            CHECK_EQUAL( 2u, unsigned(counters[multiply].executions) );
+            CHECK_EQUAL( 8u, unsigned(counters[multiply].elements) );
+        }
+    }
+
+    TEST_FIXTURE( ProfilingTest, elements_are_counted_under_condition_mask )
+    {
+        test(
+            "surface elements_are_counted_under_condition_mask() { \n"
+            "   if ( x > 2 ) { \n"
+            "       y = x * 3; \n"
+            "   } \n"
+            "}",
+            &profile
+        );
+        CHECK_CLOSE( 0.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 9.0f, y[2], TOLERANCE );
+        const int multiply = find_instruction( INSTRUCTION_MULTIPLY );
+        const Profile::Counters* counters = profile.find_counters( *shader );
+        CHECK( counters != NULL && multiply >= 0 );
+        if ( counters && multiply >= 0 )
+        {
+            CHECK_EQUAL( 1u, unsigned(counters[multiply].executions) );
+            CHECK_EQUAL( 2u, unsigned(counters[multiply].elements) );
+        }
+    }
+
+    TEST_FIXTURE( ProfilingTest, instructions_are_attributed_to_lines )
+    {
+        test(
+            "surface instructions_are_attributed_to_lines() { \n"
+            "   y = x * 3; \n"
+            "   \n"
+            "   y = y - 1; \n"
+            "}",
+            &profile
+        );
+        CHECK_CLOSE( 11.0f, y[3], TOLERANCE );
+        const int multiply = find_instruction( INSTRUCTION_MULTIPLY );
+        const int subtract = find_instruction( INSTRUCTION_SUBTRACT );
+        CHECK( multiply >= 0 && subtract >= 0 );
+        if ( multiply >= 0 && subtract >= 0 )
+        {
+            const vector<DecodedInstruction>& instructions = shader->instructions();
+            CHECK( instructions[multiply].line > 0 );
+            CHECK_EQUAL( instructions[multiply].line + 2, instructions[subtract].line );
+        }
+    }
+
+    TEST_FIXTURE( ProfilingTest, nothing_is_counted_without_profile )
+    {
+        test(
+            "surface nothing_is_counted_without_profile() { \n"
+            "   y = x * 3; \n"
+            "}",
+            NULL
+        );
+        CHECK_CLOSE( 12.0f, y[3], TOLERANCE );
+        CHECK( profile.find_counters(*shader) == NULL );
+        CHECK_EQUAL( 0, profile.shaders() );
+    }
+
+    TEST_FIXTURE( ProfilingTest, reports_list_shaders_and_lines )
+    {
+        test(
+            "surface reports_list_shaders_and_lines() { \n"
+            "   y = x * 3; \n"
+            "}",
+            &profile
+        );
+        CHECK_EQUAL( 1, profile.shaders() );
+        const string text = profile.text_report();
+        CHECK( text.find("(from memory)") != string::npos );
+        CHECK( text.find("line ") != string::npos );
+        const string json = profile.json_report();
+        CHECK( json.find("\"shaders\": [{\"name\": \"\"") != string::npos );
+        CHECK( json.find("\"lines\": [{\"line\": ") != string::npos );
+        CHECK( json.find("\"instruction\": \"multiply\"") != string::npos );
+
+        profile.clear();
+        CHECK_EQUAL( 0, profile.shaders() );
+        CHECK_EQUAL( string("{\"shaders\": []}\n"), profile.json_report() );
+    }
+}
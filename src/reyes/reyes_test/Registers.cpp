@@ -0,0 +1,114 @@
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Shader.hpp>
+#include <reyes/Grid.hpp>
+#include <reyes/Value.hpp>
+#include <reyes/ErrorPolicy.hpp>
+#include <reyes/SymbolTable.hpp>
+#include <reyes/VirtualMachine.hpp>
+#include <reyes/assert.hpp>
+#include <math/vec3.ipp>
+#include <string.h>
+
+using std::vector;
+using std::shared_ptr;
+using namespace math;
+using namespace reyes;
+
+static const float TOLERANCE = 0.01f;
+
+SUITE( Registers )
+{
+    struct RegisterTest
+    {
+        ErrorPolicy error_policy;
+        SymbolTable symbol_table;
+        shared_ptr<Shader> shader;
+        VirtualMachine virtual_machine;
+
+        RegisterTest()
+        : error_policy(),
+          symbol_table(),
+          shader(),
+          virtual_machine()
+        {
+            symbol_table.add_symbols()
+                ( "x", TYPE_FLOAT )
+                ( "y", TYPE_FLOAT )
+                ( "Cx", TYPE_COLOR )
+            ;
+        }
+
+        void compile( const char* source )
+        {
+            shader.reset( new Shader(source, source + strlen(source), symbol_table, error_policy) );
+        }
+
+        // Shade a \e width by \e height grid with the same virtual machine 
+        // each time so that its registers are reused and grown between grids.
+        void test( int width, int height )
+        {
+            REYES_ASSERT( shader );
+
+            Grid grid;
+            grid.resize( width, height );
+            float* x = grid.add_value( "x", TYPE_FLOAT )->float_values();
+            float* y = grid.add_value( "y", TYPE_FLOAT )->float_values();
+            vec3* Cx = grid.add_value( "Cx", TYPE_COLOR )->vec3_values();
+            for ( int i = 0; i < grid.size(); ++i )
+            {
+                x[i] = float(i + 1);
+                y[i] = 0.0f;
+                Cx[i] = vec3( 0.0f, 0.0f, 0.0f );
+            }
+
+            virtual_machine.initialize( grid, *shader );
+            virtual_machine.shade( grid, grid, *shader );
+
+            for ( int i = 0; i < grid.size(); ++i )
+            {
+                const float value = float(i + 1);
+                CHECK_CLOSE( 5.0f * value, y[i], TOLERANCE );
+                CHECK_CLOSE( 5.0f * value, Cx[i].x, TOLERANCE );
+                CHECK_CLOSE( 7.0f * value, Cx[i].y, TOLERANCE );
+                CHECK_CLOSE( 9.0f * value, Cx[i].z, TOLERANCE );
+            }
+
+            // Every temporary register stays in its own equally sized slot of
+            // the contiguous block and each slot holds the values stored in 
+            // its register without reaching into the next slot.
+            const int registers = virtual_machine.temporary_registers();
+            CHECK( registers >= shader->registers() && registers >= 2 );
+            const char* first = static_cast<const char*>( virtual_machine.temporary_register(0).values() );
+            const ptrdiff_t stride = static_cast<const char*>( virtual_machine.temporary_register(1).values() ) - first;
+            CHECK( stride >= ptrdiff_t(grid.size() * sizeof(vec3)) );
+            for ( int i = 0; i < registers; ++i )
+            {
+                const Value& value = virtual_machine.temporary_register( i );
+                CHECK( static_cast<const char*>(value.values()) == first + i * stride );
+                CHECK( ptrdiff_t(value.size() * value.element_size()) <= stride );
+            }
+        }
+    };
+
+    TEST_FIXTURE( RegisterTest, registers_reused_across_grid_sizes )
+    {
+        // The varying colors and floats are live at the same time in 
+        // neighbouring registers so any register that overlaps another 
+        // once the registers are grown or reused corrupts the results.
+        compile(
+            "surface registers_reused_across_grid_sizes() { \n"
+            "   color a = color(1, 2, 3) * x; \n"
+            "   float b = x * 2; \n"
+            "   color c = color(4, 5, 6) * x; \n"
+            "   float d = x * 3; \n"
+            "   Cx = a + c; \n"
+            "   y = b + d; \n"
+            "}"
+        );
+        test( 2, 2 );
+        test( 16, 16 );
+        test( 2, 2 );
+        test( 32, 24 );
+        test( 3, 1 );
+    }
+}
@@ -0,0 +1,138 @@
+
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Renderer.hpp>
+#include <reyes/Shader.hpp>
+#include <reyes/ShaderCache.hpp>
+#include <reyes/Symbol.hpp>
+#include <reyes/SymbolTable.hpp>
+#include <reyes/Value.hpp>
+#include <reyes/ErrorPolicy.hpp>
+#include <reyes/assert.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+
+using std::find;
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using namespace reyes;
+
+static bool file_exists( const string& filename )
+{
+    FILE* file = fopen( filename.c_str(), "rb" );
+    if ( file )
+    {
+        fclose( file );
+    }
+    return file != NULL;
+}
+
+static bool equal_values( const Value* value, const Value* other_value )
+{
+    if ( value->type() != other_value->type() || value->storage() != other_value->storage() || value->size() != other_value->size() )
+    {
+        return false;
+    }
+    if ( value->type() == TYPE_STRING )
+    {
+        return value->string_value() == other_value->string_value();
+    }
+    return memcmp( value->values(), other_value->values(), value->size() * value->element_size() ) == 0;
+}
+
+static bool equal_shaders( const Shader& shader, const Shader& other_shader )
+{
+    bool equal = 
+        shader.code() == other_shader.code() &&
+        shader.initialize_address() == other_shader.initialize_address() &&
+        shader.shade_address() == other_shader.shade_address() &&
+        shader.end_instruction() == other_shader.end_instruction() &&
+        shader.parameters() == other_shader.parameters() &&
+        shader.variables() == other_shader.variables() &&
+        shader.constants() == other_shader.constants() &&
+        shader.permanent_registers() == other_shader.permanent_registers() &&
+        shader.registers() == other_shader.registers() &&
+        shader.uses_lights() == other_shader.uses_lights() &&
+        shader.globals() == other_shader.globals() &&
+        shader.solar_and_illuminate_statements() == other_shader.solar_and_illuminate_statements() &&
+        shader.symbols().size() == other_shader.symbols().size() &&
+        shader.values().size() == other_shader.values().size()
+    ;
+    for ( unsigned int i = 0; equal && i < shader.symbols().size(); ++i )
+    {
+        const Symbol* symbol = shader.symbols()[i].get();
+        const Symbol* other_symbol = other_shader.symbols()[i].get();
+        equal = 
+            symbol->identifier() == other_symbol->identifier() &&
+            symbol->type() == other_symbol->type() &&
+            symbol->storage() == other_symbol->storage() &&
+            (symbol->function() || symbol->register_index() == other_symbol->register_index())
+        ;
+    }
+    for ( unsigned int i = 0; equal && i < shader.values().size(); ++i )
+    {
+        equal = equal_values( shader.values()[i].get(), other_shader.values()[i].get() );
+    }
+    return equal;
+}
+
+SUITE( ShaderCache )
+{
+    TEST( shaders_loaded_from_the_cache_match_compiled_shaders )
+    {
+        ShaderCache shader_cache( "." );
+        const string cache_filename = shader_cache.cache_filename( SHADERS_PATH "plastic.sl" );
+        CHECK( !cache_filename.empty() );
+        remove( cache_filename.c_str() );
+
+        Renderer renderer;
+        shared_ptr<Shader> compiled_shader = shader_cache.shader( SHADERS_PATH "plastic.sl", renderer.symbol_table(), renderer.error_policy() );
+        CHECK( file_exists(cache_filename) );
+
+        Renderer other_renderer;
+        shared_ptr<Shader> cached_shader = shader_cache.shader( SHADERS_PATH "plastic.sl", other_renderer.symbol_table(), other_renderer.error_policy() );
+        CHECK( compiled_shader && cached_shader );
+        CHECK( equal_shaders(*compiled_shader, *cached_shader) );
+        CHECK_EQUAL( 0, renderer.error_policy().total_errors() + other_renderer.error_policy().total_errors() );
+
+        // Functions called by cached shaders are the functions in the 
+        // SymbolTable that the shader was loaded with.
+        const vector<shared_ptr<Symbol>>& symbols = cached_shader->symbols();
+        for ( vector<shared_ptr<Symbol>>::const_iterator i = symbols.begin(); i != symbols.end(); ++i )
+        {
+            if ( (*i)->function() )
+            {
+                vector<shared_ptr<Symbol>> functions = other_renderer.symbol_table().find_symbols( (*i)->identifier() );
+                CHECK( find(functions.begin(), functions.end(), *i) != functions.end() );
+            }
+        }
+
+        remove( cache_filename.c_str() );
+    }
+
+    TEST( corrupt_cache_files_are_compiled_again )
+    {
+        ShaderCache shader_cache( "." );
+        const string cache_filename = shader_cache.cache_filename( SHADERS_PATH "matte.sl" );
+        FILE* file = fopen( cache_filename.c_str(), "wb" );
+        CHECK( file );
+        if ( file )
+        {
+            fputs( "not a cached shader", file );
+            fclose( file );
+        }
+
+        Renderer renderer;
+        shared_ptr<Shader> shader = shader_cache.shader( SHADERS_PATH "matte.sl", renderer.symbol_table(), renderer.error_policy() );
+        shared_ptr<Shader> compiled_shader( new Shader(SHADERS_PATH "matte.sl", renderer.symbol_table(), renderer.error_policy()) );
+        CHECK( shader );
+        CHECK( equal_shaders(*compiled_shader, *shader) );
+        CHECK_EQUAL( 0, renderer.error_policy().total_errors() );
+
+        remove( cache_filename.c_str() );
+    }
+}
@@ -0,0 +1,141 @@
+
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Renderer.hpp>
+#include <reyes/AssetCache.hpp>
+#include <reyes/Shader.hpp>
+#include <reyes/ErrorPolicy.hpp>
+#include <reyes/DeferredErrorPolicy.hpp>
+#include <reyes/ErrorCode.hpp>
+#include <reyes/assert.hpp>
+#include <thread>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdio.h>
+
+using std::thread;
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using namespace reyes;
+
+static void write_shader( const char* filename, const char* source )
+{
+    FILE* file = fopen( filename, "wb" );
+    REYES_ASSERT( file );
+    if ( file )
+    {
+        fputs( source, file );
+        fclose( file );
+    }
+}
+
+SUITE( SharedAssets )
+{
+    TEST( shaders_are_shared_between_renderers_sharing_a_cache )
+    {
+        shared_ptr<AssetCache> asset_cache( new AssetCache );
+        Renderer renderer( asset_cache );
+        Renderer other_renderer( renderer.asset_cache() );
+        const Shader* shader = renderer.shader( SHADERS_PATH "plastic.sl" );
+        const Shader* other_shader = other_renderer.shader( SHADERS_PATH "plastic.sl" );
+        CHECK( shader );
+        CHECK( shader == other_shader );
+        CHECK( asset_cache->find_shader(SHADERS_PATH "plastic.sl").get() == shader );
+        CHECK_EQUAL( 0, renderer.error_policy().total_errors() );
+    }
+
+    TEST( shaders_are_not_shared_between_renderers_with_private_caches )
+    {
+        Renderer renderer;
+        Renderer other_renderer;
+        const Shader* shader = renderer.shader( SHADERS_PATH "matte.sl" );
+        const Shader* other_shader = other_renderer.shader( SHADERS_PATH "matte.sl" );
+        CHECK( shader && other_shader );
+        CHECK( shader != other_shader );
+    }
+
+    TEST( shaders_outlive_a_cleared_cache )
+    {
+        shared_ptr<AssetCache> asset_cache( new AssetCache );
+        Renderer renderer( asset_cache );
+        const Shader* shader = renderer.shader( SHADERS_PATH "matte.sl" );
+        asset_cache->clear();
+        CHECK( !asset_cache->find_shader(SHADERS_PATH "matte.sl") );
+        CHECK( renderer.find_shader(SHADERS_PATH "matte.sl") == shader );
+        CHECK( shader->code().size() > 0 );
+    }
+
+    TEST( shaders_loaded_concurrently_are_compiled_once_per_cache_entry )
+    {
+        shared_ptr<AssetCache> asset_cache( new AssetCache );
+        const Shader* shaders [2] = { NULL, NULL };
+        thread threads [2];
+        for ( int i = 0; i < 2; ++i )
+        {
+            threads[i] = thread( [&asset_cache, &shaders, i]() {
+                Renderer renderer( asset_cache );
+                renderer.shader( SHADERS_PATH "metal.sl" );
+                shaders[i] = asset_cache->find_shader( SHADERS_PATH "metal.sl" ).get();
+            } );
+        }
+        for ( int i = 0; i < 2; ++i )
+        {
+            threads[i].join();
+        }
+        CHECK( shaders[0] );
+        CHECK( shaders[0] == shaders[1] );
+    }
+
+    TEST( shaders_loaded_together_match_shaders_loaded_one_at_a_time )
+    {
+        vector<string> filenames;
+        filenames.push_back( SHADERS_PATH "plastic.sl" );
+        filenames.push_back( SHADERS_PATH "matte.sl" );
+        filenames.push_back( SHADERS_PATH "metal.sl" );
+        filenames.push_back( SHADERS_PATH "plastic.sl" );
+        filenames.push_back( SHADERS_PATH "pointlight.sl" );
+
+        shared_ptr<AssetCache> asset_cache( new AssetCache );
+        Renderer renderer( asset_cache );
+        renderer.load_shaders( filenames, 4 );
+        CHECK_EQUAL( 0, renderer.error_policy().total_errors() );
+
+        Renderer other_renderer;
+        for ( vector<string>::const_iterator i = filenames.begin(); i != filenames.end(); ++i )
+        {
+            const Shader* shader = renderer.find_shader( i->c_str() );
+            const Shader* other_shader = other_renderer.shader( i->c_str() );
+            CHECK( shader && other_shader );
+            CHECK( asset_cache->find_shader(i->c_str()).get() == shader );
+            CHECK( shader->code() == other_shader->code() );
+            CHECK_EQUAL( other_shader->symbols().size(), shader->symbols().size() );
+        }
+    }
+
+    TEST( errors_in_shaders_loaded_together_are_reported_in_order )
+    {
+        write_shader( "continue_outside_loop.sl", "surface continue_outside_loop() { continue; }" );
+        write_shader( "break_outside_loop.sl", "surface break_outside_loop() { break; }" );
+        vector<string> filenames;
+        filenames.push_back( "continue_outside_loop.sl" );
+        filenames.push_back( SHADERS_PATH "matte.sl" );
+        filenames.push_back( "break_outside_loop.sl" );
+
+        AssetCache asset_cache;
+        Renderer renderer;
+        DeferredErrorPolicy error_policy;
+        vector<shared_ptr<const Shader>> shaders = asset_cache.shaders( filenames, renderer.symbol_table(), error_policy, 3 );
+        CHECK_EQUAL( 3, int(shaders.size()) );
+        REQUIRE CHECK_EQUAL( 4, int(error_policy.messages().size()) );
+        CHECK_EQUAL( RENDER_ERROR_CODE_GENERATION_ERROR, error_policy.codes()[0] );
+        CHECK_EQUAL( "Continue outside of a loop", error_policy.messages()[0] );
+        CHECK_EQUAL( RENDER_ERROR_CODE_GENERATION_FAILED, error_policy.codes()[1] );
+        CHECK_EQUAL( RENDER_ERROR_CODE_GENERATION_ERROR, error_policy.codes()[2] );
+        CHECK_EQUAL( "Break outside of a loop", error_policy.messages()[2] );
+        CHECK_EQUAL( RENDER_ERROR_CODE_GENERATION_FAILED, error_policy.codes()[3] );
+
+        remove( "continue_outside_loop.sl" );
+        remove( "break_outside_loop.sl" );
+    }
+}
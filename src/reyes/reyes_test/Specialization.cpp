@@ -0,0 +1,179 @@
+
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Shader.hpp>
+#include <reyes/Grid.hpp>
+#include <reyes/Value.hpp>
+#include <reyes/ErrorPolicy.hpp>
+#include <reyes/SymbolTable.hpp>
+#include <reyes/VirtualMachine.hpp>
+#include <reyes/reyes_virtual_machine/Instruction.hpp>
+#include <reyes/reyes_virtual_machine/InstructionMetadata.hpp>
+#include <reyes/assert.hpp>
+#include <algorithm>
+#include <string.h>
+
+using std::find;
+using std::vector;
+using std::shared_ptr;
+using namespace reyes;
+
+static const float TOLERANCE = 0.01f;
+
+SUITE( Specialization )
+{
+    struct SpecializationTest
+    {
+        Grid grid;
+        Grid parameters;
+        float* x;
+        float* y;
+        shared_ptr<Shader> shader;
+     
+        SpecializationTest()
+        : grid(),
+          parameters(),
+          x( NULL ),
+          y( NULL ),
+          shader()
+        {
+            grid.resize( 2, 2 );            
+            shared_ptr<Value> x_value = grid.add_value( "x", TYPE_FLOAT );
+            x_value->zero();
+            x = x_value->float_values();
+            x[0] = 1.0f;
+            x[1] = 2.0f;
+            x[2] = 3.0f;
+            x[3] = 4.0f;
+
+            shared_ptr<Value> y_value = grid.add_value( "y", TYPE_FLOAT );
+            y_value->zero();
+            y = y_value->float_values();
+        }
+        
+        void compile( const char* source, bool specialized )
+        {
+            ErrorPolicy error_policy;
+            SymbolTable symbol_table;
+            symbol_table.add_symbols()
+                ( "x", TYPE_FLOAT )
+                ( "y", TYPE_FLOAT )
+            ;
+            shader.reset( new Shader(source, source + strlen(source), symbol_table, error_policy) );
+            shader->set_specialized( specialized );
+            VirtualMachine virtual_machine;
+            virtual_machine.initialize( parameters, *shader );
+        }
+
+        const Shader* shade()
+        {
+            const Shader* specialization = shader->specialization( parameters );
+            REYES_ASSERT( specialization );
+            VirtualMachine virtual_machine;
+            virtual_machine.shade( grid, parameters, *specialization );
+            return specialization;
+        }
+
+        static bool contains( const Shader& shader, int instruction )
+        {
+            const vector<unsigned char>& code = shader.code();
+            unsigned int address = 0;
+            while ( address < code.size() )
+            {
+                int code_instruction = *reinterpret_cast<const short*>( &code[address] );
+                if ( code_instruction == instruction )
+                {
+                    return true;
+                }
+                const InstructionMetadata& metadata = instruction_metadata( code_instruction );
+                address += sizeof(short) + metadata.words * sizeof(short) + metadata.arguments * sizeof(int);
+            }
+            return false;
+        }
+    };
+
+    static const char* DOUBLE_OR_SQUARE = 
+        "surface double_or_square( float square = 0; ) { \n"
+        "   if ( square != 0 ) { \n"
+        "       y = x * x; \n"
+        "   } else { \n"
+        "       y = x + x; \n"
+        "   } \n"
+        "}"
+    ;
+
+    TEST_FIXTURE( SpecializationTest, unspecialized_shaders_run_themselves )
+    {
+        compile( DOUBLE_OR_SQUARE, false );
+        const Shader* specialization = shade();
+        CHECK( specialization == shader.get() );
+        CHECK_CLOSE( 2.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 8.0f, y[3], TOLERANCE );
+    }
+
+    TEST_FIXTURE( SpecializationTest, branches_on_uniform_parameters_are_folded )
+    {
+        compile( DOUBLE_OR_SQUARE, true );
+        CHECK( contains(*shader, INSTRUCTION_GENERATE_MASK) );
+
+        const Shader* doubled = shade();
+        CHECK( doubled != shader.get() );
+        CHECK( !contains(*doubled, INSTRUCTION_GENERATE_MASK) );
+        CHECK( !contains(*doubled, INSTRUCTION_INVERT_MASK) );
+        CHECK( !contains(*doubled, INSTRUCTION_MULTIPLY) );
+        CHECK_CLOSE( 2.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 4.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 6.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 8.0f, y[3], TOLERANCE );
+
+        parameters["square"].float_values()[0] = 1.0f;
+        const Shader* squared = shade();
+        CHECK( squared != doubled );
+        CHECK( !contains(*squared, INSTRUCTION_GENERATE_MASK) );
+        CHECK( !contains(*squared, INSTRUCTION_ADD) );
+        CHECK_CLOSE( 1.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 4.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 9.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 16.0f, y[3], TOLERANCE );
+
+        parameters["square"].float_values()[0] = 0.0f;
+        CHECK( shade() == doubled );
+    }
+
+    TEST_FIXTURE( SpecializationTest, written_parameters_are_not_specialized )
+    {
+        compile( 
+            "surface written_parameter( float square = 0; ) { \n"
+            "   square = square + 1; \n"
+            "   if ( square != 0 ) { \n"
+            "       y = x * x; \n"
+            "   } \n"
+            "}",
+            true
+        );
+        CHECK( shade() == shader.get() );
+    }
+
+    TEST_FIXTURE( SpecializationTest, parameters_past_the_most_variants_run_the_shader )
+    {
+        compile( DOUBLE_OR_SQUARE, true );
+        vector<const Shader*> variants;
+        const Shader* specialization = NULL;
+        float square = 1.0f;
+        while ( (specialization = shade()) != shader.get() )
+        {
+            CHECK( find(variants.begin(), variants.end(), specialization) == variants.end() );
+            variants.push_back( specialization );
+            REQUIRE CHECK( variants.size() <= 1024 );
+            parameters["square"].float_values()[0] = square;
+            square += 1.0f;
+        }
+        CHECK( variants.size() > 1 );
+        CHECK_CLOSE( 1.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 16.0f, y[3], TOLERANCE );
+
+        parameters["square"].float_values()[0] = 0.0f;
+        CHECK( shade() == variants.front() );
+        parameters["square"].float_values()[0] = 1.0f;
+        CHECK( shade() == variants[1] );
+    }
+}
@@ -0,0 +1,231 @@
+
+#include "CaptureErrorPolicy.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Shader.hpp>
+#include <reyes/Grid.hpp>
+#include <reyes/Value.hpp>
+#include <reyes/ErrorCode.hpp>
+#include <reyes/ErrorPolicy.hpp>
+#include <reyes/SymbolTable.hpp>
+#include <reyes/VirtualMachine.hpp>
+#include <reyes/reyes_virtual_machine/Instruction.hpp>
+#include <reyes/reyes_virtual_machine/InstructionMetadata.hpp>
+#include <reyes/assert.hpp>
+#include <string.h>
+
+using std::vector;
+using std::shared_ptr;
+using namespace reyes;
+
+static const float TOLERANCE = 0.01f;
+
+SUITE( UserFunctions )
+{
+    struct UserFunctionTest
+    {
+        Grid grid;
+        float* x;
+        float* y;
+        shared_ptr<Shader> shader;
+     
+        UserFunctionTest()
+        : grid(),
+          x( NULL ),
+          y( NULL ),
+          shader()
+        {
+            grid.resize( 2, 2 );            
+            shared_ptr<Value> x_value = grid.add_value( "x", TYPE_FLOAT );
+            x_value->zero();
+            x = x_value->float_values();
+            x[0] = 1.0f;
+            x[1] = 2.0f;
+            x[2] = 3.0f;
+            x[3] = 4.0f;
+
+            shared_ptr<Value> y_value = grid.add_value( "y", TYPE_FLOAT );
+            y_value->zero();
+            y = y_value->float_values();
+        }
+        
+        void test( const char* source )
+        {
+            ErrorPolicy error_policy;
+            test( source, error_policy );
+            VirtualMachine virtual_machine;
+            virtual_machine.initialize( grid, *shader );
+            virtual_machine.shade( grid, grid, *shader );
+        }
+
+        void test( const char* source, ErrorPolicy& error_policy )
+        {
+            SymbolTable symbol_table;
+            symbol_table.add_symbols()
+                ( "x", TYPE_FLOAT )
+                ( "y", TYPE_FLOAT )
+            ;
+            shader.reset( new Shader(source, source + strlen(source), symbol_table, error_policy) );
+        }
+
+        bool contains( int instruction ) const
+        {
+            REYES_ASSERT( shader );
+            const vector<unsigned char>& code = shader->code();
+            unsigned int address = 0;
+            while ( address < code.size() )
+            {
+                int code_instruction = *reinterpret_cast<const short*>( &code[address] );
+                if ( code_instruction == instruction )
+                {
+                    return true;
+                }
+                const InstructionMetadata& metadata = instruction_metadata( code_instruction );
+                address += sizeof(short) + metadata.words * sizeof(short) + metadata.arguments * sizeof(int);
+            }
+            return false;
+        }
+    };
+
+    TEST_FIXTURE( UserFunctionTest, return_value )
+    {
+        test(
+            "float twice( float a; ) { \n"
+            "   return a * 2; \n"
+            "} \n"
+            "surface return_value() { \n"
+            "   y = twice( x ) + 1; \n"
+            "}"
+        );
+        CHECK_CLOSE( 3.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 5.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 7.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 9.0f, y[3], TOLERANCE );
+        CHECK( !contains(INSTRUCTION_CALL_1) );
+    }
+
+    TEST_FIXTURE( UserFunctionTest, called_twice_in_expression )
+    {
+        test(
+            "float twice( float a; ) { \n"
+            "   float b = a * 2; \n"
+            "   return b; \n"
+            "} \n"
+            "surface called_twice_in_expression() { \n"
+            "   y = twice( x ) + twice( x + 1 ); \n"
+            "}"
+        );
+        CHECK_CLOSE( 6.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 10.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 14.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 18.0f, y[3], TOLERANCE );
+    }
+
+    TEST_FIXTURE( UserFunctionTest, nested_calls )
+    {
+        test(
+            "float twice( float a; ) { \n"
+            "   return a * 2; \n"
+            "} \n"
+            "float quadruple( float a; ) { \n"
+            "   return twice( twice(a) ); \n"
+            "} \n"
+            "surface nested_calls() { \n"
+            "   y = quadruple( x ); \n"
+            "}"
+        );
+        CHECK_CLOSE( 4.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 8.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 12.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 16.0f, y[3], TOLERANCE );
+    }
+
+    TEST_FIXTURE( UserFunctionTest, output_parameter )
+    {
+        test(
+            "void scale( output float value; float factor; ) { \n"
+            "   value *= factor; \n"
+            "} \n"
+            "surface output_parameter() { \n"
+            "   y = x; \n"
+            "   scale( y, 3 ); \n"
+            "}"
+        );
+        CHECK_CLOSE( 3.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 6.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 9.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 12.0f, y[3], TOLERANCE );
+    }
+
+    TEST_FIXTURE( UserFunctionTest, extern_variable )
+    {
+        test(
+            "float scaled( float a; ) { \n"
+            "   extern float k; \n"
+            "   return a * k; \n"
+            "} \n"
+            "surface extern_variable() { \n"
+            "   float k = 3; \n"
+            "   y = scaled( x ); \n"
+            "}"
+        );
+        CHECK_CLOSE( 3.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 6.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 9.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 12.0f, y[3], TOLERANCE );
+    }
+
+    TEST_FIXTURE( UserFunctionTest, call_in_condition )
+    {
+        test(
+            "float twice( float a; ) { \n"
+            "   return a * 2; \n"
+            "} \n"
+            "surface call_in_condition() { \n"
+            "   y = x; \n"
+            "   if ( x > 2 ) { \n"
+            "       y = twice( x ); \n"
+            "   } \n"
+            "}"
+        );
+        CHECK_CLOSE( 1.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 2.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 6.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 8.0f, y[3], TOLERANCE );
+    }
+
+    TEST_FIXTURE( UserFunctionTest, dead_code_in_function )
+    {
+        test(
+            "float square( float a; ) { \n"
+            "   float debug = a + 7; \n"
+            "   return a * a; \n"
+            "} \n"
+            "surface dead_code_in_function() { \n"
+            "   y = square( x ); \n"
+            "}"
+        );
+        CHECK_CLOSE( 1.0f, y[0], TOLERANCE );
+        CHECK_CLOSE( 4.0f, y[1], TOLERANCE );
+        CHECK_CLOSE( 9.0f, y[2], TOLERANCE );
+        CHECK_CLOSE( 16.0f, y[3], TOLERANCE );
+        CHECK( !contains(INSTRUCTION_ADD) );
+    }
+
+    TEST_FIXTURE( UserFunctionTest, return_before_last_statement )
+    {
+        const char* source =
+            "float first( float a; ) { \n"
+            "   return a; \n"
+            "   a = 2; \n"
+            "} \n"
+            "surface return_before_last_statement() { \n"
+            "   y = first( x ); \n"
+            "}"
+        ;
+        CaptureErrorPolicy error_policy;
+        test( source, error_policy );
+        REQUIRE CHECK( !error_policy.errors.empty() && !error_policy.messages.empty() );
+        CHECK_EQUAL( error_policy.errors[0], RENDER_ERROR_SYNTAX_ERROR );
+        CHECK_EQUAL( error_policy.messages[0], "(1): Function 'first' must return a value from its last statement only" );
+    }
+}
@@ -0,0 +1,56 @@
+
+#include <UnitTest++/UnitTest++.h>
+#include <reyes/Value.hpp>
+#include <math/vec3.ipp>
+
+using namespace math;
+using namespace reyes;
+
+SUITE( Values )
+{
+    TEST( uniform_values_are_stored_inline )
+    {
+        Value value( TYPE_COLOR, STORAGE_UNIFORM, 1 );
+        value = vec3( 1.0f, 0.5f, 0.25f );
+        const char* begin = reinterpret_cast<const char*>( &value );
+        const char* values = reinterpret_cast<const char*>( value.values() );
+        CHECK( values >= begin && values < begin + sizeof(Value) );
+        CHECK_CLOSE( 0.5f, value.vec3_value().y, 0.01f );
+    }
+
+    TEST( varying_values_keep_their_contents_when_they_grow )
+    {
+        Value value( TYPE_FLOAT, STORAGE_VARYING, 4 );
+        float* values = value.float_values();
+        for ( int i = 0; i < 4; ++i )
+        {
+            values[i] = float(i);
+        }
+        value.reset( TYPE_FLOAT, STORAGE_VARYING, 1024 );
+        CHECK_EQUAL( 1024u, value.size() );
+        CHECK_CLOSE( 3.0f, value.float_values()[3], 0.01f );
+        value.float_values()[1023] = 1.0f;
+    }
+
+    TEST( copied_values_use_their_own_buffers )
+    {
+        Value value( TYPE_POINT, STORAGE_VARYING, 256 );
+        value.zero();
+        Value copied_value( value );
+        copied_value.vec3_values()[255] = vec3( 1.0f, 1.0f, 1.0f );
+        CHECK( copied_value.values() != value.values() );
+        CHECK_CLOSE( 0.0f, value.vec3_values()[255].x, 0.01f );
+        CHECK_CLOSE( 1.0f, copied_value.vec3_values()[255].x, 0.01f );
+    }
+
+    TEST( released_buffers_are_reused )
+    {
+        void* released_values = NULL;
+        {
+            Value value( TYPE_NORMAL, STORAGE_VARYING, 17 * 17 );
+            released_values = value.values();
+        }
+        Value value( TYPE_NORMAL, STORAGE_VARYING, 17 * 17 );
+        CHECK( value.values() == released_values );
+    }
+}
@@ -9,9 +9,18 @@
 
 using namespace reyes;
 
+// A mask is sparse when no more than one in SPARSE_ELEMENTS elements is
+// processed and the processed elements fall in no more than one run per 
+// SPARSE_RUN_ELEMENTS elements; denser masks are cheaper to apply by 
+// processing every element with the vectorized kernels.
+static const int SPARSE_ELEMENTS = 4;
+static const unsigned int SPARSE_RUN_ELEMENTS = 16;
+
 ConditionMask::ConditionMask()
 : mask_(),
-  processed_( 0 )
+  processed_( 0 ),
+  runs_(),
+  sparse_( false )
 {
 }
 
@@ -30,7 +39,31 @@ bool ConditionMask::empty() const
     return processed_ == 0;
 }
 
-void ConditionMask::generate( std::shared_ptr<Value> value )
+/**
+// Does this mask process few enough elements that operations should only
+// process the elements in runs() rather than every element?
+//
+// @return
+//  True if this mask is sparse otherwise false.
+*/
+bool ConditionMask::sparse() const
+{
+    return sparse_;
+}
+
+/**
+// Get the runs of consecutive processed elements in this mask.
+//
+// @return
+//  The runs of processed elements or an empty vector if this mask isn't
+//  sparse (or processes no elements).
+*/
+const std::vector<ConditionMask::Run>& ConditionMask::runs() const
+{
+    return runs_;
+}
+
+void ConditionMask::generate( const Value* value )
 {
     REYES_ASSERT( value );
     REYES_ASSERT( value->type() == TYPE_INTEGER );
@@ -38,7 +71,7 @@ void ConditionMask::generate( std::shared_ptr<Value> value )
     const unsigned int size = value->size();
     const int* values = value->int_values();
 
-    mask_.insert( mask_.end(), size, 0 );
+    mask_.assign( size, 0 );
     processed_ = 0;
     unsigned char* mask = &mask_[0];
     for ( unsigned int i = 0; i < size; ++i )
@@ -47,9 +80,10 @@ void ConditionMask::generate( std::shared_ptr<Value> value )
         mask[i] = process != 0;
         processed_ += process != 0;
     }
+    find_runs();
 }
 
-void ConditionMask::generate( const ConditionMask& condition_mask, std::shared_ptr<Value> value )
+void ConditionMask::generate( const ConditionMask& condition_mask, const Value* value )
 {
     REYES_ASSERT( value );
     REYES_ASSERT( value->type() == TYPE_INTEGER );
@@ -59,7 +93,7 @@ void ConditionMask::generate( const ConditionMask& condition_mask, std::shared_p
     const int* values = value->int_values();
     const unsigned char* existing_mask = &condition_mask.mask_[0];
 
-    mask_.insert( mask_.end(), size, 0 );
+    mask_.assign( size, 0 );
     processed_ = 0;
     unsigned char* mask = &mask_[0];
     for ( unsigned int i = 0; i < size; ++i )
@@ -68,6 +102,7 @@ void ConditionMask::generate( const ConditionMask& condition_mask, std::shared_p
         mask[i] = process != 0;
         processed_ += process != 0;
     }
+    find_runs();
 }
 
 void ConditionMask::invert()
@@ -82,4 +117,50 @@ void ConditionMask::invert()
         mask[i] = process != 0;
         processed_ += process != 0;
     }
+    find_runs();
+}
+
+/**
+// Find the runs of consecutive processed elements in this mask if few 
+// enough elements are processed for the mask to be sparse.
+//
+// Blocks of elements that aren't processed fall between runs so iterating
+// over runs skips them entirely.
+*/
+void ConditionMask::find_runs()
+{
+    runs_.clear();
+    sparse_ = false;
+
+    const unsigned int size = (unsigned int) mask_.size();
+    if ( size == 0 || processed_ * SPARSE_ELEMENTS > int(size) )
+    {
+        return;
+    }
+
+    const unsigned char* mask = &mask_[0];
+    unsigned int i = 0;
+    while ( i < size )
+    {
+        while ( i < size && !mask[i] )
+        {
+            ++i;
+        }
+        const unsigned int begin = i;
+        while ( i < size && mask[i] )
+        {
+            ++i;
+        }
+        if ( i > begin )
+        {
+            Run run = { begin, i - begin };
+            runs_.push_back( run );
+            if ( runs_.size() * SPARSE_RUN_ELEMENTS > size )
+            {
+                runs_.clear();
+                return;
+            }
+        }
+    }
+    sparse_ = true;
 }
@@ -11,17 +11,35 @@ class Value;
 
 class ConditionMask
 {
+public:
+    /**
+    // A run of consecutive elements that are all processed.
+    */
+    struct Run
+    {
+        unsigned int begin; ///< The index of the first element in the run.
+        unsigned int length; ///< The number of elements in the run.
+    };
+
+private:
     std::vector<unsigned char> mask_; ///< The mask that specifies whether or not an element is to be processed.
     int processed_; ///< The number of elements that are to be processed by this mask.
+    std::vector<Run> runs_; ///< The runs of processed elements (only when this mask is sparse).
+    bool sparse_; ///< True if few enough elements are processed that operations should iterate over runs_.
 
 public:
     ConditionMask();
     const std::vector<unsigned char>& mask() const;
     int processed() const;
     bool empty() const;
-    void generate( std::shared_ptr<Value> value );
-    void generate( const ConditionMask& condition_mask, std::shared_ptr<Value> value );
+    bool sparse() const;
+    const std::vector<Run>& runs() const;
+    void generate( const Value* value );
+    void generate( const ConditionMask& condition_mask, const Value* value );
     void invert();
+
+private:
+    void find_runs();
 };
 
 }
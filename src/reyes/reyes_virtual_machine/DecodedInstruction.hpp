@@ -0,0 +1,43 @@
+#ifndef REYES_DECODEDINSTRUCTION_HPP_INCLUDED
+#define REYES_DECODEDINSTRUCTION_HPP_INCLUDED
+
+#include "Kernel.hpp"
+
+namespace reyes
+{
+
+/**
+// An instruction decoded from byte code once when a shader is loaded so 
+// that the virtual machine doesn't decode it again each time it executes.
+//
+// The register that an instruction writes its result to is resolved from
+// the implicit allocation of registers by instructions and resets so no
+// resets remain, jumps refer to the index of the instruction jumped to,
+// and arithmetic, comparisons, and negation refer to the kernel selected 
+// by their dispatch code.
+*/
+struct DecodedInstruction
+{
+    enum
+    {
+        ARGUMENTS = 7 ///< The most arguments taken by any instruction.
+    };
+
+    int instruction; ///< The instruction.
+    int dispatch; ///< The dispatch code for the instruction.
+    int addend_dispatch; ///< The dispatch code for the addend of multiply-adds (otherwise 0).
+    union
+    {
+        BinaryKernel binary; ///< The kernel for add, subtract, multiply, and divide.
+        ComparisonKernel comparison; ///< The kernel for greater, greater equal, less, less equal, equal, and not equal.
+        UnaryKernel unary; ///< The kernel for negate.
+    } kernel; ///< The kernel selected by the dispatch code of the instruction (otherwise null).
+    int result; ///< The register that the instruction writes its result to or -1 if it doesn't have a result.
+    int jump; ///< The index of the instruction jumped to by jumps (otherwise -1).
+    int line; ///< The line of shader source that the instruction was generated for (or 0 if not known).
+    int arguments [ARGUMENTS]; ///< The arguments to the instruction (registers or the symbol called by calls).
+};
+
+}
+
+#endif
@@ -29,6 +29,7 @@ enum Instruction
     INSTRUCTION_DIVIDE,
     INSTRUCTION_ADD,
     INSTRUCTION_SUBTRACT,
+    INSTRUCTION_MULTIPLY_ADD,
     INSTRUCTION_GREATER,
     INSTRUCTION_GREATER_EQUAL,
     INSTRUCTION_LESS,
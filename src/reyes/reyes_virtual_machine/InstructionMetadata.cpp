@@ -0,0 +1,88 @@
+//
+// InstructionMetadata.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "InstructionMetadata.hpp"
+#include "Instruction.hpp"
+#include <reyes/assert.hpp>
+
+namespace reyes
+{
+
+static const InstructionMetadata INSTRUCTIONS [INSTRUCTION_COUNT] =
+{
+    { "null", 1, 0, false, false },
+    { "halt", 1, 0, false, false },
+    { "reset", 1, 1, false, false },
+    { "clear_mask", 1, 0, false, false },
+    { "generate_mask", 1, 1, false, false },
+    { "invert_mask", 1, 0, false, false },
+    { "jump_empty", 1, 1, false, true },
+    { "jump_not_empty", 1, 1, false, true },
+    { "jump_illuminance", 1, 1, false, true },
+    { "jump", 1, 1, false, true },
+    { "transform_point", 1, 2, true, false },
+    { "transform_vector", 1, 2, true, false },
+    { "transform_normal", 1, 2, true, false },
+    { "transform_color", 1, 2, true, false },
+    { "transform_matrix", 1, 2, true, false },
+    { "dot", 1, 2, true, false },
+    { "multiply", 1, 2, true, false },
+    { "divide", 1, 2, true, false },
+    { "add", 1, 2, true, false },
+    { "subtract", 1, 2, true, false },
+    { "multiply_add", 2, 3, true, false },
+    { "greater", 1, 2, true, false },
+    { "greater_equal", 1, 2, true, false },
+    { "less", 1, 2, true, false },
+    { "less_equal", 1, 2, true, false },
+    { "and", 1, 2, true, false },
+    { "or", 1, 2, true, false },
+    { "equal", 1, 2, true, false },
+    { "not_equal", 1, 2, true, false },
+    { "negate", 1, 1, true, false },
+    { "convert", 1, 1, true, false },
+    { "promote", 1, 1, true, false },
+    { "assign", 1, 2, false, false },
+    { "assign_string", 1, 2, false, false },
+    { "add_assign", 1, 2, false, false },
+    { "subtract_assign", 1, 2, false, false },
+    { "multiply_assign", 1, 2, false, false },
+    { "divide_assign", 1, 2, false, false },
+    { "float_texture", 1, 3, true, false },
+    { "vec3_texture", 1, 3, true, false },
+    { "float_environment", 1, 2, true, false },
+    { "vec3_environment", 1, 2, true, false },
+    { "shadow", 1, 3, true, false },
+    { "call_0", 1, 1, true, false },
+    { "call_1", 1, 2, true, false },
+    { "call_2", 1, 3, true, false },
+    { "call_3", 1, 4, true, false },
+    { "call_4", 1, 5, true, false },
+    { "call_5", 1, 6, true, false },
+    { "ambient", 1, 2, false, false },
+    { "solar", 1, 0, false, false },
+    { "solar_axis_angle", 1, 4, false, false },
+    { "illuminate", 1, 5, false, false },
+    { "illuminate_axis_angle", 1, 7, false, false },
+    { "illuminance_axis_angle", 1, 6, true, false }
+};
+
+/**
+// Get the layout of an instruction.
+//
+// @param instruction
+//  The instruction to get the layout of (assumed to be a valid 
+//  instruction).
+//
+// @return
+//  The layout of the instruction.
+*/
+const InstructionMetadata& instruction_metadata( int instruction )
+{
+    REYES_ASSERT( instruction >= INSTRUCTION_NULL && instruction < INSTRUCTION_COUNT );
+    return INSTRUCTIONS[instruction];
+}
+
+}
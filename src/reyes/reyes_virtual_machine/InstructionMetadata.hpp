@@ -0,0 +1,28 @@
+#ifndef REYES_INSTRUCTIONMETADATA_HPP_INCLUDED
+#define REYES_INSTRUCTIONMETADATA_HPP_INCLUDED
+
+namespace reyes
+{
+
+/**
+// The layout of an instruction in byte code.
+//
+// Every instruction is encoded as a word for the instruction, a word for 
+// its dispatch code, any further dispatch words, and then its arguments as
+// quads.  Calls have one argument more than their number (the index of the
+// symbol for the function called).
+*/
+struct InstructionMetadata
+{
+    const char* name; ///< The name of the instruction (for dumping code).
+    int words; ///< The number of dispatch words after the instruction.
+    int arguments; ///< The number of arguments after the dispatch words.
+    bool result; ///< True if the instruction implicitly allocates a register for its result.
+    bool jump; ///< True if the only argument is a distance to jump relative to the end of the instruction.
+};
+
+const InstructionMetadata& instruction_metadata( int instruction );
+
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef REYES_KERNEL_HPP_INCLUDED
+#define REYES_KERNEL_HPP_INCLUDED
+
+namespace reyes
+{
+
+/**
+// A kernel for arithmetic on one combination of operand widths and 
+// storage selected from a dispatch code ahead of execution.
+*/
+typedef void (*BinaryKernel)( float* result, const float* lhs, const float* rhs, unsigned int length );
+
+/**
+// A kernel for a comparison on one combination of operand widths and 
+// storage selected from a dispatch code ahead of execution.
+*/
+typedef void (*ComparisonKernel)( int* result, const float* lhs, const float* rhs, unsigned int length );
+
+/**
+// A kernel for a unary operation on one operand width and storage selected 
+// from a dispatch code ahead of execution.
+*/
+typedef void (*UnaryKernel)( float* result, const float* rhs, unsigned int length );
+
+}
+
+#endif
@@ -1,9 +1,12 @@
 #ifndef REYES_ADD_HPP_INCLUDED
 #define REYES_ADD_HPP_INCLUDED
 
+#include "Kernel.hpp"
+
 namespace reyes
 {
 
+BinaryKernel add_kernel( int dispatch );
 void add( int dispatch, float* result, const float* lhs, const float* rhs, unsigned int length );
 
 }
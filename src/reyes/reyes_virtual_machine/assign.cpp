@@ -6,6 +6,7 @@
 #include "assign.hpp"
 #include "Dispatch.hpp"
 #include "Instruction.hpp"
+#include "simd.hpp"
 #include <reyes/assert.hpp>
 
 namespace reyes
@@ -60,23 +61,7 @@ void assign_u4u4( float* result, const float* rhs, unsigned int /*length*/ )
 
 void assign_v1u1( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
 {
-    if ( !mask )
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            result[i] = rhs[0];
-        }
-    }
-    else
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            if ( mask[i] )
-            {
-                result[i] = rhs[0];
-            }
-        }
-    }
+    simd_assign_uniform<1>( result, rhs, mask, length );
 }
 
 void assign_v2u1( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
@@ -156,98 +141,22 @@ void assign_v4u1( float* result, const float* rhs, const unsigned char* mask, un
 
 void assign_v2u2( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
 {
-    if ( !mask )
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            result[i * 2 + 0] = rhs[0];
-            result[i * 2 + 1] = rhs[1];
-        }
-    }
-    else 
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            if ( mask[i] )
-            {
-                result[i * 2 + 0] = rhs[0];
-                result[i * 2 + 1] = rhs[1];
-            }
-        }
-    }
+    simd_assign_uniform<2>( result, rhs, mask, length );
 }
 
 void assign_v3u3( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
 {
-    if ( !mask )
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            result[i * 3 + 0] = rhs[0];
-            result[i * 3 + 1] = rhs[1];
-            result[i * 3 + 2] = rhs[2];
-        }
-    }
-    else
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            if ( mask[i] )
-            {
-                result[i * 3 + 0] = rhs[0];
-                result[i * 3 + 1] = rhs[1];
-                result[i * 3 + 2] = rhs[2];
-            }
-        }
-    }
+    simd_assign_uniform<3>( result, rhs, mask, length );
 }
 
 void assign_v4u4( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
 {
-    if ( !mask )
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            result[i * 4 + 0] = rhs[0];
-            result[i * 4 + 1] = rhs[1];
-            result[i * 4 + 2] = rhs[2];
-            result[i * 4 + 3] = rhs[3];
-        }
-    }
-    else
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            if ( mask[i] )
-            {
-                result[i * 4 + 0] = rhs[0];
-                result[i * 4 + 1] = rhs[1];
-                result[i * 4 + 2] = rhs[2];
-                result[i * 4 + 3] = rhs[3];
-            }
-        }
-    }
+    simd_assign_uniform<4>( result, rhs, mask, length );
 }
 
 void assign_v1v1( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
 {
-    if ( !mask )
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            result[i] = rhs[i];
-        }
-    }
-    else
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            if ( mask[i] )
-            {
-                result[i] = rhs[i];
-            }
-        }
-    }
+    simd_assign<1>( result, rhs, mask, length );
 }
 
 void assign_v2v1( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
@@ -327,77 +236,17 @@ void assign_v4v1( float* result, const float* rhs, const unsigned char* mask, un
 
 void assign_v2v2( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
 {
-    if ( !mask )
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            result[i * 2 + 0] = rhs[i * 2 + 0];
-            result[i * 2 + 1] = rhs[i * 2 + 1];
-        }
-    }
-    else
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            if ( mask[i] )
-            {
-                result[i * 2 + 0] = rhs[i * 2 + 0];
-                result[i * 2 + 1] = rhs[i * 2 + 1];
-            }
-        }
-    }
+    simd_assign<2>( result, rhs, mask, length );
 }
 
 void assign_v3v3( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
 {
-    if ( !mask )
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            result[i * 3 + 0] = rhs[i * 3 + 0];
-            result[i * 3 + 1] = rhs[i * 3 + 1];
-            result[i * 3 + 2] = rhs[i * 3 + 2];
-        }
-    }
-    else
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            if ( mask[i] )
-            {
-                result[i * 3 + 0] = rhs[i * 3 + 0];
-                result[i * 3 + 1] = rhs[i * 3 + 1];
-                result[i * 3 + 2] = rhs[i * 3 + 2];
-            }
-        }
-    }
+    simd_assign<3>( result, rhs, mask, length );
 }
 
 void assign_v4v4( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
 {
-    if ( !mask )
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            result[i * 4 + 0] = rhs[i * 4 + 0];
-            result[i * 4 + 1] = rhs[i * 4 + 1];
-            result[i * 4 + 2] = rhs[i * 4 + 2];
-            result[i * 4 + 3] = rhs[i * 4 + 3];
-        }
-    }
-    else
-    {
-        for ( unsigned int i = 0; i < length; ++i )
-        {
-            if ( mask[i] )
-            {
-                result[i * 4 + 0] = rhs[i * 4 + 0];
-                result[i * 4 + 1] = rhs[i * 4 + 1];
-                result[i * 4 + 2] = rhs[i * 4 + 2];
-                result[i * 4 + 3] = rhs[i * 4 + 3];
-            }
-        }
-    }
+    simd_assign<4>( result, rhs, mask, length );
 }
 
 void assign_v16v16( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
@@ -16,13 +16,12 @@
 #include <math/vec2.ipp>
 #include <math/vec3.ipp>
 
-using std::shared_ptr;
 using namespace math;
 
 namespace reyes
 {
 
-void comp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> color, std::shared_ptr<Value> index_value )
+void comp( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* color, const Value* index_value )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( color );
@@ -61,7 +60,7 @@ void comp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<V
     }
 }
 
-void setcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> /*result*/, std::shared_ptr<Value> color, std::shared_ptr<Value> index_value, std::shared_ptr<Value> value )
+void setcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* /*result*/, const Value* color, const Value* index_value, const Value* value )
 {
     REYES_ASSERT( color );
     REYES_ASSERT( index_value );
@@ -99,7 +98,7 @@ void setcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_pt
     }
 }
 
-void ctransform_function( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> fromspace, std::shared_ptr<Value> color )
+void ctransform_function( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* fromspace, const Value* color )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( fromspace );
@@ -1,8 +1,6 @@
 #ifndef REYES_COLOR_FUNCTIONS_HPP_INCLUDED
 #define REYES_COLOR_FUNCTIONS_HPP_INCLUDED
 
-#include <memory>
-
 namespace reyes
 {
 
@@ -10,9 +8,9 @@ class Grid;
 class Value;
 class Renderer;
 
-void comp( const Renderer& renderer, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> c, std::shared_ptr<Value> index );
-void setcomp( const Renderer& renderer, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> c, std::shared_ptr<Value> index, std::shared_ptr<Value> value );
-void ctransform_function( const Renderer& renderer, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> fromspace, std::shared_ptr<Value> color );
+void comp( const Renderer& renderer, const Grid& grid, Value* result, const Value* c, const Value* index );
+void setcomp( const Renderer& renderer, const Grid& grid, Value* result, const Value* c, const Value* index, const Value* value );
+void ctransform_function( const Renderer& renderer, const Grid& grid, Value* result, const Value* fromspace, const Value* color );
 
 }
 
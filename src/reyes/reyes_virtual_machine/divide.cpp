@@ -2,6 +2,7 @@
 #include "divide.hpp"
 #include "Dispatch.hpp"
 #include "Instruction.hpp"
+#include "simd.hpp"
 #include <reyes/assert.hpp>
 
 namespace reyes
@@ -35,191 +36,134 @@ void divide_u4u1( float* result, const float* lhs, const float* rhs, unsigned in
 
 void divide_u1v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i] = lhs[0] / rhs[i];
-    }
+    simd_uv<1>( SimdDivide(), result, lhs, rhs, length );
 }
 
 void divide_u2v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[0] / rhs[i];
-        result[i * 2 + 1] = lhs[1] / rhs[i];
-    }
+    simd_uv1<2>( SimdDivide(), result, lhs, rhs, length );
 }
 
 void divide_u3v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[0] / rhs[i];
-        result[i * 3 + 1] = lhs[1] / rhs[i];
-        result[i * 3 + 2] = lhs[2] / rhs[i];
-    }
+    simd_uv1<3>( SimdDivide(), result, lhs, rhs, length );
 }
 
 void divide_u4v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[0] / rhs[i];
-        result[i * 4 + 1] = lhs[1] / rhs[i];
-        result[i * 4 + 2] = lhs[2] / rhs[i];
-        result[i * 4 + 3] = lhs[3] / rhs[i];
-    }
+    simd_uv1<4>( SimdDivide(), result, lhs, rhs, length );
 }
 
 void divide_v1u1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i] = lhs[i] / rhs[0];
-    }
+    simd_vu<1>( SimdDivide(), result, lhs, rhs, length );
 }
 
 void divide_v2u1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[i * 2 + 0] / rhs[0];
-        result[i * 2 + 1] = lhs[i * 2 + 1] / rhs[0];
-    }
+    simd_vu<1>( SimdDivide(), result, lhs, rhs, length * 2 );
 }
 
 void divide_v3u1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[i * 3 + 0] / rhs[0];
-        result[i * 3 + 1] = lhs[i * 3 + 1] / rhs[0];
-        result[i * 3 + 2] = lhs[i * 3 + 2] / rhs[0];
-    }
+    simd_vu<1>( SimdDivide(), result, lhs, rhs, length * 3 );
 }
 
 void divide_v4u1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[i * 4 + 0] / rhs[0];
-        result[i * 4 + 1] = lhs[i * 4 + 1] / rhs[0];
-        result[i * 4 + 2] = lhs[i * 4 + 2] / rhs[0];
-        result[i * 4 + 3] = lhs[i * 4 + 3] / rhs[0];
-    }
+    simd_vu<1>( SimdDivide(), result, lhs, rhs, length * 4 );
 }
 
 void divide_v1v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i] = lhs[i] / rhs[i];
-    }
+    simd_vv( SimdDivide(), result, lhs, rhs, length );
 }
 
 void divide_v2v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[i * 2 + 0] / rhs[i];
-        result[i * 2 + 1] = lhs[i * 2 + 1] / rhs[i];
-    }
+    simd_vv1<2>( SimdDivide(), result, lhs, rhs, length );
 }
 
 void divide_v3v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[i * 3 + 0] / rhs[i];
-        result[i * 3 + 1] = lhs[i * 3 + 1] / rhs[i];
-        result[i * 3 + 2] = lhs[i * 3 + 2] / rhs[i];
-    }
+    simd_vv1<3>( SimdDivide(), result, lhs, rhs, length );
 }
 
 void divide_v4v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        const float denominator = rhs[i];
-        result[i * 4 + 0] = lhs[i * 4 + 0] / denominator;
-        result[i * 4 + 1] = lhs[i * 4 + 1] / denominator;
-        result[i * 4 + 2] = lhs[i * 4 + 2] / denominator;
-        result[i * 4 + 3] = lhs[i * 4 + 3] / denominator;
-    }
+    simd_vv1<4>( SimdDivide(), result, lhs, rhs, length );
 }
 
-void divide( int dispatch, float* result, const float* lhs, const float* rhs, unsigned int length )
+/**
+// Select the kernel that divides operands of the widths and storage 
+// described by a dispatch code.
+//
+// @return
+//  The kernel or null if there is no kernel for the dispatch code.
+*/
+BinaryKernel divide_kernel( int dispatch )
 {
     switch ( dispatch )
     {
         case DISPATCH_U1U1:
-            divide_u1u1( result, lhs, rhs, length );
-            break;
+            return divide_u1u1;
 
         case DISPATCH_U2U1:
-            divide_u2u1( result, lhs, rhs, length );
-            break;
+            return divide_u2u1;
 
         case DISPATCH_U3U1:
-            divide_u3u1( result, lhs, rhs, length );
-            break;
+            return divide_u3u1;
 
         case DISPATCH_U4U1:
-            divide_u4u1( result, lhs, rhs, length );
-            break;
+            return divide_u4u1;
 
         case DISPATCH_U1V1:
-            divide_u1v1( result, lhs, rhs, length );
-            break;
+            return divide_u1v1;
 
         case DISPATCH_U2V1:
-            divide_u2v1( result, lhs, rhs, length );
-            break;
+            return divide_u2v1;
 
         case DISPATCH_U3V1:
-            divide_u3v1( result, lhs, rhs, length );
-            break;
+            return divide_u3v1;
 
         case DISPATCH_U4V1:
-            divide_u4v1( result, lhs, rhs, length );
-            break;
+            return divide_u4v1;
 
         case DISPATCH_V1U1:
-            divide_v1u1( result, lhs, rhs, length );
-            break;
+            return divide_v1u1;
 
         case DISPATCH_V2U1:
-            divide_v2u1( result, lhs, rhs, length );
-            break;
+            return divide_v2u1;
 
         case DISPATCH_V3U1:
-            divide_v3u1( result, lhs, rhs, length );
-            break;
+            return divide_v3u1;
 
         case DISPATCH_V4U1:   
-            divide_v4u1( result, lhs, rhs, length );
-            break;
+            return divide_v4u1;
 
         case DISPATCH_V1V1:
-            divide_v1v1( result, lhs, rhs, length );
-            break;
+            return divide_v1v1;
 
         case DISPATCH_V2V1:
-            divide_v2v1( result, lhs, rhs, length );
-            break;
+            return divide_v2v1;
 
         case DISPATCH_V3V1:
-            divide_v3v1( result, lhs, rhs, length );
-            break;
+            return divide_v3v1;
 
         case DISPATCH_V4V1:
-            divide_v4v1( result, lhs, rhs, length );
-            break;
+            return divide_v4v1;
 
         default:
             REYES_ASSERT( false );
-            break;        
+            return NULL;
     }
 }
 
+void divide( int dispatch, float* result, const float* lhs, const float* rhs, unsigned int length )
+{
+    BinaryKernel kernel = divide_kernel( dispatch );
+    REYES_ASSERT( kernel );
+    (*kernel)( result, lhs, rhs, length );
+}
+
 }
@@ -1,9 +1,12 @@
 #ifndef REYES_DIVIDE_HPP_INCLUDED
 #define REYES_DIVIDE_HPP_INCLUDED
 
+#include "Kernel.hpp"
+
 namespace reyes
 {
 
+BinaryKernel divide_kernel( int dispatch );
 void divide( int dispatch, float* result, const float* lhs, const float* rhs, unsigned int length );
 
 }
@@ -7,6 +7,7 @@
 #include "Dispatch.hpp"
 #include "Instruction.hpp"
 #include <reyes/assert.hpp>
+#include <stddef.h>
 
 namespace reyes
 {
@@ -151,78 +152,69 @@ void equal_v4v4( int* result, const float* lhs, const float* rhs, unsigned int l
     }
 }
 
-void equal( int dispatch, int* result, const float* lhs, const float* rhs, unsigned int length )
+ComparisonKernel equal_kernel( int dispatch )
 {
     switch ( dispatch )
     {
         case DISPATCH_U1U1:
-            equal_u1u1( result, lhs, rhs, length );
-            break;
+            return equal_u1u1;
 
         case DISPATCH_U2U2:
-            equal_u2u2( result, lhs, rhs, length );
-            break;
+            return equal_u2u2;
 
         case DISPATCH_U3U3:
-            equal_u3u3( result, lhs, rhs, length );
-            break;
+            return equal_u3u3;
 
         case DISPATCH_U4U4:
-            equal_u4u4( result, lhs, rhs, length );
-            break;
+            return equal_u4u4;
 
         case DISPATCH_U1V1:
-            equal_u1v1( result, lhs, rhs, length );
-            break;
+            return equal_u1v1;
 
         case DISPATCH_U2V2:
-            equal_u2v2( result, lhs, rhs, length );
-            break;
+            return equal_u2v2;
 
         case DISPATCH_U3V3:
-            equal_u3v3( result, lhs, rhs, length );
-            break;
+            return equal_u3v3;
 
         case DISPATCH_U4V4:
-            equal_u4v4( result, lhs, rhs, length );
-            break;
+            return equal_u4v4;
 
         case DISPATCH_V1U1:
-            equal_v1u1( result, lhs, rhs, length );
-            break;
+            return equal_v1u1;
 
         case DISPATCH_V2U2:
-            equal_v2u2( result, lhs, rhs, length );
-            break;
+            return equal_v2u2;
 
         case DISPATCH_V3U3:
-            equal_v3u3( result, lhs, rhs, length );
-            break;
+            return equal_v3u3;
 
         case DISPATCH_V4U4:
-            equal_v4u4( result, lhs, rhs, length );
-            break;
+            return equal_v4u4;
 
         case DISPATCH_V1V1:
-            equal_v1v1( result, lhs, rhs, length );
-            break;
+            return equal_v1v1;
 
         case DISPATCH_V2V2:
-            equal_v2v2( result, lhs, rhs, length );
-            break;
+            return equal_v2v2;
 
         case DISPATCH_V3V3:
-            equal_v3v3( result, lhs, rhs, length );
-            break;
+            return equal_v3v3;
 
         case DISPATCH_V4V4:
-            equal_v4v4( result, lhs, rhs, length );
-            break;
+            return equal_v4v4;
 
         default:
             REYES_ASSERT( false );
-            break;
+            return NULL;
     }
 }
 
+void equal( int dispatch, int* result, const float* lhs, const float* rhs, unsigned int length )
+{
+    ComparisonKernel kernel = equal_kernel( dispatch );
+    REYES_ASSERT( kernel );
+    (*kernel)( result, lhs, rhs, length );
+}
+
 }
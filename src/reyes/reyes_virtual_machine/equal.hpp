@@ -1,9 +1,12 @@
 #ifndef REYES_EQUAL_HPP_INCLUDED
 #define REYES_EQUAL_HPP_INCLUDED
 
+#include "Kernel.hpp"
+
 namespace reyes
 {
 
+ComparisonKernel equal_kernel( int dispatch );
 void equal( int dispatch, int* result, const float* lhs, const float* rhs, unsigned int length );
 
 }
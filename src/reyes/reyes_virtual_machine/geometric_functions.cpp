@@ -22,13 +22,12 @@
 #include <math.h>
 
 using std::max;
-using std::shared_ptr;
 using namespace math;
 
 namespace reyes
 {
 
-void xcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> p )
+void xcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( p );
@@ -44,7 +43,7 @@ void xcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<
     }
 }
 
-void ycomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> p )
+void ycomp( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( p );
@@ -60,7 +59,7 @@ void ycomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<
     }
 }
 
-void zcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> p )
+void zcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( p );
@@ -76,7 +75,7 @@ void zcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<
     }
 }
 
-void setxcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> p, std::shared_ptr<Value> x )
+void setxcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* p, const Value* x )
 {
     REYES_ASSERT( p );
     REYES_ASSERT( x );
@@ -91,7 +90,7 @@ void setxcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_p
     }
 }
 
-void setycomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> p, std::shared_ptr<Value> y )
+void setycomp( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* p, const Value* y )
 {
     REYES_ASSERT( p );
     REYES_ASSERT( y );
@@ -106,7 +105,7 @@ void setycomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_p
     }
 }
 
-void setzcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> p, std::shared_ptr<Value> z )
+void setzcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* p, const Value* z )
 {
     REYES_ASSERT( p );
     REYES_ASSERT( z );
@@ -121,7 +120,7 @@ void setzcomp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_p
     }
 }
 
-void length( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x )
+void length( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -137,7 +136,7 @@ void length( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr
     }
 }
 
-void normalize( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> n )
+void normalize( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* n )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( n );
@@ -166,7 +165,7 @@ void normalize( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_
     }    
 }
 
-void distance( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> p0, std::shared_ptr<Value> p1 )
+void distance( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* p0, const Value* p1 )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( p0 );
@@ -185,7 +184,7 @@ void distance( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_p
     }
 }
 
-void rotate( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> q, std::shared_ptr<Value> angle, std::shared_ptr<Value> p0, std::shared_ptr<Value> p1 )
+void rotate( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* q, const Value* angle, const Value* p0, const Value* p1 )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( q );
@@ -208,44 +207,50 @@ void rotate( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr
     }    
 }
 
-void area( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> p )
+void area( const Renderer& /*renderer*/, const Grid& grid, Value* result, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( p );
     
     result->reset( TYPE_FLOAT, p->storage(), p->size() );
     
-    int i = 0;
-    int width = grid.width_;
-    int height = grid.height_;
     const vec3* other_values = p->vec3_values();    
     float* values = result->float_values();
     
-    for ( int y = 0; y < height - 1; ++y )
+    const int patches = grid.patches();
+    for ( int j = 0; j < patches; ++j )
     {
-        for ( int x = 0; x < width - 1; ++x )
+        const Grid::Patch patch = grid.patch( j );
+        int i = patch.offset;
+        int width = patch.width;
+        int height = patch.height;
+
+        for ( int y = 0; y < height - 1; ++y )
         {
-            int i0 = i + x;
-            int i1 = i + x + 1;
-            int i3 = i + x + width;
-            values[i0] = length(other_values[i1] - other_values[i0]) * length(other_values[i3] - other_values[i0]);
+            for ( int x = 0; x < width - 1; ++x )
+            {
+                int i0 = i + x;
+                int i1 = i + x + 1;
+                int i3 = i + x + width;
+                values[i0] = length(other_values[i1] - other_values[i0]) * length(other_values[i3] - other_values[i0]);
+            }
+            values[i + width - 1] = values[i + width - 2];
+            i += width;
         }
-        values[i + width - 1] = values[i + width - 2];
-        i += width;
-    }
     
-    for ( int x = 0; x < width; ++x )
-    {
-        values[i + x] = values[i - width + x];
+        for ( int x = 0; x < width; ++x )
+        {
+            values[i + x] = values[i - width + x];
+        }
     }
 }
 
-void faceforward_vv( const Renderer& renderer, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> n, std::shared_ptr<Value> i )
+void faceforward_vv( const Renderer& renderer, const Grid& grid, Value* result, const Value* n, const Value* i )
 {
     faceforward_vvv( renderer, grid, result, n, i, n );
 }
 
-void faceforward_vvv( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> n, std::shared_ptr<Value> i, std::shared_ptr<Value> nref )
+void faceforward_vvv( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* n, const Value* i, const Value* nref )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( n );
@@ -280,7 +285,7 @@ void faceforward_vvv( const Renderer& /*renderer*/, const Grid& /*grid*/, std::s
     }    
 }
 
-void reflect( const Renderer& /*render*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> i, std::shared_ptr<Value> n )
+void reflect( const Renderer& /*render*/, const Grid& /*grid*/, Value* result, const Value* i, const Value* n )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( i );
@@ -298,7 +303,7 @@ void reflect( const Renderer& /*render*/, const Grid& /*grid*/, std::shared_ptr<
     }
 }
 
-void refract( const Renderer& /*render*/, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> incident, std::shared_ptr<Value> normal, std::shared_ptr<Value> eta_value )
+void refract( const Renderer& /*render*/, const Grid& grid, Value* result, const Value* incident, const Value* normal, const Value* eta_value )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( incident );
@@ -324,7 +329,7 @@ void refract( const Renderer& /*render*/, const Grid& grid, std::shared_ptr<Valu
     }
 }
 
-void fresnel( const Renderer& /*render*/, const Grid& grid, std::shared_ptr<Value> /*result*/, std::shared_ptr<Value> incident, std::shared_ptr<Value> normal, std::shared_ptr<Value> eta_value, std::shared_ptr<Value> Kr, std::shared_ptr<Value> Kt )
+void fresnel( const Renderer& /*render*/, const Grid& grid, Value* /*result*/, const Value* incident, const Value* normal, const Value* eta_value, Value* Kr, Value* Kt )
 {
     REYES_ASSERT( incident );
     REYES_ASSERT( normal );
@@ -369,7 +374,7 @@ void fresnel( const Renderer& /*render*/, const Grid& grid, std::shared_ptr<Valu
     }
 }
 
-void transform_sv( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> tospace, std::shared_ptr<Value> p )
+void transform_sv( const Renderer& renderer, const Grid& /*grid*/, Value* result, const Value* tospace, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( tospace );
@@ -380,7 +385,7 @@ void transform_sv( const Renderer& renderer, const Grid& /*grid*/, std::shared_p
     result->reset( TYPE_POINT, STORAGE_VARYING, size );
     result->zero();
     
-    const math::mat4x4 transform = renderer.transform_to( tospace->string_value() );
+    const math::mat4x4 transform = renderer.transform_to( tospace->string_identifier() );
     const vec3* p_values = p->vec3_values();
     vec3* return_values = result->vec3_values();
     for ( int i = 0; i < size; ++i )
@@ -389,7 +394,7 @@ void transform_sv( const Renderer& renderer, const Grid& /*grid*/, std::shared_p
     }
 }
 
-void transform_ssv( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> fromspace, std::shared_ptr<Value> tospace, std::shared_ptr<Value> p )
+void transform_ssv( const Renderer& renderer, const Grid& /*grid*/, Value* result, const Value* fromspace, const Value* tospace, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( fromspace );
@@ -402,7 +407,7 @@ void transform_ssv( const Renderer& renderer, const Grid& /*grid*/, std::shared_
     result->reset( TYPE_POINT, STORAGE_VARYING, size );
     result->zero();
     
-    const math::mat4x4 transform = renderer.transform_between( fromspace->string_value(), tospace->string_value() );
+    const math::mat4x4 transform = renderer.transform_between( fromspace->string_identifier(), tospace->string_identifier() );
     const vec3* p_values = p->vec3_values();
     vec3* return_values = result->vec3_values();
     for ( int i = 0; i < size; ++i )
@@ -411,7 +416,7 @@ void transform_ssv( const Renderer& renderer, const Grid& /*grid*/, std::shared_
     }
 }
 
-void transform_mv( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> m, std::shared_ptr<Value> p )
+void transform_mv( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* m, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( m );
@@ -428,7 +433,7 @@ void transform_mv( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shar
     );
 }
 
-void transform_smv( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> fromspace, std::shared_ptr<Value> m, std::shared_ptr<Value> p )
+void transform_smv( const Renderer& renderer, const Grid& /*grid*/, Value* result, const Value* fromspace, const Value* m, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( fromspace );
@@ -442,7 +447,7 @@ void transform_smv( const Renderer& renderer, const Grid& /*grid*/, std::shared_
     result->zero();
     
     const math::mat4x4& to = m->mat4x4_values()[0];
-    const math::mat4x4 transform = to * renderer.transform_from( fromspace->string_value() );
+    const math::mat4x4 transform = to * renderer.transform_from( fromspace->string_identifier() );
     const vec3* p_values = p->vec3_values();
     vec3* return_values = result->vec3_values();
     for ( int i = 0; i < size; ++i )
@@ -451,7 +456,7 @@ void transform_smv( const Renderer& renderer, const Grid& /*grid*/, std::shared_
     }
 }
 
-void vtransform_sv( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> tospace, std::shared_ptr<Value> p )
+void vtransform_sv( const Renderer& renderer, const Grid& /*grid*/, Value* result, const Value* tospace, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( tospace );
@@ -461,13 +466,13 @@ void vtransform_sv( const Renderer& renderer, const Grid& /*grid*/, std::shared_
     vtransform( 
         p->size() > 1 ? DISPATCH_V3 : DISPATCH_U3,
         result->vec3_values(),
-        renderer.transform_to(tospace->string_value()),
+        renderer.transform_to( tospace->string_identifier() ),
         p->vec3_values(),
         p->size()
     );    
 }
 
-void vtransform_ssv( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> fromspace, std::shared_ptr<Value> tospace, std::shared_ptr<Value> p )
+void vtransform_ssv( const Renderer& renderer, const Grid& /*grid*/, Value* result, const Value* fromspace, const Value* tospace, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( fromspace );
@@ -479,13 +484,13 @@ void vtransform_ssv( const Renderer& renderer, const Grid& /*grid*/, std::shared
     vtransform( 
         p->size() > 1 ? DISPATCH_V3 : DISPATCH_U3,
         result->vec3_values(),
-        renderer.transform_between(fromspace->string_value(), tospace->string_value()),
+        renderer.transform_between( fromspace->string_identifier(), tospace->string_identifier() ),
         p->vec3_values(),
         p->size()
     );
 }
 
-void vtransform_mv( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> m, std::shared_ptr<Value> p )
+void vtransform_mv( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* m, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( m );
@@ -502,7 +507,7 @@ void vtransform_mv( const Renderer& /*renderer*/, const Grid& /*grid*/, std::sha
     );    
 }
 
-void vtransform_smv( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> fromspace, std::shared_ptr<Value> m, std::shared_ptr<Value> p )
+void vtransform_smv( const Renderer& renderer, const Grid& /*grid*/, Value* result, const Value* fromspace, const Value* m, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( fromspace );
@@ -515,13 +520,13 @@ void vtransform_smv( const Renderer& renderer, const Grid& /*grid*/, std::shared
     vtransform( 
         p->size() > 1 ? DISPATCH_V3 : DISPATCH_U3,
         result->vec3_values(),
-        m->mat4x4_value() * renderer.transform_from(fromspace->string_value()),
+        m->mat4x4_value() * renderer.transform_from( fromspace->string_identifier() ),
         p->vec3_values(),
         p->size()
     );    
 }
 
-void ntransform_sv( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> tospace, std::shared_ptr<Value> p )
+void ntransform_sv( const Renderer& renderer, const Grid& /*grid*/, Value* result, const Value* tospace, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( tospace );
@@ -531,13 +536,13 @@ void ntransform_sv( const Renderer& renderer, const Grid& /*grid*/, std::shared_
     ntransform(
         p->size() > 1 ? DISPATCH_V3 : DISPATCH_U3,
         result->vec3_values(),
-        renderer.transform_to(tospace->string_value()),
+        renderer.transform_to( tospace->string_identifier() ),
         p->vec3_values(),
         p->size()
     );
 }
 
-void ntransform_ssv( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> fromspace, std::shared_ptr<Value> tospace, std::shared_ptr<Value> p )
+void ntransform_ssv( const Renderer& renderer, const Grid& /*grid*/, Value* result, const Value* fromspace, const Value* tospace, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( fromspace );
@@ -549,13 +554,13 @@ void ntransform_ssv( const Renderer& renderer, const Grid& /*grid*/, std::shared
     ntransform(
         p->size() > 1 ? DISPATCH_V3 : DISPATCH_U3,
         result->vec3_values(),
-        renderer.transform_between(fromspace->string_value(), tospace->string_value()),
+        renderer.transform_between( fromspace->string_identifier(), tospace->string_identifier() ),
         p->vec3_values(),
         p->size()
     );
 }
 
-void ntransform_mv( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> m, std::shared_ptr<Value> p )
+void ntransform_mv( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* m, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( m );
@@ -572,7 +577,7 @@ void ntransform_mv( const Renderer& /*renderer*/, const Grid& /*grid*/, std::sha
     );
 }
 
-void ntransform_smv( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> fromspace, std::shared_ptr<Value> m, std::shared_ptr<Value> p )
+void ntransform_smv( const Renderer& renderer, const Grid& /*grid*/, Value* result, const Value* fromspace, const Value* m, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( fromspace );
@@ -585,13 +590,13 @@ void ntransform_smv( const Renderer& renderer, const Grid& /*grid*/, std::shared
     ntransform(
         p->size() > 1 ? DISPATCH_V3 : DISPATCH_U3,
         result->vec3_values(),
-        m->mat4x4_value() * renderer.transform_from(fromspace->string_value()),
+        m->mat4x4_value() * renderer.transform_from( fromspace->string_identifier() ),
         p->vec3_values(),
         p->size()
     );
 }
 
-void depth( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> p )
+void depth( const Renderer& renderer, const Grid& /*grid*/, Value* result, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( p );
@@ -607,22 +612,24 @@ void depth( const Renderer& renderer, const Grid& /*grid*/, std::shared_ptr<Valu
     }
 }
 
-void calculatenormal( const Renderer& renderer, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> p )
+void calculatenormal( const Renderer& renderer, const Grid& grid, Value* result, const Value* p )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( p );
     
-    shared_ptr<Value> dpdu( new Value() );
-    du_vec3( renderer, grid, dpdu, p );
+    // The derivatives are calculated into values kept per thread so that 
+    // their buffers are reused from one grid to the next.
+    static thread_local Value dpdu;
+    du_vec3( renderer, grid, &dpdu, p );
 
-    shared_ptr<Value> dpdv( new Value() );
-    dv_vec3( renderer, grid, dpdv, p );
+    static thread_local Value dpdv;
+    dv_vec3( renderer, grid, &dpdv, p );
     
     result->reset( p->type(), p->storage(), p->size() );
     
     const int size = result->size();
-    const vec3* dpdu_values = dpdu->vec3_values();
-    const vec3* dpdv_values = dpdv->vec3_values();
+    const vec3* dpdu_values = dpdu.vec3_values();
+    const vec3* dpdv_values = dpdv.vec3_values();
     vec3* values = result->vec3_values();
     
     if ( renderer.attributes().geometry_left_handed() )
@@ -7,6 +7,7 @@
 #include "Dispatch.hpp"
 #include "Instruction.hpp"
 #include <reyes/assert.hpp>
+#include <stddef.h>
 
 namespace reyes
 {
@@ -40,30 +41,33 @@ void greater_v1v1( int* result, const float* lhs, const float* rhs, unsigned int
     }
 }
 
-void greater( int dispatch, int* result, const float* lhs, const float* rhs, unsigned int length )
+ComparisonKernel greater_kernel( int dispatch )
 {
     switch ( dispatch )
     {
         case DISPATCH_U1U1:
-            greater_u1u1( result, lhs, rhs, length );
-            break;
+            return greater_u1u1;
 
         case DISPATCH_U1V1:
-            greater_u1v1( result, lhs, rhs, length );
-            break;
+            return greater_u1v1;
 
         case DISPATCH_V1U1:
-            greater_v1u1( result, lhs, rhs, length );
-            break;
+            return greater_v1u1;
 
         case DISPATCH_V1V1:
-            greater_v1v1( result, lhs, rhs, length );        
-            break;
+            return greater_v1v1;
 
         default:
             REYES_ASSERT( false );
-            break;
+            return NULL;
     }
 }
 
+void greater( int dispatch, int* result, const float* lhs, const float* rhs, unsigned int length )
+{
+    ComparisonKernel kernel = greater_kernel( dispatch );
+    REYES_ASSERT( kernel );
+    (*kernel)( result, lhs, rhs, length );
+}
+
 }
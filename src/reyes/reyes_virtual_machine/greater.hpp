@@ -1,9 +1,12 @@
 #ifndef REYES_GREATER_HPP_INCLUDED
 #define REYES_GREATER_HPP_INCLUDED
 
+#include "Kernel.hpp"
+
 namespace reyes
 {
 
+ComparisonKernel greater_kernel( int dispatch );
 void greater( int dispatch, int* result, const float* lhs, const float* rhs, unsigned int length );
 
 }
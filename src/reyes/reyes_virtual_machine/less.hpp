@@ -1,9 +1,12 @@
 #ifndef REYES_LESS_HPP_INCLUDED
 #define REYES_LESS_HPP_INCLUDED
 
+#include "Kernel.hpp"
+
 namespace reyes
 {
 
+ComparisonKernel less_kernel( int dispatch );
 void less( int dispatch, int* result, const float* lhs, const float* rhs, unsigned int length );
 
 }
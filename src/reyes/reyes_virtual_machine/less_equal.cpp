@@ -7,6 +7,7 @@
 #include "Dispatch.hpp"
 #include "Instruction.hpp"
 #include <reyes/assert.hpp>
+#include <stddef.h>
 
 namespace reyes
 {
@@ -40,30 +41,33 @@ void less_equal_v1v1( int* result, const float* lhs, const float* rhs, unsigned
     }
 }
 
-void less_equal( int dispatch, int* result, const float* lhs, const float* rhs, unsigned int length )
+ComparisonKernel less_equal_kernel( int dispatch )
 {
     switch ( dispatch )
     {
         case DISPATCH_U1U1:
-            less_equal_u1u1( result, lhs, rhs, length );
-            break;
+            return less_equal_u1u1;
 
         case DISPATCH_U1V1:
-            less_equal_u1v1( result, lhs, rhs, length );
-            break;
+            return less_equal_u1v1;
 
         case DISPATCH_V1U1:
-            less_equal_v1u1( result, lhs, rhs, length );
-            break;
+            return less_equal_v1u1;
 
         case DISPATCH_V1V1:
-            less_equal_v1v1( result, lhs, rhs, length );
-            break;
+            return less_equal_v1v1;
 
         default:
             REYES_ASSERT( false );
-            break;
+            return NULL;
     }
 }
 
+void less_equal( int dispatch, int* result, const float* lhs, const float* rhs, unsigned int length )
+{
+    ComparisonKernel kernel = less_equal_kernel( dispatch );
+    REYES_ASSERT( kernel );
+    (*kernel)( result, lhs, rhs, length );
+}
+
 }
@@ -9,6 +9,7 @@
 #include <reyes/assert.hpp>
 #include <math/scalar.ipp>
 #include <math/vec3.ipp>
+#include <random>
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -17,7 +18,19 @@ using namespace math;
 namespace reyes
 {
 
-void radians( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> degrees )
+/**
+// Generate a pseudo-random number in the range [0, 1].
+//
+// Each thread uses its own generator so that renderers shading on different
+// threads don't contend for (or race on) the global state used by rand().
+*/
+static float random_unit_float()
+{
+    static thread_local std::minstd_rand generator;
+    return float(generator() - std::minstd_rand::min()) / float(std::minstd_rand::max() - std::minstd_rand::min());
+}
+
+void radians( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* degrees )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( degrees );
@@ -33,7 +46,7 @@ void radians( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_pt
     }
 }
 
-void degrees( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> radians )
+void degrees( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* radians )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( radians );
@@ -49,7 +62,7 @@ void degrees( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_pt
     }
 }
 
-void sin( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> a )
+void sin( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* a )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( a );
@@ -65,7 +78,7 @@ void sin( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Va
     }
 }
 
-void asin( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> a )
+void asin( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* a )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( a );
@@ -81,7 +94,7 @@ void asin( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<V
     }
 }
 
-void cos( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> a )
+void cos( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* a )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( a );
@@ -97,7 +110,7 @@ void cos( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Va
     }
 }
 
-void acos( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> a )
+void acos( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* a )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( a );
@@ -113,7 +126,7 @@ void acos( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<V
     }
 }
 
-void tan( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> a )
+void tan( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* a )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( a );
@@ -129,7 +142,7 @@ void tan( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Va
     }
 }
 
-void atan( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> yoverx )
+void atan( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* yoverx )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( yoverx );
@@ -145,7 +158,7 @@ void atan( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<V
     }
 }
 
-void atan2( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> y, std::shared_ptr<Value> x )
+void atan2( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* y, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( y );
@@ -164,7 +177,7 @@ void atan2( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<
     }
 }
 
-void pow( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x, std::shared_ptr<Value> y )
+void pow( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x, const Value* y )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -183,7 +196,7 @@ void pow( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Va
     }
 }
 
-void exp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x )
+void exp( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -199,7 +212,7 @@ void exp( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Va
     }
 }
 
-void sqrt( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x )
+void sqrt( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -215,7 +228,7 @@ void sqrt( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<V
     }
 }
 
-void inversesqrt( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x )
+void inversesqrt( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -231,7 +244,7 @@ void inversesqrt( const Renderer& /*renderer*/, const Grid& /*grid*/, std::share
     }
 }
 
-void log( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x )
+void log( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -247,7 +260,7 @@ void log( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Va
     }
 }
 
-void logb( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x, std::shared_ptr<Value> base )
+void logb( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x, const Value* base )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -266,7 +279,7 @@ void logb( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<V
     }
 }
 
-void mod( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> a, std::shared_ptr<Value> b )
+void mod( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* a, const Value* b )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( a );
@@ -285,7 +298,7 @@ void mod( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Va
     }
 }
 
-void abs( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x )
+void abs( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -301,7 +314,7 @@ void abs( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Va
     }
 }
 
-void sign( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x )
+void sign( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -317,7 +330,7 @@ void sign( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<V
     }
 }
 
-void mix_float( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x, std::shared_ptr<Value> y, std::shared_ptr<Value> alpha )
+void mix_float( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x, const Value* y, const Value* alpha )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -337,7 +350,7 @@ void mix_float( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_
     }
 }
 
-void mix_vec3( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x, std::shared_ptr<Value> y, std::shared_ptr<Value> alpha )
+void mix_vec3( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x, const Value* y, const Value* alpha )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -359,7 +372,7 @@ void mix_vec3( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_p
     }
 }
 
-void floor( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x )
+void floor( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -375,7 +388,7 @@ void floor( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<
     }
 }
 
-void ceil( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x )
+void ceil( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -391,7 +404,7 @@ void ceil( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<V
     }
 }
 
-void round( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> x )
+void round( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( x );
@@ -407,7 +420,7 @@ void round( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<
     }
 }
 
-void step( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> min, std::shared_ptr<Value> x )
+void step( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* min, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( min );
@@ -425,7 +438,7 @@ void step( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<V
     }
 }
 
-void smoothstep( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> min, std::shared_ptr<Value> max, std::shared_ptr<Value> x )
+void smoothstep( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* min, const Value* max, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( min );
@@ -446,157 +459,181 @@ void smoothstep( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared
     }
 }
 
-void du_float( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> p )
+void du_float( const Renderer& /*renderer*/, const Grid& grid, Value* result, const Value* p )
 {
     REYES_ASSERT( p );
     REYES_ASSERT( p->type() >= TYPE_COLOR && p->type() <= TYPE_NORMAL );
     
     result->reset( p->type(), p->storage(), p->size() );
     
-    int i = 0;
-    int width = grid.width_;
-    int height = grid.height_;
-    float du = grid.du_;
     const float* other_values = p->float_values();    
     float* values = result->float_values();
     
-    for ( int y = 0; y < height; ++y )
+    const int patches = grid.patches();
+    for ( int j = 0; j < patches; ++j )
     {
-        int i0 = i;
-        int i1 = i + 1;
-        values[i0] = (other_values[i1] - other_values[i0]) / du;
+        const Grid::Patch patch = grid.patch( j );
+        int i = patch.offset;
+        int width = patch.width;
+        int height = patch.height;
+        float du = patch.du;
 
-        for ( int x = 1; x < width - 1; ++x )
+        for ( int y = 0; y < height; ++y )
         {
-            int i0 = i + x - 1;
-            int i2 = i + x + 1;
-            values[i0] = (other_values[i2] - other_values[i0]) / (2.0f * du);
+            int i0 = i;
+            int i1 = i + 1;
+            values[i0] = (other_values[i1] - other_values[i0]) / du;
+
+            for ( int x = 1; x < width - 1; ++x )
+            {
+                int i0 = i + x - 1;
+                int i2 = i + x + 1;
+                values[i0] = (other_values[i2] - other_values[i0]) / (2.0f * du);
+            }
+
+            i0 = i + width - 2;
+            i1 = i + width - 1;
+            values[i0] = (other_values[i1] - other_values[i0]) / du;
+
+            i += width;
         }
-
-        i0 = i + width - 2;
-        i1 = i + width - 1;
-        values[i0] = (other_values[i1] - other_values[i0]) / du;
-
-        i += width;
     }
 }
 
-void du_vec3( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> p )
+void du_vec3( const Renderer& /*renderer*/, const Grid& grid, Value* result, const Value* p )
 {
     REYES_ASSERT( p );
     REYES_ASSERT( p->type() >= TYPE_COLOR && p->type() <= TYPE_NORMAL );
     
     result->reset( p->type(), p->storage(), p->size() );
     
-    int i = 0;
-    int width = grid.width_;
-    int height = grid.height_;
-    float du = grid.du_;
     const vec3* other_values = p->vec3_values();    
     vec3* values = result->vec3_values();
     
-    for ( int y = 0; y < height; ++y )
+    const int patches = grid.patches();
+    for ( int j = 0; j < patches; ++j )
     {
-        int i0 = i;
-        int i1 = i + 1;
-        values[i0] = (other_values[i1] - other_values[i0]) / du;
+        const Grid::Patch patch = grid.patch( j );
+        int i = patch.offset;
+        int width = patch.width;
+        int height = patch.height;
+        float du = patch.du;
 
-        for ( int x = 1; x < width - 1; ++x )
+        for ( int y = 0; y < height; ++y )
         {
-            int i0 = i + x - 1;
-            int i2 = i + x + 1;
-            values[i0] = (other_values[i2] - other_values[i0]) / (2.0f * du);
+            int i0 = i;
+            int i1 = i + 1;
+            values[i0] = (other_values[i1] - other_values[i0]) / du;
+
+            for ( int x = 1; x < width - 1; ++x )
+            {
+                int i0 = i + x - 1;
+                int i2 = i + x + 1;
+                values[i0] = (other_values[i2] - other_values[i0]) / (2.0f * du);
+            }
+
+            i0 = i + width - 2;
+            i1 = i + width - 1;
+            values[i0] = (other_values[i1] - other_values[i0]) / du;
+
+            i += width;
         }
-
-        i0 = i + width - 2;
-        i1 = i + width - 1;
-        values[i0] = (other_values[i1] - other_values[i0]) / du;
-
-        i += width;
     }
 }
 
-void dv_float( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> p )
+void dv_float( const Renderer& /*renderer*/, const Grid& grid, Value* result, const Value* p )
 {
     REYES_ASSERT( p );
     REYES_ASSERT( p->type() >= TYPE_COLOR && p->type() <= TYPE_NORMAL );
     
     result->reset( p->type(), p->storage(), p->size() );
     
-    int i = 0;
-    int width = grid.width_;
-    int height = grid.height_;
-    float dv = grid.dv_;
     const float* other_values = p->float_values();    
     float* values = result->float_values();
     
-    for ( int x = 0; x < width; ++x )
+    const int patches = grid.patches();
+    for ( int j = 0; j < patches; ++j )
     {
-        int i0 = i + x;
-        int i1 = i + width + x;
-        values[i0] = (other_values[i1] - other_values[i0]) / dv;
-    }
+        const Grid::Patch patch = grid.patch( j );
+        int i = patch.offset;
+        int width = patch.width;
+        int height = patch.height;
+        float dv = patch.dv;
 
-    for ( int y = 1; y < height - 1; ++y )
-    {
         for ( int x = 0; x < width; ++x )
         {
             int i0 = i + x;
-            int i2 = i + width * 2 + x;
-            values[i0] = (other_values[i2] - other_values[i0]) / (2.0f * dv);
-        }                               
-        i += width;
-    }
+            int i1 = i + width + x;
+            values[i0] = (other_values[i1] - other_values[i0]) / dv;
+        }
+
+        for ( int y = 1; y < height - 1; ++y )
+        {
+            for ( int x = 0; x < width; ++x )
+            {
+                int i0 = i + x;
+                int i2 = i + width * 2 + x;
+                values[i0] = (other_values[i2] - other_values[i0]) / (2.0f * dv);
+            }                               
+            i += width;
+        }
     
-    for ( int x = 0; x < width; ++x )
-    {
-        int i0 = i + x;
-        int i1 = i + width + x;
-        values[i0] = (other_values[i1] - other_values[i0]) / dv;
-    }                            
+        for ( int x = 0; x < width; ++x )
+        {
+            int i0 = i + x;
+            int i1 = i + width + x;
+            values[i0] = (other_values[i1] - other_values[i0]) / dv;
+        }                            
+    }
 }
 
-void dv_vec3( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> p )
+void dv_vec3( const Renderer& /*renderer*/, const Grid& grid, Value* result, const Value* p )
 {
     REYES_ASSERT( p );
     REYES_ASSERT( p->type() >= TYPE_COLOR && p->type() <= TYPE_NORMAL );
     
     result->reset( p->type(), p->storage(), p->size() );
     
-    int i = 0;
-    int width = grid.width_;
-    int height = grid.height_;
-    float dv = grid.dv_;
     const vec3* other_values = p->vec3_values();    
     vec3* values = result->vec3_values();
     
-    for ( int x = 0; x < width; ++x )
+    const int patches = grid.patches();
+    for ( int j = 0; j < patches; ++j )
     {
-        int i0 = i + x;
-        int i1 = i + width + x;
-        values[i0] = (other_values[i1] - other_values[i0]) / dv;
-    }
+        const Grid::Patch patch = grid.patch( j );
+        int i = patch.offset;
+        int width = patch.width;
+        int height = patch.height;
+        float dv = patch.dv;
 
-    for ( int y = 1; y < height - 1; ++y )
-    {
         for ( int x = 0; x < width; ++x )
         {
             int i0 = i + x;
-            int i2 = i + width * 2 + x;
-            values[i0] = (other_values[i2] - other_values[i0]) / (2.0f * dv);
-        }                               
-        i += width;
-    }
+            int i1 = i + width + x;
+            values[i0] = (other_values[i1] - other_values[i0]) / dv;
+        }
+
+        for ( int y = 1; y < height - 1; ++y )
+        {
+            for ( int x = 0; x < width; ++x )
+            {
+                int i0 = i + x;
+                int i2 = i + width * 2 + x;
+                values[i0] = (other_values[i2] - other_values[i0]) / (2.0f * dv);
+            }                               
+            i += width;
+        }
     
-    for ( int x = 0; x < width; ++x )
-    {
-        int i0 = i + x;
-        int i1 = i + width + x;
-        values[i0] = (other_values[i1] - other_values[i0]) / dv;
-    }                            
+        for ( int x = 0; x < width; ++x )
+        {
+            int i0 = i + x;
+            int i1 = i + width + x;
+            values[i0] = (other_values[i1] - other_values[i0]) / dv;
+        }                            
+    }
 }
 
-void deriv_float( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> y, std::shared_ptr<Value> x )
+void deriv_float( const Renderer& /*renderer*/, const Grid& grid, Value* result, const Value* y, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( y );
@@ -605,61 +642,67 @@ void deriv_float( const Renderer& /*renderer*/, const Grid& grid, std::shared_pt
     
     result->reset( TYPE_FLOAT, y->storage(), y->size() );
 
-    int i = 0;
-    int width = grid.width_;
-    int height = grid.height_;
     const float* y_values = y->float_values();    
     const float* x_values = x->float_values();    
     float* values = result->float_values();
     
-    for ( int y = 0; y < height; ++y )
+    const int patches = grid.patches();
+    for ( int j = 0; j < patches; ++j )
     {
-        int i0 = i;
-        int i1 = i + 1;
-        values[i0] = (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
+        const Grid::Patch patch = grid.patch( j );
+        int i = patch.offset;
+        int width = patch.width;
+        int height = patch.height;
 
-        for ( int x = 1; x < width - 1; ++x )
+        for ( int y = 0; y < height; ++y )
         {
-            int i0 = i + x - 1;
-            int i2 = i + x + 1;
-            values[i0] = (y_values[i2] - y_values[i0]) / (x_values[i2] - x_values[i0]);
+            int i0 = i;
+            int i1 = i + 1;
+            values[i0] = (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
+
+            for ( int x = 1; x < width - 1; ++x )
+            {
+                int i0 = i + x - 1;
+                int i2 = i + x + 1;
+                values[i0] = (y_values[i2] - y_values[i0]) / (x_values[i2] - x_values[i0]);
+            }
+
+            i0 = i + width - 2;
+            i1 = i + width - 1;
+            values[i1] = (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
+
+            i += width;
         }
 
-        i0 = i + width - 2;
-        i1 = i + width - 1;
-        values[i1] = (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
-
-        i += width;
-    }
-
-    i = 0;
-    for ( int x = 0; x < width; ++x )
-    {
-        int i0 = i + x;
-        int i1 = i + width + x;        
-        values[i0] += (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
-    }
+        i = patch.offset;
+        for ( int x = 0; x < width; ++x )
+        {
+            int i0 = i + x;
+            int i1 = i + width + x;        
+            values[i0] += (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
+        }
 
-    for ( int y = 1; y < height - 1; ++y )
-    {
+        for ( int y = 1; y < height - 1; ++y )
+        {
+            for ( int x = 0; x < width; ++x )
+            {
+                int i0 = i + x;
+                int i2 = i + width * 2 + x;
+                values[i0] += (y_values[i2] - y_values[i0]) / (x_values[i2] - x_values[i0]);
+            }                               
+            i += width;
+        }
+    
         for ( int x = 0; x < width; ++x )
         {
             int i0 = i + x;
-            int i2 = i + width * 2 + x;
-            values[i0] += (y_values[i2] - y_values[i0]) / (x_values[i2] - x_values[i0]);
-        }                               
-        i += width;
+            int i1 = i + width + x;
+            values[i1] += (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
+        }                            
     }
-    
-    for ( int x = 0; x < width; ++x )
-    {
-        int i0 = i + x;
-        int i1 = i + width + x;
-        values[i1] += (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
-    }                            
 }
 
-void deriv_vec3( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> y, std::shared_ptr<Value> x )
+void deriv_vec3( const Renderer& /*renderer*/, const Grid& grid, Value* result, const Value* y, const Value* x )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( y );
@@ -668,79 +711,85 @@ void deriv_vec3( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr
     
     result->reset( y->type(), y->storage(), y->size() );
 
-    int i = 0;
-    int width = grid.width_;
-    int height = grid.height_;
     const vec3* y_values = y->vec3_values();    
     const float* x_values = x->float_values();    
     vec3* values = result->vec3_values();
     
-    for ( int y = 0; y < height; ++y )
+    const int patches = grid.patches();
+    for ( int j = 0; j < patches; ++j )
     {
-        int i0 = i;
-        int i1 = i + 1;
-        values[i0] = (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
+        const Grid::Patch patch = grid.patch( j );
+        int i = patch.offset;
+        int width = patch.width;
+        int height = patch.height;
 
-        for ( int x = 1; x < width - 1; ++x )
+        for ( int y = 0; y < height; ++y )
         {
-            int i0 = i + x - 1;
-            int i2 = i + x + 1;
-            values[i0] = (y_values[i2] - y_values[i0]) / (x_values[i2] - x_values[i0]);
+            int i0 = i;
+            int i1 = i + 1;
+            values[i0] = (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
+
+            for ( int x = 1; x < width - 1; ++x )
+            {
+                int i0 = i + x - 1;
+                int i2 = i + x + 1;
+                values[i0] = (y_values[i2] - y_values[i0]) / (x_values[i2] - x_values[i0]);
+            }
+
+            i0 = i + width - 2;
+            i1 = i + width - 1;
+            values[i1] = (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
+
+            i += width;
         }
 
-        i0 = i + width - 2;
-        i1 = i + width - 1;
-        values[i1] = (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
-
-        i += width;
-    }
-
-    i = 0;
-    for ( int x = 0; x < width; ++x )
-    {
-        int i0 = i + x;
-        int i1 = i + width + x;        
-        values[i0] += (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
-    }
+        i = patch.offset;
+        for ( int x = 0; x < width; ++x )
+        {
+            int i0 = i + x;
+            int i1 = i + width + x;        
+            values[i0] += (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
+        }
 
-    for ( int y = 1; y < height - 1; ++y )
-    {
+        for ( int y = 1; y < height - 1; ++y )
+        {
+            for ( int x = 0; x < width; ++x )
+            {
+                int i0 = i + x;
+                int i2 = i + width * 2 + x;
+                values[i0] += (y_values[i2] - y_values[i0]) / (x_values[i2] - x_values[i0]);
+            }                               
+            i += width;
+        }
+    
         for ( int x = 0; x < width; ++x )
         {
             int i0 = i + x;
-            int i2 = i + width * 2 + x;
-            values[i0] += (y_values[i2] - y_values[i0]) / (x_values[i2] - x_values[i0]);
-        }                               
-        i += width;
+            int i1 = i + width + x;
+            values[i1] += (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
+        }                            
     }
-    
-    for ( int x = 0; x < width; ++x )
-    {
-        int i0 = i + x;
-        int i1 = i + width + x;
-        values[i1] += (y_values[i1] - y_values[i0]) / (x_values[i1] - x_values[i0]);
-    }                            
 }
 
-void uniform_float_random( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result )
+void uniform_float_random( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result )
 {
     REYES_ASSERT( result );
     result->reset( TYPE_FLOAT, STORAGE_UNIFORM, 1 );
-    result->float_values()[0] = (float(rand()) / (RAND_MAX / 2) - 1.0f);
+    result->float_values()[0] = random_unit_float() * 2.0f - 1.0f;
 }
 
-void uniform_vec3_random( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result )
+void uniform_vec3_random( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result )
 {
     REYES_ASSERT( result );
     result->reset( TYPE_POINT, STORAGE_UNIFORM, 1 );
     result->vec3_values()[0] = vec3(
-        (float(rand()) / (RAND_MAX / 2) - 1.0f),
-        (float(rand()) / (RAND_MAX / 2) - 1.0f),
-        (float(rand()) / (RAND_MAX / 2) - 1.0f)
+        random_unit_float() * 2.0f - 1.0f,
+        random_unit_float() * 2.0f - 1.0f,
+        random_unit_float() * 2.0f - 1.0f
     );
 }
 
-void float_random( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result )
+void float_random( const Renderer& /*renderer*/, const Grid& grid, Value* result )
 {
     REYES_ASSERT( result );
     
@@ -749,11 +798,11 @@ void float_random( const Renderer& /*renderer*/, const Grid& grid, std::shared_p
     float* values = result->float_values();
     for ( int i = 0; i < size; ++i )
     {
-        values[i] = float(rand()) / RAND_MAX;
+        values[i] = random_unit_float();
     }    
 }
 
-void vec3_random( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result )
+void vec3_random( const Renderer& /*renderer*/, const Grid& grid, Value* result )
 {
     REYES_ASSERT( result );
 
@@ -763,9 +812,9 @@ void vec3_random( const Renderer& /*renderer*/, const Grid& grid, std::shared_pt
     for ( int i = 0; i < size; ++i )
     {
         values[i] = vec3(
-            float(rand() / RAND_MAX),
-            float(rand() / RAND_MAX),
-            float(rand() / RAND_MAX)
+            random_unit_float(),
+            random_unit_float(),
+            random_unit_float()
         );
     }    
 }
@@ -6,6 +6,7 @@
 #include "multiply.hpp"
 #include "Dispatch.hpp"
 #include "Instruction.hpp"
+#include "simd.hpp"
 #include <reyes/assert.hpp>
 
 namespace reyes
@@ -39,116 +40,62 @@ void multiply_u4u4( float* result, const float* lhs, const float* rhs, unsigned
 
 void multiply_u1v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i] = lhs[0] * rhs[i];
-    }
+    simd_uv<1>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_u2v2( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[0] * rhs[i * 2 + 0];
-        result[i * 2 + 1] = lhs[1] * rhs[i * 2 + 1];
-    }
+    simd_uv<2>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_u3v3( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[0] * rhs[i * 3 + 0];
-        result[i * 3 + 1] = lhs[1] * rhs[i * 3 + 1];
-        result[i * 3 + 2] = lhs[2] * rhs[i * 3 + 2];
-    }
+    simd_uv<3>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_u4v4( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[0] * rhs[i * 4 + 0];
-        result[i * 4 + 1] = lhs[1] * rhs[i * 4 + 1];
-        result[i * 4 + 2] = lhs[2] * rhs[i * 4 + 2];
-        result[i * 4 + 3] = lhs[3] * rhs[i * 4 + 3];
-    }
+    simd_uv<4>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_v1u1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i] = lhs[i] * rhs[0];
-    }
+    simd_vu<1>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_v2u2( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[i * 2 + 0] * rhs[0];
-        result[i * 2 + 1] = lhs[i * 2 + 1] * rhs[1];
-    }
+    simd_vu<2>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_v3u3( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[i * 3 + 0] * rhs[0];
-        result[i * 3 + 1] = lhs[i * 3 + 1] * rhs[1];
-        result[i * 3 + 2] = lhs[i * 3 + 2] * rhs[2];
-    }
+    simd_vu<3>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_v4u4( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[i * 4 + 0] * rhs[0];
-        result[i * 4 + 1] = lhs[i * 4 + 1] * rhs[1];
-        result[i * 4 + 2] = lhs[i * 4 + 2] * rhs[2];
-        result[i * 4 + 3] = lhs[i * 4 + 3] * rhs[3];
-    }
+    simd_vu<4>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_v1v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i] = lhs[i] * rhs[i];
-    }
+    simd_vv( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_v2v2( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[i * 2 + 0] * rhs[i * 2 + 0];
-        result[i * 2 + 1] = lhs[i * 2 + 1] * rhs[i * 2 + 1];
-    }
+    simd_vv( SimdMultiply(), result, lhs, rhs, length * 2 );
 }
 
 void multiply_v3v3( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[i * 3 + 0] * rhs[i * 3 + 0];
-        result[i * 3 + 1] = lhs[i * 3 + 1] * rhs[i * 3 + 1];
-        result[i * 3 + 2] = lhs[i * 3 + 2] * rhs[i * 3 + 2];
-    }
+    simd_vv( SimdMultiply(), result, lhs, rhs, length * 3 );
 }
 
 void multiply_v4v4( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[i * 4 + 0] * rhs[i * 4 + 0];
-        result[i * 4 + 1] = lhs[i * 4 + 1] * rhs[i * 4 + 1];
-        result[i * 4 + 2] = lhs[i * 4 + 2] * rhs[i * 4 + 2];
-        result[i * 4 + 3] = lhs[i * 4 + 3] * rhs[i * 4 + 3];
-    }
+    simd_vv( SimdMultiply(), result, lhs, rhs, length * 4 );
 }
 
 void multiply_u2u1( float* result, const float* lhs, const float* rhs, unsigned int /*length*/ )
@@ -174,214 +121,155 @@ void multiply_u4u1( float* result, const float* lhs, const float* rhs, unsigned
 
 void multiply_u2v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[0] * rhs[i];
-        result[i * 2 + 1] = lhs[1] * rhs[i];
-    }
+    simd_uv1<2>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_u3v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[0] * rhs[i];
-        result[i * 3 + 1] = lhs[1] * rhs[i];
-        result[i * 3 + 2] = lhs[2] * rhs[i];
-    }
+    simd_uv1<3>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_u4v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[0] * rhs[i];
-        result[i * 4 + 1] = lhs[1] * rhs[i];
-        result[i * 4 + 2] = lhs[2] * rhs[i];
-        result[i * 4 + 3] = lhs[3] * rhs[i];
-    }
+    simd_uv1<4>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_v2u1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[i * 2 + 0] * rhs[0];
-        result[i * 2 + 1] = lhs[i * 2 + 1] * rhs[0];
-    }
+    simd_vu<1>( SimdMultiply(), result, lhs, rhs, length * 2 );
 }
 
 void multiply_v3u1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[i * 3 + 0] * rhs[0];
-        result[i * 3 + 1] = lhs[i * 3 + 1] * rhs[0];
-        result[i * 3 + 2] = lhs[i * 3 + 2] * rhs[0];
-    }
+    simd_vu<1>( SimdMultiply(), result, lhs, rhs, length * 3 );
 }
 
 void multiply_v4u1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[i * 4 + 0] * rhs[0];
-        result[i * 4 + 1] = lhs[i * 4 + 1] * rhs[0];
-        result[i * 4 + 2] = lhs[i * 4 + 2] * rhs[0];
-        result[i * 4 + 3] = lhs[i * 4 + 3] * rhs[0];
-    }
+    simd_vu<1>( SimdMultiply(), result, lhs, rhs, length * 4 );
 }
 
 void multiply_v2v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[i * 2 + 0] * rhs[i];
-        result[i * 2 + 1] = lhs[i * 2 + 1] * rhs[i];
-    }
+    simd_vv1<2>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_v3v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[i * 3 + 0] * rhs[i];
-        result[i * 3 + 1] = lhs[i * 3 + 1] * rhs[i];
-        result[i * 3 + 2] = lhs[i * 3 + 2] * rhs[i];
-    }
+    simd_vv1<3>( SimdMultiply(), result, lhs, rhs, length );
 }
 
 void multiply_v4v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[i * 4 + 0] * rhs[i];
-        result[i * 4 + 1] = lhs[i * 4 + 1] * rhs[i];
-        result[i * 4 + 2] = lhs[i * 4 + 2] * rhs[i];
-        result[i * 4 + 3] = lhs[i * 4 + 3] * rhs[i];
-    }
+    simd_vv1<4>( SimdMultiply(), result, lhs, rhs, length );
 }
 
-void multiply( int dispatch, float* result, const float* lhs, const float* rhs, unsigned int length )
+/**
+// Select the kernel that multiplies operands of the widths and storage 
+// described by a dispatch code.
+//
+// @return
+//  The kernel or null if there is no kernel for the dispatch code.
+*/
+BinaryKernel multiply_kernel( int dispatch )
 {
     switch ( dispatch )
     {
         case DISPATCH_U1U1:
-            multiply_u1u1( result, lhs, rhs, length );
-            break;
+            return multiply_u1u1;
 
         case DISPATCH_U2U2:
-            multiply_u2u2( result, lhs, rhs, length );
-            break;
+            return multiply_u2u2;
 
         case DISPATCH_U3U3:
-            multiply_u3u3( result, lhs, rhs, length );
-            break;
+            return multiply_u3u3;
 
         case DISPATCH_U4U4:
-            multiply_u4u4( result, lhs, rhs, length );
-            break;
+            return multiply_u4u4;
 
         case DISPATCH_U1V1:
-            multiply_u1v1( result, lhs, rhs, length );
-            break;
+            return multiply_u1v1;
 
         case DISPATCH_U2V2:
-            multiply_u2v2( result, lhs, rhs, length );
-            break;
+            return multiply_u2v2;
 
         case DISPATCH_U3V3:
-            multiply_u3v3( result, lhs, rhs, length );
-            break;
+            return multiply_u3v3;
 
         case DISPATCH_U4V4:
-            multiply_u4v4( result, lhs, rhs, length );
-            break;
+            return multiply_u4v4;
 
         case DISPATCH_V1U1:
-            multiply_v1u1( result, lhs, rhs, length );
-            break;
+            return multiply_v1u1;
 
         case DISPATCH_V2U2:
-            multiply_v2u2( result, lhs, rhs, length );
-            break;
+            return multiply_v2u2;
 
         case DISPATCH_V3U3:
-            multiply_v3u3( result, lhs, rhs, length );
-            break;
+            return multiply_v3u3;
 
         case DISPATCH_V4U4:
-            multiply_v4u4( result, lhs, rhs, length );
-            break;
+            return multiply_v4u4;
 
         case DISPATCH_V1V1:
-            multiply_v1v1( result, lhs, rhs, length );
-            break;
+            return multiply_v1v1;
 
         case DISPATCH_V2V2:
-            multiply_v2v2( result, lhs, rhs, length );
-            break;
+            return multiply_v2v2;
 
         case DISPATCH_V3V3:
-            multiply_v3v3( result, lhs, rhs, length );
-            break;
+            return multiply_v3v3;
 
         case DISPATCH_V4V4:
-            multiply_v4v4( result, lhs, rhs, length );
-            break;
+            return multiply_v4v4;
 
         case DISPATCH_U2U1:
-            multiply_u2u1( result, lhs, rhs, length );
-            break;
+            return multiply_u2u1;
 
         case DISPATCH_U3U1:
-            multiply_u3u1( result, lhs, rhs, length );
-            break;
+            return multiply_u3u1;
 
         case DISPATCH_U4U1:
-            multiply_u4u1( result, lhs, rhs, length );
-            break;
+            return multiply_u4u1;
 
         case DISPATCH_U2V1:
-            multiply_u2v1( result, lhs, rhs, length );
-            break;
+            return multiply_u2v1;
 
         case DISPATCH_U3V1:
-            multiply_u3v1( result, lhs, rhs, length );
-            break;
+            return multiply_u3v1;
 
         case DISPATCH_U4V1:
-            multiply_u4v1( result, lhs, rhs, length );
-            break;
+            return multiply_u4v1;
 
         case DISPATCH_V2U1:
-            multiply_v2u1( result, lhs, rhs, length );
-            break;
+            return multiply_v2u1;
 
         case DISPATCH_V3U1:
-            multiply_v3u1( result, lhs, rhs, length );
-            break;
+            return multiply_v3u1;
 
         case DISPATCH_V4U1:
-            multiply_v4u1( result, lhs, rhs, length );
-            break;
+            return multiply_v4u1;
 
         case DISPATCH_V2V1:
-            multiply_v2v1( result, lhs, rhs, length );
-            break;
+            return multiply_v2v1;
 
         case DISPATCH_V3V1:
-            multiply_v3v1( result, lhs, rhs, length );
-            break;
+            return multiply_v3v1;
 
         case DISPATCH_V4V1:
-            multiply_v4v1( result, lhs, rhs, length );
-            break;
+            return multiply_v4v1;
 
         default:
             REYES_ASSERT( false );
-            break;
+            return NULL;
     }
 }
 
+void multiply( int dispatch, float* result, const float* lhs, const float* rhs, unsigned int length )
+{
+    BinaryKernel kernel = multiply_kernel( dispatch );
+    REYES_ASSERT( kernel );
+    (*kernel)( result, lhs, rhs, length );
+}
+
 }
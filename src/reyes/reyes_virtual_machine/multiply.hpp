@@ -1,9 +1,12 @@
 #ifndef REYES_MULTIPLY_HPP_INCLUDED
 #define REYES_MULTIPLY_HPP_INCLUDED
 
+#include "Kernel.hpp"
+
 namespace reyes
 {
 
+BinaryKernel multiply_kernel( int dispatch );
 void multiply( int dispatch, float* result, const float* lhs, const float* rhs, unsigned int length );
 
 }
@@ -0,0 +1,124 @@
+//
+// multiply_add.cpp
+// Copyright (c) Charles Baker.  All rights reserved.
+//
+
+#include "multiply_add.hpp"
+#include "Dispatch.hpp"
+#include "simd.hpp"
+#include <reyes/assert.hpp>
+
+namespace reyes
+{
+
+/**
+// Multiply and add \e count floats of three varying values of the same 
+// width.
+*/
+static void multiply_add_vvv( float* result, const float* lhs, const float* rhs, const float* addend, unsigned int count )
+{
+    unsigned int i = 0;
+#ifdef REYES_SIMD_SSE2
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        __m128 product = _mm_mul_ps( _mm_loadu_ps(lhs + i), _mm_loadu_ps(rhs + i) );
+        _mm_storeu_ps( result + i, _mm_add_ps(product, _mm_loadu_ps(addend + i)) );
+    }
+#endif
+    for ( ; i < count; ++i )
+    {
+        result[i] = lhs[i] * rhs[i] + addend[i];
+    }
+}
+
+/**
+// Multiply and add \e length elements of WIDTH floats where any operand 
+// may be uniform (a stride of zero) and the right hand side may be a 
+// single float that scales every component (a step of zero).
+*/
+template <unsigned int WIDTH>
+static void multiply_add_strided( float* result, const float* lhs, unsigned int lhs_stride, const float* rhs, unsigned int rhs_stride, unsigned int rhs_step, const float* addend, unsigned int addend_stride, unsigned int length )
+{
+    for ( unsigned int i = 0; i < length; ++i )
+    {
+        for ( unsigned int j = 0; j < WIDTH; ++j )
+        {
+            result[j] = lhs[j] * rhs[j * rhs_step] + addend[j];
+        }
+        result += WIDTH;
+        lhs += lhs_stride;
+        rhs += rhs_stride;
+        addend += addend_stride;
+    }
+}
+
+static unsigned int width( int dispatch )
+{
+    return (dispatch & 0x0f) + 1;
+}
+
+static unsigned int stride( int dispatch )
+{
+    return (dispatch & DISPATCH_VARYING) ? width( dispatch ) : 0;
+}
+
+/**
+// Calculate lhs * rhs + addend in a single pass.
+//
+// @param dispatch
+//  The dispatch code for the multiplication; the left hand side is one or
+//  three floats wide and the right hand side is either as wide as the left
+//  hand side or a single float.
+//
+// @param addend_dispatch
+//  The dispatch code for the addend; as wide as the left hand side.
+//
+// @param result
+//  The values to write the results to (as wide as the left hand side).
+//
+// @param lhs
+//  The left hand side of the multiplication.
+//
+// @param rhs
+//  The right hand side of the multiplication.
+//
+// @param addend
+//  The values added to the product.
+//
+// @param length
+//  The number of elements to calculate.
+*/
+void multiply_add( int dispatch, int addend_dispatch, float* result, const float* lhs, const float* rhs, const float* addend, unsigned int length )
+{
+    const int lhs_dispatch = (dispatch >> 8) & 0xff;
+    const int rhs_dispatch = dispatch & 0xff;
+    const unsigned int lhs_width = width( lhs_dispatch );
+    const unsigned int rhs_width = width( rhs_dispatch );
+    REYES_ASSERT( lhs_width == width(addend_dispatch) );
+    REYES_ASSERT( rhs_width == lhs_width || rhs_width == 1 );
+
+    const int varying = lhs_dispatch & rhs_dispatch & addend_dispatch & DISPATCH_VARYING;
+    if ( varying && rhs_width == lhs_width )
+    {
+        multiply_add_vvv( result, lhs, rhs, addend, length * lhs_width );
+        return;
+    }
+
+    const unsigned int rhs_step = rhs_width == lhs_width ? 1 : 0;
+    switch ( lhs_width )
+    {
+        case 1:
+            multiply_add_strided<1>( result, lhs, stride(lhs_dispatch), rhs, stride(rhs_dispatch), rhs_step, addend, stride(addend_dispatch), length );
+            break;
+
+        case 3:
+            multiply_add_strided<3>( result, lhs, stride(lhs_dispatch), rhs, stride(rhs_dispatch), rhs_step, addend, stride(addend_dispatch), length );
+            break;
+
+        default:
+            REYES_ASSERT( false );
+            break;
+    }
+}
+
+}
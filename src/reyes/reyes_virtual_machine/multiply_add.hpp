@@ -0,0 +1,11 @@
+#ifndef REYES_MULTIPLY_ADD_HPP_INCLUDED
+#define REYES_MULTIPLY_ADD_HPP_INCLUDED
+
+namespace reyes
+{
+
+void multiply_add( int dispatch, int addend_dispatch, float* result, const float* lhs, const float* rhs, const float* addend, unsigned int length );
+
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include "Dispatch.hpp"
 #include "Instruction.hpp"
 #include <reyes/assert.hpp>
+#include <stddef.h>
 
 namespace reyes
 {
@@ -75,46 +76,45 @@ void negate_v4( float* result, const float* rhs, unsigned int length )
     }
 }
 
-void negate( unsigned int dispatch, float* result, const float* rhs, unsigned int length )
+UnaryKernel negate_kernel( int dispatch )
 {
     switch ( dispatch )
     {
         case DISPATCH_U1:
-            negate_u1( result, rhs, length );
-            break;
+            return negate_u1;
 
         case DISPATCH_U2:
-            negate_u2( result, rhs, length );
-            break;
+            return negate_u2;
 
         case DISPATCH_U3:
-            negate_u3( result, rhs, length );
-            break;
+            return negate_u3;
 
         case DISPATCH_U4:
-            negate_u4( result, rhs, length );
-            break;
+            return negate_u4;
 
         case DISPATCH_V1:
-            negate_v1( result, rhs, length );
-            break;
+            return negate_v1;
 
         case DISPATCH_V2:
-            negate_v2( result, rhs, length );
-            break;
+            return negate_v2;
 
         case DISPATCH_V3:
-            negate_v3( result, rhs, length );
-            break;
+            return negate_v3;
 
         case DISPATCH_V4:
-            negate_v4( result, rhs, length );
-            break;
+            return negate_v4;
 
         default:
             REYES_ASSERT( false );
-            break;
+            return NULL;
     }
 }
 
+void negate( unsigned int dispatch, float* result, const float* rhs, unsigned int length )
+{
+    UnaryKernel kernel = negate_kernel( dispatch );
+    REYES_ASSERT( kernel );
+    (*kernel)( result, rhs, length );
+}
+
 }
@@ -1,9 +1,12 @@
 #ifndef REYES_NEGATE_HPP_INCLUDED
 #define REYES_NEGATE_HPP_INCLUDED
 
+#include "Kernel.hpp"
+
 namespace reyes
 {
 
+UnaryKernel negate_kernel( int dispatch );
 void negate( unsigned int dispatch, float* result, const float* rhs, unsigned int length );
 
 }
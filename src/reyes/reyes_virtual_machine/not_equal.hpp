@@ -1,9 +1,12 @@
 #ifndef REYES_NOT_EQUAL_HPP_INCLUDED
 #define REYES_NOT_EQUAL_HPP_INCLUDED
 
+#include "Kernel.hpp"
+
 namespace reyes
 {
 
+ComparisonKernel not_equal_kernel( int dispatch );
 void not_equal( int dispatch, int* result, const float* lhs, const float* rhs, unsigned int length );
 
 }
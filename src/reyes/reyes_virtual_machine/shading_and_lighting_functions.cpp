@@ -4,6 +4,7 @@
 //
 
 #include <reyes/Grid.hpp>
+#include <reyes/Identifier.hpp>
 #include <reyes/Texture.hpp>
 #include <reyes/Value.hpp>
 #include <reyes/VirtualMachine.hpp>
@@ -24,7 +25,7 @@ using namespace math;
 namespace reyes
 {
 
-void ambient( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> color )
+void ambient( const Renderer& /*renderer*/, const Grid& grid, Value* color )
 {
     REYES_ASSERT( color );
     
@@ -39,7 +40,7 @@ void ambient( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Va
         
         if ( light->type() == LIGHT_AMBIENT )
         {
-            const std::shared_ptr<Value>& light_color = light->color();
+            const Value* light_color = light->color().get();
             REYES_ASSERT( light_color );
             
             vec3* color_values = color->vec3_values();
@@ -52,7 +53,7 @@ void ambient( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Va
     }
 }
 
-void diffuse( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> color, std::shared_ptr<Value> normal )
+void diffuse( const Renderer& /*renderer*/, const Grid& grid, Value* color, const Value* normal )
 {
     REYES_ASSERT( color );
     REYES_ASSERT( normal );
@@ -61,7 +62,7 @@ void diffuse( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Va
     color->reset( TYPE_COLOR, STORAGE_VARYING, grid.size() );
     color->zero();
 
-    std::shared_ptr<Value> P = grid.find_value( "P" );
+    const Value* P = &grid.value( IDENTIFIER_P );
     REYES_ASSERT( P );
     REYES_ASSERT( P->type() == TYPE_POINT );
     REYES_ASSERT( P->storage() == STORAGE_VARYING );
@@ -75,13 +76,14 @@ void diffuse( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Va
         
         if ( light->type() != LIGHT_AMBIENT )
         {
-            const std::shared_ptr<Value>& light_color = light->color();
+            const Value* light_color = light->color().get();
             REYES_ASSERT( light_color );
             
             vec3* colors = color->vec3_values();
             const vec3* positions = P->vec3_values();
             const vec3* normals = normal->vec3_values();
             const vec3* light_colors = light_color->vec3_values();
+            const int light_color_stride = light_color->storage() == STORAGE_UNIFORM ? 0 : 1;
             const int size = color->size();
 
             switch ( light->type() )
@@ -98,7 +100,7 @@ void diffuse( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Va
                             const vec3& N = normals[i];
                             if ( dot(N, L) >= 0.0f )
                             {
-                                const vec3& Cl = light_colors[i];
+                                const vec3& Cl = light_colors[i * light_color_stride];
                                 colors[i] +=  Cl * dot( N, normalize(L) );
                             }                    
                         }
@@ -113,7 +115,7 @@ void diffuse( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Va
                             const vec3& N = normals[i];
                             if ( dot(N, L) >= 0.0f && dot(light_axis, -N) >= light_angle_cosine )
                             {
-                                const vec3& Cl = light_colors[i];
+                                const vec3& Cl = light_colors[i * light_color_stride];
                                 colors[i] +=  Cl * dot( N, normalize(L) );
                             }                    
                         }
@@ -130,7 +132,7 @@ void diffuse( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Va
                         const vec3& N = normals[i];
                         if ( dot(N, L) >= 0.0f )
                         {
-                            const vec3& Cl = light_colors[i];
+                            const vec3& Cl = light_colors[i * light_color_stride];
                             colors[i] +=  Cl * dot( N, normalize(L) );
                         }                    
                     }
@@ -148,7 +150,7 @@ void diffuse( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Va
                         const vec3& N = normals[i];
                         if ( dot(N, L) >= 0.0f && dot(light_axis, -L) >= light_angle_cosine )
                         {
-                            const vec3& Cl = light_colors[i];
+                            const vec3& Cl = light_colors[i * light_color_stride];
                             colors[i] +=  Cl * dot( N, L );
                         }                    
                     }
@@ -162,7 +164,7 @@ void diffuse( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Va
     }    
 }
 
-void specular( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> color, std::shared_ptr<Value> normal, std::shared_ptr<Value> view, std::shared_ptr<Value> roughness_value )
+void specular( const Renderer& /*renderer*/, const Grid& grid, Value* color, const Value* normal, const Value* view, const Value* roughness_value )
 {
     REYES_ASSERT( color );
     REYES_ASSERT( normal );
@@ -172,7 +174,7 @@ void specular( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<V
     color->reset( TYPE_COLOR, STORAGE_VARYING, grid.size() );
     color->zero();
     
-    std::shared_ptr<Value> P = grid.find_value( "P" );
+    const Value* P = &grid.value( IDENTIFIER_P );
     REYES_ASSERT( P );
     REYES_ASSERT( P->type() == TYPE_POINT );
     REYES_ASSERT( P->storage() == STORAGE_VARYING );
@@ -190,6 +192,7 @@ void specular( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<V
         const vec3* views = view->vec3_values();
         const float roughness = roughness_value->float_value();
         const vec3* light_colors = light->color()->vec3_values();
+        const int light_color_stride = light->color()->storage() == STORAGE_UNIFORM ? 0 : 1;
         const int size = color->size();
 
         switch ( light->type() )
@@ -206,7 +209,7 @@ void specular( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<V
                         const vec3& N = normals[i];
                         if ( dot(N, L) >= 0.0f )
                         {
-                            const vec3& Cl = light_colors[i];
+                            const vec3& Cl = light_colors[i * light_color_stride];
                             const vec3& V = views[i];
                             vec3 H = normalize( L + V );
                             colors[i] += Cl * powf( std::max(0.0f, dot(N, H)), 1.0f / roughness );
@@ -223,7 +226,7 @@ void specular( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<V
                         const vec3& N = normals[i];
                         if ( dot(N, L) >= 0.0f && dot(light_axis, -N) >= light_angle_cosine )
                         {
-                            const vec3& Cl = light_colors[i];
+                            const vec3& Cl = light_colors[i * light_color_stride];
                             const vec3& V = views[i];
                             vec3 H = normalize( L + V );
                             colors[i] += Cl * powf( std::max(0.0f, dot(N, H)), 1.0f / roughness );
@@ -242,7 +245,7 @@ void specular( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<V
                     const vec3& N = normals[i];
                     if ( dot(N, L) >= 0.0f )
                     {
-                        const vec3& Cl = light_colors[i];
+                        const vec3& Cl = light_colors[i * light_color_stride];
                         const vec3& V = views[i];
                         vec3 H = normalize( L + V );
                         colors[i] += Cl * powf( std::max(0.0f, dot(N, H)), 1.0f / roughness );
@@ -262,7 +265,7 @@ void specular( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<V
                     const vec3& N = normals[i];
                     if ( dot(N, L) >= 0.0f && dot(light_axis, -L) >= light_angle_cosine )
                     {
-                        const vec3& Cl = light_colors[i];
+                        const vec3& Cl = light_colors[i * light_color_stride];
                         const vec3& V = views[i];
                         vec3 H = normalize( L + V );
                         colors[i] += Cl * powf( std::max(0.0f, dot(N, H)), 1.0f / roughness );
@@ -277,7 +280,7 @@ void specular( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<V
     }
 }
 
-void specularbrdf( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shared_ptr<Value> result, std::shared_ptr<Value> l, std::shared_ptr<Value> n, std::shared_ptr<Value> v, std::shared_ptr<Value> roughness_value )
+void specularbrdf( const Renderer& /*renderer*/, const Grid& /*grid*/, Value* result, const Value* l, const Value* n, const Value* v, const Value* roughness_value )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( l );
@@ -303,7 +306,7 @@ void specularbrdf( const Renderer& /*renderer*/, const Grid& /*grid*/, std::shar
     }
 }
 
-void phong( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> normal, std::shared_ptr<Value> view, std::shared_ptr<Value> power_value )
+void phong( const Renderer& /*renderer*/, const Grid& grid, Value* result, const Value* normal, const Value* view, const Value* power_value )
 {
     REYES_ASSERT( result );
     REYES_ASSERT( normal );
@@ -313,7 +316,7 @@ void phong( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Valu
     result->reset( TYPE_COLOR, STORAGE_VARYING, grid.size() );
     result->zero();
     
-    std::shared_ptr<Value> P = grid.find_value( "P" );
+    const Value* P = &grid.value( IDENTIFIER_P );
     REYES_ASSERT( P );
     REYES_ASSERT( P->type() == TYPE_POINT );
     REYES_ASSERT( P->storage() == STORAGE_VARYING );
@@ -331,6 +334,7 @@ void phong( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Valu
         const vec3* views = view->vec3_values();
         const float power = power_value->float_value();
         const vec3* light_colors = light->color()->vec3_values();
+        const int light_color_stride = light->color()->storage() == STORAGE_UNIFORM ? 0 : 1;
         const int size = result->size();
 
         switch ( light->type() )
@@ -347,7 +351,7 @@ void phong( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Valu
                         const vec3 N = normalize( normals[i] );
                         if ( dot(N, L) >= 0.0f )
                         {
-                            const vec3& Cl = light_colors[i];
+                            const vec3& Cl = light_colors[i * light_color_stride];
                             const vec3& V = views[i];
                             const vec3 R = -V - 2.0f * dot(-V, N) * N;
                             colors[i] += Cl * powf( max(0.0f, dot(R, L)), power );
@@ -364,7 +368,7 @@ void phong( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Valu
                         const vec3 N = normalize( normals[i] );
                         if ( dot(N, L) >= 0.0f && dot(light_axis, -N) >= light_angle_cosine )
                         {
-                            const vec3& Cl = light_colors[i];
+                            const vec3& Cl = light_colors[i * light_color_stride];
                             const vec3& V = views[i];
                             const vec3 R = -V - 2.0f * dot(-V, N) * N;
                             colors[i] += Cl * powf( max(0.0f, dot(R, L)), power );
@@ -383,7 +387,7 @@ void phong( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Valu
                     const vec3 N = normalize( normals[i] );
                     if ( dot(N, L) >= 0.0f )
                     {
-                        const vec3& Cl = light_colors[i];
+                        const vec3& Cl = light_colors[i * light_color_stride];
                         const vec3& V = views[i];
                         const vec3 R = -V - 2.0f * dot(-V, N) * N;
                         colors[i] += Cl * powf( max(0.0f, dot(R, L)), power );
@@ -403,7 +407,7 @@ void phong( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Valu
                     const vec3 N = normalize( normals[i] );
                     if ( dot(N, L) >= 0.0f && dot(light_axis, -L) >= light_angle_cosine )
                     {
-                        const vec3& Cl = light_colors[i];
+                        const vec3& Cl = light_colors[i * light_color_stride];
                         const vec3& V = views[i];
                         const vec3 R = -V - 2.0f * dot(-V, N) * N;
                         colors[i] += Cl * powf( max(0.0f, dot(R, L)), power );
@@ -418,7 +422,7 @@ void phong( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Valu
     }
 }
 
-void trace( const Renderer& /*renderer*/, const Grid& grid, std::shared_ptr<Value> result, std::shared_ptr<Value> /*point*/, std::shared_ptr<Value> /*reflection*/ )
+void trace( const Renderer& /*renderer*/, const Grid& grid, Value* result, const Value* /*point*/, const Value* /*reflection*/ )
 {
     REYES_ASSERT( result );
     result->reset( TYPE_COLOR, STORAGE_VARYING, grid.size() );
@@ -0,0 +1,370 @@
+#ifndef REYES_SIMD_HPP_INCLUDED
+#define REYES_SIMD_HPP_INCLUDED
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define REYES_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <string.h>
+
+namespace reyes
+{
+
+//
+// Helpers shared by the typed kernels to process varying values four
+// elements at a time with SSE2.
+//
+// Varying values store tightly packed elements of one to four floats so a
+// group of four elements always fills exactly WIDTH SSE registers.  Uniform
+// operands are repeated into a matching pattern of WIDTH registers and
+// varying floats combined with wider elements are expanded across WIDTH
+// registers so that every kernel runs on whole registers and finishes any
+// remaining elements with a scalar loop.
+//
+// SSE2 is part of the x86-64 baseline so it is selected at compile time;
+// other targets use only the scalar loops.
+//
+
+struct SimdAdd
+{
+    float operator()( float lhs, float rhs ) const { return lhs + rhs; }
+#ifdef REYES_SIMD_SSE2
+    __m128 operator()( __m128 lhs, __m128 rhs ) const { return _mm_add_ps( lhs, rhs ); }
+#endif
+};
+
+struct SimdSubtract
+{
+    float operator()( float lhs, float rhs ) const { return lhs - rhs; }
+#ifdef REYES_SIMD_SSE2
+    __m128 operator()( __m128 lhs, __m128 rhs ) const { return _mm_sub_ps( lhs, rhs ); }
+#endif
+};
+
+struct SimdMultiply
+{
+    float operator()( float lhs, float rhs ) const { return lhs * rhs; }
+#ifdef REYES_SIMD_SSE2
+    __m128 operator()( __m128 lhs, __m128 rhs ) const { return _mm_mul_ps( lhs, rhs ); }
+#endif
+};
+
+struct SimdDivide
+{
+    float operator()( float lhs, float rhs ) const { return lhs / rhs; }
+#ifdef REYES_SIMD_SSE2
+    __m128 operator()( __m128 lhs, __m128 rhs ) const { return _mm_div_ps( lhs, rhs ); }
+#endif
+};
+
+#ifdef REYES_SIMD_SSE2
+
+/**
+// Repeat a uniform element of WIDTH floats across the WIDTH registers that
+// hold four varying elements.
+*/
+template <unsigned int WIDTH>
+inline void simd_repeat( const float* values, __m128* repeated )
+{
+    float pattern [4 * WIDTH];
+    for ( unsigned int i = 0; i < 4 * WIDTH; ++i )
+    {
+        pattern[i] = values[i % WIDTH];
+    }
+    for ( unsigned int i = 0; i < WIDTH; ++i )
+    {
+        repeated[i] = _mm_loadu_ps( pattern + i * 4 );
+    }
+}
+
+/**
+// Expand the four lanes of \e values so that each lane is repeated WIDTH
+// times across WIDTH registers.
+*/
+template <unsigned int WIDTH>
+inline void simd_expand( __m128 values, __m128* expanded );
+
+template <>
+inline void simd_expand<1>( __m128 values, __m128* expanded )
+{
+    expanded[0] = values;
+}
+
+template <>
+inline void simd_expand<2>( __m128 values, __m128* expanded )
+{
+    expanded[0] = _mm_shuffle_ps( values, values, _MM_SHUFFLE(1, 1, 0, 0) );
+    expanded[1] = _mm_shuffle_ps( values, values, _MM_SHUFFLE(3, 3, 2, 2) );
+}
+
+template <>
+inline void simd_expand<3>( __m128 values, __m128* expanded )
+{
+    expanded[0] = _mm_shuffle_ps( values, values, _MM_SHUFFLE(1, 0, 0, 0) );
+    expanded[1] = _mm_shuffle_ps( values, values, _MM_SHUFFLE(2, 2, 1, 1) );
+    expanded[2] = _mm_shuffle_ps( values, values, _MM_SHUFFLE(3, 3, 3, 2) );
+}
+
+template <>
+inline void simd_expand<4>( __m128 values, __m128* expanded )
+{
+    expanded[0] = _mm_shuffle_ps( values, values, _MM_SHUFFLE(0, 0, 0, 0) );
+    expanded[1] = _mm_shuffle_ps( values, values, _MM_SHUFFLE(1, 1, 1, 1) );
+    expanded[2] = _mm_shuffle_ps( values, values, _MM_SHUFFLE(2, 2, 2, 2) );
+    expanded[3] = _mm_shuffle_ps( values, values, _MM_SHUFFLE(3, 3, 3, 3) );
+}
+
+/**
+// Load four bytes of a condition mask as four lanes that are all ones where
+// the mask is set and all zeros where it is clear.
+*/
+inline __m128 simd_mask( const unsigned char* mask )
+{
+    int bytes = 0;
+    memcpy( &bytes, mask, sizeof(bytes) );
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lanes = _mm_unpacklo_epi8( _mm_cvtsi32_si128(bytes), zero );
+    lanes = _mm_unpacklo_epi16( lanes, zero );
+    return _mm_castsi128_ps( _mm_cmpgt_epi32(lanes, zero) );
+}
+
+/**
+// Select lanes from \e selected where \e mask is set and from
+// \e unselected elsewhere.
+*/
+inline __m128 simd_select( __m128 mask, __m128 selected, __m128 unselected )
+{
+    return _mm_or_ps( _mm_and_ps(mask, selected), _mm_andnot_ps(mask, unselected) );
+}
+
+#endif
+
+/**
+// Apply \e operation to \e count floats of two varying values of the same
+// width.
+*/
+template <class Operation>
+inline void simd_vv( Operation operation, float* result, const float* lhs, const float* rhs, unsigned int count )
+{
+    unsigned int i = 0;
+#ifdef REYES_SIMD_SSE2
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        _mm_storeu_ps( result + i, operation(_mm_loadu_ps(lhs + i), _mm_loadu_ps(rhs + i)) );
+    }
+#endif
+    for ( ; i < count; ++i )
+    {
+        result[i] = operation( lhs[i], rhs[i] );
+    }
+}
+
+/**
+// Apply \e operation to a uniform left hand side and \e length varying
+// elements of WIDTH floats on the right hand side.
+*/
+template <unsigned int WIDTH, class Operation>
+inline void simd_uv( Operation operation, float* result, const float* lhs, const float* rhs, unsigned int length )
+{
+    const unsigned int count = length * WIDTH;
+    unsigned int i = 0;
+#ifdef REYES_SIMD_SSE2
+    __m128 repeated [WIDTH];
+    simd_repeat<WIDTH>( lhs, repeated );
+    for ( ; i + 4 * WIDTH <= count; i += 4 * WIDTH )
+    {
+        for ( unsigned int j = 0; j < WIDTH; ++j )
+        {
+            _mm_storeu_ps( result + i + j * 4, operation(repeated[j], _mm_loadu_ps(rhs + i + j * 4)) );
+        }
+    }
+#endif
+    for ( ; i < count; ++i )
+    {
+        result[i] = operation( lhs[i % WIDTH], rhs[i] );
+    }
+}
+
+/**
+// Apply \e operation to \e length varying elements of WIDTH floats on the
+// left hand side and a uniform right hand side.
+*/
+template <unsigned int WIDTH, class Operation>
+inline void simd_vu( Operation operation, float* result, const float* lhs, const float* rhs, unsigned int length )
+{
+    const unsigned int count = length * WIDTH;
+    unsigned int i = 0;
+#ifdef REYES_SIMD_SSE2
+    __m128 repeated [WIDTH];
+    simd_repeat<WIDTH>( rhs, repeated );
+    for ( ; i + 4 * WIDTH <= count; i += 4 * WIDTH )
+    {
+        for ( unsigned int j = 0; j < WIDTH; ++j )
+        {
+            _mm_storeu_ps( result + i + j * 4, operation(_mm_loadu_ps(lhs + i + j * 4), repeated[j]) );
+        }
+    }
+#endif
+    for ( ; i < count; ++i )
+    {
+        result[i] = operation( lhs[i], rhs[i % WIDTH] );
+    }
+}
+
+/**
+// Apply \e operation to a uniform left hand side of WIDTH floats and
+// \e length varying floats on the right hand side.
+*/
+template <unsigned int WIDTH, class Operation>
+inline void simd_uv1( Operation operation, float* result, const float* lhs, const float* rhs, unsigned int length )
+{
+    unsigned int i = 0;
+#ifdef REYES_SIMD_SSE2
+    __m128 repeated [WIDTH];
+    simd_repeat<WIDTH>( lhs, repeated );
+    for ( ; i + 4 <= length; i += 4 )
+    {
+        __m128 expanded [WIDTH];
+        simd_expand<WIDTH>( _mm_loadu_ps(rhs + i), expanded );
+        for ( unsigned int j = 0; j < WIDTH; ++j )
+        {
+            _mm_storeu_ps( result + i * WIDTH + j * 4, operation(repeated[j], expanded[j]) );
+        }
+    }
+#endif
+    for ( ; i < length; ++i )
+    {
+        for ( unsigned int j = 0; j < WIDTH; ++j )
+        {
+            result[i * WIDTH + j] = operation( lhs[j], rhs[i] );
+        }
+    }
+}
+
+/**
+// Apply \e operation to \e length varying elements of WIDTH floats on the
+// left hand side and varying floats on the right hand side.
+*/
+template <unsigned int WIDTH, class Operation>
+inline void simd_vv1( Operation operation, float* result, const float* lhs, const float* rhs, unsigned int length )
+{
+    unsigned int i = 0;
+#ifdef REYES_SIMD_SSE2
+    for ( ; i + 4 <= length; i += 4 )
+    {
+        __m128 expanded [WIDTH];
+        simd_expand<WIDTH>( _mm_loadu_ps(rhs + i), expanded );
+        for ( unsigned int j = 0; j < WIDTH; ++j )
+        {
+            _mm_storeu_ps( result + i * WIDTH + j * 4, operation(_mm_loadu_ps(lhs + i * WIDTH + j * 4), expanded[j]) );
+        }
+    }
+#endif
+    for ( ; i < length; ++i )
+    {
+        for ( unsigned int j = 0; j < WIDTH; ++j )
+        {
+            result[i * WIDTH + j] = operation( lhs[i * WIDTH + j], rhs[i] );
+        }
+    }
+}
+
+/**
+// Assign \e length varying elements of WIDTH floats from \e rhs to
+// \e result where \e mask is set (or everywhere if \e mask is null).
+//
+// Groups of four elements that are entirely masked out are skipped and
+// groups that are entirely masked in are stored directly; other groups
+// blend the new and old values.
+*/
+template <unsigned int WIDTH>
+inline void simd_assign( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
+{
+    unsigned int i = 0;
+#ifdef REYES_SIMD_SSE2
+    for ( ; i + 4 <= length; i += 4 )
+    {
+        float* values = result + i * WIDTH;
+        const float* rhs_values = rhs + i * WIDTH;
+        const __m128 lanes = mask ? simd_mask( mask + i ) : _mm_castsi128_ps( _mm_set1_epi32(-1) );
+        const int bits = _mm_movemask_ps( lanes );
+        if ( bits == 0xf )
+        {
+            for ( unsigned int j = 0; j < WIDTH; ++j )
+            {
+                _mm_storeu_ps( values + j * 4, _mm_loadu_ps(rhs_values + j * 4) );
+            }
+        }
+        else if ( bits != 0 )
+        {
+            __m128 expanded [WIDTH];
+            simd_expand<WIDTH>( lanes, expanded );
+            for ( unsigned int j = 0; j < WIDTH; ++j )
+            {
+                _mm_storeu_ps( values + j * 4, simd_select(expanded[j], _mm_loadu_ps(rhs_values + j * 4), _mm_loadu_ps(values + j * 4)) );
+            }
+        }
+    }
+#endif
+    for ( ; i < length; ++i )
+    {
+        if ( !mask || mask[i] )
+        {
+            for ( unsigned int j = 0; j < WIDTH; ++j )
+            {
+                result[i * WIDTH + j] = rhs[i * WIDTH + j];
+            }
+        }
+    }
+}
+
+/**
+// Assign a uniform element of WIDTH floats to \e length varying elements
+// of \e result where \e mask is set (or everywhere if \e mask is null).
+*/
+template <unsigned int WIDTH>
+inline void simd_assign_uniform( float* result, const float* rhs, const unsigned char* mask, unsigned int length )
+{
+    unsigned int i = 0;
+#ifdef REYES_SIMD_SSE2
+    __m128 repeated [WIDTH];
+    simd_repeat<WIDTH>( rhs, repeated );
+    for ( ; i + 4 <= length; i += 4 )
+    {
+        float* values = result + i * WIDTH;
+        const __m128 lanes = mask ? simd_mask( mask + i ) : _mm_castsi128_ps( _mm_set1_epi32(-1) );
+        const int bits = _mm_movemask_ps( lanes );
+        if ( bits == 0xf )
+        {
+            for ( unsigned int j = 0; j < WIDTH; ++j )
+            {
+                _mm_storeu_ps( values + j * 4, repeated[j] );
+            }
+        }
+        else if ( bits != 0 )
+        {
+            __m128 expanded [WIDTH];
+            simd_expand<WIDTH>( lanes, expanded );
+            for ( unsigned int j = 0; j < WIDTH; ++j )
+            {
+                _mm_storeu_ps( values + j * 4, simd_select(expanded[j], repeated[j], _mm_loadu_ps(values + j * 4)) );
+            }
+        }
+    }
+#endif
+    for ( ; i < length; ++i )
+    {
+        if ( !mask || mask[i] )
+        {
+            for ( unsigned int j = 0; j < WIDTH; ++j )
+            {
+                result[i * WIDTH + j] = rhs[j];
+            }
+        }
+    }
+}
+
+}
+
+#endif
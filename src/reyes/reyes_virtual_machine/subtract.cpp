@@ -6,6 +6,7 @@
 #include "subtract.hpp"
 #include "Dispatch.hpp"
 #include "Instruction.hpp"
+#include "simd.hpp"
 #include <reyes/assert.hpp>
 
 namespace reyes
@@ -39,190 +40,134 @@ void subtract_u4u4( float* result, const float* lhs, const float* rhs, unsigned
 
 void subtract_u1v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i] = lhs[0] - rhs[i];
-    }
+    simd_uv<1>( SimdSubtract(), result, lhs, rhs, length );
 }
 
 void subtract_u2v2( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[0] - rhs[i * 2 + 0];
-        result[i * 2 + 1] = lhs[1] - rhs[i * 2 + 1];
-    }
+    simd_uv<2>( SimdSubtract(), result, lhs, rhs, length );
 }
 
 void subtract_u3v3( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[0] - rhs[i * 3 + 0];
-        result[i * 3 + 1] = lhs[1] - rhs[i * 3 + 1];
-        result[i * 3 + 2] = lhs[2] - rhs[i * 3 + 2];
-    }
+    simd_uv<3>( SimdSubtract(), result, lhs, rhs, length );
 }
 
 void subtract_u4v4( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[0] - rhs[i * 4 + 0];
-        result[i * 4 + 1] = lhs[1] - rhs[i * 4 + 1];
-        result[i * 4 + 2] = lhs[2] - rhs[i * 4 + 2];
-        result[i * 4 + 3] = lhs[3] - rhs[i * 4 + 3];
-    }
+    simd_uv<4>( SimdSubtract(), result, lhs, rhs, length );
 }
 
 void subtract_v1u1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i] = lhs[i] - rhs[0];
-    }
+    simd_vu<1>( SimdSubtract(), result, lhs, rhs, length );
 }
 
 void subtract_v2u2( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[i * 2 + 0] - rhs[0];
-        result[i * 2 + 1] = lhs[i * 2 + 1] - rhs[1];
-    }
+    simd_vu<2>( SimdSubtract(), result, lhs, rhs, length );
 }
 
 void subtract_v3u3( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[i * 3 + 0] - rhs[0];
-        result[i * 3 + 1] = lhs[i * 3 + 1] - rhs[1];
-        result[i * 3 + 2] = lhs[i * 3 + 2] - rhs[2];
-    }
+    simd_vu<3>( SimdSubtract(), result, lhs, rhs, length );
 }
 
 void subtract_v4u4( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[i * 4 + 0] - rhs[0];
-        result[i * 4 + 1] = lhs[i * 4 + 1] - rhs[1];
-        result[i * 4 + 2] = lhs[i * 4 + 2] - rhs[2];
-        result[i * 4 + 3] = lhs[i * 4 + 3] - rhs[3];
-    }
+    simd_vu<4>( SimdSubtract(), result, lhs, rhs, length );
 }
 
 void subtract_v1v1( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i] = lhs[i] - rhs[i];
-    }
+    simd_vv( SimdSubtract(), result, lhs, rhs, length );
 }
 
 void subtract_v2v2( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 2 + 0] = lhs[i * 2 + 0] - rhs[i * 2 + 0];
-        result[i * 2 + 1] = lhs[i * 2 + 1] - rhs[i * 2 + 1];
-    }
+    simd_vv( SimdSubtract(), result, lhs, rhs, length * 2 );
 }
 
 void subtract_v3v3( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 3 + 0] = lhs[i * 3 + 0] - rhs[i * 3 + 0];
-        result[i * 3 + 1] = lhs[i * 3 + 1] - rhs[i * 3 + 1];
-        result[i * 3 + 2] = lhs[i * 3 + 2] - rhs[i * 3 + 2];
-    }
+    simd_vv( SimdSubtract(), result, lhs, rhs, length * 3 );
 }
 
 void subtract_v4v4( float* result, const float* lhs, const float* rhs, unsigned int length )
 {
-    for ( unsigned int i = 0; i < length; ++i )
-    {
-        result[i * 4 + 0] = lhs[i * 4 + 0] - rhs[i * 4 + 0];
-        result[i * 4 + 1] = lhs[i * 4 + 1] - rhs[i * 4 + 1];
-        result[i * 4 + 2] = lhs[i * 4 + 2] - rhs[i * 4 + 2];
-        result[i * 4 + 3] = lhs[i * 4 + 3] - rhs[i * 4 + 3];
-    }
+    simd_vv( SimdSubtract(), result, lhs, rhs, length * 4 );
 }
 
-void subtract( int dispatch, float* result, const float* lhs, const float* rhs, unsigned int length )
+/**
+// Select the kernel that subtracts operands of the widths and storage 
+// described by a dispatch code.
+//
+// @return
+//  The kernel or null if there is no kernel for the dispatch code.
+*/
+BinaryKernel subtract_kernel( int dispatch )
 {
     switch ( dispatch )
     {
         case DISPATCH_U1U1:
-            subtract_u1u1( result, lhs, rhs, length );
-            break;
+            return subtract_u1u1;
 
         case DISPATCH_U2U2:
-            subtract_u2u2( result, lhs, rhs, length );
-            break;
+            return subtract_u2u2;
 
         case DISPATCH_U3U3:
-            subtract_u3u3( result, lhs, rhs, length );
-            break;
+            return subtract_u3u3;
 
         case DISPATCH_U4U4:
-            subtract_u4u4( result, lhs, rhs, length );
-            break;
+            return subtract_u4u4;
 
         case DISPATCH_U1V1:
-            subtract_u1v1( result, lhs, rhs, length );
-            break;
+            return subtract_u1v1;
 
         case DISPATCH_U2V2:
-            subtract_u2v2( result, lhs, rhs, length );
-            break;
+            return subtract_u2v2;
 
         case DISPATCH_U3V3:
-            subtract_u3v3( result, lhs, rhs, length );
-            break;
+            return subtract_u3v3;
 
         case DISPATCH_U4V4:
-            subtract_u4v4( result, lhs, rhs, length );
-            break;
+            return subtract_u4v4;
 
         case DISPATCH_V1U1:
-            subtract_v1u1( result, lhs, rhs, length );
-            break;
+            return subtract_v1u1;
 
         case DISPATCH_V2U2:
-            subtract_v2u2( result, lhs, rhs, length );
-            break;
+            return subtract_v2u2;
 
         case DISPATCH_V3U3:
-            subtract_v3u3( result, lhs, rhs, length );
-            break;
+            return subtract_v3u3;
 
         case DISPATCH_V4U4:
-            subtract_v4u4( result, lhs, rhs, length );
-            break;
+            return subtract_v4u4;
 
         case DISPATCH_V1V1:
-            subtract_v1v1( result, lhs, rhs, length );
-            break;
+            return subtract_v1v1;
 
         case DISPATCH_V2V2:
-            subtract_v2v2( result, lhs, rhs, length );
-            break;
+            return subtract_v2v2;
 
         case DISPATCH_V3V3:
-            subtract_v3v3( result, lhs, rhs, length );
-            break;
+            return subtract_v3v3;
 
         case DISPATCH_V4V4:
-            subtract_v4v4( result, lhs, rhs, length );
-            break;
+            return subtract_v4v4;
 
         default:
             REYES_ASSERT( false );
-            break;
+            return NULL;
     }    
 }
 
+void subtract( int dispatch, float* result, const float* lhs, const float* rhs, unsigned int length )
+{
+    BinaryKernel kernel = subtract_kernel( dispatch );
+    REYES_ASSERT( kernel );
+    (*kernel)( result, lhs, rhs, length );
+}
+
 }
@@ -1,9 +1,12 @@
 #ifndef REYES_SUBTRACT_HPP_INCLUDED
 #define REYES_SUBTRACT_HPP_INCLUDED
 
+#include "Kernel.hpp"
+
 namespace reyes
 {
 
+BinaryKernel subtract_kernel( int dispatch );
 void subtract( int dispatch, float* result, const float* lhs, const float* rhs, unsigned int length );
 
 }